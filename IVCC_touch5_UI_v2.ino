@@ -7,6 +7,14 @@
 #include "can_twai.h"
 #include "sd_logging.h"
 #include "rs485_vfdComs.h"
+#include "sensor_snapshot.h"
+#include "can_stats.h"
+#include "charge_control.h"
+#include "plant_sim.h"
+#include "pi_autotune.h"
+#include "ff_map.h"
+#include "safety_interlock.h"
+#include "charge_session.h"
 
 // Forward declarations for screen management functions
 extern void initialize_all_screens();
@@ -21,26 +29,9 @@ static const unsigned long HEARTBEAT_CHECK_INTERVAL_MS = 1000;
 // Forward declarations for screen management variables
 extern bool battery_detected;
 
-// Global sensor data struct
-struct sensor_data {
-    float volt = -3.0f;
-    float curr = -3.0f;
-    int32_t temp1 = 0;
-    int32_t temp2 = 0;
-    int32_t temp3 = 0;
-    int32_t temp4 = 0;
-} sensorData;
-
-// Time data from M2 struct
-struct time_from_m2 {
-    uint16_t year = 2010;
-    uint8_t month = 1;
-    uint8_t date = 1;
-    uint8_t day_of_week = 1; // 1=Sunday
-    uint8_t hour = 0;
-    uint8_t minute = 0;
-    uint8_t second = 0;
-} m2Time;
+// Loop-task copies of the M2 sensor/time snapshots (refreshed at the top of every loop pass)
+sensor_data sensorData;
+time_from_m2 m2Time;
 
 using namespace esp_panel::drivers;
 using namespace esp_panel::board;
@@ -93,18 +84,27 @@ void setup()
     }
     Serial.println("LVGL initialized successfully");
 
+    safety_interlock_init();
+
     Serial.println("Initializing CAN/TWAI");
     if (!init_can_twai()) {
         Serial.println("CAN initialization failed!");
     }
 
-    // Create CAN monitoring task (RTOS)
-    xTaskCreatePinnedToCore(can_task, "CAN_Task", 4096, NULL, 1, NULL, 1);
+    // Create CAN receive task (RTOS) - blocks on TWAI RX alerts, drains the RX queue per wakeup
+    xTaskCreatePinnedToCore(can_task, "CAN_Task", CAN_TASK_STACK_SIZE, NULL, CAN_TASK_PRIORITY, NULL, CAN_TASK_CORE);
+    // CAN transmit task - drains the urgent queue and the coalesced routine slots
+    xTaskCreatePinnedToCore(can_tx_task, "CAN_TX_Task", CAN_TX_TASK_STACK_SIZE, NULL, CAN_TX_TASK_PRIORITY, NULL, CAN_TASK_CORE);
     
     //initialise rs485 coms, with uart2 at pin 44,43 as tx,rx at 9600 baud.
     rs485_init();
+    // RS485 worker task - sends queued VFD commands (callers never block on the UART) and monitoring reads
+    xTaskCreatePinnedToCore(rs485_task, "RS485_Task", RS485_TASK_STACK_SIZE, NULL, RS485_TASK_PRIORITY, NULL, RS485_TASK_CORE);
     delay(100); // Small delay for serial stabilization
 
+    // Charge interrupted by a reset or power loss: found before the SD log so its open line is kept
+    charge_session_init();
+
     /* Initialize SD card before screens so screen 1 can show entry number from charge_log */
     initializeSDCard();
 
@@ -124,6 +124,17 @@ void setup()
     // Initialize battery profiles after SD card setup
     initializeBatteryProfiles();
 
+    // Charging control task - runs the charging FSM on a fixed period, independent of loop()/LVGL timing
+    charge_control_init();
+    xTaskCreatePinnedToCore(charge_control_task, "Charge_Ctrl_Task", CHARGE_CONTROL_TASK_STACK_SIZE, NULL,
+                            CHARGE_CONTROL_TASK_PRIORITY, NULL, CHARGE_CONTROL_TASK_CORE);
+
+#if PLANT_SIM
+    // Simulated M2/VFD/battery in place of the hardware (connect a battery with "simbatt")
+    xTaskCreatePinnedToCore(plant_sim_task, "Plant_Sim_Task", PLANT_SIM_TASK_STACK_SIZE, NULL,
+                            PLANT_SIM_TASK_PRIORITY, NULL, PLANT_SIM_TASK_CORE);
+#endif
+
     //give 200ms delay and send a contactor open cmd over can bus.
     delay(200);
     send_contactor_control(CONTACTOR_OPEN);
@@ -135,7 +146,15 @@ void loop()
 {
     //Serial.println("IDLE loop");
     //check serial rx buffer. (for input cmds. ) and print .
-    //process_serial_cmd(); //remove in production
+#if PLANT_SIM
+    process_serial_cmd();  // Simulator console (simbatt/simstat, voltage input) and the diagnostics
+#else
+    process_serial_diag();  // Read-only diagnostics (canstats, mbstats, ...)
+#endif
+
+    // Take one consistent copy of the latest M2 sample for this pass (written by CAN task)
+    sensor_snapshot_read(&sensorData);
+    m2Time = m2_time_snapshot_get();
 
     // Periodic screen state check (non-blocking)
     update_screen_based_on_state();
@@ -155,10 +174,70 @@ void loop()
         last_heartbeat_check_ms = millis();
     }
 
+    // NVS writes of freshly tuned PI gains / learned feed-forward map (kept out of the control task)
+    pi_tuning_service();
+    ff_map_service();
+
+    // Report an interlock trip and its frame-to-bus latency (the trip itself ran in the CAN task)
+    safety_interlock_service();
+
+    // Session checkpoint to NVS; resume an interrupted charge once the battery re-check passes
+    charge_session_service();
+    {
+        static charge_session_record_t session;  // Too big for the loop stack
+        BatteryType* battery = nullptr;
+        if (charge_session_take_resume(&battery, &session)) {
+            resume_charge_session(battery, &session);
+        }
+    }
+
     delay(100); // 10Hz loop frequency (100ms = 10 times per second)
 }
 
-// Process serial commands - mainly for voltage input
+// Read-only diagnostics, in every build. Returns false if cmd is not one of them.
+bool process_diag_cmd(const String& cmd) {
+    if (cmd.equalsIgnoreCase("canstats")) {
+        can_stats_dump();
+    } else if (cmd.equalsIgnoreCase("mbstats")) {
+        rs485_dump_stats();
+    } else if (cmd.equalsIgnoreCase("interlock")) {
+        safety_interlock_dump_stats();
+    } else if (cmd.equalsIgnoreCase("ctlstats")) {
+        charge_control_dump_stats();
+    } else if (cmd.equalsIgnoreCase("pitune")) {
+        pi_tuning_dump();
+    } else if (cmd.equalsIgnoreCase("ffmap")) {
+        ff_map_dump();
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void print_diag_help() {
+    Serial.println("  canstats - Dump CAN bus statistics");
+    Serial.println("  mbstats  - Dump VFD status and Modbus statistics");
+    Serial.println("  interlock - Dump hard-limit interlock trips and latency");
+    Serial.println("  ctlstats - Dump charging control period/execution statistics");
+    Serial.println("  pitune   - Show auto-tuned PI gains of the selected profile");
+    Serial.println("  ffmap    - Show the learned frequency->current map of the selected profile");
+}
+
+// Production console: diagnostics only, nothing here changes the charger's state
+void process_serial_diag() {
+    if (Serial.available() > 0) {
+        String cmd = Serial.readStringUntil('\n');
+        cmd.trim();
+        if (cmd.length() > 0 && !process_diag_cmd(cmd)) {
+            Serial.println("Diagnostic commands:");
+            print_diag_help();
+        }
+    }
+}
+
+#if PLANT_SIM
+// Simulator console: the diagnostics, plus commands that change state (voltage input,
+// simulated battery, clearing learned gains/maps)
 void process_serial_cmd() {
     if (Serial.available() > 0) {
         String cmd = Serial.readStringUntil('\n');
@@ -169,6 +248,38 @@ void process_serial_cmd() {
         Serial.print(cmd);
         Serial.println("'");
 
+        if (process_diag_cmd(cmd)) {
+            return;
+        }
+        if (cmd.equalsIgnoreCase("pitune clear")) {
+            pi_tuning_clear_all();
+            return;
+        }
+        if (cmd.equalsIgnoreCase("ffmap clear")) {
+            ff_map_clear_all();
+            return;
+        }
+        // simbatt <profile index> [soc%] | simbatt off
+        if (cmd.startsWith("simbatt")) {
+            String arg = cmd.substring(7);
+            arg.trim();
+            if (arg.equalsIgnoreCase("off")) {
+                plant_sim_connect_battery(-1, 0.0f);
+            } else {
+                int space = arg.indexOf(' ');
+                int index = (space < 0 ? arg : arg.substring(0, space)).toInt();
+                float soc = (space < 0) ? (float)PLANT_SIM_DEFAULT_SOC : arg.substring(space + 1).toFloat();
+                if (!plant_sim_connect_battery(index, soc)) {
+                    Serial.printf("[SIM] No battery profile %d\n", index);
+                }
+            }
+            return;
+        }
+        if (cmd.equalsIgnoreCase("simstat")) {
+            plant_sim_dump();
+            return;
+        }
+
         // Check if command ends with 'v' or 'V' (voltage command)
         if (cmd.length() > 0 && (cmd.charAt(cmd.length() - 1) == 'v' || cmd.charAt(cmd.length() - 1) == 'V')) {
             // Remove the 'v' and parse as float
@@ -177,7 +288,9 @@ void process_serial_cmd() {
 
             // Basic validation - voltage should be reasonable (0-100V range)
             if (voltValue > 0 && voltValue <= 100) {
-                sensorData.volt = voltValue;
+                sensor_snapshot_publish_vi(voltValue, sensorData.curr, (uint32_t) millis());
+                charge_control_notify_sample();
+                sensor_snapshot_read(&sensorData);
                 Serial.print("Voltage updated to: ");
                 Serial.print(sensorData.volt);
                 Serial.println("V");
@@ -199,10 +312,16 @@ void process_serial_cmd() {
             Serial.println("Valid commands:");
             Serial.println("  12.3v  - Set voltage to 12.3V");
             Serial.println("  45v    - Set voltage to 45V");
+            print_diag_help();
+            Serial.println("  pitune clear - Forget all auto-tuned gains (next charges re-tune)");
+            Serial.println("  ffmap clear - Forget all learned maps");
+            Serial.println("  simbatt <n> [soc%] / simbatt off - Connect/remove a simulated battery");
+            Serial.println("  simstat  - Dump the simulated plant");
             Serial.println("  (voltage must be 0.1-100V)");
         }
     }
 }
+#endif
 
 //initialize SD card, call at end of setup. 
 void initializeSDCard() {
@@ -237,8 +356,8 @@ void initializeSDCard() {
     uint64_t cardSize = SD.cardSize() / (1024 * 1024);
     Serial.printf("SD Card Size: %lluMB\n", cardSize); // SD card size
 
-    // Initialize charge logging first
-    if (initChargeLogging()) {
+    // Initialize charge logging first (an interrupted charge's open line stays open for its resume)
+    if (initChargeLogging(charge_session_pending())) {
         // Only set flag to true if charge logging initialization succeeds
         sd_logging_initialized = true;
         Serial.println("SD card initialized successfully, logging enabled");
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <lvgl.h>
+#include "charge_plan.h"
 
 // ============================================================0================
 // Battery Type Class Definition
@@ -14,6 +15,7 @@ This class represents different battery configurations for the charger.
 - Capacity: 2Ah to 565Ah
 - Cutoff voltage: 16V to 480V (configurable per battery)
 - Constant current: Configurable per battery
+- Charge plan: ordered charge stages (charge_plan.h); by default the standard plan
 */
 
 enum BatteryChemistry {
@@ -31,13 +33,16 @@ private:
     float constCurrent;         // Target charging current in CC mode
     String batteryName;         // User given name for UI; max 32 chars recommended
     String displayName;        // Display name for UI (e.g. "24V LA 20Ah")
+    uint8_t chargePlan;         // charge_plan_id_t
 
 public:
-    // Constructor; name optional — if blank/null, batteryName becomes "<un_named warning>"
+    // Constructor; name optional — if blank/null, batteryName becomes "<un_named warning>".
+    // Plan optional — standard unless the pack needs another.
     BatteryType(BatteryChemistry chem, uint16_t voltage, uint16_t ah,
-                float cutoff, float current, const char* name = nullptr)
+                float cutoff, float current, const char* name = nullptr,
+                charge_plan_id_t plan = CHARGE_PLAN_STANDARD)
         : chemistry(chem), ratedVoltage(voltage), ratedAh(ah),
-          cutoffVoltage(cutoff), constCurrent(current) {
+          cutoffVoltage(cutoff), constCurrent(current), chargePlan(plan) {
         if (name != nullptr && name[0] != '\0') {
             batteryName = String(name);
         } else {
@@ -55,6 +60,7 @@ public:
     uint16_t getRatedAh() const { return ratedAh; }
     float getCutoffVoltage() const { return cutoffVoltage; }
     float getConstCurrent() const { return constCurrent; }
+    uint8_t getChargePlan() const { return chargePlan; }
     String getDisplayName() const { return displayName; }
     // Same format as getDisplayName() but chemistry shown as 鉛 for LEAD_ACID on Japanese UI
     String getDisplayNameForJapanese() const {
@@ -64,9 +70,25 @@ public:
     }
     String getBatteryName() const { return batteryName; }
 
+    // Stable id for per-profile data kept in NVS (FNV-1a of name, rated voltage and Ah),
+    // so reordering or adding profiles keeps learned data with its profile
+    uint32_t getStorageId() const {
+        uint32_t hash = 2166136261u;
+        for (unsigned int i = 0; i < batteryName.length(); i++) {
+            hash = (hash ^ (uint8_t) batteryName.charAt(i)) * 16777619u;
+        }
+        const uint16_t values[2] = { ratedVoltage, ratedAh };
+        const uint8_t* bytes = (const uint8_t*) values;
+        for (size_t i = 0; i < sizeof(values); i++) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        return hash;
+    }
+
     // Setters (for manual configuration)
     void setCutoffVoltage(float voltage) { cutoffVoltage = voltage; }
     void setConstCurrent(float current) { constCurrent = current; }
+    void setChargePlan(charge_plan_id_t plan) { chargePlan = plan; }
     // Set battery name; blank/empty is stored as "<un_named warning>". Max 32 chars recommended.
     void setBatteryName(const String& name) {
         String t = name;
@@ -0,0 +1,293 @@
+#ifndef CAN_FRAMES_H
+#define CAN_FRAMES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+#include <utility>
+#include <driver/twai.h>
+
+// ============================================================================
+// Compile-time CAN frame registry
+// ============================================================================
+/*
+Each received frame is described once: ID, minimum DLC and a list of big-endian
+fields with their scaling. From a constexpr array of descriptors the templates
+below generate one decoder per frame (layout known at compile time, loop
+unrolled) and an ID-sorted dispatch table searched with a binary search.
+The sink of a frame gets the decoded field values in descriptor order.
+
+Adding a frame = one descriptor entry + its sink function.
+*/
+
+#define CAN_FRAME_MAX_FIELDS 8
+#define CAN_STD_ID_MAX       0x7FF   // Registry holds standard (11-bit) frames only
+
+// Unit of a decoded value (after scaling). Raw M2 values are already in these units.
+typedef enum : uint8_t {
+    CAN_UNIT_RAW = 0,
+    CAN_UNIT_CENTIVOLT,    // 0.01 V
+    CAN_UNIT_CENTIAMP,     // 0.01 A
+    CAN_UNIT_CENTIDEGREE,  // 0.01 °C
+} can_unit_t;
+
+typedef struct {
+    uint8_t offset;     // First byte in data[]
+    uint8_t width;      // 1 or 2 bytes (2 = big-endian)
+    bool is_signed;
+    can_unit_t unit;
+    int16_t scale_num;  // value = raw * scale_num / scale_den
+    int16_t scale_den;
+} can_field_desc_t;
+
+// Called with the decoded values (field order) and millis() at reception
+typedef void (*can_frame_sink_t)(const int32_t* values, uint32_t rx_ms);
+
+typedef struct {
+    uint32_t identifier;
+    uint8_t min_dlc;
+    uint8_t field_count;
+    can_field_desc_t fields[CAN_FRAME_MAX_FIELDS];
+    can_frame_sink_t sink;
+    const char* name;
+} can_frame_desc_t;
+
+// Returns false if the frame is shorter than min_dlc (nothing decoded)
+typedef bool (*can_frame_decoder_t)(const twai_message_t* message, uint32_t rx_ms);
+
+typedef struct {
+    uint32_t identifier;
+    uint8_t index;                // Position in the descriptor array
+    can_frame_decoder_t decode;
+} can_dispatch_entry_t;
+
+// Field helpers for descriptor tables
+constexpr can_field_desc_t can_u8(uint8_t offset, can_unit_t unit = CAN_UNIT_RAW) {
+    return { offset, 1, false, unit, 1, 1 };
+}
+constexpr can_field_desc_t can_u16be(uint8_t offset, can_unit_t unit = CAN_UNIT_RAW, int16_t num = 1, int16_t den = 1) {
+    return { offset, 2, false, unit, num, den };
+}
+constexpr can_field_desc_t can_s16be(uint8_t offset, can_unit_t unit = CAN_UNIT_RAW, int16_t num = 1, int16_t den = 1) {
+    return { offset, 2, true, unit, num, den };
+}
+
+constexpr int32_t can_decode_field(const can_field_desc_t& field, const uint8_t* data) {
+    int32_t raw = 0;
+    if (field.width == 1) {
+        raw = field.is_signed ? (int32_t)(int8_t)data[field.offset] : (int32_t)data[field.offset];
+    } else {
+        uint16_t word = (uint16_t)((data[field.offset] << 8) | data[field.offset + 1]);
+        raw = field.is_signed ? (int32_t)(int16_t)word : (int32_t)word;
+    }
+    if (field.scale_num == 1 && field.scale_den == 1) {
+        return raw;
+    }
+    return raw * field.scale_num / field.scale_den;
+}
+
+// Descriptor table checks, used in static_assert next to the table
+template <size_t N>
+constexpr bool can_frames_valid(const std::array<can_frame_desc_t, N>& frames) {
+    for (size_t i = 0; i < N; i++) {
+        const can_frame_desc_t& frame = frames[i];
+        if (frame.identifier > CAN_STD_ID_MAX || frame.min_dlc > 8 || frame.field_count > CAN_FRAME_MAX_FIELDS) {
+            return false;
+        }
+        for (size_t f = 0; f < frame.field_count; f++) {
+            const can_field_desc_t& field = frame.fields[f];
+            if ((field.width != 1 && field.width != 2) || field.scale_den == 0) {
+                return false;
+            }
+            // Every field must lie inside the guaranteed DLC
+            if (field.offset + field.width > frame.min_dlc) {
+                return false;
+            }
+        }
+        for (size_t j = i + 1; j < N; j++) {
+            if (frames[j].identifier == frame.identifier) {
+                return false;  // Duplicate ID
+            }
+        }
+    }
+    return true;
+}
+
+// Generated decoder for frames[I]: DLC check, unrolled field decode, sink call.
+template <const auto& Frames, size_t I>
+bool can_decode_frame(const twai_message_t* message, uint32_t rx_ms) {
+    constexpr const can_frame_desc_t& frame = Frames[I];
+    if (message->data_length_code < frame.min_dlc) {
+        return false;
+    }
+    int32_t values[frame.field_count > 0 ? frame.field_count : 1] = {0};
+    for (size_t f = 0; f < frame.field_count; f++) {
+        values[f] = can_decode_field(frame.fields[f], message->data);
+    }
+    if (frame.sink != nullptr) {
+        frame.sink(values, rx_ms);
+    }
+    return true;
+}
+
+template <size_t N>
+constexpr std::array<can_dispatch_entry_t, N> can_sort_dispatch(std::array<can_dispatch_entry_t, N> table) {
+    for (size_t i = 1; i < N; i++) {
+        can_dispatch_entry_t key = table[i];
+        size_t j = i;
+        while (j > 0 && table[j - 1].identifier > key.identifier) {
+            table[j] = table[j - 1];
+            j--;
+        }
+        table[j] = key;
+    }
+    return table;
+}
+
+template <const auto& Frames, size_t... I>
+constexpr std::array<can_dispatch_entry_t, sizeof...(I)> can_make_dispatch_impl(std::index_sequence<I...>) {
+    return can_sort_dispatch<sizeof...(I)>({{ { Frames[I].identifier, (uint8_t)I, &can_decode_frame<Frames, I> }... }});
+}
+
+// ID-sorted dispatch table for a constexpr descriptor array
+template <const auto& Frames>
+constexpr auto can_make_dispatch() {
+    return can_make_dispatch_impl<Frames>(std::make_index_sequence<std::tuple_size<std::remove_reference_t<decltype(Frames)>>::value>{});
+}
+
+// Binary search in a sorted dispatch table; nullptr if the ID is not registered
+template <size_t N>
+constexpr const can_dispatch_entry_t* can_find_dispatch(const std::array<can_dispatch_entry_t, N>& table, uint32_t identifier) {
+    size_t lo = 0;
+    size_t hi = N;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (table[mid].identifier == identifier) {
+            return &table[mid];
+        }
+        if (table[mid].identifier < identifier) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return nullptr;
+}
+
+// ============================================================================
+// Acceptance filter
+// ============================================================================
+/*
+TWAI filter bit layout for standard (11-bit) frames, mask bit 1 = don't care:
+  single filter: ID = bits 31..21, RTR = bit 20, data bytes 1-2 = bits 15..0
+  dual filter:   filter 1: ID = bits 31..21, RTR = bit 20, data byte 1 = bits 19..16 + 3..0
+                 filter 2: ID = bits 15..5,  RTR = bit 4
+A group of IDs fits one filter with code = any member and mask = OR of (member XOR code);
+that filter then passes 2^popcount(mask) IDs. The single filter or the split into two
+groups that passes the fewest IDs is chosen at compile time. RTR is never masked, so
+remote frames are rejected in hardware; whatever else slips through (unregistered IDs
+covered by a mask, extended frames) is rejected by the software post-filter.
+*/
+
+#define CAN_FILTER_MAX_IDS 16   // Partition search is 2^(N-1)
+
+typedef struct {
+    uint32_t code;
+    uint32_t mask;
+} can_id_group_t;
+
+constexpr uint32_t can_id_span(uint32_t mask) {
+    uint32_t span = 1;
+    for (; mask != 0; mask &= mask - 1) {
+        span <<= 1;
+    }
+    return span;
+}
+
+// Smallest code/mask covering the frames whose bit is set in members
+template <size_t N>
+constexpr can_id_group_t can_id_group(const std::array<can_frame_desc_t, N>& frames, uint32_t members) {
+    can_id_group_t group = { 0, 0 };
+    bool first = true;
+    for (size_t i = 0; i < N; i++) {
+        if ((members & (1u << i)) == 0) {
+            continue;
+        }
+        if (first) {
+            group.code = frames[i].identifier;
+            first = false;
+        } else {
+            group.mask |= frames[i].identifier ^ group.code;
+        }
+    }
+    group.code &= ~group.mask;
+    return group;
+}
+
+template <size_t N>
+constexpr twai_filter_config_t can_make_filter(const std::array<can_frame_desc_t, N>& frames) {
+    static_assert(N > 0 && N <= CAN_FILTER_MAX_IDS, "CAN filter: registry size out of range");
+    const uint32_t all = (uint32_t)((1ull << N) - 1);
+
+    can_id_group_t single = can_id_group(frames, all);
+    uint32_t best_span = can_id_span(single.mask);
+    uint32_t best_split = 0;
+
+    // Frame N-1 always goes to filter 2, so each split is tried once
+    for (uint32_t split = 1; split < (1u << (N - 1)); split++) {
+        can_id_group_t a = can_id_group(frames, split);
+        can_id_group_t b = can_id_group(frames, all & ~split);
+        uint32_t span = can_id_span(a.mask) + can_id_span(b.mask);
+        if (span < best_span) {
+            best_span = span;
+            best_split = split;
+        }
+    }
+
+    twai_filter_config_t filter = { 0, 0, true };
+    if (best_split == 0) {
+        filter.acceptance_code = single.code << 21;
+        filter.acceptance_mask = (single.mask << 21) | 0x000FFFFF;
+        filter.single_filter = true;
+    } else {
+        can_id_group_t a = can_id_group(frames, best_split);
+        can_id_group_t b = can_id_group(frames, all & ~best_split);
+        filter.acceptance_code = (a.code << 21) | (b.code << 5);
+        filter.acceptance_mask = (a.mask << 21) | 0x000F000F | (b.mask << 5);
+        filter.single_filter = false;
+    }
+    return filter;
+}
+
+// Would a standard data frame with this ID pass the filter?
+constexpr bool can_filter_accepts(const twai_filter_config_t& filter, uint32_t identifier) {
+    if (filter.single_filter) {
+        return (((identifier << 21) ^ filter.acceptance_code) & ~filter.acceptance_mask & 0xFFF00000) == 0;
+    }
+    bool pass1 = (((identifier << 21) ^ filter.acceptance_code) & ~filter.acceptance_mask & 0xFFF00000) == 0;
+    bool pass2 = (((identifier << 5) ^ filter.acceptance_code) & ~filter.acceptance_mask & 0x0000FFF0) == 0;
+    return pass1 || pass2;
+}
+
+template <size_t N>
+constexpr bool can_filter_covers(const twai_filter_config_t& filter, const std::array<can_frame_desc_t, N>& frames) {
+    for (size_t i = 0; i < N; i++) {
+        if (!can_filter_accepts(filter, frames[i].identifier)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Number of 11-bit IDs the filter lets through (registered + foreign)
+constexpr uint32_t can_filter_accepted_ids(const twai_filter_config_t& filter) {
+    uint32_t count = 0;
+    for (uint32_t identifier = 0; identifier < 0x800; identifier++) {
+        if (can_filter_accepts(filter, identifier)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+#endif // CAN_FRAMES_H
@@ -0,0 +1,182 @@
+#include "can_stats.h"
+#include "can_twai.h"
+#include <atomic>
+
+typedef struct {
+    uint32_t identifier;
+    const char* name;
+    std::atomic<uint32_t> rx_count;
+    std::atomic<uint32_t> last_rx_us;
+    LatencyHist interval_us;
+} can_id_stats_t;
+
+static can_id_stats_t id_stats[CAN_STATS_MAX_IDS];
+
+// Receive path
+static std::atomic<uint32_t> rx_rejected(0);
+static std::atomic<uint32_t> rx_short_dlc(0);
+static std::atomic<uint32_t> rx_queue_full(0);
+static std::atomic<uint32_t> rx_fifo_overrun(0);
+static std::atomic<uint32_t> rx_queue_hwm(0);
+
+// Transmit path
+static std::atomic<uint32_t> tx_ok(0);
+static std::atomic<uint32_t> tx_timeout(0);   // TX queue stayed full for the whole wait
+static std::atomic<uint32_t> tx_fail(0);      // Any other twai_transmit error
+static std::atomic<uint32_t> tx_coalesced(0);
+static std::atomic<uint32_t> tx_urgent_full(0);
+static std::atomic<uint32_t> tx_routine_full(0);
+static std::atomic<uint32_t> tx_urgent_held(0);   // Urgent frame held for re-sending
+static LatencyHist tx_urgent_latency_us;
+static LatencyHist tx_routine_latency_us;
+
+// Controller health (alert counts + last status sample)
+static std::atomic<uint32_t> alert_bus_error(0);
+static std::atomic<uint32_t> alert_err_passive(0);
+static std::atomic<uint32_t> alert_bus_off(0);
+static std::atomic<uint32_t> alert_recovered(0);
+static twai_status_info_t last_status;
+static portMUX_TYPE status_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void counter_add(std::atomic<uint32_t>& counter) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+void can_stats_register(uint8_t slot, uint32_t identifier, const char* name) {
+    if (slot >= CAN_STATS_MAX_IDS) {
+        return;
+    }
+    id_stats[slot].identifier = identifier;
+    id_stats[slot].name = name;
+}
+
+void can_stats_rx(uint8_t slot, uint32_t rx_us) {
+    if (slot >= CAN_STATS_MAX_IDS) {
+        return;
+    }
+    can_id_stats_t& stats = id_stats[slot];
+    uint32_t previous = stats.last_rx_us.exchange(rx_us, std::memory_order_relaxed);
+    if (stats.rx_count.fetch_add(1, std::memory_order_relaxed) != 0) {
+        stats.interval_us.record(rx_us - previous);
+    }
+}
+
+void can_stats_rx_rejected(void) {
+    counter_add(rx_rejected);
+}
+
+void can_stats_rx_short_dlc(void) {
+    counter_add(rx_short_dlc);
+}
+
+uint32_t can_stats_rx_rejected_count(void) {
+    return rx_rejected.load(std::memory_order_relaxed);
+}
+
+void can_stats_tx_result(esp_err_t result) {
+    if (result == ESP_OK) {
+        counter_add(tx_ok);
+    } else if (result == ESP_ERR_TIMEOUT) {
+        counter_add(tx_timeout);
+    } else {
+        counter_add(tx_fail);
+    }
+}
+
+void can_stats_tx_latency(bool urgent, uint32_t latency_us) {
+    (urgent ? tx_urgent_latency_us : tx_routine_latency_us).record(latency_us);
+}
+
+void can_stats_tx_coalesced(void) {
+    counter_add(tx_coalesced);
+}
+
+void can_stats_tx_queue_full(bool urgent) {
+    counter_add(urgent ? tx_urgent_full : tx_routine_full);
+}
+
+void can_stats_tx_urgent_held(void) {
+    counter_add(tx_urgent_held);
+}
+
+void can_stats_alerts(uint32_t alerts) {
+    if (alerts & TWAI_ALERT_RX_QUEUE_FULL)  counter_add(rx_queue_full);
+    if (alerts & TWAI_ALERT_RX_FIFO_OVERRUN) counter_add(rx_fifo_overrun);
+    if (alerts & TWAI_ALERT_BUS_ERROR)      counter_add(alert_bus_error);
+    if (alerts & TWAI_ALERT_ERR_PASS)       counter_add(alert_err_passive);
+    if (alerts & TWAI_ALERT_BUS_OFF)        counter_add(alert_bus_off);
+    if (alerts & TWAI_ALERT_BUS_RECOVERED)  counter_add(alert_recovered);
+}
+
+// Called by can_task before draining, so msgs_to_rx is the queue depth at wakeup
+void can_stats_sample_status(void) {
+    twai_status_info_t status;
+    if (twai_get_status_info(&status) != ESP_OK) {
+        return;
+    }
+    uint32_t seen = rx_queue_hwm.load(std::memory_order_relaxed);
+    while (status.msgs_to_rx > seen &&
+           !rx_queue_hwm.compare_exchange_weak(seen, status.msgs_to_rx, std::memory_order_relaxed)) {
+    }
+    portENTER_CRITICAL(&status_mux);
+    last_status = status;
+    portEXIT_CRITICAL(&status_mux);
+}
+
+const LatencyHist* can_stats_interval_hist(uint32_t identifier) {
+    for (uint8_t slot = 0; slot < CAN_STATS_MAX_IDS; slot++) {
+        if (id_stats[slot].name != NULL && id_stats[slot].identifier == identifier) {
+            return &id_stats[slot].interval_us;
+        }
+    }
+    return NULL;
+}
+
+static const char* twai_state_name(twai_state_t state) {
+    switch (state) {
+        case TWAI_STATE_STOPPED:    return "STOPPED";
+        case TWAI_STATE_RUNNING:    return "RUNNING";
+        case TWAI_STATE_BUS_OFF:    return "BUS_OFF";
+        case TWAI_STATE_RECOVERING: return "RECOVERING";
+        default:                    return "?";
+    }
+}
+
+void can_stats_dump(void) {
+    twai_status_info_t status;
+    portENTER_CRITICAL(&status_mux);
+    status = last_status;
+    portEXIT_CRITICAL(&status_mux);
+
+    uint32_t now_us = (uint32_t) micros();
+    Serial.printf("[CANSTATS] ===== CAN statistics (uptime %lu s) =====\n", (unsigned long)(millis() / 1000));
+    Serial.printf("[CANSTATS] TX ok=%u timeout=%u fail=%u coalesced=%u queue_full urgent=%u routine=%u urgent_held=%u\n",
+                 tx_ok.load(), tx_timeout.load(), tx_fail.load(), tx_coalesced.load(),
+                 tx_urgent_full.load(), tx_routine_full.load(), tx_urgent_held.load());
+    tx_urgent_latency_us.print("CANSTATS", "TX urgent latency", "us");
+    tx_routine_latency_us.print("CANSTATS", "TX routine latency", "us");
+    Serial.printf("[CANSTATS] RX queue hwm=%u/%u full=%u fifo_overrun=%u sw_rejected=%u short_dlc=%u\n",
+                 rx_queue_hwm.load(), (unsigned)CAN_RX_QUEUE_LEN, rx_queue_full.load(), rx_fifo_overrun.load(),
+                 rx_rejected.load(), rx_short_dlc.load());
+    Serial.printf("[CANSTATS] Controller %s tec=%u rec=%u bus_err=%u arb_lost=%u tx_failed=%u rx_missed=%u rx_overrun=%u\n",
+                 twai_state_name(status.state), status.tx_error_counter, status.rx_error_counter,
+                 status.bus_error_count, status.arb_lost_count, status.tx_failed_count,
+                 status.rx_missed_count, status.rx_overrun_count);
+    Serial.printf("[CANSTATS] Alerts bus_error=%u err_passive=%u bus_off=%u recovered=%u\n",
+                 alert_bus_error.load(), alert_err_passive.load(), alert_bus_off.load(), alert_recovered.load());
+
+    for (uint8_t slot = 0; slot < CAN_STATS_MAX_IDS; slot++) {
+        can_id_stats_t& stats = id_stats[slot];
+        if (stats.name == NULL) {
+            continue;
+        }
+        uint32_t count = stats.rx_count.load(std::memory_order_relaxed);
+        if (count == 0) {
+            Serial.printf("[CANSTATS] 0x%03X %s: none received\n", stats.identifier, stats.name);
+            continue;
+        }
+        Serial.printf("[CANSTATS] 0x%03X %s: count=%u last=%u ms ago\n", stats.identifier, stats.name, count,
+                     (now_us - stats.last_rx_us.load(std::memory_order_relaxed)) / 1000);
+        stats.interval_us.print("CANSTATS", "  interval", "us");
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef CAN_STATS_H
+#define CAN_STATS_H
+
+#include <Arduino.h>
+#include <driver/twai.h>
+#include "latency_hist.h"
+
+// ============================================================================
+// CAN bus statistics
+// ============================================================================
+// Fixed-size, lock-free counters for the receive path, transmit results and TWAI
+// controller health. Updated from can_task and senders, dumped over Serial
+// (serial command "canstats", in every build, and on entering the M2 lost screen).
+
+#define CAN_STATS_MAX_IDS   8     // Per-ID slots (one per registered receive frame)
+
+// Receive path
+void can_stats_register(uint8_t slot, uint32_t identifier, const char* name);
+void can_stats_rx(uint8_t slot, uint32_t rx_us);   // Frame decoded; records count and inter-arrival time
+void can_stats_rx_rejected(void);                  // Dropped by the software post-filter
+void can_stats_rx_short_dlc(void);                 // Registered ID with DLC below min_dlc
+uint32_t can_stats_rx_rejected_count(void);
+
+// Transmit path (result of twai_transmit, enqueue-to-controller latency, queue events)
+void can_stats_tx_result(esp_err_t result);
+void can_stats_tx_latency(bool urgent, uint32_t latency_us);
+void can_stats_tx_coalesced(void);                 // Pending routine frame replaced by newer data
+void can_stats_tx_queue_full(bool urgent);         // Enqueue rejected
+void can_stats_tx_urgent_held(void);               // Urgent frame held for re-sending (queue full or not sent)
+
+// Controller health: alerts returned by twai_read_alerts, and a twai_get_status_info sample
+void can_stats_alerts(uint32_t alerts);
+void can_stats_sample_status(void);
+
+// Per-ID inter-arrival histogram (microseconds); NULL if the ID is not registered
+const LatencyHist* can_stats_interval_hist(uint32_t identifier);
+
+void can_stats_dump(void);
+
+#endif // CAN_STATS_H
@@ -1,28 +1,22 @@
 #include "can_twai.h"
 #include "screen_definitions.h"
+#include "sensor_snapshot.h"
+#include "can_frames.h"
+#include "can_stats.h"
+#include "plant_sim.h"
+#include "charge_control.h"
+#include "safety_interlock.h"
 #include <esp_log.h>
 
-// Forward declarations for global structs
-extern struct sensor_data {
-    float volt;
-    float curr;
-    int32_t temp1, temp2, temp3, temp4;
-} sensorData;
-
-extern struct time_from_m2 {
-    uint16_t year;
-    uint8_t month, date, day_of_week, hour, minute, second;
-} m2Time;
-
 // Forward declaration for battery detection flag
 extern bool battery_detected;
 
 // Big-endian conversion functions
-uint16_t bigEndianToUint16(uint8_t* data) {
+uint16_t bigEndianToUint16(const uint8_t* data) {
     return (data[0] << 8) | data[1];
 }
 
-int16_t bigEndianToInt16(uint8_t* data) {
+int16_t bigEndianToInt16(const uint8_t* data) {
     uint16_t val = bigEndianToUint16(data);
     return (int16_t)val;
 }
@@ -42,17 +36,99 @@ static twai_timing_config_t t_config = {
     .triple_sampling = false
 };
 
-static twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
-
 // CAN status variables
 static bool can_initialized = false;
 static uint32_t can_rx_count = 0;
 static uint32_t can_tx_count = 0;
 
+
+// Transmit queues (drained by can_tx_task)
+typedef struct {
+    twai_message_t message;
+    uint32_t enqueue_us;
+    can_tx_completion_t* completion;
+} can_tx_request_t;
+
+typedef struct {
+    bool pending;
+    can_tx_request_t request;
+} can_tx_slot_t;
+
+static QueueHandle_t can_tx_urgent_queue = NULL;
+static can_tx_slot_t can_tx_routine_slots[CAN_TX_ROUTINE_SLOTS];
+// Urgent frame that did not fit the queue or was not sent: can_tx_task re-sends it, ahead of
+// routine traffic, until the controller takes it
+static can_tx_slot_t can_tx_urgent_latch;
+static portMUX_TYPE can_tx_slots_mux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t can_tx_task_handle = NULL;
+
+// Last handshake/heartbeat (0x100) and contactor feedback (0x104) seen from M2
+static volatile uint8_t m2_last_msg_type = 0xFF;
+static volatile unsigned long can100_rx_timestamp = 0;
+static volatile uint8_t m2_contactor_state = 0;
+static volatile unsigned long can104_rx_timestamp = 0;
+
+// micros() when the frame being decoded was taken off the RX queue (interlock latency)
+static uint32_t can_rx_frame_us = 0;
+
+// Frame sinks (called from can_task with the decoded fields of the matching descriptor)
+static void sink_handshake(const int32_t* values, uint32_t rx_ms);
+static void sink_sensor_data_1(const int32_t* values, uint32_t rx_ms);
+static void sink_sensor_data_2(const int32_t* values, uint32_t rx_ms);
+static void sink_sensor_data_3(const int32_t* values, uint32_t rx_ms);
+static void sink_contactor_feedback(const int32_t* values, uint32_t rx_ms);
+
+// Receive frame registry: layout and scaling of every frame M1 decodes.
+// Decoders and the ID-sorted dispatch table are generated from this at compile time.
+static constexpr std::array<can_frame_desc_t, 6> can_rx_frames = {{
+    { HANDSHAKE_FRAME_ID, 2, 2,
+      { can_u8(0), can_u8(1) },                                           // node ID, message type
+      sink_handshake, "HANDSHAKE" },
+    { SENSOR_DATA_1_ID, 4, 2,
+      { can_u16be(0, CAN_UNIT_CENTIVOLT), can_u16be(2, CAN_UNIT_CENTIAMP) },
+      sink_sensor_data_1, "SENSOR_DATA_1" },
+    { SENSOR_DATA_2_ID, 8, 4,
+      { can_s16be(0, CAN_UNIT_CENTIDEGREE), can_s16be(2, CAN_UNIT_CENTIDEGREE),
+        can_s16be(4, CAN_UNIT_CENTIDEGREE), can_s16be(6, CAN_UNIT_CENTIDEGREE) },
+      sink_sensor_data_2, "SENSOR_DATA_2" },
+    { SENSOR_DATA_3_ID, 8, 7,
+      { can_u16be(0), can_u8(2), can_u8(3), can_u8(4), can_u8(5), can_u8(6), can_u8(7) },  // Y M D DoW h m s
+      sink_sensor_data_3, "SENSOR_DATA_3" },
+    { CONTACTOR_FEEDBACK_ID, 2, 2,
+      { can_u8(0), can_u8(1) },                                           // node ID, contactor state
+      sink_contactor_feedback, "CONTACTOR_FEEDBACK" },
+    // Our own ID, accepted so another M1 on the bus is visible; not decoded.
+    // STARTUP_FRAME_ID (0x901) is not a valid 11-bit ID and cannot be registered.
+    { CONTACTOR_CONTROL_ID, 0, 0, {}, nullptr, "CONTACTOR_CONTROL" },
+}};
+static_assert(can_frames_valid(can_rx_frames), "CAN frame registry: bad ID, duplicate ID or field outside min_dlc");
+
+static constexpr auto can_rx_dispatch = can_make_dispatch<can_rx_frames>();
+static_assert(can_rx_frames.size() <= CAN_STATS_MAX_IDS, "CAN_STATS_MAX_IDS too small for the frame registry");
+
+// Hardware acceptance filter derived from the registry IDs
+#if CAN_HW_FILTER_ENABLE
+static constexpr twai_filter_config_t can_rx_filter = can_make_filter(can_rx_frames);
+static_assert(can_filter_covers(can_rx_filter, can_rx_frames), "CAN filter rejects a registered ID");
+#else
+static constexpr twai_filter_config_t can_rx_filter = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+#endif
+static twai_filter_config_t f_config = can_rx_filter;
+
 // Initialize CAN/TWAI driver
 bool init_can_twai(void) {
     esp_err_t result;
 
+    // Deeper RX queue so bursts are buffered until can_task drains them, and wake can_task on RX alerts
+    g_config.rx_queue_len = CAN_RX_QUEUE_LEN;
+    g_config.tx_queue_len = CAN_TX_DRIVER_QUEUE_LEN;
+    g_config.alerts_enabled = TWAI_ALERT_RX_DATA | TWAI_ALERT_RX_QUEUE_FULL | TWAI_ALERT_RX_FIFO_OVERRUN |
+                              TWAI_ALERT_BUS_ERROR | TWAI_ALERT_ERR_PASS | TWAI_ALERT_BUS_OFF | TWAI_ALERT_BUS_RECOVERED;
+
+    for (size_t i = 0; i < can_rx_frames.size(); i++) {
+        can_stats_register((uint8_t)i, can_rx_frames[i].identifier, can_rx_frames[i].name);
+    }
+
     // Install TWAI driver
     result = twai_driver_install(&g_config, &t_config, &f_config);
     if (result != ESP_OK) {
@@ -68,58 +144,278 @@ bool init_can_twai(void) {
         return false;
     }
 
+    can_tx_urgent_queue = xQueueCreate(CAN_TX_URGENT_QUEUE_LEN, sizeof(can_tx_request_t));
+    if (can_tx_urgent_queue == NULL) {
+        Serial.println("Failed to create CAN TX queue");
+        twai_stop();
+        twai_driver_uninstall();
+        return false;
+    }
+
     can_initialized = true;
     Serial.println("CAN/TWAI initialized successfully");
+    Serial.printf("[CAN] Acceptance filter: %s code=0x%08X mask=0x%08X\n",
+                 f_config.single_filter ? "single" : "dual",
+                 f_config.acceptance_code, f_config.acceptance_mask);
 
-    // Send startup frame
+    // Queue startup frame (sent once can_tx_task runs)
     uint8_t startup_data[8] = {0xAA, 0xAA, 0xAA, 0x00, 0x00, 0x00, 0x99, 0x99};
     if (send_can_frame(STARTUP_FRAME_ID, startup_data, 8)) {
-        Serial.println("Startup CAN frame sent successfully");
+        Serial.println("Startup CAN frame queued");
     } else {
-        Serial.println("Failed to send startup CAN frame");
+        Serial.println("Failed to queue startup CAN frame");
     }
 
     return true;
 }
 
-// Send CAN frame
+// Send CAN frame (routine priority, non-blocking; see can_tx_enqueue)
 bool send_can_frame(uint32_t id, uint8_t* data, uint8_t length) {
+    return can_tx_enqueue(id, data, length, CAN_TX_ROUTINE, NULL);
+}
+
+static void can_tx_complete(can_tx_completion_t* completion, esp_err_t result) {
+    if (completion != NULL) {
+        completion->done_us = (uint32_t) micros();
+        completion->result = result;
+        xSemaphoreGive(completion->done);
+    }
+}
+
+static void can_tx_wake_task(void) {
+    if (can_tx_task_handle != NULL) {
+        xTaskNotifyGive(can_tx_task_handle);
+    }
+}
+
+// Hold an urgent frame for can_tx_task to re-send. A frame with the ID already held merges into
+// it (the new data, the older enqueue time, the new completion unless it has none); false only
+// while a frame with another ID is held.
+static bool can_tx_latch_urgent(const can_tx_request_t* request) {
+    can_tx_completion_t* superseded = NULL;
+    bool latched = false;
+    portENTER_CRITICAL(&can_tx_slots_mux);
+    if (!can_tx_urgent_latch.pending) {
+        can_tx_urgent_latch.request = *request;
+        can_tx_urgent_latch.pending = true;
+        latched = true;
+    } else if (can_tx_urgent_latch.request.message.identifier == request->message.identifier) {
+        can_tx_request_t merged = *request;
+        merged.enqueue_us = can_tx_urgent_latch.request.enqueue_us;
+        if (merged.completion == NULL) {
+            merged.completion = can_tx_urgent_latch.request.completion;
+        } else if (can_tx_urgent_latch.request.completion != merged.completion) {
+            superseded = can_tx_urgent_latch.request.completion;
+        }
+        can_tx_urgent_latch.request = merged;
+        latched = true;
+    }
+    portEXIT_CRITICAL(&can_tx_slots_mux);
+    can_tx_complete(superseded, ESP_ERR_INVALID_STATE);
+    if (latched) {
+        can_stats_tx_urgent_held();
+    }
+    return latched;
+}
+
+static bool can_tx_take_latch(can_tx_request_t* request) {
+    portENTER_CRITICAL(&can_tx_slots_mux);
+    bool pending = can_tx_urgent_latch.pending;
+    if (pending) {
+        *request = can_tx_urgent_latch.request;
+        can_tx_urgent_latch.pending = false;
+    }
+    portEXIT_CRITICAL(&can_tx_slots_mux);
+    return pending;
+}
+
+static bool can_tx_latch_pending(void) {
+    portENTER_CRITICAL(&can_tx_slots_mux);
+    bool pending = can_tx_urgent_latch.pending;
+    portEXIT_CRITICAL(&can_tx_slots_mux);
+    return pending;
+}
+
+// Queue a frame for can_tx_task and return immediately.
+// Urgent: FIFO queue sent ahead of all routine frames; also cancels a pending routine frame
+// with the same ID so it cannot go out after the urgent one (e.g. CLOSE after OPEN). With the
+// queue full the frame is held for re-sending (can_tx_latch_urgent) rather than dropped.
+// Routine: one slot per ID, a newer frame replaces a pending one (latest data wins). It also
+// replaces a held urgent frame with the same ID, as the newer command for that ID.
+bool can_tx_enqueue(uint32_t id, const uint8_t* data, uint8_t length, can_tx_priority_t priority,
+                    can_tx_completion_t* completion) {
     if (!can_initialized || length > 8) {
         return false;
     }
 
-    twai_message_t message;
-    message.identifier = id;
-    message.extd = 0; // Standard frame
-    message.data_length_code = length;
-    memcpy(message.data, data, length);
+    can_tx_request_t request;
+    memset(&request, 0, sizeof(request));
+    request.message.identifier = id;
+    request.message.extd = 0; // Standard frame
+    request.message.data_length_code = length;
+    memcpy(request.message.data, data, length);
+    request.enqueue_us = (uint32_t) micros();
+    request.completion = completion;
+
+    can_tx_completion_t* superseded = NULL;
+    bool queued = false;
+
+    if (priority == CAN_TX_URGENT) {
+        portENTER_CRITICAL(&can_tx_slots_mux);
+        for (int i = 0; i < CAN_TX_ROUTINE_SLOTS; i++) {
+            if (can_tx_routine_slots[i].pending && can_tx_routine_slots[i].request.message.identifier == id) {
+                can_tx_routine_slots[i].pending = false;
+                superseded = can_tx_routine_slots[i].request.completion;
+            }
+        }
+        portEXIT_CRITICAL(&can_tx_slots_mux);
+        queued = (xQueueSend(can_tx_urgent_queue, &request, 0) == pdTRUE) || can_tx_latch_urgent(&request);
+    } else {
+        int free_slot = -1;
+        can_tx_completion_t* held = NULL;
+        portENTER_CRITICAL(&can_tx_slots_mux);
+        if (can_tx_urgent_latch.pending && can_tx_urgent_latch.request.message.identifier == id) {
+            can_tx_urgent_latch.pending = false;
+            held = can_tx_urgent_latch.request.completion;
+        }
+        for (int i = 0; i < CAN_TX_ROUTINE_SLOTS; i++) {
+            if (can_tx_routine_slots[i].pending && can_tx_routine_slots[i].request.message.identifier == id) {
+                superseded = can_tx_routine_slots[i].request.completion;
+                request.enqueue_us = can_tx_routine_slots[i].request.enqueue_us;  // Keep queue position/latency
+                can_tx_routine_slots[i].request = request;
+                queued = true;
+                break;
+            }
+            if (!can_tx_routine_slots[i].pending && free_slot < 0) {
+                free_slot = i;
+            }
+        }
+        if (!queued && free_slot >= 0) {
+            can_tx_routine_slots[free_slot].request = request;
+            can_tx_routine_slots[free_slot].pending = true;
+            queued = true;
+        }
+        portEXIT_CRITICAL(&can_tx_slots_mux);
+        if (superseded != NULL) {
+            can_stats_tx_coalesced();
+        }
+        can_tx_complete(held, ESP_ERR_INVALID_STATE);
+    }
+
+    can_tx_complete(superseded, ESP_ERR_INVALID_STATE);
+    if (!queued) {
+        can_stats_tx_queue_full(priority == CAN_TX_URGENT);
+        #if CAN_DEBUG_LEVEL == 1
+        Serial.printf("CAN TX queue full, ID=0x%03X dropped\n", id);
+        #endif
+        return false;
+    }
+    can_tx_wake_task();
+    return true;
+}
+
+void can_tx_completion_init(can_tx_completion_t* completion) {
+    completion->done = xSemaphoreCreateBinaryStatic(&completion->done_buffer);
+    completion->result = ESP_ERR_NOT_FINISHED;
+    completion->done_us = 0;
+}
+
+// Wait for an enqueued frame to be handed to the controller; false on timeout
+bool can_tx_completion_wait(can_tx_completion_t* completion, TickType_t ticks_to_wait, esp_err_t* result) {
+    if (xSemaphoreTake(completion->done, ticks_to_wait) != pdTRUE) {
+        return false;
+    }
+    if (result != NULL) {
+        *result = completion->result;
+    }
+    return true;
+}
+
+// Oldest pending routine frame, removed from its slot
+static bool can_tx_take_routine(can_tx_request_t* request) {
+    int oldest = -1;
+    portENTER_CRITICAL(&can_tx_slots_mux);
+    for (int i = 0; i < CAN_TX_ROUTINE_SLOTS; i++) {
+        if (can_tx_routine_slots[i].pending &&
+            (oldest < 0 || (int32_t)(can_tx_routine_slots[i].request.enqueue_us - can_tx_routine_slots[oldest].request.enqueue_us) < 0)) {
+            oldest = i;
+        }
+    }
+    if (oldest >= 0) {
+        *request = can_tx_routine_slots[oldest].request;
+        can_tx_routine_slots[oldest].pending = false;
+    }
+    portEXIT_CRITICAL(&can_tx_slots_mux);
+    return oldest >= 0;
+}
 
-    esp_err_t result = twai_transmit(&message, pdMS_TO_TICKS(100));
+static void can_tx_transmit(const can_tx_request_t* request, bool urgent) {
+#if PLANT_SIM
+    esp_err_t result = plant_sim_can_transmit(&request->message) ? ESP_OK : ESP_FAIL;  // Simulated M2, bus unused
+#else
+    esp_err_t result = twai_transmit(&request->message, pdMS_TO_TICKS(CAN_TX_TIMEOUT_MS));
+#endif
+    can_stats_tx_result(result);
     if (result == ESP_OK) {
         can_tx_count++;
+        can_stats_tx_latency(urgent, (uint32_t) micros() - request->enqueue_us);
         #if CAN_DEBUG_LEVEL == 1
-        Serial.printf("CAN TX: ID=0x%03X, Data=", id);
-        for (int i = 0; i < length; i++) {
-            Serial.printf("%02X ", data[i]);
+        Serial.printf("CAN TX: ID=0x%03X, Data=", request->message.identifier);
+        for (int i = 0; i < request->message.data_length_code; i++) {
+            Serial.printf("%02X ", request->message.data[i]);
         }
         Serial.println();
         #endif
-        return true;
     } else {
         #if CAN_DEBUG_LEVEL == 1
         Serial.printf("CAN TX failed: %s\n", esp_err_to_name(result));
         #endif
-        return false;
+        if (urgent && can_tx_latch_urgent(request)) {
+            return;  // Completes once a re-send is taken
+        }
+    }
+    can_tx_complete(request->completion, result);
+}
+
+// CAN transmit task (RTOS). Woken by can_tx_enqueue; sends every urgent frame first and
+// re-checks the urgent queue before each routine frame. A held urgent frame is tried once per
+// pass and blocks routine frames; while it is held the task wakes every CAN_TX_URGENT_RETRY_MS.
+void can_tx_task(void* parameter) {
+    can_tx_request_t request;
+    can_tx_task_handle = xTaskGetCurrentTaskHandle();
+
+    while (true) {
+        if (!can_initialized) {
+            vTaskDelay(pdMS_TO_TICKS(CAN_RX_IDLE_TIMEOUT_MS));
+            continue;
+        }
+
+        // Drain first: frames queued before this task started (startup frame) have no notification
+        bool latch_tried = false;
+        while (true) {
+            if (xQueueReceive(can_tx_urgent_queue, &request, 0) == pdTRUE) {
+                can_tx_transmit(&request, true);
+            } else if (!latch_tried && can_tx_take_latch(&request)) {
+                latch_tried = true;
+                can_tx_transmit(&request, true);
+            } else if (!can_tx_latch_pending() && can_tx_take_routine(&request)) {
+                can_tx_transmit(&request, false);
+            } else {
+                break;
+            }
+        }
+
+        ulTaskNotifyTake(pdTRUE, can_tx_latch_pending() ? pdMS_TO_TICKS(CAN_TX_URGENT_RETRY_MS) : portMAX_DELAY);
     }
 }
 
-// Receive CAN frame (non-blocking)
-bool receive_can_frame(twai_message_t* message) {
+// Receive CAN frame (waits up to ticks_to_wait; 0 = non-blocking)
+bool receive_can_frame(twai_message_t* message, TickType_t ticks_to_wait) {
     if (!can_initialized) {
         return false;
     }
 
-    esp_err_t result = twai_receive(message, pdMS_TO_TICKS(10)); // 10ms timeout
+    esp_err_t result = twai_receive(message, ticks_to_wait);
     if (result == ESP_OK) {
         can_rx_count++;
         #if CAN_DEBUG_LEVEL == 1
@@ -136,85 +432,147 @@ bool receive_can_frame(twai_message_t* message) {
     return false;
 }
 
-// CAN monitoring task (can run in RTOS)
+// Handshake/Heartbeat (0x100)
+static void sink_handshake(const int32_t* values, uint32_t rx_ms) {
+    if (values[0] != M2_NODE_ID) {
+        return;
+    }
+    m2_last_msg_type = (uint8_t)values[1];
+    can100_rx_timestamp = rx_ms;
+
+    #if CAN_DEBUG_LEVEL == 1
+    Serial.printf("Handshake: node=0x%02X type=0x%02X\n", values[0], values[1]);
+    #endif
+}
+
+// Voltage/Current data (0x101) — also used for M2 heartbeat
+static void sink_sensor_data_1(const int32_t* values, uint32_t rx_ms) {
+    can101_rx_timestamp = rx_ms;
+
+    float volt = values[0] / 100.0f;  // Convert to volts
+    float curr = values[1] / 100.0f;  // Convert to amps
+    safety_interlock_check_vi(volt, curr, can_rx_frame_us);  // Hard limits first, before anything else
+    sensor_snapshot_publish_vi(volt, curr, rx_ms);
+
+    // Update battery detection state (same logic as UART command)
+    battery_detected = (volt >= 9.0f);
+    charge_control_notify_sample();
+
+    #if CAN_DEBUG_LEVEL == 1
+    Serial.printf("Sensor Data 1: Volt=%.2fV, Curr=%.2fA, Battery_detected=%d\n", 
+                 volt, curr, battery_detected);
+    #endif
+}
+
+// Temperature data (0x102)
+static void sink_sensor_data_2(const int32_t* values, uint32_t rx_ms) {
+    safety_interlock_check_temps(values[0], values[1], can_rx_frame_us);  // Motor and generator
+    sensor_snapshot_publish_temps(values[0], values[1], values[2], values[3], rx_ms);
+    charge_control_notify_sample();
+
+    #if CAN_DEBUG_LEVEL == 1
+    Serial.printf("Sensor Data 2: Temp1=%d, Temp2=%d, Temp3=%d, Temp4=%d\n",
+                values[0], values[1], values[2], values[3]);
+    #endif
+}
+
+// RTC Date/Time data (0x103)
+static void sink_sensor_data_3(const int32_t* values, uint32_t rx_ms) {
+    (void)rx_ms;
+    time_from_m2 time;
+    time.year = (uint16_t)values[0];
+    time.month = (uint8_t)values[1];
+    time.date = (uint8_t)values[2];
+    time.day_of_week = (uint8_t)values[3];
+    time.hour = (uint8_t)values[4];
+    time.minute = (uint8_t)values[5];
+    time.second = (uint8_t)values[6];
+    m2_time_snapshot_publish(&time);
+
+    #if CAN_DEBUG_LEVEL == 1
+    Serial.printf("Sensor Data 3: %04d-%02d-%02d %02d:%02d:%02d (Day %d)\n",
+                time.year, time.month, time.date,
+                time.hour, time.minute, time.second, time.day_of_week);
+    #endif
+}
+
+// Contactor feedback (0x104)
+static void sink_contactor_feedback(const int32_t* values, uint32_t rx_ms) {
+    if (values[0] != M2_NODE_ID) {
+        return;
+    }
+    m2_contactor_state = (uint8_t)values[1];
+    can104_rx_timestamp = rx_ms;
+
+    #if CAN_DEBUG_LEVEL == 1
+    Serial.printf("Contactor feedback: state=0x%02X\n", values[1]);
+    #endif
+}
+
+// Hand a received frame to the decoder registered for its ID (binary search in the sorted table)
+void can_dispatch_frame(const twai_message_t* message) {
+#if CAN_RTC_DEBUG
+    // Update CAN debug screen with received frame
+    update_can_debug_display(message->identifier, (uint8_t*)message->data, message->data_length_code);
+#endif // CAN_RTC_DEBUG
+
+    // Software post-filter: the hardware mask can pass foreign IDs and extended frames
+    const can_dispatch_entry_t* entry = NULL;
+    if (!message->extd && !message->rtr) {
+        entry = can_find_dispatch(can_rx_dispatch, message->identifier);
+    }
+    if (entry == nullptr) {
+        can_stats_rx_rejected();
+        #if CAN_DEBUG_LEVEL == 1
+        Serial.printf("Unknown CAN ID: 0x%03X\n", message->identifier);
+        #endif
+        return;
+    }
+
+    can_rx_frame_us = (uint32_t) micros();
+    can_stats_rx(entry->index, can_rx_frame_us);
+    if (!entry->decode(message, (uint32_t) millis())) {
+        can_stats_rx_short_dlc();
+        #if CAN_DEBUG_LEVEL == 1
+        Serial.printf("CAN %s: DLC %d < %d, dropped\n", can_rx_frames[entry->index].name,
+                     message->data_length_code, can_rx_frames[entry->index].min_dlc);
+        #endif
+    }
+}
+
+// CAN receive task (RTOS). Sleeps until the driver raises an RX alert, then drains the
+// whole RX queue so a burst is handled in one wakeup instead of one frame per poll.
 void can_task(void* parameter) {
     twai_message_t rx_message;
+    uint32_t alerts;
 
     while (true) {
-        // Check for received messages
-        if (receive_can_frame(&rx_message)) {
-#if CAN_RTC_DEBUG
-            // Update CAN debug screen with received frame
-            update_can_debug_display(rx_message.identifier, rx_message.data, rx_message.data_length_code);
-#endif // CAN_RTC_DEBUG
+        if (!can_initialized) {
+            // Driver failed to start; nothing to wait on
+            vTaskDelay(pdMS_TO_TICKS(CAN_RX_IDLE_TIMEOUT_MS));
+            continue;
+        }
 
-            // Process received frame based on ID
-            switch (rx_message.identifier) {
-                case SENSOR_DATA_1_ID:
-                    // Process Voltage/Current data (0x101) — also used for M2 heartbeat
-                    if (rx_message.data_length_code >= 4) {
-                        can101_rx_timestamp = (unsigned long) millis();
-
-                        uint16_t voltage_raw = bigEndianToUint16(&rx_message.data[0]);
-                        uint16_t current_raw = bigEndianToUint16(&rx_message.data[2]);
-
-                        sensorData.volt = voltage_raw / 100.0f;  // Convert to volts
-                        sensorData.curr = current_raw / 100.0f;  // Convert to amps
-
-                        // Update battery detection state (same logic as UART command)
-                        battery_detected = (sensorData.volt >= 9.0f);
-
-                        #if CAN_DEBUG_LEVEL == 1
-                        Serial.printf("Sensor Data 1: Volt=%.2fV, Curr=%.2fA, Battery_detected=%d\n", 
-                                     sensorData.volt, sensorData.curr, battery_detected);
-                        #endif
-                    }
-                    break;
-
-                case SENSOR_DATA_2_ID:
-                    // Process Temperature data (0x102)
-                    if (rx_message.data_length_code >= 8) {
-                        sensorData.temp1 = (int32_t)bigEndianToInt16(&rx_message.data[0]);
-                        sensorData.temp2 = (int32_t)bigEndianToInt16(&rx_message.data[2]);
-                        sensorData.temp3 = (int32_t)bigEndianToInt16(&rx_message.data[4]);
-                        sensorData.temp4 = (int32_t)bigEndianToInt16(&rx_message.data[6]);
-
-                        #if CAN_DEBUG_LEVEL == 1
-                        Serial.printf("Sensor Data 2: Temp1=%d, Temp2=%d, Temp3=%d, Temp4=%d\n",
-                                    sensorData.temp1, sensorData.temp2, sensorData.temp3, sensorData.temp4);
-                        #endif
-                    }
-                    break;
-
-                case SENSOR_DATA_3_ID:
-                    // Process RTC Date/Time data (0x103)
-                    if (rx_message.data_length_code >= 7) {
-                        m2Time.year = bigEndianToUint16(&rx_message.data[0]);
-                        m2Time.month = rx_message.data[2];
-                        m2Time.date = rx_message.data[3];
-                        m2Time.day_of_week = rx_message.data[4];
-                        m2Time.hour = rx_message.data[5];
-                        m2Time.minute = rx_message.data[6];
-                        m2Time.second = rx_message.data[7];
-
-                        #if CAN_DEBUG_LEVEL == 1
-                        Serial.printf("Sensor Data 3: %04d-%02d-%02d %02d:%02d:%02d (Day %d)\n",
-                                    m2Time.year, m2Time.month, m2Time.date,
-                                    m2Time.hour, m2Time.minute, m2Time.second, m2Time.day_of_week);
-                        #endif
-                    }
-                    break;
-
-                default:
-                    #if CAN_DEBUG_LEVEL == 1
-                    Serial.printf("Unknown CAN ID: 0x%03X\n", rx_message.identifier);
-                    #endif
-                    break;
-            }
+        esp_err_t result = twai_read_alerts(&alerts, pdMS_TO_TICKS(CAN_RX_IDLE_TIMEOUT_MS));
+        can_stats_sample_status();  // Queue depth before draining + error counters
+        if (result != ESP_OK) {
+            continue;  // Idle timeout, no frames
+        }
+
+        can_stats_alerts(alerts);
+        #if CAN_DEBUG_LEVEL == 1
+        if (alerts & TWAI_ALERT_RX_QUEUE_FULL) {
+            Serial.println("CAN RX queue full, frames dropped");
         }
+        if (alerts & TWAI_ALERT_BUS_OFF) {
+            Serial.println("CAN bus-off");
+        }
+        #endif
 
-        // Small delay to prevent hogging CPU
-        vTaskDelay(pdMS_TO_TICKS(50));
+        // Drain everything queued since the last wakeup
+        while (receive_can_frame(&rx_message, 0)) {
+            can_dispatch_frame(&rx_message);
+        }
     }
 }
 
@@ -224,6 +582,22 @@ void get_can_stats(uint32_t* rx_count, uint32_t* tx_count) {
     *tx_count = can_tx_count;
 }
 
+// Last M2 handshake/heartbeat message type (0xFF = none yet) and its millis() timestamp
+uint8_t get_m2_handshake_state(unsigned long* rx_ms) {
+    if (rx_ms != NULL) {
+        *rx_ms = can100_rx_timestamp;
+    }
+    return m2_last_msg_type;
+}
+
+// Last contactor state reported by M2 on 0x104 (0 = none yet) and its millis() timestamp
+uint8_t get_m2_contactor_feedback(unsigned long* rx_ms) {
+    if (rx_ms != NULL) {
+        *rx_ms = can104_rx_timestamp;
+    }
+    return m2_contactor_state;
+}
+
 // Check if CAN is initialized
 bool is_can_initialized(void) {
     return can_initialized;
@@ -234,6 +608,7 @@ bool is_can_initialized(void) {
 // Data[0]: 0x01 (M1 Node ID - ESP32 LCD)
 // Data[1]: 0x4C (ON/close) or 0x8B (OFF/open)
 // Data[2-7]: 0x00 (Reserved)
+// OPEN is queued as urgent (ahead of all routine traffic), CLOSE as routine.
 bool send_contactor_control(uint8_t command) {
     if (!can_initialized) {
         Serial.println("[CONTACTOR] CAN not initialized, cannot send contactor control");
@@ -245,14 +620,15 @@ bool send_contactor_control(uint8_t command) {
     data[1] = command;      // 0x4C (close) or 0x8B (open)
     // Data[2-7] remain 0x00 (Reserved)
     
-    bool result = send_can_frame(CONTACTOR_CONTROL_ID, data, 8);
+    can_tx_priority_t priority = (command == CONTACTOR_OPEN) ? CAN_TX_URGENT : CAN_TX_ROUTINE;
+    bool result = can_tx_enqueue(CONTACTOR_CONTROL_ID, data, 8, priority, NULL);
     
     if (result) {
         const char* cmd_str = (command == CONTACTOR_CLOSE) ? "CLOSE" : "OPEN";
-        Serial.printf("[CONTACTOR] Sent %s command (0x%02X) to M2 via CAN ID 0x%03X\n", 
+        Serial.printf("[CONTACTOR] Queued %s command (0x%02X) to M2 via CAN ID 0x%03X\n", 
                      cmd_str, command, CONTACTOR_CONTROL_ID);
     } else {
-        Serial.printf("[CONTACTOR] Failed to send contactor control command (0x%02X)\n", command);
+        Serial.printf("[CONTACTOR] Failed to queue contactor control command (0x%02X)\n", command);
     }
     
     return result;
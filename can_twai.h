@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <driver/twai.h>
+#include <freertos/semphr.h>
 
 // CAN Debug Level Control
 // Set to 1 to enable all CAN debug prints, 0 to disable
@@ -12,12 +13,32 @@
 #define CAN_TX_PIN      GPIO_NUM_15  // ESP32-S3 CAN TX pin
 #define CAN_RX_PIN      GPIO_NUM_16  // ESP32-S3 CAN RX pin
 
+// Hardware acceptance filter computed from the receive frame registry (0 = accept all, e.g. for bus sniffing)
+#define CAN_HW_FILTER_ENABLE    1
+
+// CAN receive task configuration
+#define CAN_RX_QUEUE_LEN        32     // TWAI driver RX queue depth (frames)
+#define CAN_RX_IDLE_TIMEOUT_MS  1000   // can_task wakes at least this often when the bus is idle
+#define CAN_TASK_STACK_SIZE     4096
+#define CAN_TASK_PRIORITY       5      // Above LVGL (2) and loop() (1); task blocks until frames arrive
+#define CAN_TASK_CORE           1
+
+// CAN transmit task configuration
+#define CAN_TX_URGENT_QUEUE_LEN 8      // Safety frames (contactor open), sent before any routine frame
+#define CAN_TX_ROUTINE_SLOTS    4      // Routine frames, one pending slot per ID (newer data replaces older)
+#define CAN_TX_DRIVER_QUEUE_LEN 1      // Kept short so urgent frames wait behind at most one routine frame
+#define CAN_TX_TIMEOUT_MS       100    // Max wait for driver TX queue space (TX task only)
+#define CAN_TX_URGENT_RETRY_MS  50     // Re-send interval of a held urgent frame (queue full or not sent)
+#define CAN_TX_TASK_STACK_SIZE  3072
+#define CAN_TX_TASK_PRIORITY    5
+
 // CAN Frame IDs
 #define STARTUP_FRAME_ID        0x901
 #define HANDSHAKE_FRAME_ID      0x100  // Handshake/Heartbeat
 #define SENSOR_DATA_1_ID        0x101  // Voltage/Current
 #define SENSOR_DATA_2_ID        0x102  // Temperature Channels
 #define SENSOR_DATA_3_ID        0x103  // RTC Date/Time
+#define CONTACTOR_FEEDBACK_ID   0x104  // Contactor state feedback (M2 -> M1)
 #define CONTACTOR_CONTROL_ID    0x105  // Contactor control (M1 -> M2)
 
 // CAN Node IDs
@@ -33,12 +54,36 @@
 #define CONTACTOR_CLOSE         0x4C  // Close contactor (ON)
 #define CONTACTOR_OPEN          0x8B  // Open contactor (OFF)
 
+// Transmit priority: urgent frames jump the queue, routine frames are coalesced per ID
+typedef enum {
+    CAN_TX_ROUTINE = 0,
+    CAN_TX_URGENT
+} can_tx_priority_t;
+
+// Optional completion for an enqueued frame. result is the twai_transmit result,
+// or ESP_ERR_INVALID_STATE if a newer frame with the same ID replaced it before sending.
+typedef struct {
+    SemaphoreHandle_t done;
+    StaticSemaphore_t done_buffer;
+    volatile esp_err_t result;
+    volatile uint32_t done_us;      // micros() when the result was set
+} can_tx_completion_t;
+
 // Function declarations
 bool init_can_twai(void);
-bool send_can_frame(uint32_t id, uint8_t* data, uint8_t length);
-bool receive_can_frame(twai_message_t* message);
+bool send_can_frame(uint32_t id, uint8_t* data, uint8_t length);  // Non-blocking routine enqueue
+bool can_tx_enqueue(uint32_t id, const uint8_t* data, uint8_t length, can_tx_priority_t priority,
+                    can_tx_completion_t* completion);  // Non-blocking; completion may be NULL
+void can_tx_completion_init(can_tx_completion_t* completion);
+bool can_tx_completion_wait(can_tx_completion_t* completion, TickType_t ticks_to_wait, esp_err_t* result);
+void can_tx_task(void* parameter);
+bool receive_can_frame(twai_message_t* message, TickType_t ticks_to_wait);
+void can_dispatch_frame(const twai_message_t* message);  // Decode a received frame via the frame registry
 void can_task(void* parameter);
+void get_can_stats(uint32_t* rx_count, uint32_t* tx_count);  // Totals; details in can_stats.h
 bool send_contactor_control(uint8_t command);  // Send contactor control command (0x4C = close, 0x8B = open)
+uint8_t get_m2_handshake_state(unsigned long* rx_ms);     // Last 0x100 message type from M2 (0xFF = none)
+uint8_t get_m2_contactor_feedback(unsigned long* rx_ms);  // Last 0x104 contactor state from M2 (0 = none)
 
 // M2 heartbeat: updated to millis() on reception of CAN frame 0x101 (validated every 1s after 6s grace)
 extern volatile unsigned long can101_rx_timestamp;
@@ -0,0 +1,240 @@
+#include "charge_control.h"
+#include "battery_types.h"
+#include "can_twai.h"
+#include "rs485_vfdComs.h"
+#include "sensor_snapshot.h"
+#include "latency_hist.h"
+#include "plant_sim.h"
+#include "safety_interlock.h"
+#include "charge_session.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <atomic>
+
+// FSM state shared with the UI (see charge_control.h)
+static SemaphoreHandle_t charge_state_mutex = NULL;
+static StaticSemaphore_t charge_state_mutex_buffer;
+
+// Statistics
+static LatencyHist charge_period_jitter_us;   // |actual period - CHARGE_CONTROL_PERIOD_MS|
+static LatencyHist charge_exec_us;            // FSM step duration, lock wait included
+static std::atomic<uint32_t> charge_overruns(0);  // Steps that took longer than one period
+static std::atomic<uint32_t> charge_rule_checks(0);  // Stop-rule passes woken by a sensor frame
+
+// Woken by charge_control_notify_sample() between periods
+static std::atomic<TaskHandle_t> charge_task_handle(NULL);
+
+// ============================================================================
+// Firmware adapters for the controller (charge_controller.h)
+// ============================================================================
+class FirmwareClock : public ChargeClock {
+public:
+    unsigned long now_ms(void) override { return charge_millis(); }
+};
+
+// Controller clock at a millis() receive timestamp (0 stays 0 = never received)
+static uint32_t charge_millis_at(uint32_t rx_ms) {
+#if PLANT_SIM
+    return rx_ms * PLANT_SIM_TIME_SCALE;  // plant_sim_millis() is millis() scaled
+#else
+    return rx_ms;
+#endif
+}
+
+// Control task: read the snapshot, not the loop copy
+class SnapshotSensorSource : public ChargeSensorSource {
+public:
+    charge_sample_t read(void) override {
+        const sensor_data data = sensor_snapshot_get();
+        charge_sample_t sample;
+        sample.volt = data.volt;
+        sample.curr = data.curr;
+        sample.temp1 = data.temp1;
+        sample.temp2 = data.temp2;
+        sample.seq = data.seq;
+        sample.vi_ms = charge_millis_at(data.vi_rx_ms);
+        switch (safety_interlock_tripped()) {
+            case INTERLOCK_OVER_VOLT:
+            case INTERLOCK_OVER_CURR: sample.interlock = CHARGE_INTERLOCK_LIMIT; break;
+            case INTERLOCK_OVER_TEMP: sample.interlock = CHARGE_INTERLOCK_TEMP; break;
+            default:                  sample.interlock = CHARGE_INTERLOCK_NONE; break;
+        }
+        const vfd_status_t vfd = rs485_get_vfd_status();
+        if (vfd.fault_code != 0) {
+            sample.vfd = CHARGE_VFD_FAULT;
+        } else if (!vfd.online && vfd.consecutive_fails >= VFD_OFFLINE_AFTER_FAILS) {
+            sample.vfd = CHARGE_VFD_OFFLINE;  // Not "never answered yet": the first START may still be queued
+        } else {
+            sample.vfd = CHARGE_VFD_OK;
+        }
+        return sample;
+    }
+};
+
+// Commands are queued to the RS485 task (rs485_vfdComs.h), nothing blocks here. Held at 0 Hz
+// once the interlock has tripped: a period racing the trip must not replace its queued 0 Hz.
+class Rs485VfdSink : public ChargeVfdSink {
+public:
+    void start(void) override { rs485_sendStartCommand(); }
+    void set_frequency(uint16_t freq_0_01Hz) override {
+        rs485_sendFrequencyCommand(safety_interlock_tripped() == INTERLOCK_OK ? freq_0_01Hz : 0);
+    }
+    void stop(void) override { rs485_sendStopCommand(); }
+    uint16_t min_frequency(void) const override { return RS485_FREQ_MIN; }
+    uint16_t max_frequency(void) const override { return RS485_FREQ_MAX; }
+    float rpm_per_hz(void) const override { return (float) VFD_FREQ_TO_RPM_RATIO; }
+};
+
+// The hard-limit interlock is armed for the charge while the contactor is closed
+class CanContactorSink : public ChargeContactorSink {
+public:
+    void set_closed(bool closed) override;
+};
+
+// Finished charge kept for loop(), which writes the SD record (charge_control_take_result)
+static charge_result_t charge_result;
+static bool charge_result_pending = false;
+
+class SerialChargeLog : public ChargeLogSink {
+public:
+    void message(const char* text) override { Serial.println(text); }
+    void charge_finished(const charge_result_t* result) override {
+        charge_result = *result;
+        charge_result_pending = true;
+    }
+};
+
+static FirmwareClock charge_clock;
+static SnapshotSensorSource charge_sensors;
+static Rs485VfdSink charge_vfd;
+static CanContactorSink charge_contactor;
+static SerialChargeLog charge_log;
+static ChargeController charge_ctl(charge_clock, charge_sensors, charge_vfd, charge_contactor, charge_log,
+                                   CHARGE_CONTROL_PERIOD_MS);
+
+void CanContactorSink::set_closed(bool closed) {
+    if (closed) {
+        const charge_profile_t& profile = charge_ctl.active_profile();
+        safety_interlock_arm(profile.cutoff_voltage, profile.const_current);
+        send_contactor_control(CONTACTOR_CLOSE);
+    } else {
+        send_contactor_control(CONTACTOR_OPEN);
+        safety_interlock_disarm();
+    }
+}
+
+ChargeController& charge_controller(void) {
+    return charge_ctl;
+}
+
+charge_profile_t charge_profile_of(const BatteryType* battery) {
+    charge_profile_t profile;
+    profile.battery = battery;
+    profile.const_current = battery->getConstCurrent();
+    profile.cutoff_voltage = battery->getCutoffVoltage();
+    profile.rated_ah = (float) battery->getRatedAh();
+    profile.rated_voltage = (float) battery->getRatedVoltage();
+    if (!charge_plan_compile(&profile.plan, battery->getChargePlan(), profile.const_current, profile.cutoff_voltage,
+                             profile.rated_ah)) {
+        Serial.printf("[STAGE] %s: unknown charge plan %u, standard plan used\n",
+                      battery->getBatteryName().c_str(), (unsigned) battery->getChargePlan());
+    }
+    return profile;
+}
+
+bool charge_control_take_result(charge_result_t* result) {
+    charge_control_lock();
+    bool pending = charge_result_pending;
+    if (pending) {
+        *result = charge_result;
+        charge_result_pending = false;
+    }
+    charge_control_unlock();
+    return pending;
+}
+
+void charge_control_init(void) {
+    if (charge_state_mutex == NULL) {
+        charge_state_mutex = xSemaphoreCreateMutexStatic(&charge_state_mutex_buffer);
+    }
+}
+
+unsigned long charge_millis(void) {
+#if PLANT_SIM
+    return plant_sim_millis();
+#else
+    return millis();
+#endif
+}
+
+void charge_control_lock(void) {
+    if (charge_state_mutex != NULL) {
+        xSemaphoreTake(charge_state_mutex, portMAX_DELAY);
+    }
+}
+
+void charge_control_unlock(void) {
+    if (charge_state_mutex != NULL) {
+        xSemaphoreGive(charge_state_mutex);
+    }
+}
+
+void charge_control_task(void* pvParameters) {
+    (void) pvParameters;
+    const TickType_t period_ticks = pdMS_TO_TICKS(CHARGE_CONTROL_PERIOD_MS) > 0 ? pdMS_TO_TICKS(CHARGE_CONTROL_PERIOD_MS) : 1;
+    const int64_t period_us = (int64_t) CHARGE_CONTROL_PERIOD_MS * 1000;
+
+    Serial.printf("[CTRL] Control task started: %d Hz (%d ms)\n", CHARGE_CONTROL_RATE_HZ, CHARGE_CONTROL_PERIOD_MS);
+    charge_task_handle.store(xTaskGetCurrentTaskHandle());
+
+    TickType_t next_wake = xTaskGetTickCount() + period_ticks;
+    int64_t last_start_us = 0;
+
+    while (true) {
+        // Sleep until the next period; a new sensor frame wakes the task early for the stop rules
+        TickType_t now_ticks = xTaskGetTickCount();
+        if ((int32_t)(next_wake - now_ticks) > 0 && ulTaskNotifyTake(pdTRUE, next_wake - now_ticks) > 0) {
+            charge_control_lock();
+            charge_ctl.check_stop_rules();
+            charge_control_unlock();
+            charge_rule_checks.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        next_wake += period_ticks;
+
+        int64_t start_us = esp_timer_get_time();
+        if (last_start_us != 0) {
+            int64_t deviation = (start_us - last_start_us) - period_us;
+            charge_period_jitter_us.record((uint32_t)(deviation < 0 ? -deviation : deviation));
+        }
+        last_start_us = start_us;
+
+        charge_control_lock();
+        charge_ctl.step();
+        charge_session_capture();
+        charge_control_unlock();
+
+        uint32_t exec_us = (uint32_t)(esp_timer_get_time() - start_us);
+        charge_exec_us.record(exec_us);
+        if (exec_us > (uint32_t) period_us) {
+            charge_overruns.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void charge_control_notify_sample(void) {
+    TaskHandle_t task = charge_task_handle.load();
+    if (task != NULL) {
+        xTaskNotifyGive(task);
+    }
+}
+
+void charge_control_dump_stats(void) {
+    Serial.printf("[CTRL] ===== Charging control (%d Hz, %d ms) =====\n", CHARGE_CONTROL_RATE_HZ, CHARGE_CONTROL_PERIOD_MS);
+    Serial.printf("[CTRL] Overruns: %u\n", charge_overruns.load(std::memory_order_relaxed));
+    Serial.printf("[CTRL] Stop-rule checks on new samples: %u\n", charge_rule_checks.load(std::memory_order_relaxed));
+    charge_period_jitter_us.print("CTRL", "Period jitter", "us");
+    charge_exec_us.print("CTRL", "Execution time", "us");
+}
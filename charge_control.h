@@ -0,0 +1,52 @@
+#ifndef CHARGE_CONTROL_H
+#define CHARGE_CONTROL_H
+
+#include <Arduino.h>
+#include "charge_controller.h"
+
+// ============================================================================
+// Charging control task
+// ============================================================================
+/*
+Runs the charging FSM (ChargeController::step, charge_controller.h) on a fixed
+period, independent of loop()/LVGL/SD timing. Between periods the task sleeps on its
+notification: every 0x101/0x102 frame (charge_control_notify_sample, CAN task) wakes it
+for one pass of the stop rules, so a stop condition is acted on when its sample arrives
+rather than at the next period. The task never touches
+LVGL or the SD card: screen changes follow the controller state in
+determine_screen_from_state(), and the charge-complete log record is written later
+from loop().
+
+charge_controller() is the firmware instance, wired to charge_millis(), the sensor
+snapshot, the RS485 VFD commands, the CAN contactor command and Serial.
+charge_control_lock() guards it against the UI (start, stop handlers, M2 lost, status).
+It is a leaf lock: never take lvgl_port_lock or do SD I/O while holding it.
+*/
+
+#define CHARGE_CONTROL_RATE_HZ          10      // Control rate, 1..50 Hz
+#define CHARGE_CONTROL_PERIOD_MS        (1000 / CHARGE_CONTROL_RATE_HZ)
+#define CHARGE_CONTROL_TASK_STACK_SIZE  6144
+#define CHARGE_CONTROL_TASK_PRIORITY    3       // Above LVGL (2) and loop() (1), below RS485 (4) and CAN (5)
+#define CHARGE_CONTROL_TASK_CORE        1
+
+static_assert(CHARGE_CONTROL_RATE_HZ >= 1 && CHARGE_CONTROL_RATE_HZ <= 50,
+              "CHARGE_CONTROL_RATE_HZ must be 1..50");
+
+void charge_control_init(void);            // Create the state mutex (call before starting the task)
+void charge_control_task(void* pvParameters);
+
+void charge_control_lock(void);
+void charge_control_unlock(void);
+
+ChargeController& charge_controller(void);
+charge_profile_t charge_profile_of(const BatteryType* battery);
+bool charge_control_take_result(charge_result_t* result);  // loop(): a finished charge for the SD record
+void charge_control_notify_sample(void);   // New sensor snapshot published: run the stop rules
+
+void charge_control_dump_stats(void);      // Period jitter and execution time histograms
+
+// Time base of the charging logic (stage timers, Ah integration, PI dt). millis(), except in
+// PLANT_SIM builds where it runs PLANT_SIM_TIME_SCALE times faster (plant_sim.h).
+unsigned long charge_millis(void);
+
+#endif // CHARGE_CONTROL_H
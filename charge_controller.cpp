@@ -0,0 +1,1083 @@
+#include "charge_controller.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+ChargeController::ChargeController(ChargeClock& clock, ChargeSensorSource& sensors, ChargeVfdSink& vfd,
+                                   ChargeContactorSink& contactor, ChargeLogSink& log, uint32_t period_ms)
+    : clock(clock), sensors(sensors), vfd(vfd), contactor(contactor), log_sink(log), period_ms(period_ms) {
+    memset(&profile, 0, sizeof(profile));
+    has_profile = false;
+    app_state = STATE_HOME;
+    stop_reason_code = CHARGE_STOP_NONE;
+    clear_timers();
+    final_charging_time_ms = 0;
+    final_remaining_time_ms = 0;
+    charging_complete = false;
+    charge_counter_reset(&charge_counter);
+    current_frequency = 0;
+    memset(&pi, 0, sizeof(pi));
+    pi_mode = PI_MODE_NONE;
+    pi_last_ms = 0;
+    memset(&tune, 0, sizeof(tune));
+    autotune_pending = false;
+    memset(&ff_ramp, 0, sizeof(ff_ramp));
+    ff_entry_pending = false;
+    ff_handover_0_01A = 0;
+    ff_learning = false;
+    ff_last_frequency = 0;
+    sat_detector_init(&sat_detector, VOLTAGE_SATURATION_WINDOW_MS, VOLTAGE_SATURATION_SAMPLE_MS,
+                      VOLTAGE_SATURATION_SLOPE_MV_PER_MIN);
+}
+
+void ChargeController::logf(const char* format, ...) {
+    char line[192];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    log_sink.message(line);
+}
+
+bool ChargeController::is_charging_state(app_state_t state) {
+    return state == STATE_CHARGING_START || state == STATE_CHARGING_CC ||
+           state == STATE_CHARGING_CV || state == STATE_CHARGING_VOLTAGE_SATURATION;
+}
+
+// Entry transient over: the stage has run settle_ms, and so has the charge since a resume
+bool ChargeController::settled(unsigned long now, unsigned long stage_start, unsigned long settle_ms) const {
+    return now - stage_start >= settle_ms && (resume_time == 0 || now - resume_time >= settle_ms);
+}
+
+void ChargeController::clear_timers(void) {
+    charging_start_time = 0;
+    cv_start_time = 0;
+    cc_state_start_time = 0;
+    cc_state_duration = 0;
+    precharge_duration = 0;
+    stage_index = 0;
+    stage_start_time = 0;
+    tail_current = 0.0f;
+    tail_primed = false;
+    tail_last_ms = 0;
+    tail_seq = 0;
+    tail_samples = 0;
+    precharge_ocv_sum = 0.0f;
+    precharge_ocv_count = 0;
+    precharge_step_since = 0;
+    memset(precharge_step_volt, 0, sizeof(precharge_step_volt));
+    memset(precharge_step_count, 0, sizeof(precharge_step_count));
+    precharge_step_curr = 0.0f;
+    precharge_ir_ohm = -1.0f;
+    precharge_check = CHARGE_PRECHARGE_NONE;
+    pending_stop_command = false;
+    current_flow_start = false;
+    flow_wait_start_time = 0;
+    resume_flow_pending = false;
+    resume_time = 0;
+    last_rule_seq = 0;
+    voltage_saturation_detected_voltage = 0.0f;
+    voltage_saturation_cv_start_time = 0;
+    eta_fit_reset(&eta_cc_fit, ETA_CC_WINDOW_S);
+    eta_fit_reset(&eta_cv_fit, ETA_CV_WINDOW_S);
+    eta_log_count = 0;
+    eta_log_interval_ms = ETA_LOG_INTERVAL_MS;
+    eta_next_log_ms = 0;
+}
+
+// CV stage length: precharge + 50% of CC, capped at CV_MAX_TIME_MS
+unsigned long ChargeController::cv_target_time(void) const {
+    unsigned long cv_target_base = precharge_duration + (cc_state_duration / 2);
+    return (cv_target_base < (unsigned long) CV_MAX_TIME_MS) ? cv_target_base : (unsigned long) CV_MAX_TIME_MS;
+}
+
+void ChargeController::command(uint16_t frequency) {
+    vfd.set_frequency(frequency);
+    current_frequency = frequency;
+}
+
+// ============================================================================
+// Commands from the UI (charge_control_lock() held)
+// ============================================================================
+void ChargeController::start(const charge_profile_t* new_profile) {
+    profile = *new_profile;
+    has_profile = true;
+    if (profile.plan.count == 0) {
+        charge_plan_compile(&profile.plan, CHARGE_PLAN_STANDARD, profile.const_current, profile.cutoff_voltage,
+                            profile.rated_ah);
+    }
+
+    logf("[CONTACTOR] Closing contactor before starting charge...");
+    contactor.set_closed(true);
+    vfd.start();
+
+    // Frequency control: PI re-seeded from 0 Hz on the first control update
+    current_frequency = 0;
+    pi_mode = PI_MODE_NONE;
+    tune.state = PI_AUTOTUNE_IDLE;
+    autotune_pending = PI_AUTOTUNE_ENABLE && !pi_tuning_load(profile.battery);
+    ff_map_begin(profile.battery);
+    ff_ramp.active = false;
+    ff_entry_pending = true;  // First update ramps to the learned precharge frequency
+
+    clear_timers();
+    unsigned long now = clock.now_ms();
+    charging_start_time = now;
+    flow_wait_start_time = now;
+    charging_complete = false;
+    final_charging_time_ms = 0;
+    final_remaining_time_ms = 0;
+    stop_reason_code = CHARGE_STOP_NONE;
+    charge_counter_reset(&charge_counter);
+    eta_next_log_ms = now + eta_log_interval_ms;
+
+    stage_index = 0;
+    stage_start_time = now;
+    app_state = (app_state_t) profile.plan.stages[0].state;
+    logf("[STAGE] Plan '%s', %u stages; 1/%u '%s'", charge_plan_name(profile.plan.id),
+         (unsigned) profile.plan.count, (unsigned) profile.plan.count, profile.plan.stages[0].name);
+}
+
+// Stage start on this clock from its charge time (0 = not reached stays 0)
+static unsigned long resumed_stage_time(unsigned long charge_start, uint32_t at_ms) {
+    if (at_ms == 0) {
+        return 0;
+    }
+    unsigned long t = charge_start + at_ms;
+    return (t != 0) ? t : 1;
+}
+
+void ChargeController::resume(const charge_profile_t* new_profile, const charge_checkpoint_t* checkpoint) {
+    start(new_profile);
+    const unsigned long now = charging_start_time;
+
+    // Charge clock continues from the checkpoint
+    charging_start_time = now - checkpoint->elapsed_ms;
+    if (charging_start_time == 0) {
+        charging_start_time = 1;
+    }
+    cc_state_start_time = resumed_stage_time(charging_start_time, checkpoint->cc_start_ms);
+    cv_start_time = resumed_stage_time(charging_start_time, checkpoint->cv_start_ms);
+    voltage_saturation_cv_start_time = resumed_stage_time(charging_start_time, checkpoint->saturation_start_ms);
+    stage_index = (checkpoint->stage < profile.plan.count) ? checkpoint->stage : profile.plan.count - 1;
+    stage_start_time = resumed_stage_time(charging_start_time, checkpoint->stage_start_ms);
+    if (stage_start_time == 0) {
+        stage_start_time = charging_start_time;
+    }
+    precharge_duration = checkpoint->precharge_duration_ms;
+    cc_state_duration = checkpoint->cc_duration_ms;
+    voltage_saturation_detected_voltage = checkpoint->saturation_voltage;
+    precharge_ir_ohm = checkpoint->precharge_ir_ohm;
+    precharge_check = (charge_precharge_t) checkpoint->precharge_check;
+    eta_next_log_ms = now + eta_log_interval_ms;
+
+    charge_counter = checkpoint->counter;
+    charge_counter.primed = false;  // Old clock: the first sample starts a new trapezoid chain
+    sat_detector = checkpoint->sat_detector;
+    sat_detector_resync(&sat_detector, now);
+
+    // Outputs restart from 0: the disconnect rule waits until current flows again
+    app_state = (app_state_t) checkpoint->state;
+    resume_time = now;
+    resume_flow_pending = checkpoint->current_flow_start && app_state != STATE_CHARGING_START;
+    current_flow_start = false;
+    autotune_pending = false;
+    // ff_entry_pending (set by start()): CC ramps to its target, CV and saturation CV to first flow
+
+    logf("[RESUME] Charge resumed in state %d (stage '%s') at %.2f min, %.3f Ah delivered so far",
+         (int) app_state, profile.plan.stages[stage_index].name, checkpoint->elapsed_ms / 60000.0f,
+         charge_counter_ah(&charge_counter));
+}
+
+bool ChargeController::checkpoint(charge_checkpoint_t* out) const {
+    if (!running() || !is_charging_state(app_state)) {
+        return false;
+    }
+    const unsigned long now = clock.now_ms();
+    memset(out, 0, sizeof(*out));
+    out->state = (uint8_t) app_state;
+    out->current_flow_start = current_flow_start || resume_flow_pending;
+    out->elapsed_ms = now - charging_start_time;
+    out->cc_start_ms = (cc_state_start_time > 0) ? cc_state_start_time - charging_start_time : 0;
+    out->cv_start_ms = (cv_start_time > 0) ? cv_start_time - charging_start_time : 0;
+    out->saturation_start_ms = (voltage_saturation_cv_start_time > 0) ?
+                               voltage_saturation_cv_start_time - charging_start_time : 0;
+    out->stage = stage_index;
+    out->stage_start_ms = stage_start_time - charging_start_time;
+    out->precharge_duration_ms = precharge_duration;
+    out->cc_duration_ms = cc_state_duration;
+    out->saturation_voltage = voltage_saturation_detected_voltage;
+    out->precharge_ir_ohm = precharge_ir_ohm;
+    out->precharge_check = (uint8_t) precharge_check;
+    out->counter = charge_counter;
+    out->sat_detector = sat_detector;
+    return true;
+}
+
+void ChargeController::stop(charge_stop_reason_t reason) {
+    logf("[CHARGING] Stop requested (reason %d)", (int) reason);
+    finish(reason, STATE_EMERGENCY_STOP, sensors.read().volt);
+}
+
+void ChargeController::halt(void) {
+    command(0);
+    logf("[M2] 0 rpm queued");
+    vfd.stop();
+    logf("[M2] Stop motor queued");
+    contactor.set_closed(false);
+    logf("[M2] Contactor open sent");
+    // Motor must never restart from here: no pending stop, flow or timers
+    app_state = STATE_EMERGENCY_STOP;
+    charging_complete = true;
+    current_flow_start = false;
+    pending_stop_command = false;
+}
+
+void ChargeController::reset(void) {
+    stop_reason_code = CHARGE_STOP_NONE;
+    clear_timers();
+    has_profile = false;
+    app_state = STATE_HOME;
+}
+
+void ChargeController::send_pending_stop(void) {
+    if (!pending_stop_command) {
+        return;
+    }
+    logf("[CHARGING] Sending STOP command to VFD after screen load...");
+    vfd.stop();
+    logf("[CHARGING] Stop command sent to VFD - Motor should now be stopped");
+    pending_stop_command = false;
+}
+
+void ChargeController::status(charge_status_t* out) {
+    unsigned long now = clock.now_ms();
+    out->state = app_state;
+    out->stop_reason = stop_reason_code;
+    out->complete = charging_complete;
+    out->ah = charge_counter_ah(&charge_counter);
+    out->wh = charge_counter_wh(&charge_counter);
+    out->saturation_voltage = voltage_saturation_detected_voltage;
+    out->frequency = current_frequency;
+
+    if (charging_complete && final_charging_time_ms > 0) {
+        out->elapsed_ms = final_charging_time_ms;
+    } else if (charging_start_time > 0) {
+        out->elapsed_ms = now - charging_start_time;
+    } else {
+        out->elapsed_ms = 0;
+    }
+
+    out->remaining_ms = -1;
+    out->remaining_lo_ms = -1;
+    out->remaining_hi_ms = -1;
+    if (charging_complete) {
+        out->remaining_ms = (long) final_remaining_time_ms;
+        out->remaining_lo_ms = out->remaining_ms;
+        out->remaining_hi_ms = out->remaining_ms;
+    } else {
+        estimate_remaining(now, &out->remaining_ms, &out->remaining_lo_ms, &out->remaining_hi_ms);
+    }
+}
+
+// ============================================================================
+// Remaining time (eta_estimator.h)
+// ============================================================================
+// Whole charge from CC: the rest of CC plus the CV budget that CC duration will give
+unsigned long ChargeController::cc_finish_ms(unsigned long now, float cc_remaining_s) const {
+    if (cc_remaining_s * 1000.0f > (float) ETA_MAX_MS) {
+        return ETA_MAX_MS + 1;
+    }
+    unsigned long cc_remaining = (unsigned long)(cc_remaining_s * 1000.0f);
+    unsigned long cv_time = precharge_duration + ((now - cc_state_start_time) + cc_remaining) / 2;
+    if (cv_time > (unsigned long) CV_MAX_TIME_MS) {
+        cv_time = CV_MAX_TIME_MS;
+    }
+    return cc_remaining + cv_time;
+}
+
+// CC: voltage-rise model. CV: current-taper model to the tail current, capped by the rest of
+// the time budget (the budget alone until the fit has enough CV). Saturation CV: its fixed time.
+bool ChargeController::estimate_remaining(unsigned long now, long* remaining_ms, long* lo_ms, long* hi_ms) const {
+    const float t_now = (now - charging_start_time) / 1000.0f;
+    float eta_s, lo_s, hi_s;
+    if (app_state == STATE_CHARGING_CC && cc_state_start_time > 0) {
+        if (!eta_time_to_level(&eta_cc_fit, t_now, profile.cutoff_voltage, true, &eta_s, &lo_s, &hi_s)) {
+            return false;
+        }
+        unsigned long eta = cc_finish_ms(now, eta_s);
+        if (eta > ETA_MAX_MS) {
+            return false;
+        }
+        unsigned long hi = (hi_s >= 0.0f) ? cc_finish_ms(now, hi_s) : ETA_MAX_MS + 1;
+        *remaining_ms = (long) eta;
+        *lo_ms = (long) cc_finish_ms(now, lo_s);
+        *hi_ms = (hi <= ETA_MAX_MS) ? (long) hi : -1;
+        return true;
+    }
+
+    long fixed = -1;
+    if (app_state == STATE_CHARGING_CV && stage_start_time > 0) {
+        const charge_stage_t& stage = profile.plan.stages[stage_index];
+        unsigned long cv_elapsed = now - stage_start_time;
+        unsigned long target = stage_timeout(stage);
+        long cap = (target == 0) ? -1 : (target > cv_elapsed) ? (long)(target - cv_elapsed) : 0;
+        if (stage.exit_0_01A > 0 &&
+            eta_time_to_level(&eta_cv_fit, t_now, eta_log_current(stage.exit_0_01A / 100.0f), false,
+                              &eta_s, &lo_s, &hi_s) &&
+            eta_s * 1000.0f <= (float) ETA_MAX_MS) {
+            long eta = (long)(eta_s * 1000.0f);
+            long lo = (long)(lo_s * 1000.0f);
+            long hi = (hi_s >= 0.0f && hi_s * 1000.0f <= (float) ETA_MAX_MS) ? (long)(hi_s * 1000.0f) : -1;
+            if (cap >= 0) {
+                eta = (eta < cap) ? eta : cap;
+                lo = (lo < cap) ? lo : cap;
+                hi = (hi >= 0 && hi < cap) ? hi : cap;
+            }
+            *remaining_ms = eta;
+            *lo_ms = lo;
+            *hi_ms = hi;
+            return true;
+        }
+        fixed = cap;
+    } else if (app_state == STATE_CHARGING_VOLTAGE_SATURATION && voltage_saturation_cv_start_time > 0) {
+        unsigned long sat_cv_elapsed = now - voltage_saturation_cv_start_time;
+        fixed = (VOLTAGE_SATURATION_CV_DURATION_MS > sat_cv_elapsed) ?
+                (long)(VOLTAGE_SATURATION_CV_DURATION_MS - sat_cv_elapsed) : 0;
+    }
+    if (fixed < 0) {
+        return false;
+    }
+    *remaining_ms = fixed;
+    *lo_ms = fixed;
+    *hi_ms = fixed;
+    return true;
+}
+
+// Feed the stage's fit with this sample; every eta_log_interval_ms keep the estimate for the SD log
+void ChargeController::update_eta(const charge_sample_t& sample, unsigned long now) {
+    float t = (now - charging_start_time) / 1000.0f;
+    if (app_state == STATE_CHARGING_CC && settled(now, cc_state_start_time, ETA_SETTLE_MS)) {
+        eta_fit_add(&eta_cc_fit, t, sample.volt);
+    } else if (app_state == STATE_CHARGING_CV && settled(now, cv_start_time, ETA_SETTLE_MS)) {
+        eta_fit_add(&eta_cv_fit, t, eta_log_current(sample.curr));
+    }
+
+    if ((long)(now - eta_next_log_ms) < 0) {
+        return;
+    }
+    eta_next_log_ms += eta_log_interval_ms;
+    if (eta_log_count == ETA_LOG_POINTS) {
+        // Full: keep every other point and log half as often, so the whole charge stays covered
+        for (uint8_t i = 0; i < ETA_LOG_POINTS / 2; i++) {
+            eta_log[i] = eta_log[2 * i];
+        }
+        eta_log_count = ETA_LOG_POINTS / 2;
+        eta_log_interval_ms *= 2;
+    }
+
+    long remaining = -1, lo = -1, hi = -1;
+    estimate_remaining(now, &remaining, &lo, &hi);
+    eta_point_t* point = &eta_log[eta_log_count++];
+    point->elapsed_ms = now - charging_start_time;
+    point->remaining_ms = remaining;
+    point->lo_ms = lo;
+    point->hi_ms = hi;
+    point->state = (uint8_t) app_state;
+    if (remaining >= 0) {
+        logf("[ETA] %.1f min into the charge (state %d): remaining %.1f min (%.1f .. %.1f min, -1 = open)",
+             point->elapsed_ms / 60000.0f, (int) app_state, remaining / 60000.0f, lo / 60000.0f,
+             (hi >= 0) ? hi / 60000.0f : -1.0f);
+    }
+}
+
+// ============================================================================
+// Stop sequence: 0 Hz, contactor open, freeze the timers, hand the result to the log
+// ============================================================================
+void ChargeController::finish(charge_stop_reason_t reason, app_state_t next_state, float end_volt) {
+    logf("[CHARGING] Sending 0 RPM command immediately...");
+    command(0);
+    logf("[CONTACTOR] Opening contactor...");
+    contactor.set_closed(false);
+
+    unsigned long now = clock.now_ms();
+    if (charging_start_time > 0 && !charging_complete) {
+        final_charging_time_ms = now - charging_start_time;
+        charging_complete = true;
+        logf("[CHARGING] Final charging time: %lu ms (%.2f minutes)",
+             final_charging_time_ms, final_charging_time_ms / 60000.0f);
+        logf("[CHARGING] Delivered %.3f Ah, %.1f Wh over %lu samples",
+             charge_counter_ah(&charge_counter), charge_counter_wh(&charge_counter),
+             (unsigned long) charge_counter.samples);
+
+        // Remaining CV time (screen 6), only once CV has started and the plan did not run to its end
+        if (reason != CHARGE_STOP_COMPLETE && cv_start_time > 0 && cc_state_duration > 0) {
+            unsigned long cv_elapsed = now - cv_start_time;
+            unsigned long target = cv_target_time();
+            final_remaining_time_ms = (target > cv_elapsed) ? (target - cv_elapsed) : 0;
+            logf("[CHARGING] Final remaining time: %lu ms (%.2f minutes)",
+                 final_remaining_time_ms, final_remaining_time_ms / 60000.0f);
+        }
+    }
+
+    stop_reason_code = reason;
+    current_flow_start = false;
+
+    charge_result_t result;
+    result.end_volt = end_volt;
+    result.total_time_ms = final_charging_time_ms;
+    result.ah_final = charge_counter_ah(&charge_counter);
+    result.wh_final = charge_counter_wh(&charge_counter);
+    result.max_volt = charge_counter.max_volt;
+    result.max_curr = charge_counter.max_curr;
+    result.max_temp1 = charge_counter.max_temp1;
+    result.max_temp2 = charge_counter.max_temp2;
+    result.stop_reason = reason;
+    result.precharge_ir_ohm = precharge_ir_ohm;
+    result.precharge_check = precharge_check;
+    memcpy(result.eta, eta_log, sizeof(eta_log));
+    result.eta_points = eta_log_count;
+    log_sink.charge_finished(&result);
+
+    // VFD stop command follows once the stop screen has loaded (send_pending_stop)
+    pending_stop_command = true;
+    app_state = next_state;
+}
+
+// ============================================================================
+// Frequency control
+// ============================================================================
+// Next frequency from the PI controller. On a mode change (or the first update after start)
+// the controller is re-tuned for the mode/profile and seeded from the frequency currently applied.
+uint16_t ChargeController::pi_frequency(pi_mode_t mode, uint16_t setpoint_0_01, uint16_t measured_0_01) {
+    unsigned long now = clock.now_ms();
+    if (mode != pi_mode) {
+        const int32_t max_step = (CHARGE_FREQ_SLEW_PER_S * (int32_t) period_ms + 999) / 1000;
+        pi_controller_init(&pi, pi_gains_for_profile(profile.battery, mode),
+                           vfd.min_frequency(), vfd.max_frequency(), max_step);
+        pi_controller_bumpless(&pi, current_frequency, setpoint_0_01, measured_0_01);
+        pi_mode = mode;
+        pi_last_ms = now;
+    }
+    uint32_t dt_ms = now - pi_last_ms;
+    if (dt_ms > CHARGE_PI_MAX_DT_MS) {
+        dt_ms = CHARGE_PI_MAX_DT_MS;  // Stalled loop: don't integrate the gap
+    }
+    pi_last_ms = now;
+    return (uint16_t) pi_controller_update(&pi, setpoint_0_01, measured_0_01, dt_ms);
+}
+
+// CC frequency. A profile without stored gains gets one relay auto-tune once the PI has
+// settled near the target; the result is stored and the PI re-seeded with the new gains.
+uint16_t ChargeController::cc_frequency(uint16_t target_0_01A, uint16_t actual_0_01A) {
+    int32_t error = (int32_t) target_0_01A - (int32_t) actual_0_01A;
+    if (error < 0) {
+        error = -error;
+    }
+    if (autotune_pending && pi_mode == PI_MODE_CC && error <= 2 * PI_AUTOTUNE_HYSTERESIS) {
+        autotune_pending = false;
+        const int32_t max_step = (CHARGE_FREQ_SLEW_PER_S * (int32_t) period_ms + 999) / 1000;
+        pi_autotune_start(&tune, current_frequency, target_0_01A, vfd.min_frequency(), vfd.max_frequency(),
+                          max_step, clock.now_ms());
+    }
+    if (tune.state == PI_AUTOTUNE_RUNNING) {
+        uint16_t relay_frequency = (uint16_t) pi_autotune_step(&tune, actual_0_01A, clock.now_ms());
+        if (tune.state == PI_AUTOTUNE_RUNNING) {
+            return relay_frequency;
+        }
+        if (tune.state == PI_AUTOTUNE_DONE) {
+            pi_tuning_update(profile.battery, &tune);
+        }
+        current_frequency = tune.bias;
+        pi_mode = PI_MODE_NONE;  // Re-seed from the bias with the (possibly new) gains
+    }
+    return pi_frequency(PI_MODE_CC, target_0_01A, actual_0_01A);
+}
+
+// Entry into a current target: S-curve ramp straight to the learned frequency (ff_map.h),
+// capped at max_0_01Hz. Without a learned frequency and with no current flowing yet, a slow
+// ramp searches up to max_0_01Hz instead and stops at the first flow. The PI takes over
+// (bumpless) once the ramp arrives or the current gets there. Returns false when no ramp runs.
+bool ChargeController::ff_frequency(float volt, uint16_t target_0_01A, uint16_t actual_0_01A, uint16_t max_0_01Hz,
+                                    uint16_t* frequency) {
+    if (ff_entry_pending) {
+        ff_entry_pending = false;
+        uint16_t predicted = 0;
+        bool learned = ff_map_predict(volt, target_0_01A, &predicted);
+        bool search = !learned && actual_0_01A < FF_MAP_MIN_CURRENT;
+        if (search || predicted > max_0_01Hz) {
+            predicted = max_0_01Hz;
+        }
+        ff_handover_0_01A = search ? FF_SEARCH_HANDOVER_CURRENT : target_0_01A;
+        uint16_t from = (current_frequency < vfd.min_frequency()) ? vfd.min_frequency() : current_frequency;
+        if ((learned || search) && actual_0_01A < ff_handover_0_01A && predicted > from) {
+            ff_ramp_start(&ff_ramp, from, predicted, search ? FF_SEARCH_MAX_SLEW : FF_RAMP_MAX_SLEW);
+            logf("[FF] %s ramp %.2f -> %.2f Hz for %.2f A", learned ? "Learned" : "Search",
+                 from / 100.0f, predicted / 100.0f, target_0_01A / 100.0f);
+        }
+    }
+    if (!ff_ramp.active) {
+        return false;
+    }
+    if (actual_0_01A >= ff_handover_0_01A) {
+        ff_ramp.active = false;
+        pi_mode = PI_MODE_NONE;  // PI continues from the applied frequency
+        return false;
+    }
+    *frequency = (uint16_t) ff_ramp_step(&ff_ramp, period_ms);
+    if (!ff_ramp.active) {
+        pi_mode = PI_MODE_NONE;
+    }
+    return true;
+}
+
+// Ah, Wh and peaks on every new sample, in every charging state (precharge, CC, CV, saturation CV)
+void ChargeController::update_counter(const charge_sample_t& sample, unsigned long now) {
+    const uint32_t vi_ms = (sample.vi_ms != 0) ? sample.vi_ms : (uint32_t) now;
+    charge_counter_peaks(&charge_counter, sample.volt, sample.curr, sample.temp1, sample.temp2);
+    if (!charge_counter_add(&charge_counter, sample.volt, sample.curr, vi_ms)) {
+        return;
+    }
+
+    #if Ah_CALCULATION_DEBUG
+        logf("[AH] Current: %.2fA, Voltage: %.2fV, Total: %.4fAh %.2fWh (%lu samples)",
+             sample.curr, sample.volt, charge_counter_ah(&charge_counter), charge_counter_wh(&charge_counter),
+             (unsigned long) charge_counter.samples);
+    #endif
+}
+
+// ============================================================================
+// Stop rules
+// ============================================================================
+// Hard-limit interlock already opened the contactor and sent 0 Hz; stop the FSM behind it
+bool ChargeController::rule_interlock_limit(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now) {
+    (void) ctl;
+    (void) now;
+    return sample.interlock == CHARGE_INTERLOCK_LIMIT;
+}
+
+bool ChargeController::rule_interlock_temp(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now) {
+    (void) ctl;
+    (void) now;
+    return sample.interlock == CHARGE_INTERLOCK_TEMP;
+}
+
+// The drive tripped or its link is down: the frequency commands no longer reach it
+bool ChargeController::rule_vfd_fault(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now) {
+    (void) ctl;
+    (void) now;
+    return sample.vfd != CHARGE_VFD_OK;
+}
+
+// Motor (temp1) or GCU generator (temp2) over MAX_TEMP_THRESHOLD, 0.01°C units
+bool ChargeController::rule_high_temp(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now) {
+    (void) ctl;
+    (void) now;
+    return sample.temp1 / 100.0f > MAX_TEMP_THRESHOLD || sample.temp2 / 100.0f > MAX_TEMP_THRESHOLD;
+}
+
+// Current had flowed but dropped below 1.0 A
+bool ChargeController::rule_disconnected(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now) {
+    (void) now;
+    return ctl.current_flow_start && sample.curr < CHARGE_DISCONNECT_AMPS;
+}
+
+// Step 1 safety: no current flow within the timeout, or RPM over the limit before flow
+bool ChargeController::rule_no_flow(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now) {
+    (void) sample;
+    if (ctl.current_flow_start) {
+        return false;
+    }
+    unsigned long step1_elapsed = (ctl.flow_wait_start_time > 0) ? (now - ctl.flow_wait_start_time) : 0;
+    float step1_rpm = ctl.current_frequency / 100.0f * ctl.vfd.rpm_per_hz();
+    return step1_elapsed >= PRECHARGE_CURRENT_FLOW_TIMEOUT_MS || step1_rpm > (float) PRECHARGE_RPM_LIMIT;
+}
+
+// Resumed in CC/CV/saturation CV and the current has not come back within the step 1 timeout
+bool ChargeController::rule_resume_no_flow(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now) {
+    (void) sample;
+    return ctl.resume_flow_pending && now - ctl.flow_wait_start_time >= PRECHARGE_CURRENT_FLOW_TIMEOUT_MS;
+}
+
+bool ChargeController::rule_capacity(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now) {
+    (void) sample;
+    (void) now;
+    return charge_counter_ah(&ctl.charge_counter) >= ctl.profile.rated_ah * CHARGE_CAPACITY_LIMIT_FRAC;
+}
+
+// Voltage limit already reached in precharge: done
+bool ChargeController::rule_precharge_voltage(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now) {
+    (void) now;
+    return sample.volt >= ctl.profile.cutoff_voltage;
+}
+
+bool ChargeController::rule_saturation_cv_time(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now) {
+    (void) sample;
+    unsigned long sat_cv_duration = (ctl.voltage_saturation_cv_start_time > 0) ?
+                                    (now - ctl.voltage_saturation_cv_start_time) : 0;
+    return sat_cv_duration >= VOLTAGE_SATURATION_CV_DURATION_MS;
+}
+
+#define RULE_CHARGING (CHARGE_RULE_STATE(STATE_CHARGING_START) | CHARGE_RULE_STATE(STATE_CHARGING_CC) | \
+                       CHARGE_RULE_STATE(STATE_CHARGING_CV) | CHARGE_RULE_STATE(STATE_CHARGING_VOLTAGE_SATURATION))
+
+const ChargeController::stop_rule_t ChargeController::stop_rules[] = {
+    // name, priority, states, stop reason, next state, predicate
+    { "interlock_limit", 0, RULE_CHARGING,
+      CHARGE_STOP_VOLT_OR_CURRENT_ERROR, STATE_EMERGENCY_STOP, rule_interlock_limit },
+    { "interlock_temp", 0, RULE_CHARGING,
+      CHARGE_STOP_HIGH_TEMP, STATE_EMERGENCY_STOP, rule_interlock_temp },
+    { "vfd_fault", 1, RULE_CHARGING,
+      CHARGE_STOP_VFD_FAULT, STATE_EMERGENCY_STOP, rule_vfd_fault },
+    { "high_temp", 1, RULE_CHARGING,
+      CHARGE_STOP_HIGH_TEMP, STATE_EMERGENCY_STOP, rule_high_temp },
+    { "battery_disconnected", 2, RULE_CHARGING,
+      CHARGE_STOP_BATTERY_DISCONNECTED, STATE_EMERGENCY_STOP, rule_disconnected },
+    { "precharge_no_flow", 3, CHARGE_RULE_STATE(STATE_CHARGING_START),
+      CHARGE_STOP_VOLT_OR_CURRENT_ERROR, STATE_EMERGENCY_STOP, rule_no_flow },
+    { "resume_no_flow", 3, RULE_CHARGING & ~CHARGE_RULE_STATE(STATE_CHARGING_START),
+      CHARGE_STOP_VOLT_OR_CURRENT_ERROR, STATE_EMERGENCY_STOP, rule_resume_no_flow },
+    { "capacity_110", 4, CHARGE_RULE_STATE(STATE_CHARGING_CC),
+      CHARGE_STOP_110_PERCENT_CAPACITY, STATE_EMERGENCY_STOP, rule_capacity },
+    { "precharge_voltage", 5, CHARGE_RULE_STATE(STATE_CHARGING_START),
+      CHARGE_STOP_VOLTAGE_LIMIT_PRECHARGE, STATE_CHARGING_COMPLETE, rule_precharge_voltage },
+    { "saturation_cv_time", 7, CHARGE_RULE_STATE(STATE_CHARGING_VOLTAGE_SATURATION),
+      CHARGE_STOP_VOLTAGE_SATURATION, STATE_CHARGING_COMPLETE, rule_saturation_cv_time },
+};
+
+// Every rule for the current state; the highest-priority one that fires stops the charge
+bool ChargeController::evaluate_stop_rules(const charge_sample_t& sample, unsigned long now) {
+    last_rule_seq = sample.seq;
+
+    // Flow latch (step 1, or the first current after a resume) feeds the disconnect and no-flow rules
+    if ((app_state == STATE_CHARGING_START || resume_flow_pending) && sample.curr >= 1.5f) {
+        current_flow_start = true;
+        resume_flow_pending = false;
+    }
+
+    const stop_rule_t* fired = NULL;
+    const uint32_t state_bit = CHARGE_RULE_STATE(app_state);
+    for (size_t i = 0; i < sizeof(stop_rules) / sizeof(stop_rules[0]); i++) {
+        const stop_rule_t* rule = &stop_rules[i];
+        if ((rule->states & state_bit) == 0 || (fired != NULL && rule->priority >= fired->priority)) {
+            continue;
+        }
+        if (rule->fires(*this, sample, now)) {
+            fired = rule;
+        }
+    }
+    if (fired == NULL) {
+        return false;
+    }
+
+    unsigned long charge_ms = (charging_start_time > 0) ? (now - charging_start_time) : 0;
+    logf("[STOP] Rule '%s' (priority %u) fired in state %d at %lu ms (%.2f min into the charge), sample #%lu",
+         fired->name, (unsigned) fired->priority, (int) app_state, now, charge_ms / 60000.0f,
+         (unsigned long) sample.seq);
+    logf("[STOP] Sample: %.2f V, %.2f A, temp1 %.2f°C, temp2 %.2f°C, %.2f Ah, %.2f Hz",
+         sample.volt, sample.curr, sample.temp1 / 100.0f, sample.temp2 / 100.0f, charge_counter_ah(&charge_counter),
+         current_frequency / 100.0f);
+    finish(fired->reason, fired->next_state, sample.volt);
+    return true;
+}
+
+// New sensor sample between control periods: Ah/Wh and stop rules only, no frequency command
+bool ChargeController::check_stop_rules(void) {
+    if (!is_charging_state(app_state) || !has_profile) {
+        return false;
+    }
+    const charge_sample_t sample = sensors.read();
+    if (sample.seq != 0 && sample.seq == last_rule_seq) {
+        return false;  // Already seen
+    }
+    const unsigned long now = clock.now_ms();
+    update_counter(sample, now);
+    return evaluate_stop_rules(sample, now);
+}
+
+// ============================================================================
+// Plan stages (charge_plan.h)
+// ============================================================================
+// Stage time limit; the CV budget follows from the precharge and CC times
+unsigned long ChargeController::stage_timeout(const charge_stage_t& stage) const {
+    if (stage.timeout_ms == CHARGE_STAGE_CV_BUDGET) {
+        return (cc_state_duration > 0) ? cv_target_time() : (unsigned long) CV_MAX_TIME_MS;
+    }
+    return stage.timeout_ms;
+}
+
+// Current target of a current or power stage, 0.01A (power: P / V, at most the profile's CC current)
+uint16_t ChargeController::stage_current(const charge_stage_t& stage, float volt) const {
+    if (stage.mode != CHARGE_REG_POWER) {
+        return stage.setpoint;
+    }
+    float amps = stage.setpoint / ((volt > 1.0f) ? volt : 1.0f);
+    if (amps > profile.const_current) {
+        amps = profile.const_current;
+    }
+    return (uint16_t)(amps * 100);
+}
+
+// Tail-current exit: first-order low-pass of the current over new samples, counting how many in a
+// row are at or below the stage's exit current. Starts over until the stage has settled with flow.
+void ChargeController::update_tail(const charge_stage_t& stage, const charge_sample_t& sample, unsigned long now) {
+    if (!current_flow_start || resume_flow_pending || !settled(now, stage_start_time, CHARGE_STAGE_EXIT_SETTLE_MS)) {
+        tail_primed = false;
+        tail_samples = 0;
+        return;
+    }
+    if (sample.seq != 0 && sample.seq == tail_seq) {
+        return;  // Already filtered
+    }
+    tail_seq = sample.seq;
+    const unsigned long t = (sample.vi_ms != 0) ? sample.vi_ms : now;
+    if (!tail_primed) {
+        tail_current = sample.curr;
+        tail_primed = true;
+    } else {
+        float alpha = (float)(t - tail_last_ms) / (float) CHARGE_STAGE_TAIL_FILTER_MS;
+        tail_current += ((alpha < 1.0f) ? alpha : 1.0f) * (sample.curr - tail_current);
+    }
+    tail_last_ms = t;
+
+    const float exit_current = stage.exit_0_01A / 100.0f;
+    if (tail_current > exit_current) {
+        tail_samples = 0;
+    } else if (tail_samples < CHARGE_STAGE_TAIL_SAMPLES && ++tail_samples == CHARGE_STAGE_TAIL_SAMPLES) {
+        logf("[STAGE] Tail current: %.2f A filtered (%.2f A now) at or below %.2f A for %u samples",
+             tail_current, sample.curr, exit_current, (unsigned) CHARGE_STAGE_TAIL_SAMPLES);
+    }
+}
+
+// Adaptive precharge: open-circuit voltage before flow, then the voltage once the current has settled
+// at the target. IR = (V - OCV) / I. Decided once; only a healthy pack ends the precharge early.
+void ChargeController::update_precharge(const charge_stage_t& stage, const charge_sample_t& sample,
+                                        unsigned long now) {
+    if (precharge_check != CHARGE_PRECHARGE_NONE || profile.rated_voltage <= 0.0f) {
+        return;
+    }
+    if (!current_flow_start) {
+        if (sample.curr < PRECHARGE_OCV_MAX_AMPS && sample.volt > 0.0f) {
+            precharge_ocv_sum += sample.volt;
+            precharge_ocv_count++;
+        }
+        return;
+    }
+
+    charge_precharge_t check = CHARGE_PRECHARGE_NONE;
+    const float target = stage_current(stage, sample.volt) / 100.0f;
+    const float error = sample.curr - target;
+    if (precharge_ocv_count == 0 || now - stage_start_time >= PRECHARGE_IR_DEADLINE_MS) {
+        check = CHARGE_PRECHARGE_FULL_NO_STEP;
+    } else if (error > target * PRECHARGE_IR_TOLERANCE || -error > target * PRECHARGE_IR_TOLERANCE) {
+        precharge_step_since = 0;  // Not settled: start the window over
+        memset(precharge_step_volt, 0, sizeof(precharge_step_volt));
+        memset(precharge_step_count, 0, sizeof(precharge_step_count));
+        precharge_step_curr = 0.0f;
+        return;
+    } else {
+        if (precharge_step_since == 0) {
+            precharge_step_since = now;
+        }
+        const unsigned long settled_ms = now - precharge_step_since;
+        if (settled_ms < PRECHARGE_IR_SETTLE_MS) {
+            return;
+        }
+        const int half = (settled_ms < PRECHARGE_IR_SETTLE_MS + PRECHARGE_IR_WINDOW_MS / 2) ? 0 : 1;
+        precharge_step_volt[half] += sample.volt;
+        precharge_step_count[half]++;
+        precharge_step_curr += sample.curr;
+        if (settled_ms < PRECHARGE_IR_SETTLE_MS + PRECHARGE_IR_WINDOW_MS || precharge_step_count[1] == 0) {
+            return;
+        }
+
+        const float rated = profile.rated_voltage;
+        const float ocv = precharge_ocv_sum / precharge_ocv_count;
+        const uint16_t count = precharge_step_count[0] + precharge_step_count[1];
+        const float volt = (precharge_step_volt[0] + precharge_step_volt[1]) / count;
+        const float curr = precharge_step_curr / count;
+        const float sag = precharge_step_volt[0] / precharge_step_count[0] -
+                          precharge_step_volt[1] / precharge_step_count[1];
+        precharge_ir_ohm = (volt - ocv) / curr;
+        if (ocv < rated * PRECHARGE_SHORT_VOLT_FRAC || precharge_ir_ohm <= 0.0f ||
+            sag > rated * PRECHARGE_SAG_VOLT_FRAC) {
+            check = CHARGE_PRECHARGE_FULL_SHORT;
+        } else if (ocv < rated * PRECHARGE_DEEP_VOLT_FRAC) {
+            check = CHARGE_PRECHARGE_FULL_DEEP;
+        } else if (precharge_ir_ohm * profile.const_current > rated * PRECHARGE_IR_MAX_FRAC) {
+            check = CHARGE_PRECHARGE_FULL_HIGH_IR;
+        } else {
+            check = CHARGE_PRECHARGE_EARLY;
+        }
+        logf("[PRECHARGE] OCV %.2f V, %.2f V at %.2f A (sag %.3f V): IR %.1f mOhm, %.2f V drop at %.1f A",
+             ocv, volt, curr, sag, precharge_ir_ohm * 1000.0f, precharge_ir_ohm * profile.const_current,
+             profile.const_current);
+    }
+
+    static const char* const check_names[] = { "none", "healthy, early CC", "full precharge: suspected short",
+                                               "full precharge: deeply discharged", "full precharge: high IR",
+                                               "full precharge: no settled step" };
+    precharge_check = check;
+    logf("[PRECHARGE] %s after %.1f s", check_names[check], (now - stage_start_time) / 1000.0f);
+}
+
+// Why the running stage ends on this sample (NULL: it continues)
+const char* ChargeController::stage_exit(const charge_stage_t& stage, const charge_sample_t& sample,
+                                         unsigned long now) const {
+    unsigned long timeout = stage_timeout(stage);
+    if (timeout > 0 && now - stage_start_time >= timeout) {
+        return "time";
+    }
+    if (stage.mode != CHARGE_REG_VOLTAGE && stage.exit_0_01V > 0 && sample.volt >= stage.exit_0_01V / 100.0f) {
+        return "voltage";
+    }
+    if (stage.mode == CHARGE_REG_VOLTAGE && stage.exit_0_01A > 0 && tail_samples >= CHARGE_STAGE_TAIL_SAMPLES) {
+        return "tail current";
+    }
+    if ((stage.flags & CHARGE_STAGE_ADAPTIVE) && precharge_check == CHARGE_PRECHARGE_EARLY &&
+        now - stage_start_time >= PRECHARGE_MIN_TIME_MS) {
+        return "healthy response";
+    }
+    return NULL;
+}
+
+// Next stage whose entry condition holds; past the last one the charge is complete
+void ChargeController::enter_stage(uint8_t index, float volt, unsigned long now) {
+    while (index < profile.plan.count && profile.plan.stages[index].entry_0_01V > 0 &&
+           volt >= profile.plan.stages[index].entry_0_01V / 100.0f) {
+        logf("[STAGE] Skipping '%s': %.2fV already at its entry limit", profile.plan.stages[index].name, volt);
+        index++;
+    }
+    if (index >= profile.plan.count) {
+        logf("[STAGE] Plan '%s' complete", charge_plan_name(profile.plan.id));
+        finish(CHARGE_STOP_COMPLETE, STATE_CHARGING_COMPLETE, volt);
+        return;
+    }
+
+    const charge_stage_t& stage = profile.plan.stages[index];
+    const app_state_t next_state = (app_state_t) stage.state;
+    if (app_state == STATE_CHARGING_START && next_state != STATE_CHARGING_START) {
+        logf("[CHARGING] Precharge complete (x min elapsed), transitioning to %s mode",
+             (stage.mode == CHARGE_REG_VOLTAGE) ? "CV" : "CC");
+        precharge_duration = now - charging_start_time;  // For CV time: precharge + 50% CC, max 33 min
+        if (precharge_duration < (unsigned long) PRECHARGE_TIME_MS) {
+            precharge_duration = PRECHARGE_TIME_MS;  // Early (adaptive) precharge does not shorten the CV cap
+        }
+    }
+    // CV budget follows the first CC run (the bulk charge)
+    if (app_state == STATE_CHARGING_CC && next_state != STATE_CHARGING_CC && cc_state_duration == 0 &&
+        cc_state_start_time > 0) {
+        cc_state_duration = now - cc_state_start_time;
+        logf("[CHARGING] CC state duration: %lu ms (%.2f minutes)", cc_state_duration, cc_state_duration / 60000.0f);
+    }
+    const app_state_t prev_state = app_state;
+    stage_index = index;
+    stage_start_time = now;
+    tail_primed = false;
+    tail_samples = 0;
+    app_state = next_state;
+    logf("[STAGE] %u/%u '%s': %s %.2f%s", (unsigned)(index + 1), (unsigned) profile.plan.count, stage.name,
+         (stage.mode == CHARGE_REG_VOLTAGE) ? "voltage" : (stage.mode == CHARGE_REG_POWER) ? "power" : "current",
+         (stage.mode == CHARGE_REG_POWER) ? (float) stage.setpoint : stage.setpoint / 100.0f,
+         (stage.mode == CHARGE_REG_VOLTAGE) ? "V" : (stage.mode == CHARGE_REG_POWER) ? "W" : "A");
+
+    if (stage.mode != CHARGE_REG_VOLTAGE) {
+        if (next_state == STATE_CHARGING_CC && cc_state_start_time == 0) {
+            cc_state_start_time = now;
+        }
+        eta_fit_reset(&eta_cc_fit, ETA_CC_WINDOW_S);
+        ff_entry_pending = true;  // Ramp straight to the learned frequency for the new current
+
+        // Voltage saturation tracking starts once the entry transient has settled. The voltage
+        // rises in proportion to the current, so a reduced-current stage gets a lower threshold.
+        if (stage.flags & CHARGE_STAGE_SATURATION) {
+            float current_frac = (profile.const_current > 0.0f) ?
+                                 stage_current(stage, volt) / (profile.const_current * 100.0f) : 1.0f;
+            sat_detector_reset(&sat_detector, now);
+            sat_detector.threshold_mv_per_min = VOLTAGE_SATURATION_SLOPE_MV_PER_MIN * current_frac;
+            logf("[VOLT_SAT] CC entry at %.2fV: slope window %lu s after %lu s settling, threshold %.1f mV/min",
+                 volt, (unsigned long)(VOLTAGE_SATURATION_WINDOW_MS / 1000),
+                 (unsigned long)(VOLTAGE_SATURATION_SETTLE_MS / 1000), sat_detector.threshold_mv_per_min);
+        }
+        return;
+    }
+
+    if (prev_state == STATE_CHARGING_CC) {
+        logf("[CHARGING] Voltage reached target, transitioning to CV mode");
+    }
+    cv_start_time = now;
+    eta_fit_reset(&eta_cv_fit, ETA_CV_WINDOW_S);
+
+    // Send the CV frequency now so the motor never waits a period for a command
+    command(pi_frequency(PI_MODE_CV, stage.setpoint, (uint16_t)(volt * 100)));
+    unsigned long budget = stage_timeout(stage);
+    if (budget > 0) {
+        unsigned long rem_seconds = budget / 1000;
+        logf("[CHARGING] Initial remaining time: %02lu:%02lu (target CV time: %lu ms)",
+             rem_seconds / 60, rem_seconds % 60, budget);
+    }
+}
+
+// Saturation stage: fitted CC voltage slope confidently below the threshold -> saturation CV
+bool ChargeController::update_saturation(float volt, unsigned long now) {
+    if (now - stage_start_time < VOLTAGE_SATURATION_SETTLE_MS) {
+        sat_detector_reset(&sat_detector, now);
+        return false;
+    }
+    if (resume_time > 0 && now - resume_time < VOLTAGE_SATURATION_RESUME_MS) {
+        sat_detector_resync(&sat_detector, now);  // Checkpointed window kept through the restart transient
+        return false;
+    }
+    if (!sat_detector_add(&sat_detector, volt, now)) {
+        return false;
+    }
+    const uint32_t log_buckets = VOLTAGE_SATURATION_LOG_MS / VOLTAGE_SATURATION_SAMPLE_MS;
+    if (sat_detector.filled == sat_detector.points &&
+        (sat_detector_saturated(&sat_detector) || sat_detector.buckets % log_buckets == 0)) {
+        logf("[VOLT_SAT] Slope %.1f +/- %.1f mV/min (threshold %.1f) at %.3fV",
+             sat_detector.slope_mv_per_min, SAT_DETECTOR_SIGMA * sat_detector.sigma_mv_per_min,
+             sat_detector.threshold_mv_per_min, sat_detector_voltage(&sat_detector));
+    }
+    if (!sat_detector_saturated(&sat_detector)) {
+        return false;
+    }
+
+    voltage_saturation_detected_voltage = sat_detector_voltage(&sat_detector);
+    logf("[VOLT_SAT] Saturation detected! Saturation voltage %.2fV", voltage_saturation_detected_voltage);
+    app_state = STATE_CHARGING_VOLTAGE_SATURATION;
+    voltage_saturation_cv_start_time = now;
+    current_flow_start = false;  // Reset on saturate entry
+
+    // CV on the saturation voltage right away
+    uint16_t saturation_voltage_0_01V = (uint16_t)(voltage_saturation_detected_voltage * 100);
+    command(pi_frequency(PI_MODE_SAT_CV, saturation_voltage_0_01V, (uint16_t)(volt * 100)));
+    logf("[VOLT_SAT] CV frequency command sent immediately on saturation transition");
+    return true;
+}
+
+// ============================================================================
+// Control period
+// ============================================================================
+void ChargeController::step(void) {
+    // Only run in charging states
+    if (!is_charging_state(app_state)) {
+        if (ff_learning) {
+            ff_learning = false;
+            ff_map_end();  // Charge over (any stop path): fold this charge into the learned map
+        }
+        return;
+    }
+    if (!has_profile) {
+        return;
+    }
+    ff_learning = true;
+
+    const charge_sample_t sample = sensors.read();
+    const unsigned long now = clock.now_ms();
+    update_counter(sample, now);
+    update_eta(sample, now);
+
+    // Stop rules before any command: time-based rules need a check even without a new sample
+    if (evaluate_stop_rules(sample, now)) {
+        return;
+    }
+
+    // Clamp negative values to 0 to prevent unsigned wrap-around
+    float safe_actual_current = (sample.curr < 0.0f) ? 0.0f : sample.curr;
+    float safe_actual_voltage = (sample.volt < 0.0f) ? 0.0f : sample.volt;
+
+    // Convert to 0.01 units (as required by RS485 functions)
+    uint16_t actual_current_0_01A = (uint16_t)(safe_actual_current * 100);
+    uint16_t actual_voltage_0_01V = (uint16_t)(safe_actual_voltage * 100);
+
+    uint16_t new_frequency = current_frequency;
+
+    // Learn frequency -> current from quasi-steady samples (frequency held over the last period)
+    if (current_flow_start && !ff_ramp.active && tune.state != PI_AUTOTUNE_RUNNING &&
+        abs((int32_t) current_frequency - (int32_t) ff_last_frequency) <= FF_MAP_STEADY_STEP) {
+        ff_map_observe(safe_actual_voltage, actual_current_0_01A, current_frequency);
+    }
+    ff_last_frequency = current_frequency;
+
+    // ============================================================================
+    // Saturation CV: CV on the detected saturation voltage (ends on its time rule)
+    // ============================================================================
+    if (app_state == STATE_CHARGING_VOLTAGE_SATURATION) {
+        uint16_t saturation_voltage_0_01V = (uint16_t)(voltage_saturation_detected_voltage * 100);
+        if (!ff_frequency(safe_actual_voltage, (uint16_t)(PRECHARGE_AMPS * 100), actual_current_0_01A,
+                          vfd.max_frequency(), &new_frequency)) {
+            new_frequency = pi_frequency(PI_MODE_SAT_CV, saturation_voltage_0_01V, actual_voltage_0_01V);
+        }
+
+        #if ACTUAL_TARGET_CC_CV_debug
+        logf("[CHARGING_VOLT_SAT] Target: %.2fV, Actual: %.2fV, Freq: %.2f Hz -> %.2f Hz",
+             voltage_saturation_detected_voltage, safe_actual_voltage,
+             current_frequency / 100.0f, new_frequency / 100.0f);
+        #endif
+
+        command(new_frequency);
+        return;
+    }
+
+    // ============================================================================
+    // Plan stage (charge_plan.h): regulate on its setpoint, then check its exits
+    // ============================================================================
+    const charge_stage_t& stage = profile.plan.stages[stage_index];
+    if (stage.mode == CHARGE_REG_VOLTAGE) {
+        // After a resume the frequency starts from the floor: ramp to first flow, then the voltage loop
+        if (!ff_frequency(safe_actual_voltage, (uint16_t)(PRECHARGE_AMPS * 100), actual_current_0_01A,
+                          vfd.max_frequency(), &new_frequency)) {
+            new_frequency = pi_frequency(PI_MODE_CV, stage.setpoint, actual_voltage_0_01V);
+        }
+
+        #if ACTUAL_TARGET_CC_CV_debug
+        logf("[CHARGING_CV] Target: %.2fV, Actual: %.2fV, Freq: %.2f Hz -> %.2f Hz",
+             stage.setpoint / 100.0f, safe_actual_voltage, current_frequency / 100.0f, new_frequency / 100.0f);
+        #endif
+    } else if (app_state == STATE_CHARGING_START) {
+        // Precharge: current loop; learned frequency capped at 95% of the step 1 RPM limit
+        // (that check trips before current flows)
+        uint16_t precharge_target_0_01A = stage_current(stage, safe_actual_voltage);
+        uint16_t precharge_max_0_01Hz = (uint16_t)(PRECHARGE_RPM_LIMIT / vfd.rpm_per_hz() * 95);
+        if (!ff_frequency(safe_actual_voltage, precharge_target_0_01A, actual_current_0_01A, precharge_max_0_01Hz,
+                          &new_frequency)) {
+            new_frequency = pi_frequency(PI_MODE_PRECHARGE, precharge_target_0_01A, actual_current_0_01A);
+        }
+
+        #if ACTUAL_TARGET_CC_CV_debug
+        logf("[CHARGING_START] Target: %.2fA (Precharge), Actual: %.2fA, Freq: %.2f Hz -> %.2f Hz",
+             precharge_target_0_01A / 100.0f, safe_actual_current, current_frequency / 100.0f, new_frequency / 100.0f);
+        #endif
+    } else {
+        // Current (or power as current at this voltage) stage
+        uint16_t target_current_0_01A = stage_current(stage, safe_actual_voltage);
+        if (!ff_frequency(safe_actual_voltage, target_current_0_01A, actual_current_0_01A, vfd.max_frequency(),
+                          &new_frequency)) {
+            new_frequency = cc_frequency(target_current_0_01A, actual_current_0_01A);
+        }
+
+        #if ACTUAL_TARGET_CC_CV_debug
+        logf("[CHARGING_CC] Target: %.2fA, Actual: %.2fA, Freq: %.2f Hz -> %.2f Hz",
+             target_current_0_01A / 100.0f, safe_actual_current, current_frequency / 100.0f, new_frequency / 100.0f);
+        #endif
+    }
+    command(new_frequency);
+
+    if ((stage.flags & CHARGE_STAGE_SATURATION) && update_saturation(safe_actual_voltage, now)) {
+        return;
+    }
+
+    if (stage.mode == CHARGE_REG_VOLTAGE && stage.exit_0_01A > 0) {
+        update_tail(stage, sample, now);
+    }
+    if (stage.flags & CHARGE_STAGE_ADAPTIVE) {
+        update_precharge(stage, sample, now);
+    }
+    const char* exit = stage_exit(stage, sample, now);
+    if (exit != NULL) {
+        logf("[STAGE] '%s' done (%s) after %.2f min: %.2f V, %.2f A",
+             stage.name, exit, (now - stage_start_time) / 60000.0f, safe_actual_voltage, safe_actual_current);
+        enter_stage(stage_index + 1, safe_actual_voltage, now);
+    }
+}
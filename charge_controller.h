@@ -0,0 +1,419 @@
+#ifndef CHARGE_CONTROLLER_H
+#define CHARGE_CONTROLLER_H
+
+#include <stdint.h>
+#include "pi_controller.h"
+#include "pi_autotune.h"
+#include "ff_map.h"
+#include "eta_estimator.h"
+#include "sat_detector.h"
+#include "charge_counter.h"
+#include "charge_plan.h"
+
+class BatteryType;
+
+// ============================================================================
+// ChargeController - charging FSM with injected I/O
+// ============================================================================
+/*
+The stages of the profile's charge plan (charge_plan.h; precharge -> CC -> CV by default,
+or saturation CV) -> complete / emergency stop, the PI/auto-tune/feed-forward frequency
+control, stage timers, Ah/Wh integration and the stop conditions.
+The controller owns all charging state; everything it touches outside itself goes
+through five small interfaces: clock, sensor source, VFD sink, contactor sink and
+log sink. No Arduino, FreeRTOS or LVGL includes here or in charge_controller.cpp, so
+the FSM builds and runs on a host against fake sinks (it still links pi_controller,
+pi_autotune and ff_map).
+
+The firmware instance and its adapters (charge_millis, sensor snapshot, RS485, CAN
+contactor, Serial) live in charge_control.cpp. Threading is the caller's job: step()
+runs in the control task and every other mutating call is made with
+charge_control_lock() held. The UI is an observer: it reads state()/status() and only
+calls start(), stop(), reset() and halt() from its event handlers.
+
+Stop conditions are a table of rules (stop_rules[] in charge_controller.cpp): a predicate
+over the sample and controller state, the states it applies in, the stop reason, the state
+the FSM ends in and a priority. check_stop_rules() evaluates the table for every new sensor
+sample (the control task is woken by each 0x101/0x102 frame, not just once per period) and
+step() evaluates it once more at the top of every period, before any frequency command. If
+several rules fire on one sample the lowest priority number wins; its name, the charge
+time and the sample are logged, and finish() is the only shutdown sequence. Stage
+transitions are not rules: after its command every period, step() checks the running
+stage's exits (voltage, tail current, time, healthy precharge response) and moves to the next stage, and running
+past the last stage completes the charge.
+
+checkpoint() captures what a charge needs to continue after a reset (state and plan
+stage, stage start times as charge time, Ah/Wh counter, saturation-detector window) and
+resume() restarts the outputs and carries on from it. The charge clock continues from the checkpoint;
+the outage itself is not charge time. After a resume the disconnect rule waits for
+current to flow again (resume_no_flow stops the charge if it does not), and the
+saturation detector and the ETA fits skip the restart transient.
+*/
+
+// Debug macro for CC/CV charging control prints
+#define ACTUAL_TARGET_CC_CV_debug 0  // 1 = print, 0 = print off
+#define Ah_CALCULATION_DEBUG 0  // 1 = print, 0 = print off
+
+// Voltage saturation detection (3kW): CC voltage slope over a sliding window (sat_detector.h)
+#define VOLTAGE_SATURATION_SETTLE_MS ETA_SETTLE_MS            // CC entry transient (IR step, FF ramp, PI settling), not fitted
+#define VOLTAGE_SATURATION_WINDOW_MS (5 * 60 * 1000)          // Fit window: first decision 10 min into CC, as the old check
+#define VOLTAGE_SATURATION_SAMPLE_MS 2500                     // Bucket (boxcar average) length: window / SAT_DETECTOR_MAX_POINTS
+#define VOLTAGE_SATURATION_SLOPE_MV_PER_MIN 20.0f             // Saturated below this (0.2 V per 10 min)
+#define VOLTAGE_SATURATION_LOG_MS (60 * 1000)                 // Slope log interval
+#define VOLTAGE_SATURATION_RESUME_MS (2 * 60 * 1000)          // After a resume: window kept, not fed
+#define VOLTAGE_SATURATION_CV_DURATION_MS (5 * 60 * 1000)     // xx2: 5 minutes in milliseconds
+
+// Precharge timing macros (Screen 3 - Charging Start)
+//#define PRECHARGE_TIME_MS (1.2 * 60 * 1000)  // 3 minutes in milliseconds
+#define PRECHARGE_TIME_MS (5 * 60 * 1000)  // 3 minutes in milliseconds
+#define PRECHARGE_AMPS 5.0f                // 2.0 Amps threshold
+// Step 1 safety: current must flow within this time, else volt_or_current error
+#define PRECHARGE_CURRENT_FLOW_TIMEOUT_MS (45 * 1000)  // 45 seconds (precharge can be 1 min)
+#define PRECHARGE_RPM_LIMIT 3700           // RPM above this in step 1 -> volt_or_current error
+
+// Adaptive precharge: IR from the 0 A -> PRECHARGE_AMPS step; a healthy pack goes to CC early.
+// Voltages are fractions of the rated voltage.
+#define PRECHARGE_MIN_TIME_MS (60 * 1000)            // Shortest precharge of a healthy pack
+#define PRECHARGE_OCV_MAX_AMPS 0.3f                  // Open-circuit voltage: samples below this, before flow
+#define PRECHARGE_IR_TOLERANCE 0.2f                  // Current within 20% of the precharge target ...
+#define PRECHARGE_IR_SETTLE_MS 5000                  // ... this long before the voltage is averaged
+#define PRECHARGE_IR_WINDOW_MS 10000                 // Averaging window (first half vs second half: sag check)
+#define PRECHARGE_IR_DEADLINE_MS (2 * 60 * 1000)     // No settled step by then: full precharge
+#define PRECHARGE_SHORT_VOLT_FRAC 0.85f              // OCV below: suspected shorted cell
+#define PRECHARGE_SAG_VOLT_FRAC 0.002f               // Voltage falling more than this under current: suspected short
+#define PRECHARGE_DEEP_VOLT_FRAC 1.0f                // OCV below the rated voltage: deeply discharged
+#define PRECHARGE_IR_MAX_FRAC 0.20f                  // IR drop at the CC current above this: high IR
+
+// CV time budget: precharge time + 50% of the CC time, at most this (cap when CV ends on a tail current)
+#define CV_MAX_TIME_MS (33 * 60 * 1000)    // 33 minutes
+
+// PI frequency control (pi_controller.h)
+#define CHARGE_FREQ_SLEW_PER_S 300         // Max frequency change per second (0.01Hz units = 3 Hz/s)
+#define CHARGE_PI_MAX_DT_MS 2000           // dt clamp after a stalled control loop
+
+// Temperature threshold macro
+#define MAX_TEMP_THRESHOLD 80.0f           // 80.0 degrees Celsius
+
+// Disconnect stop: current below this after flow started. The CV tail exit is floored
+// above it (charge_plan.h) so a small pack can taper out before this rule fires.
+#define CHARGE_DISCONNECT_AMPS 1.0f
+static_assert(CHARGE_STAGE_TAIL_MIN_AMPS > CHARGE_DISCONNECT_AMPS, "tail exit below the disconnect threshold");
+
+// Capacity stop: delivered Ah over the rated Ah
+#define CHARGE_CAPACITY_LIMIT_FRAC 1.1f
+
+// Bit for an app_state_t in a stop rule's state mask
+#define CHARGE_RULE_STATE(state) (1u << (state))
+
+typedef enum {
+    STATE_HOME = 0,               // Home state
+    STATE_BATTERY_DETECTED,       // Battery detected
+    STATE_CHARGING_START,         // Charging start (waiting for 1A current)
+    STATE_CHARGING_CC,            // Constant Current mode
+    STATE_CHARGING_CV,            // Constant Voltage mode
+    STATE_CHARGING_VOLTAGE_SATURATION, // Voltage saturation detected (CV with saturation voltage)
+    STATE_CHARGING_COMPLETE,      // Charging complete
+    STATE_EMERGENCY_STOP          // Emergency stop
+} app_state_t;
+
+// Charge stop reason enum
+typedef enum {
+    CHARGE_STOP_NONE = 0,              // No stop reason
+    CHARGE_STOP_COMPLETE = 1,          // Charging complete (normal termination)
+    CHARGE_STOP_EMERGENCY = 2,         // Emergency stop (user initiated)
+    CHARGE_STOP_VOLTAGE_SATURATION = 3, // Charge stopped due to voltage saturation
+    CHARGE_STOP_VOLTAGE_LIMIT_PRECHARGE = 4, // Voltage limit reached during precharge
+    CHARGE_STOP_HIGH_TEMP = 5,         // Emergency stop due to high temperature
+    CHARGE_STOP_110_PERCENT_CAPACITY = 6, // Charge stopped: 110% capacity reached, Ah limit
+    CHARGE_STOP_BATTERY_DISCONNECTED = 7, // Battery disconnected (current dropped below 1.0 A after flow)
+    CHARGE_STOP_VOLT_OR_CURRENT_ERROR = 8, // Step 1: no current flow in time or RPM > limit
+    CHARGE_STOP_VFD_FAULT = 9          // VFD reported a fault code, or stopped answering on RS485
+} charge_stop_reason_t;
+
+// Adaptive precharge decision (charge log)
+typedef enum {
+    CHARGE_PRECHARGE_NONE = 0,         // Not decided (charge ended first, or no rated voltage)
+    CHARGE_PRECHARGE_EARLY,            // Healthy response: CC after PRECHARGE_MIN_TIME_MS
+    CHARGE_PRECHARGE_FULL_SHORT,       // OCV too low, no voltage step, or voltage sagging under current
+    CHARGE_PRECHARGE_FULL_DEEP,        // Deeply discharged
+    CHARGE_PRECHARGE_FULL_HIGH_IR,     // IR drop at the CC current too high
+    CHARGE_PRECHARGE_FULL_NO_STEP      // No 0 A reading, or the current never settled at the target
+} charge_precharge_t;
+
+// Battery profile as the controller needs it (the BatteryType is only a key for the
+// per-profile gain store, gain schedule and feed-forward map)
+typedef struct {
+    const BatteryType* battery;
+    float const_current;            // A, CC target and the ceiling of every stage
+    float cutoff_voltage;           // V, CV target and the ceiling of every stage
+    float rated_ah;
+    float rated_voltage;            // V, reference for the adaptive precharge (0: always the full precharge)
+    charge_plan_t plan;             // Compiled stages; count 0: standard plan, compiled by start()
+} charge_profile_t;
+
+// Hard-limit interlock outside the controller (firmware: CAN receive path, safety_interlock.h)
+typedef enum {
+    CHARGE_INTERLOCK_NONE = 0,
+    CHARGE_INTERLOCK_LIMIT,         // Volts or amps over the hard limit
+    CHARGE_INTERLOCK_TEMP           // Temperature over the hard limit
+} charge_interlock_t;
+
+// VFD state read back over RS485 (firmware: rs485_get_vfd_status())
+typedef enum {
+    CHARGE_VFD_OK = 0,              // Answering, no fault (or the fault register is not polled)
+    CHARGE_VFD_OFFLINE,             // VFD_OFFLINE_AFTER_FAILS transactions in a row failed
+    CHARGE_VFD_FAULT                // Fault code register non-zero
+} charge_vfd_t;
+
+typedef struct {
+    float volt;                     // V
+    float curr;                     // A
+    int32_t temp1;                  // 0.01 °C (motor)
+    int32_t temp2;                  // 0.01 °C (GCU / generator)
+    uint32_t seq;                   // Changes with every new sample (0 = source has no sequence)
+    uint32_t vi_ms;                 // Controller clock when volt/curr were measured (0 = unknown: read time)
+    charge_interlock_t interlock;   // Tripped since the charge started (outputs already off)
+    charge_vfd_t vfd;
+} charge_sample_t;
+
+// Charge in progress, as resume() needs it. Times are charge time (ms since the charge
+// started); a stage start of 0 means the stage was not reached.
+typedef struct {
+    uint8_t state;                  // app_state_t, a charging state
+    uint8_t stage;                  // Index in the profile's plan
+    bool current_flow_start;
+    uint32_t elapsed_ms;
+    uint32_t cc_start_ms;
+    uint32_t cv_start_ms;
+    uint32_t saturation_start_ms;
+    uint32_t stage_start_ms;
+    uint32_t precharge_duration_ms;
+    uint32_t cc_duration_ms;
+    float saturation_voltage;
+    float precharge_ir_ohm;
+    uint8_t precharge_check;        // charge_precharge_t
+    charge_counter_t counter;
+    sat_detector_t sat_detector;
+} charge_checkpoint_t;
+
+// Handed to the log sink once per charge, on whichever path it ends
+typedef struct {
+    float end_volt;
+    unsigned long total_time_ms;
+    float ah_final;
+    float wh_final;
+    float max_volt;                 // Peaks over the charge, every sample
+    float max_curr;
+    int32_t max_temp1;              // 0.01 °C
+    int32_t max_temp2;
+    charge_stop_reason_t stop_reason;
+    float precharge_ir_ohm;         // From the precharge step, < 0 = not measured
+    charge_precharge_t precharge_check;
+    eta_point_t eta[ETA_LOG_POINTS];  // Remaining-time estimates made during the charge
+    uint8_t eta_points;
+} charge_result_t;
+
+// What the UI shows (copied under the lock)
+typedef struct {
+    app_state_t state;
+    charge_stop_reason_t stop_reason;
+    bool complete;                  // Charge over, timers frozen
+    unsigned long elapsed_ms;       // Total charge time, 0 = not started
+    long remaining_ms;              // Time to the end of the charge (CV time left once complete), -1 = not known yet
+    long remaining_lo_ms;           // Band around remaining_ms (equal to it on a time budget), hi -1 = unbounded
+    long remaining_hi_ms;
+    float ah;
+    float wh;
+    float saturation_voltage;       // Target of the saturation CV stage
+    uint16_t frequency;             // Last frequency command, 0.01Hz
+} charge_status_t;
+
+// ============================================================================
+// Injected interfaces
+// ============================================================================
+class ChargeClock {
+public:
+    virtual ~ChargeClock() {}
+    virtual unsigned long now_ms(void) = 0;
+};
+
+class ChargeSensorSource {
+public:
+    virtual ~ChargeSensorSource() {}
+    virtual charge_sample_t read(void) = 0;       // Latest sample
+};
+
+class ChargeVfdSink {
+public:
+    virtual ~ChargeVfdSink() {}
+    virtual void start(void) = 0;
+    virtual void set_frequency(uint16_t freq_0_01Hz) = 0;
+    virtual void stop(void) = 0;
+    virtual uint16_t min_frequency(void) const = 0;   // 0.01Hz
+    virtual uint16_t max_frequency(void) const = 0;
+    virtual float rpm_per_hz(void) const = 0;
+};
+
+class ChargeContactorSink {
+public:
+    virtual ~ChargeContactorSink() {}
+    virtual void set_closed(bool closed) = 0;
+};
+
+class ChargeLogSink {
+public:
+    virtual ~ChargeLogSink() {}
+    virtual void message(const char* text) = 0;   // One diagnostic line, no newline
+    virtual void charge_finished(const charge_result_t* result) = 0;
+};
+
+// ============================================================================
+// Controller
+// ============================================================================
+class ChargeController {
+public:
+    ChargeController(ChargeClock& clock, ChargeSensorSource& sensors, ChargeVfdSink& vfd,
+                     ChargeContactorSink& contactor, ChargeLogSink& log, uint32_t period_ms);
+
+    void start(const charge_profile_t* profile);  // Close contactor, start VFD, enter precharge
+    void resume(const charge_profile_t* profile, const charge_checkpoint_t* checkpoint);  // Start, then continue there
+    void step(void);                              // One control period
+    bool check_stop_rules(void);                  // New sensor sample: Ah/Wh and stop rules only; true if the charge stopped
+    void stop(charge_stop_reason_t reason);       // Stop from outside the FSM (emergency button)
+    void halt(void);                              // Outputs off, FSM parked in EMERGENCY_STOP without a record (M2 lost)
+    void reset(void);                             // Back to STATE_HOME, timers and stop reason cleared
+    void send_pending_stop(void);                 // VFD stop command deferred until the stop screen has loaded
+
+    app_state_t state(void) const { return app_state; }
+    charge_stop_reason_t stop_reason(void) const { return stop_reason_code; }
+    bool running(void) const { return charging_start_time > 0 && !charging_complete; }
+    bool stop_pending(void) const { return pending_stop_command; }
+    uint16_t frequency(void) const { return current_frequency; }
+    const charge_profile_t& active_profile(void) const { return profile; }
+    const charge_counter_t& counter(void) const { return charge_counter; }
+    bool checkpoint(charge_checkpoint_t* out) const;  // False when no charge is running
+    void status(charge_status_t* out);
+
+private:
+    // Stop rule: fires(controller, sample, now) -> finish(reason, next_state)
+    typedef struct {
+        const char* name;
+        uint8_t priority;                         // Lower wins when several fire on one sample
+        uint8_t states;                           // Bit mask of app_state_t (CHARGE_RULE_STATE)
+        charge_stop_reason_t reason;
+        app_state_t next_state;
+        bool (*fires)(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now);
+    } stop_rule_t;
+    static const stop_rule_t stop_rules[];
+
+    ChargeClock& clock;
+    ChargeSensorSource& sensors;
+    ChargeVfdSink& vfd;
+    ChargeContactorSink& contactor;
+    ChargeLogSink& log_sink;
+    const uint32_t period_ms;
+
+    charge_profile_t profile;
+    bool has_profile;
+    app_state_t app_state;
+    charge_stop_reason_t stop_reason_code;
+
+    // Timers
+    unsigned long charging_start_time;            // When charging started (screen 3)
+    unsigned long cv_start_time;                  // When CV state started (screen 5)
+    unsigned long cc_state_start_time;
+    unsigned long cc_state_duration;              // CC state duration for the CV time and remaining time
+    unsigned long precharge_duration;             // Set at precharge->CC, for the CV time
+    uint8_t stage_index;                          // Running stage of profile.plan
+    unsigned long stage_start_time;
+    float tail_current;                           // Low-pass filtered CV current for the tail exit (A)
+    bool tail_primed;                             // tail_current seeded in this stage
+    unsigned long tail_last_ms;
+    uint32_t tail_seq;                            // Sample the filter last took
+    uint16_t tail_samples;                        // New samples in a row with tail_current at or below the exit
+
+    // Adaptive precharge
+    float precharge_ocv_sum;                      // Voltage before flow
+    uint16_t precharge_ocv_count;
+    unsigned long precharge_step_since;           // Current settled at the target since (0 = not)
+    float precharge_step_volt[2];                 // Voltage sums, first and second half of the window
+    uint16_t precharge_step_count[2];
+    float precharge_step_curr;
+    float precharge_ir_ohm;                       // < 0 = not measured
+    charge_precharge_t precharge_check;
+    unsigned long final_charging_time_ms;         // Frozen when the charge ends
+    unsigned long final_remaining_time_ms;
+    bool charging_complete;                       // Timers stop updating
+    bool pending_stop_command;                    // VFD stop after the stop screen has loaded
+    bool current_flow_start;                      // True after current >= 1.5 A in step 1; used for disconnect and timeout
+    unsigned long flow_wait_start_time;           // Start or resume: the no-flow timeout runs from here
+    bool resume_flow_pending;                     // Resumed in CC/CV: flow latches again on the first current
+    unsigned long resume_time;                    // 0 = charge not resumed
+    uint32_t last_rule_seq;                       // Sample the stop rules last saw
+
+    // Ah, Wh and peaks (charge_counter.h)
+    charge_counter_t charge_counter;
+
+    // Frequency control
+    uint16_t current_frequency;                   // Current motor frequency in 0.01Hz units (0 = stopped)
+    pi_controller_t pi;
+    pi_mode_t pi_mode;                            // Mode pi is tuned for (NONE = re-seed on next update)
+    unsigned long pi_last_ms;
+    pi_autotune_t tune;                           // CC relay auto-tune (pi_autotune.h)
+    bool autotune_pending;                        // Profile has no stored gains: tune once in CC
+    ff_ramp_t ff_ramp;                            // Feed-forward transition ramp (ff_map.h)
+    bool ff_entry_pending;                        // Next update of the state ramps to the learned frequency
+    uint16_t ff_handover_0_01A;                   // Current at which the ramp hands over to the PI
+    bool ff_learning;                             // A charge is feeding the map
+    uint16_t ff_last_frequency;                   // Frequency applied one period earlier (steady-sample check)
+
+    // Voltage saturation detection (3kW)
+    sat_detector_t sat_detector;                  // CC voltage slope
+    float voltage_saturation_detected_voltage;
+    unsigned long voltage_saturation_cv_start_time;
+
+    // Remaining-time estimate (eta_estimator.h)
+    eta_fit_t eta_cc_fit;                         // Voltage against charge time in CC
+    eta_fit_t eta_cv_fit;                         // ln(current) against charge time in CV
+    eta_point_t eta_log[ETA_LOG_POINTS];
+    uint8_t eta_log_count;
+    unsigned long eta_log_interval_ms;
+    unsigned long eta_next_log_ms;
+
+    static bool is_charging_state(app_state_t state);
+    bool settled(unsigned long now, unsigned long stage_start, unsigned long settle_ms) const;
+    void clear_timers(void);
+    unsigned long cv_target_time(void) const;
+    unsigned long stage_timeout(const charge_stage_t& stage) const;
+    uint16_t stage_current(const charge_stage_t& stage, float volt) const;
+    void update_tail(const charge_stage_t& stage, const charge_sample_t& sample, unsigned long now);
+    void update_precharge(const charge_stage_t& stage, const charge_sample_t& sample, unsigned long now);
+    const char* stage_exit(const charge_stage_t& stage, const charge_sample_t& sample, unsigned long now) const;
+    void enter_stage(uint8_t index, float volt, unsigned long now);
+    bool update_saturation(float volt, unsigned long now);
+    void update_counter(const charge_sample_t& sample, unsigned long now);
+    void update_eta(const charge_sample_t& sample, unsigned long now);
+    bool estimate_remaining(unsigned long now, long* remaining_ms, long* lo_ms, long* hi_ms) const;
+    unsigned long cc_finish_ms(unsigned long now, float cc_remaining_s) const;
+    void command(uint16_t frequency);
+    uint16_t pi_frequency(pi_mode_t mode, uint16_t setpoint_0_01, uint16_t measured_0_01);
+    uint16_t cc_frequency(uint16_t target_0_01A, uint16_t actual_0_01A);
+    bool ff_frequency(float volt, uint16_t target_0_01A, uint16_t actual_0_01A, uint16_t max_0_01Hz,
+                      uint16_t* frequency);
+    bool evaluate_stop_rules(const charge_sample_t& sample, unsigned long now);
+    void finish(charge_stop_reason_t reason, app_state_t next_state, float end_volt);
+
+    static bool rule_interlock_limit(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now);
+    static bool rule_interlock_temp(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now);
+    static bool rule_vfd_fault(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now);
+    static bool rule_high_temp(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now);
+    static bool rule_disconnected(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now);
+    static bool rule_no_flow(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now);
+    static bool rule_resume_no_flow(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now);
+    static bool rule_capacity(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now);
+    static bool rule_precharge_voltage(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now);
+    static bool rule_saturation_cv_time(const ChargeController& ctl, const charge_sample_t& sample, unsigned long now);
+    void logf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+#endif // CHARGE_CONTROLLER_H
@@ -0,0 +1,45 @@
+#include "charge_counter.h"
+#include <string.h>
+
+#define CHARGE_COUNTER_2MAMS_PER_AH 7200000000.0   // 2 * 3600 s * 1000 ms * 1000 mA
+#define CHARGE_COUNTER_2MWMS_PER_WH 7200000000.0
+
+void charge_counter_reset(charge_counter_t* counter) {
+    memset(counter, 0, sizeof(*counter));
+}
+
+bool charge_counter_add(charge_counter_t* counter, float volt, float curr, uint32_t t_ms) {
+    if (counter->primed && t_ms == counter->last_ms) {
+        return false;
+    }
+    const int32_t ma = (curr > 0.0f) ? (int32_t)(curr * 1000.0f + 0.5f) : 0;
+    const int32_t mv = (volt > 0.0f) ? (int32_t)(volt * 1000.0f + 0.5f) : 0;
+    const int32_t mw = (int32_t)(((int64_t) mv * ma) / 1000);
+
+    if (counter->primed) {
+        const int64_t dt_ms = (uint32_t)(t_ms - counter->last_ms);
+        counter->charge_2mams += (int64_t)(counter->last_ma + ma) * dt_ms;
+        counter->energy_2mwms += (int64_t)(counter->last_mw + mw) * dt_ms;
+        counter->samples++;
+    }
+    counter->last_ms = t_ms;
+    counter->last_ma = ma;
+    counter->last_mw = mw;
+    counter->primed = true;
+    return true;
+}
+
+void charge_counter_peaks(charge_counter_t* counter, float volt, float curr, int32_t temp1, int32_t temp2) {
+    if (volt > counter->max_volt) counter->max_volt = volt;
+    if (curr > counter->max_curr) counter->max_curr = curr;
+    if (temp1 > counter->max_temp1) counter->max_temp1 = temp1;
+    if (temp2 > counter->max_temp2) counter->max_temp2 = temp2;
+}
+
+float charge_counter_ah(const charge_counter_t* counter) {
+    return (float)(counter->charge_2mams / CHARGE_COUNTER_2MAMS_PER_AH);
+}
+
+float charge_counter_wh(const charge_counter_t* counter) {
+    return (float)(counter->energy_2mwms / CHARGE_COUNTER_2MWMS_PER_WH);
+}
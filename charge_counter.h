@@ -0,0 +1,45 @@
+#ifndef CHARGE_COUNTER_H
+#define CHARGE_COUNTER_H
+
+#include <stdint.h>
+
+// ============================================================================
+// Coulomb and energy counter, integrated on every sensor sample
+// ============================================================================
+/*
+Each new volt/current sample (identified by its receive timestamp, so a temperature
+frame or a repeated read adds nothing) adds the trapezoid between it and the previous
+sample. Sums are 64-bit integers: charge in mA*ms and energy in mW*ms, both doubled (the
+trapezoid's /2 is taken once on read), so nothing is lost to float rounding over a
+multi-hour charge. Negative current counts as 0, as before. Peaks of volts, amps and
+the motor/GCU temperatures are kept at the same rate (from 0, like the SD record they feed).
+
+Plain struct: the session checkpoint (charge_session.h) copies it every control period,
+so a reset or power loss does not zero the totals.
+*/
+
+typedef struct {
+    int64_t charge_2mams;           // 2 * mA*ms
+    int64_t energy_2mwms;           // 2 * mW*ms
+    uint32_t last_ms;               // Timestamp of the previous sample
+    int32_t last_ma;
+    int32_t last_mw;
+    bool primed;                    // last_* hold a sample
+    uint32_t samples;               // Integrated samples
+
+    // Peaks
+    float max_volt;                 // V
+    float max_curr;                 // A
+    int32_t max_temp1;              // 0.01 °C (motor)
+    int32_t max_temp2;              // 0.01 °C (GCU / generator)
+} charge_counter_t;
+
+void charge_counter_reset(charge_counter_t* counter);
+// New volt/current sample taken at t_ms; false when t_ms is the previous sample's (nothing added)
+bool charge_counter_add(charge_counter_t* counter, float volt, float curr, uint32_t t_ms);
+void charge_counter_peaks(charge_counter_t* counter, float volt, float curr, int32_t temp1, int32_t temp2);
+
+float charge_counter_ah(const charge_counter_t* counter);
+float charge_counter_wh(const charge_counter_t* counter);
+
+#endif // CHARGE_COUNTER_H
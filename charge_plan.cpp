@@ -0,0 +1,122 @@
+#include "charge_plan.h"
+#include "charge_controller.h"
+#include <string.h>
+
+#define EQUALISE_VOLT_FRAC  0.9375f     // Bulk/absorption at 15/16 of the cutoff (15.0 V of 16 V)
+
+// name, mode, flags, setpoint, entry volt, exit volt, exit C, timeout
+#define STAGE_PRECHARGE { "precharge", CHARGE_REG_CURRENT, \
+                          CHARGE_STAGE_PRECHARGE | CHARGE_STAGE_ABSOLUTE | CHARGE_STAGE_ADAPTIVE, \
+                          PRECHARGE_AMPS, 0.0f, 0.0f, 0.0f, PRECHARGE_TIME_MS }
+
+static const charge_stage_def_t plan_standard[] = {
+    STAGE_PRECHARGE,
+    { "cc", CHARGE_REG_CURRENT, CHARGE_STAGE_SATURATION, 1.0f, 0.0f, 1.0f, 0.0f, 0 },
+    { "cv", CHARGE_REG_VOLTAGE, 0, 1.0f, 0.0f, 0.0f, CHARGE_STAGE_TAIL_C, CHARGE_STAGE_CV_BUDGET },
+};
+
+// After the step down the voltage relaxes for longer than the saturation settle time, so
+// the slope detector only watches the full-current step
+static const charge_stage_def_t plan_two_step_cc[] = {
+    STAGE_PRECHARGE,
+    { "cc_high", CHARGE_REG_CURRENT, CHARGE_STAGE_SATURATION, 1.0f, 0.925f, 0.925f, 0.0f, 0 },
+    { "cc_low", CHARGE_REG_CURRENT, 0, 0.5f, 0.0f, 1.0f, 0.0f, 0 },
+    { "cv", CHARGE_REG_VOLTAGE, 0, 1.0f, 0.0f, 0.0f, CHARGE_STAGE_TAIL_C, CHARGE_STAGE_CV_BUDGET },
+};
+
+static const charge_stage_def_t plan_equalise[] = {
+    STAGE_PRECHARGE,
+    { "cc", CHARGE_REG_CURRENT, CHARGE_STAGE_SATURATION, 1.0f, 0.0f, EQUALISE_VOLT_FRAC, 0.0f, 0 },
+    { "absorption", CHARGE_REG_VOLTAGE, 0, EQUALISE_VOLT_FRAC, 0.0f, 0.0f, CHARGE_STAGE_TAIL_C, CHARGE_STAGE_CV_BUDGET },
+    { "equalise", CHARGE_REG_CURRENT, CHARGE_STAGE_C_RATE, 0.05f, 0.0f, 1.0f, 0.0f, 60UL * 60 * 1000 },
+};
+
+typedef struct {
+    const char* name;
+    const charge_stage_def_t* stages;
+    uint8_t count;
+} charge_plan_entry_t;
+
+#define PLAN(name, stages) { name, stages, sizeof(stages) / sizeof(stages[0]) }
+
+// Indexed by charge_plan_id_t
+static const charge_plan_entry_t plans[CHARGE_PLAN_COUNT] = {
+    PLAN("standard", plan_standard),
+    PLAN("two_step_cc", plan_two_step_cc),
+    PLAN("equalise", plan_equalise),
+};
+
+static uint16_t to_0_01(float value) {
+    if (value <= 0.0f) {
+        return 0;
+    }
+    float scaled = value * 100.0f + 0.5f;
+    return (scaled >= 65535.0f) ? 65535 : (uint16_t) scaled;
+}
+
+static uint16_t to_watts(float value) {
+    if (value <= 0.0f) {
+        return 0;
+    }
+    return (value + 0.5f >= 65535.0f) ? 65535 : (uint16_t)(value + 0.5f);
+}
+
+static float clamp_max(float value, float max) {
+    return (value > max) ? max : value;
+}
+
+bool charge_plan_compile(charge_plan_t* plan, uint8_t id, float const_current, float cutoff_voltage, float rated_ah) {
+    const bool known = id < CHARGE_PLAN_COUNT;
+    if (!known) {
+        id = CHARGE_PLAN_STANDARD;
+    }
+    const charge_plan_entry_t* entry = &plans[id];
+    memset(plan, 0, sizeof(*plan));
+    plan->id = id;
+
+    for (uint8_t i = 0; i < entry->count && i < CHARGE_PLAN_MAX_STAGES; i++) {
+        const charge_stage_def_t* def = &entry->stages[i];
+        charge_stage_t* stage = &plan->stages[i];
+        const bool absolute = (def->flags & CHARGE_STAGE_ABSOLUTE) != 0;
+        stage->name = def->name;
+        stage->mode = def->mode;
+        stage->flags = def->flags;
+
+        if (def->mode == CHARGE_REG_VOLTAGE) {
+            stage->state = STATE_CHARGING_CV;
+            stage->setpoint = to_0_01(clamp_max(absolute ? def->setpoint : def->setpoint * cutoff_voltage,
+                                                cutoff_voltage));
+        } else if (def->mode == CHARGE_REG_POWER) {
+            stage->state = STATE_CHARGING_CC;
+            stage->setpoint = to_watts(clamp_max(absolute ? def->setpoint
+                                                          : def->setpoint * const_current * cutoff_voltage,
+                                                 const_current * cutoff_voltage));
+        } else {
+            stage->state = STATE_CHARGING_CC;
+            float amps = absolute ? def->setpoint :
+                         (def->flags & CHARGE_STAGE_C_RATE) ? def->setpoint * rated_ah : def->setpoint * const_current;
+            if ((def->flags & CHARGE_STAGE_C_RATE) && amps < CHARGE_STAGE_TAIL_MIN_AMPS) {
+                // C/20 of a small pack would read as a disconnected battery
+                amps = CHARGE_STAGE_TAIL_MIN_AMPS;
+            }
+            stage->setpoint = to_0_01(clamp_max(amps, const_current));
+        }
+        if (def->flags & CHARGE_STAGE_PRECHARGE) {
+            stage->state = STATE_CHARGING_START;
+        }
+        stage->entry_0_01V = to_0_01(def->entry_volt * cutoff_voltage);
+        stage->exit_0_01V = to_0_01(def->exit_volt * cutoff_voltage);
+        float exit_amps = def->exit_c * rated_ah;
+        if (exit_amps > 0.0f && exit_amps < CHARGE_STAGE_TAIL_MIN_AMPS) {
+            exit_amps = CHARGE_STAGE_TAIL_MIN_AMPS;
+        }
+        stage->exit_0_01A = to_0_01(exit_amps);
+        stage->timeout_ms = def->timeout_ms;
+        plan->count++;
+    }
+    return known;
+}
+
+const char* charge_plan_name(uint8_t id) {
+    return (id < CHARGE_PLAN_COUNT) ? plans[id].name : "unknown";
+}
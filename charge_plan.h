@@ -0,0 +1,111 @@
+#ifndef CHARGE_PLAN_H
+#define CHARGE_PLAN_H
+
+#include <stdint.h>
+
+// ============================================================================
+// Charge plans: ordered stages compiled into a table per profile
+// ============================================================================
+/*
+A plan is an ordered list of stages. The controller runs them in order, and a charge
+that runs past the last stage is complete. Each stage has:
+  - a regulation mode: current (A), voltage (V) or power (W, as a current target of
+    P / V at the present voltage)
+  - a setpoint
+  - an entry condition: skipped while the voltage is already at or above entry_volt
+  - exit conditions (any one ends the stage):
+      voltage at or above exit_volt (current/power stages)
+      current at or below exit_c (voltage stages): from CHARGE_STAGE_EXIT_SETTLE_MS after
+      flow, the current is low-pass filtered (time constant CHARGE_STAGE_TAIL_FILTER_MS)
+      and must stay at or below exit_c for CHARGE_STAGE_TAIL_SAMPLES new samples in a row.
+      The compiled exit is at least CHARGE_STAGE_TAIL_MIN_AMPS: C/20 of a small pack is
+      under the disconnect threshold, which would stop the charge before the tail exit
+      timeout_ms of stage time. CHARGE_STAGE_CV_BUDGET is the CV time budget:
+      precharge + 50% of the CC time, at most CV_MAX_TIME_MS. With a tail current it is
+      only the safety cap for a pack that never tapers.
+  - flags: PRECHARGE (step 1 rules and RPM cap, shown on screen 3), SATURATION (the
+    CC voltage-slope detector may end the charge in saturation CV) and ADAPTIVE (the
+    stage ends after PRECHARGE_MIN_TIME_MS once the 0 A -> setpoint step has shown a
+    healthy pack: not shorted, not deeply discharged, IR in range)
+
+Definitions (charge_stage_def_t) are relative to the profile, so one plan serves every
+battery:
+  - setpoints: a fraction of the profile's CC current, cutoff voltage, or their product
+    for power; CHARGE_STAGE_ABSOLUTE takes A/V/W as given, CHARGE_STAGE_C_RATE a current
+    as a fraction of the rated Ah, at least CHARGE_STAGE_TAIL_MIN_AMPS like the tail exit
+  - voltages: a fraction of the cutoff
+  - exit currents: a fraction of the rated Ah (C-rate)
+charge_plan_compile() resolves them against the profile into the compact table the
+controller runs on (integer 0.01 A / 0.01 V / W). Setpoints are clamped to the
+profile's CC current and cutoff voltage, so those stay the ceilings the hard-limit
+interlock is armed with.
+
+Every stage shows as one of the existing charging states (app_state_t): precharge as
+CHARGING_START, current/power stages as CC and voltage stages as CV. Screens, stop rules
+and remaining-time models keep working per state; several stages can share one.
+*/
+
+#define CHARGE_PLAN_MAX_STAGES      6
+#define CHARGE_STAGE_CV_BUDGET      0xFFFFFFFFu         // timeout_ms: precharge + 50% CC, capped
+#define CHARGE_STAGE_EXIT_SETTLE_MS (60UL * 1000)       // Current exit ignored for this long after flow
+#define CHARGE_STAGE_TAIL_C         0.05f               // CV tail current: C/20 of the rated Ah
+#define CHARGE_STAGE_TAIL_FILTER_MS (20UL * 1000)       // Tail current low-pass time constant
+#define CHARGE_STAGE_TAIL_SAMPLES   30                  // Filtered current at or below the tail this many samples
+#define CHARGE_STAGE_TAIL_MIN_AMPS  1.5f                // Tail exit and C-rate setpoint floor: disconnect threshold (1.0 A) + margin
+
+typedef enum {
+    CHARGE_REG_CURRENT = 0,
+    CHARGE_REG_VOLTAGE,
+    CHARGE_REG_POWER
+} charge_reg_t;
+
+// Stage flags
+#define CHARGE_STAGE_PRECHARGE      0x01    // Step 1: precharge state, RPM cap, no-flow and voltage-limit rules
+#define CHARGE_STAGE_SATURATION     0x02    // Voltage-slope saturation detector runs
+#define CHARGE_STAGE_ABSOLUTE       0x04    // Setpoint in A / V / W
+#define CHARGE_STAGE_C_RATE         0x08    // Current setpoint as a fraction of the rated Ah
+#define CHARGE_STAGE_ADAPTIVE       0x10    // Precharge ends early on a healthy step response
+
+typedef enum {
+    CHARGE_PLAN_STANDARD = 0,       // Precharge, CC to the cutoff, CV to the tail current
+    CHARGE_PLAN_TWO_STEP_CC,        // CC at full current, then half current to the cutoff, CV
+    CHARGE_PLAN_EQUALISE,           // Lead-acid: CC and CV at 15/16 of the cutoff, C/20 equalise to it
+    CHARGE_PLAN_COUNT
+} charge_plan_id_t;
+
+// Stage as a plan lists it (relative to the profile)
+typedef struct {
+    const char* name;
+    uint8_t mode;                   // charge_reg_t
+    uint8_t flags;
+    float setpoint;
+    float entry_volt;               // Fraction of cutoff, 0 = always entered
+    float exit_volt;                // Fraction of cutoff, 0 = none
+    float exit_c;                   // Fraction of rated Ah, 0 = none
+    uint32_t timeout_ms;            // 0 = none
+} charge_stage_def_t;
+
+// Compiled stage
+typedef struct {
+    const char* name;
+    uint8_t mode;                   // charge_reg_t
+    uint8_t flags;
+    uint8_t state;                  // app_state_t shown while it runs
+    uint16_t setpoint;              // 0.01 A, 0.01 V or W
+    uint16_t entry_0_01V;           // 0 = always
+    uint16_t exit_0_01V;            // 0 = none
+    uint16_t exit_0_01A;            // 0 = none
+    uint32_t timeout_ms;            // 0 = none
+} charge_stage_t;
+
+typedef struct {
+    uint8_t id;                     // charge_plan_id_t
+    uint8_t count;                  // 0 = not compiled
+    charge_stage_t stages[CHARGE_PLAN_MAX_STAGES];
+} charge_plan_t;
+
+// Plan for the profile's numbers; false (standard plan compiled instead) for an unknown id
+bool charge_plan_compile(charge_plan_t* plan, uint8_t id, float const_current, float cutoff_voltage, float rated_ah);
+const char* charge_plan_name(uint8_t id);
+
+#endif // CHARGE_PLAN_H
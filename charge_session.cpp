@@ -0,0 +1,270 @@
+#include "charge_session.h"
+#include "charge_control.h"
+#include "battery_types.h"
+#include "sensor_snapshot.h"
+#include <Preferences.h>
+#include <esp_attr.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+#include <stddef.h>
+#include <string.h>
+
+#define CHARGE_SESSION_MAGIC 0x53455353u  // "SESS"
+
+// Newest copy: control task writes it under charge_control_lock(), RTC memory keeps it through a reset
+RTC_NOINIT_ATTR static charge_session_record_t session_rtc;
+
+// Running charge's session (charge_control_lock())
+static bool session_open = false;
+static uint32_t session_profile_id = 0;
+static charge_log_record_t session_log;
+static uint32_t session_seq = 0;
+
+// NVS ring (loop())
+static uint8_t session_next_slot = 0;
+static uint32_t session_saved_seq = 0;
+static bool session_saved_active = false;
+static uint8_t session_saved_state = 0;
+static unsigned long session_saved_ms = 0;
+static charge_session_record_t session_copy;
+
+// Interrupted charge found on boot (loop(); session_cancel also from the UI)
+static bool session_pending = false;
+static volatile bool session_cancel = false;
+static charge_session_record_t session_resume;
+static BatteryType* session_battery = nullptr;
+static unsigned long session_ok_since = 0;
+static bool session_ready = false;
+static const char* session_hold = "no sample yet";
+
+static uint32_t session_crc(const charge_session_record_t* record) {
+    return esp_rom_crc32_le(0, (const uint8_t*) record, offsetof(charge_session_record_t, crc));
+}
+
+static bool session_valid(const charge_session_record_t* record) {
+    return record->magic == CHARGE_SESSION_MAGIC && record->crc == session_crc(record);
+}
+
+static void session_slot_key(uint8_t slot, char* key, size_t key_size) {
+    snprintf(key, key_size, "s%u", (unsigned) slot);
+}
+
+bool charge_session_init(void) {
+    // Newest valid copy: RTC memory (reset) or the NVS ring (power-off)
+    bool found = session_valid(&session_rtc);
+    if (found) {
+        session_resume = session_rtc;
+    } else {
+        memset(&session_rtc, 0, sizeof(session_rtc));
+    }
+    uint32_t newest_seq = found ? session_rtc.seq : 0;
+    uint32_t newest_slot_seq = 0;
+    int newest_slot = -1;
+
+    Preferences prefs;
+    if (prefs.begin(CHARGE_SESSION_NVS_NAMESPACE, true)) {
+        for (uint8_t slot = 0; slot < CHARGE_SESSION_SLOTS; slot++) {
+            char key[8];
+            session_slot_key(slot, key, sizeof(key));
+            if (prefs.getBytes(key, &session_copy, sizeof(session_copy)) != sizeof(session_copy) ||
+                !session_valid(&session_copy)) {
+                continue;
+            }
+            if (newest_slot < 0 || session_copy.seq > newest_slot_seq) {
+                newest_slot = slot;
+                newest_slot_seq = session_copy.seq;
+            }
+            if (!found || session_copy.seq > newest_seq) {
+                session_resume = session_copy;
+                newest_seq = session_copy.seq;
+                found = true;
+            }
+        }
+        prefs.end();
+    }
+    session_seq = newest_seq;
+    session_next_slot = (uint8_t)((newest_slot + 1) % CHARGE_SESSION_SLOTS);
+    session_saved_seq = session_rtc.seq;
+    session_pending = CHARGE_SESSION_ENABLE && found && session_resume.active;
+    session_saved_active = session_pending;
+
+    if (session_pending) {
+        Serial.printf("[SESSION] Interrupted charge %lu (reset reason %d): state %d, %.1f min, %.3f Ah; re-checking the battery\n",
+                      (unsigned long) session_resume.log.serial, (int) esp_reset_reason(),
+                      (int) session_resume.checkpoint.state, session_resume.checkpoint.elapsed_ms / 60000.0f,
+                      charge_counter_ah(&session_resume.checkpoint.counter));
+    }
+    return session_pending;
+}
+
+bool charge_session_pending(void) {
+    return session_pending;
+}
+
+void charge_session_begin(const BatteryType* battery, const charge_log_record_t* log) {
+    session_cancel = session_pending;  // A new charge replaces the interrupted one
+    charge_control_lock();
+    session_profile_id = battery->getStorageId();
+    session_log = *log;
+    session_open = CHARGE_SESSION_ENABLE;
+    charge_control_unlock();
+}
+
+void charge_session_capture(void) {
+    if (!session_open) {
+        return;
+    }
+    charge_session_record_t* record = &session_rtc;
+    bool running = charge_controller().checkpoint(&record->checkpoint);
+    if (!running) {
+        memset(&record->checkpoint, 0, sizeof(record->checkpoint));
+        session_open = false;  // Charge over: this inactive copy is the last
+    }
+    record->magic = CHARGE_SESSION_MAGIC;
+    record->seq = ++session_seq;
+    record->active = running ? 1 : 0;
+    record->profile_id = session_profile_id;
+    record->log = session_log;
+    record->crc = session_crc(record);
+}
+
+// Interrupted charge dropped: an inactive copy supersedes it (unless a new charge has taken over)
+static void session_discard(const char* reason, bool close_line) {
+    Serial.printf("[SESSION] Interrupted charge %lu not resumed: %s\n",
+                  (unsigned long) session_resume.log.serial, reason);
+    session_pending = false;
+    session_ready = false;
+    charge_control_lock();
+    if (!session_open) {
+        session_rtc = session_resume;
+        session_rtc.seq = ++session_seq;
+        session_rtc.active = 0;
+        session_rtc.crc = session_crc(&session_rtc);
+    }
+    charge_control_unlock();
+    if (close_line) {
+        closeIncompleteChargeLine();
+    }
+}
+
+static BatteryType* session_find_profile(uint32_t profile_id) {
+    for (int i = 0; i < batteryProfiles.getProfileCount(); i++) {
+        BatteryType* battery = batteryProfiles.getProfile(i);
+        if (battery != nullptr && battery->getStorageId() == profile_id) {
+            return battery;
+        }
+    }
+    return nullptr;
+}
+
+// Battery still there and plausible for CHARGE_SESSION_RECHECK_MS before the charge resumes
+static void session_recheck(void) {
+    if (session_cancel) {
+        session_cancel = false;
+        session_discard("new charge started", false);  // Its start already closed the open line
+        return;
+    }
+    if (session_ready) {
+        return;
+    }
+    if (session_battery == nullptr) {
+        session_battery = session_find_profile(session_resume.profile_id);
+        if (session_battery == nullptr) {
+            session_discard("battery profile no longer exists", true);
+            return;
+        }
+    }
+
+    const unsigned long now = millis();
+    const sensor_data sample = sensor_snapshot_get();
+    const char* hold = NULL;
+    if (sample.vi_rx_ms == 0 || now - sample.vi_rx_ms > CHARGE_SESSION_SAMPLE_MAX_AGE_MS) {
+        hold = "no fresh voltage sample from M2";
+    } else if (sample.volt < 9.0f || sample.volt < session_battery->getRatedVoltage() * CHARGE_SESSION_MIN_VOLT_FRAC) {
+        hold = "battery absent or voltage too low";
+    } else if (sample.volt > session_battery->getCutoffVoltage()) {
+        hold = "voltage above the cutoff";
+    } else if (sample.curr >= 1.0f) {
+        hold = "current flowing with the contactor open";
+    } else if (sample.temp1 / 100.0f > MAX_TEMP_THRESHOLD || sample.temp2 / 100.0f > MAX_TEMP_THRESHOLD) {
+        hold = "temperature over the limit";
+    }
+
+    if (hold != NULL) {
+        session_ok_since = 0;
+        session_hold = hold;
+    } else if (session_ok_since == 0) {
+        session_ok_since = now;
+    } else if (now - session_ok_since >= CHARGE_SESSION_RECHECK_MS) {
+        Serial.printf("[SESSION] Re-check passed (%.2f V, %s): resuming charge %lu\n", sample.volt,
+                      session_battery->getBatteryName().c_str(), (unsigned long) session_resume.log.serial);
+        session_ready = true;
+        return;
+    }
+    if (now >= CHARGE_SESSION_RECHECK_TIMEOUT_MS) {
+        session_discard(session_hold, true);
+    }
+}
+
+// Newest copy to the NVS ring: every CHARGE_SESSION_SAVE_MS, on a state change and when the charge ends
+static void session_persist(void) {
+    charge_control_lock();
+    bool due = session_rtc.magic == CHARGE_SESSION_MAGIC && session_rtc.seq != session_saved_seq &&
+               ((session_rtc.active != 0) != session_saved_active ||
+                session_rtc.checkpoint.state != session_saved_state ||
+                millis() - session_saved_ms >= CHARGE_SESSION_SAVE_MS);
+    if (due) {
+        session_copy = session_rtc;
+    }
+    charge_control_unlock();
+    if (!due) {
+        return;
+    }
+
+    Preferences prefs;
+    if (!prefs.begin(CHARGE_SESSION_NVS_NAMESPACE, false)) {
+        Serial.println("[SESSION] NVS open failed, checkpoint not saved");
+        return;
+    }
+    char key[8];
+    session_slot_key(session_next_slot, key, sizeof(key));
+    bool ok = prefs.putBytes(key, &session_copy, sizeof(session_copy)) == sizeof(session_copy);
+    if (ok && !session_copy.active) {
+        // Charge over: only the inactive copy stays
+        for (uint8_t slot = 0; slot < CHARGE_SESSION_SLOTS; slot++) {
+            if (slot != session_next_slot) {
+                char other[8];
+                session_slot_key(slot, other, sizeof(other));
+                prefs.remove(other);
+            }
+        }
+    }
+    prefs.end();
+    if (!ok) {
+        Serial.println("[SESSION] NVS write failed, checkpoint not saved");
+        return;
+    }
+    session_next_slot = (uint8_t)((session_next_slot + 1) % CHARGE_SESSION_SLOTS);
+    session_saved_seq = session_copy.seq;
+    session_saved_active = session_copy.active != 0;
+    session_saved_state = session_copy.checkpoint.state;
+    session_saved_ms = millis();
+}
+
+void charge_session_service(void) {
+    if (session_pending) {
+        session_recheck();
+    }
+    session_persist();
+}
+
+bool charge_session_take_resume(BatteryType** battery, charge_session_record_t* record) {
+    if (!session_pending || !session_ready || session_cancel) {
+        return false;
+    }
+    session_pending = false;
+    session_ready = false;
+    *battery = session_battery;
+    *record = session_resume;
+    return true;
+}
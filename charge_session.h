@@ -0,0 +1,67 @@
+#ifndef CHARGE_SESSION_H
+#define CHARGE_SESSION_H
+
+#include <Arduino.h>
+#include "charge_controller.h"
+#include "sd_logging.h"
+
+// ============================================================================
+// Charge-session checkpoint and resume after a reset or power loss
+// ============================================================================
+/*
+While a charge runs, the control task copies the session into a record in RTC memory
+after every period: the controller checkpoint (state, stage start times, Ah/Wh counter,
+saturation-detector window), the profile (BatteryType::getStorageId()) and the first
+part of the SD log record (serial, start values). Each copy gets a new sequence number
+and a CRC. loop() writes the record to NVS every CHARGE_SESSION_SAVE_MS and on every
+state change. It uses a ring of CHARGE_SESSION_SLOTS keys, overwriting the oldest, so a
+write torn by the power cut leaves the previous record intact. When the charge ends,
+an inactive record goes in the ring and the other slots are removed.
+
+On boot, charge_session_init() takes the newest valid record. RTC memory survives a
+brownout, watchdog or panic reset; NVS also survives a power-off. If that record is
+active, the charge log keeps its open line, and loop() re-checks the battery for
+CHARGE_SESSION_RECHECK_MS:
+  - fresh 0x101 samples
+  - voltage between CHARGE_SESSION_MIN_VOLT_FRAC of rated and the cutoff
+  - no current (contactor open)
+  - temperatures under MAX_TEMP_THRESHOLD
+Once the re-check passes, charge_session_take_resume() hands the session to the UI. The
+UI restores the profile and log record and calls ChargeController::resume(), which
+continues at the checkpointed stage. If the profile is gone, or the re-check has not
+passed within CHARGE_SESSION_RECHECK_TIMEOUT_MS, or a new charge is started first, the
+session is discarded and the log line closed.
+*/
+
+#define CHARGE_SESSION_ENABLE               1
+#define CHARGE_SESSION_SAVE_MS              (60UL * 1000)   // NVS checkpoint interval while charging
+#define CHARGE_SESSION_SLOTS                4               // NVS ring size
+#define CHARGE_SESSION_NVS_NAMESPACE        "session"
+#define CHARGE_SESSION_RECHECK_MS           3000            // Plausible samples needed before resuming
+#define CHARGE_SESSION_RECHECK_TIMEOUT_MS   (20UL * 1000)   // Give up this long after boot
+#define CHARGE_SESSION_SAMPLE_MAX_AGE_MS    1000            // 0x101 sample at most this old
+#define CHARGE_SESSION_MIN_VOLT_FRAC        0.75f           // Of the rated voltage
+
+typedef struct charge_session_record {
+    uint32_t magic;
+    uint32_t seq;                   // Orders the copies (RTC and NVS, across boots)
+    uint32_t active;                // 0: the charge had ended
+    uint32_t profile_id;            // BatteryType::getStorageId()
+    charge_log_record_t log;        // Start part of the SD record
+    charge_checkpoint_t checkpoint;
+    uint32_t crc;                   // Over everything above
+} charge_session_record_t;
+
+bool charge_session_init(void);     // setup(), before the SD log and the control task; true: a charge may resume
+bool charge_session_pending(void);  // Interrupted charge not yet resumed or discarded
+
+// UI, charge started (after logChargeStart): the session follows this charge
+void charge_session_begin(const BatteryType* battery, const charge_log_record_t* log);
+// Control task, charge_control_lock() held, after every period
+void charge_session_capture(void);
+
+void charge_session_service(void);  // loop(): re-check before a resume, NVS writes
+// loop(): the interrupted charge passed the re-check (once); the caller resumes it
+bool charge_session_take_resume(BatteryType** battery, charge_session_record_t* record);
+
+#endif // CHARGE_SESSION_H
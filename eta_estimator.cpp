@@ -0,0 +1,105 @@
+#include "eta_estimator.h"
+#include <math.h>
+#include <string.h>
+
+void eta_fit_reset(eta_fit_t* fit, float window_s) {
+    memset(fit, 0, sizeof(*fit));
+    fit->window_s = window_s;
+}
+
+void eta_fit_add(eta_fit_t* fit, float t_s, float y) {
+    if (fit->samples == 0) {
+        fit->start_t = t_s;
+        fit->last_t = t_s;
+        fit->mean_t = t_s;
+        fit->mean_y = y;
+        fit->samples = 1;
+        return;
+    }
+    // Weight of the new sample: time-based decay, but plain averaging while the fit is young
+    float dt = t_s - fit->last_t;
+    float alpha = (dt > 0.0f) ? dt / fit->window_s : 0.0f;
+    float average = 1.0f / (float)(fit->samples + 1);
+    if (alpha < average) {
+        alpha = average;
+    }
+    if (alpha > 1.0f) {
+        alpha = 1.0f;
+    }
+
+    float d_t = t_s - fit->mean_t;
+    float d_y = y - fit->mean_y;
+    fit->mean_t += alpha * d_t;
+    fit->mean_y += alpha * d_y;
+    fit->var_t = (1.0f - alpha) * (fit->var_t + alpha * d_t * d_t);
+    fit->var_y = (1.0f - alpha) * (fit->var_y + alpha * d_y * d_y);
+    fit->cov_ty = (1.0f - alpha) * (fit->cov_ty + alpha * d_t * d_y);
+    fit->last_t = t_s;
+    fit->samples++;
+}
+
+float eta_fit_span(const eta_fit_t* fit) {
+    return (fit->samples > 1) ? fit->last_t - fit->start_t : 0.0f;
+}
+
+bool eta_fit_slope(const eta_fit_t* fit, float* slope, float* slope_sigma) {
+    if (fit->samples < 3 || fit->var_t <= 0.0f) {
+        return false;
+    }
+    *slope = fit->cov_ty / fit->var_t;
+
+    // Effective sample count of the decayed window (samples per window, or all of them)
+    float span = eta_fit_span(fit);
+    float per_window = (span > fit->window_s) ? fit->samples * fit->window_s / span : (float) fit->samples;
+    float residual = fit->var_y - fit->cov_ty * (*slope);
+    if (residual < 0.0f) {
+        residual = 0.0f;
+    }
+    *slope_sigma = sqrtf(residual / (per_window * fit->var_t));
+    return true;
+}
+
+float eta_fit_at(const eta_fit_t* fit, float t_s) {
+    float slope = (fit->var_t > 0.0f) ? fit->cov_ty / fit->var_t : 0.0f;
+    return fit->mean_y + slope * (t_s - fit->mean_t);
+}
+
+bool eta_time_to_level(const eta_fit_t* fit, float t_now, float level, bool rising,
+                       float* eta_s, float* lo_s, float* hi_s) {
+    float slope, sigma;
+    if (eta_fit_span(fit) < ETA_MIN_FIT_S || !eta_fit_slope(fit, &slope, &sigma)) {
+        return false;
+    }
+    // Work on a rising line
+    float distance = level - eta_fit_at(fit, t_now);
+    if (!rising) {
+        distance = -distance;
+        slope = -slope;
+    }
+    if (distance <= 0.0f) {
+        *eta_s = *lo_s = *hi_s = 0.0f;
+        return true;
+    }
+    if (slope <= 0.0f) {
+        return false;
+    }
+
+    *eta_s = distance / slope;
+    *lo_s = distance / (slope + ETA_BAND_SIGMA * sigma);
+    float slow = slope - ETA_BAND_SIGMA * sigma;
+    *hi_s = (slow > 0.0f) ? distance / slow : -1.0f;
+
+    float floor_lo = *eta_s * (1.0f - ETA_BAND_LO_FRAC);
+    float floor_hi = *eta_s * (1.0f + ETA_BAND_HI_FRAC);
+    if (*lo_s > floor_lo) {
+        *lo_s = floor_lo;
+    }
+    if (*hi_s >= 0.0f && *hi_s < floor_hi) {
+        *hi_s = floor_hi;
+    }
+    return true;
+}
+
+float eta_log_current(float current_a) {
+    return logf(current_a > 0.01f ? current_a : 0.01f);
+}
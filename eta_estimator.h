@@ -0,0 +1,79 @@
+#ifndef ETA_ESTIMATOR_H
+#define ETA_ESTIMATOR_H
+
+#include <stdint.h>
+
+// ============================================================================
+// Remaining-time estimation from the V/I trajectory
+// ============================================================================
+/*
+eta_fit_t is an exponentially weighted least-squares line y = a + b*t, updated in O(1)
+per sample from running means and (co)variances (no sums of t^2, so float stays
+accurate over a multi-hour charge). The weight of a sample decays with time constant
+window_s; until the fit has seen that much time every sample counts equally. The slope's
+standard error comes from the residual variance and the effective sample count.
+
+The controller keeps two fits, each fed from ETA_SETTLE_MS after its stage starts:
+  CC: terminal voltage against time. Time to the CV entry voltage is the distance to the
+      cutoff along the fitted line; CV is counted at its time budget, which follows from
+      the predicted CC duration (precharge + 50% CC, at most CV_MAX_TIME_MS). A pack that
+      tapers early finishes sooner, so from CC this is an upper estimate.
+  CV: ln(current) against time, i.e. an exponential taper I = I0 * exp(-t/tau). Time to
+      the stage's tail (exit) current is where the line crosses ln(I_tail); the CV time
+      budget caps it.
+eta_time_to_level() turns a fit into an ETA and a band: slope +/- ETA_BAND_SIGMA standard
+errors, widened to at least ETA_BAND_LO_FRAC below and ETA_BAND_HI_FRAC above the ETA.
+The models are straight lines through curved data, so the statistical band alone is too
+optimistic; and lead-acid voltage rises faster towards the end of CC, so the line tends to
+run long and the band reaches further down than up.
+
+eta_point_t is one logged estimate; the controller keeps up to ETA_LOG_POINTS per charge
+(every ETA_LOG_INTERVAL_MS, thinned to every other point and double the interval when
+full) and hands them to the SD log with the result so estimate vs actual can be checked.
+*/
+
+#define ETA_CC_WINDOW_S         600.0f  // CC voltage fit time constant
+#define ETA_CV_WINDOW_S         300.0f  // CV log-current fit time constant
+#define ETA_SETTLE_MS           (5UL * 60 * 1000)  // Stage entry transient (IR step, PI settling), not fitted
+#define ETA_MIN_FIT_S           120.0f  // Fitted time before a stage gives an estimate
+#define ETA_BAND_SIGMA          2.0f    // Band: slope +/- this many standard errors
+#define ETA_BAND_LO_FRAC        0.25f   // ... but at least 25% below
+#define ETA_BAND_HI_FRAC        0.10f   // and 10% above the estimate
+#define ETA_MAX_MS              (12UL * 60 * 60 * 1000)  // Longer estimates are reported as unknown
+#define ETA_LOG_INTERVAL_MS     (5UL * 60 * 1000)
+#define ETA_LOG_POINTS          24
+
+typedef struct {
+    float window_s;
+    float start_t;                  // First sample (s)
+    float last_t;
+    float mean_t;
+    float mean_y;
+    float var_t;
+    float var_y;
+    float cov_ty;
+    uint32_t samples;
+} eta_fit_t;
+
+typedef struct {
+    uint32_t elapsed_ms;            // Charge time when the estimate was made
+    int32_t remaining_ms;           // Estimate, -1 = none
+    int32_t lo_ms;                  // Band, -1 = unbounded
+    int32_t hi_ms;
+    uint8_t state;                  // app_state_t at the time
+} eta_point_t;
+
+void eta_fit_reset(eta_fit_t* fit, float window_s);
+void eta_fit_add(eta_fit_t* fit, float t_s, float y);
+float eta_fit_span(const eta_fit_t* fit);                   // Seconds covered
+float eta_fit_at(const eta_fit_t* fit, float t_s);          // Fitted y at t
+bool eta_fit_slope(const eta_fit_t* fit, float* slope, float* slope_sigma);
+
+// Seconds from t_now until the fitted line reaches level (rising or falling), with band.
+// hi_s is negative when the band's slope does not reach the level. False: no estimate.
+bool eta_time_to_level(const eta_fit_t* fit, float t_now, float level, bool rising,
+                       float* eta_s, float* lo_s, float* hi_s);
+
+float eta_log_current(float current_a);                     // ln() for the CV fit, floored
+
+#endif // ETA_ESTIMATOR_H
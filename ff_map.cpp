@@ -0,0 +1,302 @@
+#include "ff_map.h"
+#include <Arduino.h>
+#include "battery_types.h"
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include <math.h>
+
+typedef struct {
+    uint32_t sum_freq;
+    uint32_t sum_curr;
+    uint16_t count;
+} ff_map_acc_t;
+
+// Map of the profile selected for the current charge, shared by UI, control task and loop()
+static char ff_key[12] = "";
+static float ff_v_low = 0.0f;               // Bottom of band 0
+static float ff_v_span = 0.0f;              // Width of all bands together
+static uint16_t ff_const_curr_0_01A = 0;
+static ff_map_record_t ff_stored;
+static ff_map_acc_t ff_acc[FF_MAP_V_BANDS][FF_MAP_I_BINS];
+static bool ff_session_active = false;
+static bool ff_dirty = false;
+static portMUX_TYPE ff_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static int ff_band(float volt) {
+    if (ff_v_span <= 0.0f) {
+        return 0;
+    }
+    int band = (int) ((volt - ff_v_low) * FF_MAP_V_BANDS / ff_v_span);
+    return (band < 0) ? 0 : (band >= FF_MAP_V_BANDS) ? FF_MAP_V_BANDS - 1 : band;
+}
+
+static int ff_bin(uint16_t curr_0_01A) {
+    if (ff_const_curr_0_01A == 0) {
+        return 0;
+    }
+    int bin = (int) ((uint32_t) curr_0_01A * FF_MAP_I_BINS / ff_const_curr_0_01A);
+    return (bin >= FF_MAP_I_BINS) ? FF_MAP_I_BINS - 1 : bin;
+}
+
+// Frequency for a current on one voltage row: interpolate between the learned cells either
+// side, extrapolate from the two nearest on one side, or use a single cell in the same bin
+static bool ff_row_predict(const ff_map_cell_t* row, uint16_t curr_0_01A, uint16_t* freq_0_01Hz) {
+    const ff_map_cell_t* below = nullptr;
+    const ff_map_cell_t* below2 = nullptr;
+    const ff_map_cell_t* above = nullptr;
+    const ff_map_cell_t* above2 = nullptr;
+    for (int i = 0; i < FF_MAP_I_BINS; i++) {
+        const ff_map_cell_t* cell = &row[i];
+        if (cell->freq_0_01Hz == 0) {
+            continue;
+        }
+        if (cell->curr_0_01A <= curr_0_01A) {
+            below2 = below;
+            below = cell;
+        } else if (above == nullptr) {
+            above = cell;
+        } else if (above2 == nullptr) {
+            above2 = cell;
+        }
+    }
+
+    const ff_map_cell_t* a = nullptr;
+    const ff_map_cell_t* b = nullptr;
+    if (below != nullptr && above != nullptr) {
+        a = below;
+        b = above;
+    } else if (below2 != nullptr) {
+        a = below2;
+        b = below;
+    } else if (above2 != nullptr) {
+        a = above;
+        b = above2;
+    } else {
+        const ff_map_cell_t* only = (below != nullptr) ? below : above;
+        if (only == nullptr || ff_bin(only->curr_0_01A) != ff_bin(curr_0_01A)) {
+            return false;
+        }
+        *freq_0_01Hz = only->freq_0_01Hz;
+        return true;
+    }
+
+    int32_t di = (int32_t) b->curr_0_01A - (int32_t) a->curr_0_01A;
+    if (di < FF_MAP_MIN_CURRENT) {
+        return false;  // Cells too close in current for a usable slope
+    }
+    int32_t freq = a->freq_0_01Hz +
+                   (int32_t) ((int64_t) ((int32_t) curr_0_01A - a->curr_0_01A) * (b->freq_0_01Hz - a->freq_0_01Hz) / di);
+    if (freq <= 0 || freq > UINT16_MAX) {
+        return false;
+    }
+    *freq_0_01Hz = (uint16_t) freq;
+    return true;
+}
+
+void ff_map_begin(const BatteryType* profile) {
+    ff_map_record_t record;
+    memset(&record, 0, sizeof(record));
+    char key[sizeof(ff_key)] = "";
+    bool found = false;
+
+    if (profile != nullptr) {
+        snprintf(key, sizeof(key), "p%08lx", (unsigned long) profile->getStorageId());
+        Preferences prefs;
+        if (prefs.begin(FF_MAP_NVS_NAMESPACE, true)) {
+            found = prefs.getBytesLength(key) == sizeof(record) &&
+                    prefs.getBytes(key, &record, sizeof(record)) == sizeof(record) &&
+                    record.version == FF_MAP_RECORD_VERSION;
+            prefs.end();
+        }
+        if (!found) {
+            memset(&record, 0, sizeof(record));
+            record.version = FF_MAP_RECORD_VERSION;
+        }
+    }
+
+    portENTER_CRITICAL(&ff_mux);
+    memcpy(ff_key, key, sizeof(ff_key));
+    ff_v_low = (profile != nullptr) ? profile->getCutoffVoltage() * FF_MAP_V_LOW_FRAC : 0.0f;
+    ff_v_span = (profile != nullptr) ? profile->getCutoffVoltage() - ff_v_low : 0.0f;
+    ff_const_curr_0_01A = (profile != nullptr) ? (uint16_t) (profile->getConstCurrent() * 100) : 0;
+    ff_stored = record;
+    memset(ff_acc, 0, sizeof(ff_acc));
+    ff_session_active = (profile != nullptr) && FF_MAP_ENABLE;
+    ff_dirty = false;
+    portEXIT_CRITICAL(&ff_mux);
+
+    if (profile != nullptr) {
+        Serial.printf("[FF] %s: %s\n", key, found ? "learned map loaded" : "no learned map");
+    }
+}
+
+void ff_map_observe(float volt, uint16_t curr_0_01A, uint16_t freq_0_01Hz) {
+    if (curr_0_01A < FF_MAP_MIN_CURRENT || freq_0_01Hz == 0) {
+        return;
+    }
+    portENTER_CRITICAL(&ff_mux);
+    if (ff_session_active) {
+        ff_map_acc_t* acc = &ff_acc[ff_band(volt)][ff_bin(curr_0_01A)];
+        if (acc->count < UINT16_MAX) {
+            acc->sum_freq += freq_0_01Hz;
+            acc->sum_curr += curr_0_01A;
+            acc->count++;
+        }
+    }
+    portEXIT_CRITICAL(&ff_mux);
+}
+
+bool ff_map_predict(float volt, uint16_t curr_0_01A, uint16_t* freq_0_01Hz) {
+    static const int band_offsets[] = { 0, -1, 1 };   // Own band first, then the neighbours
+    bool found = false;
+    portENTER_CRITICAL(&ff_mux);
+    if (ff_session_active && ff_stored.charges > 0) {
+        int band = ff_band(volt);
+        for (size_t i = 0; i < sizeof(band_offsets) / sizeof(band_offsets[0]) && !found; i++) {
+            int b = band + band_offsets[i];
+            if (b >= 0 && b < FF_MAP_V_BANDS) {
+                found = ff_row_predict(ff_stored.cells[b], curr_0_01A, freq_0_01Hz);
+            }
+        }
+    }
+    portEXIT_CRITICAL(&ff_mux);
+    return found;
+}
+
+void ff_map_end(void) {
+    int learned = 0;
+    portENTER_CRITICAL(&ff_mux);
+    if (ff_session_active) {
+        for (int b = 0; b < FF_MAP_V_BANDS; b++) {
+            for (int i = 0; i < FF_MAP_I_BINS; i++) {
+                const ff_map_acc_t* acc = &ff_acc[b][i];
+                if (acc->count < FF_MAP_MIN_SAMPLES) {
+                    continue;
+                }
+                ff_map_cell_t* cell = &ff_stored.cells[b][i];
+                int32_t freq = (int32_t) (acc->sum_freq / acc->count);
+                int32_t curr = (int32_t) (acc->sum_curr / acc->count);
+                if (cell->freq_0_01Hz == 0) {
+                    cell->freq_0_01Hz = (uint16_t) freq;
+                    cell->curr_0_01A = (uint16_t) curr;
+                } else {
+                    cell->freq_0_01Hz = (uint16_t) (cell->freq_0_01Hz + ((freq - cell->freq_0_01Hz) >> FF_MAP_BLEND_SHIFT));
+                    cell->curr_0_01A = (uint16_t) (cell->curr_0_01A + ((curr - cell->curr_0_01A) >> FF_MAP_BLEND_SHIFT));
+                }
+                learned++;
+            }
+        }
+        if (learned > 0) {
+            ff_stored.charges++;
+            ff_dirty = true;
+        }
+        ff_session_active = false;
+    }
+    portEXIT_CRITICAL(&ff_mux);
+
+    if (learned > 0) {
+        Serial.printf("[FF] Charge end: %d cells learned, saving\n", learned);
+    }
+}
+
+void ff_map_service(void) {
+    portENTER_CRITICAL(&ff_mux);
+    bool dirty = ff_dirty;
+    ff_map_record_t record = ff_stored;
+    char key[sizeof(ff_key)];
+    memcpy(key, ff_key, sizeof(key));
+    ff_dirty = false;
+    portEXIT_CRITICAL(&ff_mux);
+
+    if (!dirty) {
+        return;
+    }
+    Preferences prefs;
+    if (prefs.begin(FF_MAP_NVS_NAMESPACE, false)) {
+        bool ok = prefs.putBytes(key, &record, sizeof(record)) == sizeof(record);
+        prefs.end();
+        Serial.printf("[FF] %s: map %s\n", key, ok ? "saved to NVS" : "NVS write failed");
+    } else {
+        Serial.println("[FF] NVS open failed, map not saved");
+    }
+}
+
+void ff_map_clear_all(void) {
+    Preferences prefs;
+    if (prefs.begin(FF_MAP_NVS_NAMESPACE, false)) {
+        prefs.clear();
+        prefs.end();
+    }
+    portENTER_CRITICAL(&ff_mux);
+    memset(ff_stored.cells, 0, sizeof(ff_stored.cells));
+    ff_stored.charges = 0;
+    ff_dirty = false;
+    portEXIT_CRITICAL(&ff_mux);
+    Serial.println("[FF] All learned maps cleared");
+}
+
+void ff_map_dump(void) {
+    portENTER_CRITICAL(&ff_mux);
+    ff_map_record_t record = ff_stored;
+    float v_low = ff_v_low;
+    float v_span = ff_v_span;
+    char key[sizeof(ff_key)];
+    memcpy(key, ff_key, sizeof(key));
+    portEXIT_CRITICAL(&ff_mux);
+
+    if (key[0] == '\0') {
+        Serial.println("[FF] No profile selected since boot");
+        return;
+    }
+    Serial.printf("[FF] %s: learned from %u charges (Hz@A per current bin)\n", key, record.charges);
+    for (int b = 0; b < FF_MAP_V_BANDS; b++) {
+        Serial.printf("[FF] %6.2f-%6.2fV:", v_low + v_span * b / FF_MAP_V_BANDS, v_low + v_span * (b + 1) / FF_MAP_V_BANDS);
+        for (int i = 0; i < FF_MAP_I_BINS; i++) {
+            const ff_map_cell_t* cell = &record.cells[b][i];
+            if (cell->freq_0_01Hz == 0) {
+                Serial.print("        -      ");
+            } else {
+                Serial.printf("  %6.2f@%6.2f", cell->freq_0_01Hz / 100.0f, cell->curr_0_01A / 100.0f);
+            }
+        }
+        Serial.println();
+    }
+}
+
+// ============================================================================
+// S-curve ramp
+// ============================================================================
+void ff_ramp_start(ff_ramp_t* ramp, int32_t from, int32_t to, int32_t max_speed) {
+    ramp->active = (from != to);
+    ramp->position = from;
+    ramp->target = to;
+    ramp->speed = 0;
+    ramp->max_speed = (max_speed > 0) ? max_speed : FF_RAMP_MAX_SLEW;
+}
+
+int32_t ff_ramp_step(ff_ramp_t* ramp, uint32_t dt_ms) {
+    if (!ramp->active) {
+        return ramp->position;
+    }
+    int32_t distance = abs(ramp->target - ramp->position);
+
+    // Fastest speed that can still brake to a stop at the target (v^2 = 2 a d)
+    int32_t braking = (int32_t) sqrtf(2.0f * FF_RAMP_MAX_ACCEL * (float) distance);
+    int32_t wanted = (braking < ramp->max_speed) ? braking : ramp->max_speed;
+    int32_t accel_step = (int32_t) ((int64_t) FF_RAMP_MAX_ACCEL * dt_ms / 1000);
+    if (accel_step < 1) accel_step = 1;
+    if (wanted > ramp->speed + accel_step) wanted = ramp->speed + accel_step;
+    if (wanted < ramp->speed - accel_step) wanted = ramp->speed - accel_step;
+    ramp->speed = (wanted > 0) ? wanted : 0;
+
+    int32_t step = (int32_t) ((int64_t) ramp->speed * dt_ms / 1000);
+    if (step < 1) step = 1;
+    if (step >= distance) {
+        ramp->position = ramp->target;
+        ramp->speed = 0;
+        ramp->active = false;
+    } else {
+        ramp->position += (ramp->target > ramp->position) ? step : -step;
+    }
+    return ramp->position;
+}
@@ -0,0 +1,78 @@
+#ifndef FF_MAP_H
+#define FF_MAP_H
+
+#include <stdint.h>
+
+class BatteryType;
+
+// ============================================================================
+// Learned frequency -> current feed-forward map and S-curve transition ramp
+// ============================================================================
+/*
+Per battery profile, a small table of the VFD frequency that delivered a given current
+at a given terminal voltage: FF_MAP_V_BANDS voltage bands (FF_MAP_V_LOW_FRAC * cutoff up
+to cutoff) x FF_MAP_I_BINS current bins (fractions of the profile's const current). Each
+cell keeps the mean frequency and mean current of its samples, so a row gives a
+frequency/current line to interpolate on at that voltage.
+
+Learning: the control task feeds quasi-steady samples (frequency unchanged over the last
+period) into per-charge accumulators. When the charge ends, cells with at least
+FF_MAP_MIN_SAMPLES are blended into the stored map (first charge: copied), and loop()
+writes it to NVS (namespace FF_MAP_NVS_NAMESPACE, key from BatteryType::getStorageId()).
+
+Use: on a state transition (start of precharge, CC entry) the controller ramps straight
+to ff_map_predict() for the new target with a jerk-free S-curve (acceleration-limited,
+braking to arrive with zero slew), then the PI takes over bumplessly and trims.
+Without a learned cell for the voltage the PI continues from the applied frequency; if no
+current flows yet (start of precharge) the ramp searches upwards and stops at first flow.
+*/
+
+#define FF_MAP_ENABLE               1
+#define FF_MAP_V_BANDS              8
+#define FF_MAP_V_LOW_FRAC           0.70f   // Lowest band starts at this fraction of the cutoff voltage
+#define FF_MAP_I_BINS               4       // Bins of 1/4 const current (last bin includes >= const current)
+#define FF_MAP_MIN_SAMPLES          20      // Samples a cell needs in one charge to be learned
+#define FF_MAP_BLEND_SHIFT          1       // Stored += (charge mean - stored) >> shift, i.e. 1/2 per charge
+#define FF_MAP_STEADY_STEP          50      // Max frequency change (0.01Hz) over the last period for a sample
+#define FF_MAP_MIN_CURRENT          50      // Samples below this (0.01A) are ignored
+#define FF_MAP_NVS_NAMESPACE        "ff_map"
+#define FF_MAP_RECORD_VERSION       1
+
+// S-curve ramp limits (real time, 0.01Hz units); keep the slew within the VFD's own accel ramp
+#define FF_RAMP_MAX_SLEW            1000    // 10 Hz/s
+#define FF_RAMP_MAX_ACCEL           2000    // 20 Hz/s^2
+#define FF_SEARCH_MAX_SLEW          200     // No learned frequency: search at the old 2 Hz/s no-flow rate
+#define FF_SEARCH_HANDOVER_CURRENT  150     // and stop at first flow (0.01A)
+
+typedef struct {
+    uint16_t freq_0_01Hz;           // 0 = not learned
+    uint16_t curr_0_01A;
+} ff_map_cell_t;
+
+typedef struct {
+    uint16_t version;
+    uint16_t charges;               // Charges that contributed
+    ff_map_cell_t cells[FF_MAP_V_BANDS][FF_MAP_I_BINS];
+} ff_map_record_t;
+
+void ff_map_begin(const BatteryType* profile);      // Charge start (UI): load the map, reset accumulators
+void ff_map_observe(float volt, uint16_t curr_0_01A, uint16_t freq_0_01Hz);   // Control task
+bool ff_map_predict(float volt, uint16_t curr_0_01A, uint16_t* freq_0_01Hz);  // Control task
+void ff_map_end(void);                              // Charge over: merge the accumulators (RAM only)
+void ff_map_service(void);                          // loop(): write a merged map to NVS
+void ff_map_clear_all(void);
+void ff_map_dump(void);
+
+// Acceleration-limited ramp of the frequency command
+typedef struct {
+    bool active;
+    int32_t position;               // 0.01Hz
+    int32_t target;
+    int32_t speed;                  // 0.01Hz/s, towards target
+    int32_t max_speed;
+} ff_ramp_t;
+
+void ff_ramp_start(ff_ramp_t* ramp, int32_t from, int32_t to, int32_t max_speed);
+int32_t ff_ramp_step(ff_ramp_t* ramp, uint32_t dt_ms);  // Next command; clears active on arrival
+
+#endif // FF_MAP_H
@@ -0,0 +1,95 @@
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <atomic>
+
+// ============================================================================
+// LatencyHist - lock-free log2 histogram for timing diagnostics
+// ============================================================================
+/*
+Bucket 0 counts zero samples, bucket b (1..32) counts samples in [2^(b-1), 2^b).
+record() is wait-free (relaxed 32-bit atomics, no 64-bit sums since those are not
+lock-free on Xtensa) and may be called from any task. Readers get a near-consistent
+view, which is fine for diagnostics. Fixed size, no allocation.
+*/
+#define LATENCY_HIST_BUCKETS 33
+
+class LatencyHist {
+    std::atomic<uint32_t> buckets[LATENCY_HIST_BUCKETS];
+    std::atomic<uint32_t> samples;
+    std::atomic<uint32_t> minimum;
+    std::atomic<uint32_t> maximum;
+
+    static uint8_t bucket_of(uint32_t value) {
+        return value == 0 ? 0 : (uint8_t)(32 - __builtin_clz(value));
+    }
+
+public:
+    LatencyHist() {
+        reset();
+    }
+
+    void reset(void) {
+        for (uint8_t b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+            buckets[b].store(0, std::memory_order_relaxed);
+        }
+        samples.store(0, std::memory_order_relaxed);
+        minimum.store(UINT32_MAX, std::memory_order_relaxed);
+        maximum.store(0, std::memory_order_relaxed);
+    }
+
+    void record(uint32_t value) {
+        buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        samples.fetch_add(1, std::memory_order_relaxed);
+
+        uint32_t seen = minimum.load(std::memory_order_relaxed);
+        while (value < seen && !minimum.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+        }
+        seen = maximum.load(std::memory_order_relaxed);
+        while (value > seen && !maximum.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint32_t count(void) const { return samples.load(std::memory_order_relaxed); }
+    uint32_t min(void) const { return count() ? minimum.load(std::memory_order_relaxed) : 0; }
+    uint32_t max(void) const { return maximum.load(std::memory_order_relaxed); }
+    uint32_t bucket(uint8_t b) const { return buckets[b].load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the given percentile (0-100)
+    uint32_t percentile(uint8_t pct) const {
+        uint32_t total = count();
+        if (total == 0) {
+            return 0;
+        }
+        uint32_t target = (uint32_t)(((uint64_t)total * pct + 99) / 100);
+        uint32_t running = 0;
+        for (uint8_t b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+            running += bucket(b);
+            if (running >= target) {
+                return b == 0 ? 0 : (b >= 32 ? UINT32_MAX : (1u << b) - 1);
+            }
+        }
+        return max();
+    }
+
+    // One summary line plus the non-empty buckets as "<=upper:count"
+    void print(const char* tag, const char* name, const char* unit) const {
+        Serial.printf("[%s] %s (%s): n=%u min=%u p50<=%u p99<=%u max=%u\n", tag, name, unit,
+                     count(), min(), percentile(50), percentile(99), max());
+        if (count() == 0) {
+            return;
+        }
+        Serial.printf("[%s]   ", tag);
+        for (uint8_t b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+            uint32_t n = bucket(b);
+            if (n != 0) {
+                Serial.printf("<=%u:%u ", b == 0 ? 0 : (b >= 32 ? UINT32_MAX : (1u << b) - 1), n);
+            }
+        }
+        Serial.println();
+    }
+};
+
+#endif // LATENCY_HIST_H
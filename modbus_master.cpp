@@ -0,0 +1,170 @@
+#include "modbus_master.h"
+#include "modbus_rtu.h"
+#include "latency_hist.h"
+#include "plant_sim.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <atomic>
+#include <string.h>
+
+static HardwareSerial* mb_port = NULL;
+
+// Bus ownership (one transaction at a time) and end-of-frame event from the UART callback
+static SemaphoreHandle_t mb_bus_mutex = NULL;
+static StaticSemaphore_t mb_bus_mutex_buffer;
+static SemaphoreHandle_t mb_frame_event = NULL;
+static StaticSemaphore_t mb_frame_event_buffer;
+
+// Response bytes, appended by the UART event task, read by the transaction after mb_frame_event
+static uint8_t mb_rx_buffer[MODBUS_MAX_FRAME];
+static volatile size_t mb_rx_length = 0;
+
+// Statistics
+static std::atomic<uint32_t> mb_result_count[MODBUS_RESULT_COUNT];
+static volatile uint8_t mb_last_exception = 0;
+static LatencyHist mb_rtt_us;
+static uint32_t mb_baud = 0;
+static volatile uint32_t mb_last_tx_end_us = 0;
+
+static const char* const mb_result_names[MODBUS_RESULT_COUNT] = {
+    "ok", "timeout", "crc", "address", "function", "length", "mismatch", "exception", "busy"
+};
+
+// UART event task: RX timeout (t3.5 gap) or RX buffer threshold reached
+static void modbus_on_receive(void) {
+    size_t available = (size_t) mb_port->available();
+    while (available > 0) {
+        size_t room = sizeof(mb_rx_buffer) - mb_rx_length;
+        if (room == 0) {
+            mb_port->read();  // Oversized frame: drop the excess, length check fails later
+            available--;
+            continue;
+        }
+        size_t chunk = available < room ? available : room;
+        size_t got = mb_port->readBytes(&mb_rx_buffer[mb_rx_length], chunk);
+        if (got == 0) {
+            break;
+        }
+        mb_rx_length = mb_rx_length + got;
+        available -= got;
+    }
+    xSemaphoreGive(mb_frame_event);
+}
+
+void modbus_master_init(HardwareSerial* port, uint32_t baud, int8_t rx_pin, int8_t tx_pin) {
+    mb_port = port;
+    mb_baud = baud;
+    mb_bus_mutex = xSemaphoreCreateMutexStatic(&mb_bus_mutex_buffer);
+    mb_frame_event = xSemaphoreCreateBinaryStatic(&mb_frame_event_buffer);
+
+    port->onReceive(modbus_on_receive, true);  // Callback on RX timeout only = once per frame
+    port->begin(baud, SERIAL_8N1, rx_pin, tx_pin);
+    port->setRxTimeout(MODBUS_RX_TIMEOUT_SYMBOLS);
+}
+
+const char* modbus_result_name(modbus_result_t result) {
+    return (result < MODBUS_RESULT_COUNT) ? mb_result_names[result] : "?";
+}
+
+modbus_result_t modbus_master_transact(const uint8_t* request, size_t request_len,
+                                       uint8_t* response, size_t expected_len, uint8_t* exception_code) {
+    if (mb_port == NULL || expected_len > MODBUS_MAX_FRAME) {
+        return MODBUS_ERR_LENGTH;
+    }
+    if (xSemaphoreTake(mb_bus_mutex, pdMS_TO_TICKS(MODBUS_RESPONSE_TIMEOUT_MS * 2)) != pdTRUE) {
+        mb_result_count[MODBUS_ERR_BUSY].fetch_add(1, std::memory_order_relaxed);
+        return MODBUS_ERR_BUSY;
+    }
+
+    // Drop stale bytes/events from a previous late response
+    while (mb_port->available() > 0) {
+        mb_port->read();
+    }
+    mb_rx_length = 0;
+    xSemaphoreTake(mb_frame_event, 0);
+
+    uint32_t start_us = (uint32_t) micros();
+#if PLANT_SIM
+    // Simulated drive answers in place of the UART
+    mb_rx_length = plant_sim_modbus_request(request, request_len, mb_rx_buffer, sizeof(mb_rx_buffer));
+#else
+    mb_port->write(request, request_len);
+    mb_port->flush();  // Returns when the last stop bit has left the UART
+#endif
+    mb_last_tx_end_us = (uint32_t) micros();
+
+    modbus_result_t result = MODBUS_OK;
+    if (request[0] != MODBUS_BROADCAST_ADDRESS) {
+#if !PLANT_SIM
+        // Wait for RX-timeout events until a full (or exception) frame is in
+        TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(MODBUS_RESPONSE_TIMEOUT_MS);
+        while (true) {
+            size_t length = mb_rx_length;
+            if (length >= expected_len ||
+                (length >= modbus_exception_length() && (mb_rx_buffer[1] & MODBUS_EXCEPTION_FLAG))) {
+                break;
+            }
+            TickType_t now = xTaskGetTickCount();
+            if ((int32_t)(deadline - now) <= 0 || xSemaphoreTake(mb_frame_event, deadline - now) != pdTRUE) {
+                break;
+            }
+        }
+#endif
+
+        size_t length = mb_rx_length;
+        uint32_t rtt_us = (uint32_t) micros() - start_us;
+        uint8_t code = 0;
+        result = modbus_validate_response(request, mb_rx_buffer, length, expected_len, &code);
+        if (result == MODBUS_ERR_EXCEPTION) {
+            mb_last_exception = code;
+            if (exception_code != NULL) {
+                *exception_code = code;
+            }
+        }
+        if (result == MODBUS_OK) {
+            mb_rtt_us.record(rtt_us);
+            if (response != NULL) {
+                memcpy(response, mb_rx_buffer, length);
+            }
+        }
+    }
+
+    xSemaphoreGive(mb_bus_mutex);
+    mb_result_count[result].fetch_add(1, std::memory_order_relaxed);
+    return result;
+}
+
+modbus_result_t modbus_master_read(uint8_t address, uint16_t reg, uint16_t count, uint16_t* values, uint8_t* exception_code) {
+    if (count == 0 || count > MODBUS_MAX_READ_REGS) {
+        return MODBUS_ERR_LENGTH;
+    }
+    std::array<uint8_t, 8> request = modbus_read_holding(address, reg, count);
+    uint8_t response[MODBUS_MAX_FRAME];
+    modbus_result_t result = modbus_master_transact(request.data(), request.size(), response,
+                                                    modbus_read_response_length(count), exception_code);
+    if (result == MODBUS_OK) {
+        for (uint16_t i = 0; i < count; i++) {
+            values[i] = (uint16_t)((response[3 + 2 * i] << 8) | response[4 + 2 * i]);
+        }
+    }
+    return result;
+}
+
+modbus_result_t modbus_master_write(uint8_t address, uint16_t reg, uint16_t value, uint8_t* exception_code) {
+    std::array<uint8_t, 8> request = modbus_write_single(address, reg, value);
+    return modbus_master_transact(request.data(), request.size(), NULL, modbus_write_response_length(), exception_code);
+}
+
+uint32_t modbus_master_last_tx_end_us(void) {
+    return mb_last_tx_end_us;
+}
+
+void modbus_master_dump_stats(void) {
+    Serial.printf("[MODBUS] ===== Modbus master (%lu baud) =====\n", (unsigned long) mb_baud);
+    Serial.print("[MODBUS] Results:");
+    for (int i = 0; i < MODBUS_RESULT_COUNT; i++) {
+        Serial.printf(" %s=%u", mb_result_names[i], mb_result_count[i].load(std::memory_order_relaxed));
+    }
+    Serial.printf(" last_exception=0x%02X\n", mb_last_exception);
+    mb_rtt_us.print("MODBUS", "Round trip", "us");
+}
@@ -0,0 +1,41 @@
+#ifndef MODBUS_MASTER_H
+#define MODBUS_MASTER_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "modbus_rtu.h"
+
+// ============================================================================
+// Modbus RTU master (half-duplex RS485, one transaction at a time)
+// ============================================================================
+/*
+A transaction writes the request, then waits for the response frame. End of frame is
+detected by the UART RX-timeout event (line idle for MODBUS_RX_TIMEOUT_SYMBOLS character
+times, i.e. the Modbus t3.5 gap) raised through HardwareSerial::onReceive, so no delays
+are used to find frame boundaries. Every response is validated (address, function,
+exception, length, CRC, write echo) and the round-trip time is recorded.
+*/
+
+#define MODBUS_RX_TIMEOUT_SYMBOLS   4      // t3.5 rounded up to whole characters
+#define MODBUS_RESPONSE_TIMEOUT_MS  100    // From end of request to complete response
+#define MODBUS_MAX_FRAME            256
+#define MODBUS_BROADCAST_ADDRESS    0x00   // No response expected
+
+void modbus_master_init(HardwareSerial* port, uint32_t baud, int8_t rx_pin, int8_t tx_pin);
+
+// Send request (CRC included) and receive/validate a response of expected_len bytes into response.
+// exception_code (optional) receives the slave's code on MODBUS_ERR_EXCEPTION.
+modbus_result_t modbus_master_transact(const uint8_t* request, size_t request_len,
+                                       uint8_t* response, size_t expected_len, uint8_t* exception_code);
+
+// 0x03 read of count holding registers into values
+modbus_result_t modbus_master_read(uint8_t address, uint16_t reg, uint16_t count, uint16_t* values, uint8_t* exception_code);
+// 0x06 write of a single register, echo checked
+modbus_result_t modbus_master_write(uint8_t address, uint16_t reg, uint16_t value, uint8_t* exception_code);
+
+const char* modbus_result_name(modbus_result_t result);
+uint32_t modbus_master_last_tx_end_us(void);  // micros() when the last request finished leaving the UART
+void modbus_master_dump_stats(void);
+
+#endif // MODBUS_MASTER_H
@@ -0,0 +1,177 @@
+#ifndef MODBUS_RTU_H
+#define MODBUS_RTU_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+
+// ============================================================================
+// Modbus RTU framing (CRC-16/MODBUS, request builders)
+// ============================================================================
+/*
+Everything here is constexpr: constant frames (VFD start/stop) are assembled and
+CRC'd by the compiler, dynamic frames are built with the 256-entry table lookup
+(one XOR/shift per byte instead of the 8-step bit loop).
+CRC is appended low byte first, as Modbus RTU requires.
+Response validation lives here too so it can be unit tested on the host (test/).
+*/
+
+#define MODBUS_FC_READ_HOLDING      0x03
+#define MODBUS_FC_WRITE_SINGLE      0x06
+#define MODBUS_FC_WRITE_MULTIPLE    0x10
+#define MODBUS_EXCEPTION_FLAG       0x80   // Set in the function code of an exception response
+#define MODBUS_EX_ILLEGAL_FUNCTION  0x01   // Exception codes
+#define MODBUS_EX_ILLEGAL_ADDRESS   0x02
+
+#define MODBUS_MAX_READ_REGS        125
+#define MODBUS_MAX_WRITE_REGS       123
+
+typedef enum {
+    MODBUS_OK = 0,
+    MODBUS_ERR_TIMEOUT,      // No (complete) response in time
+    MODBUS_ERR_CRC,
+    MODBUS_ERR_ADDRESS,      // Response from another slave
+    MODBUS_ERR_FUNCTION,     // Unexpected function code
+    MODBUS_ERR_LENGTH,       // Wrong frame/byte count for the request
+    MODBUS_ERR_MISMATCH,     // Write echo differs from the request
+    MODBUS_ERR_EXCEPTION,    // Slave returned an exception code
+    MODBUS_ERR_BUSY,         // Another transaction held the bus too long
+    MODBUS_RESULT_COUNT
+} modbus_result_t;
+
+// CRC-16/MODBUS table (reflected polynomial 0xA001), generated at compile time
+constexpr std::array<uint16_t, 256> modbus_make_crc_table(void) {
+    std::array<uint16_t, 256> table = {};
+    for (uint16_t i = 0; i < 256; i++) {
+        uint16_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x0001) ? (uint16_t)((crc >> 1) ^ 0xA001) : (uint16_t)(crc >> 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+static constexpr std::array<uint16_t, 256> modbus_crc_table = modbus_make_crc_table();
+
+constexpr uint16_t modbus_crc16(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc = (uint16_t)((crc >> 8) ^ modbus_crc_table[(crc ^ data[i]) & 0xFF]);
+    }
+    return crc;
+}
+
+// True if the last two bytes of frame hold the CRC of the bytes before them
+constexpr bool modbus_crc_valid(const uint8_t* frame, size_t length) {
+    if (length < 4) {
+        return false;
+    }
+    uint16_t crc = modbus_crc16(frame, length - 2);
+    return frame[length - 2] == (uint8_t)(crc & 0xFF) && frame[length - 1] == (uint8_t)(crc >> 8);
+}
+
+// Writes the CRC of frame[0 .. N-3] into the last two bytes
+template <size_t N>
+constexpr std::array<uint8_t, N> modbus_append_crc(std::array<uint8_t, N> frame) {
+    static_assert(N >= 4, "Modbus frame too short");
+    uint16_t crc = modbus_crc16(frame.data(), N - 2);
+    frame[N - 2] = (uint8_t)(crc & 0xFF);
+    frame[N - 1] = (uint8_t)(crc >> 8);
+    return frame;
+}
+
+// 0x03 Read Holding Registers: addr fc reg_hi reg_lo cnt_hi cnt_lo crc_lo crc_hi
+constexpr std::array<uint8_t, 8> modbus_read_holding(uint8_t address, uint16_t reg, uint16_t count) {
+    return modbus_append_crc<8>({ address, MODBUS_FC_READ_HOLDING,
+                                  (uint8_t)(reg >> 8), (uint8_t)(reg & 0xFF),
+                                  (uint8_t)(count >> 8), (uint8_t)(count & 0xFF), 0, 0 });
+}
+
+// 0x06 Write Single Register: addr fc reg_hi reg_lo val_hi val_lo crc_lo crc_hi
+constexpr std::array<uint8_t, 8> modbus_write_single(uint8_t address, uint16_t reg, uint16_t value) {
+    return modbus_append_crc<8>({ address, MODBUS_FC_WRITE_SINGLE,
+                                  (uint8_t)(reg >> 8), (uint8_t)(reg & 0xFF),
+                                  (uint8_t)(value >> 8), (uint8_t)(value & 0xFF), 0, 0 });
+}
+
+// 0x10 Write Multiple Registers: addr fc reg cnt byte_count values... crc
+template <size_t COUNT>
+constexpr std::array<uint8_t, 9 + 2 * COUNT> modbus_write_multiple(uint8_t address, uint16_t reg,
+                                                                   const std::array<uint16_t, COUNT>& values) {
+    static_assert(COUNT >= 1 && COUNT <= MODBUS_MAX_WRITE_REGS, "Modbus 0x10: 1..123 registers");
+    std::array<uint8_t, 9 + 2 * COUNT> frame = {};
+    frame[0] = address;
+    frame[1] = MODBUS_FC_WRITE_MULTIPLE;
+    frame[2] = (uint8_t)(reg >> 8);
+    frame[3] = (uint8_t)(reg & 0xFF);
+    frame[4] = (uint8_t)(COUNT >> 8);
+    frame[5] = (uint8_t)(COUNT & 0xFF);
+    frame[6] = (uint8_t)(2 * COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        frame[7 + 2 * i] = (uint8_t)(values[i] >> 8);
+        frame[8 + 2 * i] = (uint8_t)(values[i] & 0xFF);
+    }
+    return modbus_append_crc(frame);
+}
+
+// Expected response lengths (normal, non-exception)
+constexpr size_t modbus_read_response_length(uint16_t count) { return 5 + 2 * (size_t)count; }  // addr fc n data crc
+constexpr size_t modbus_write_response_length(void) { return 8; }   // 0x06 echo / 0x10 reg+count
+constexpr size_t modbus_exception_length(void) { return 5; }        // addr fc|0x80 code crc
+
+// Check a received frame (length 0 = nothing arrived) against its request: address, function,
+// exception, length, CRC and write echo. exception_code (optional) receives the slave's code.
+constexpr modbus_result_t modbus_validate_response(const uint8_t* request, const uint8_t* response, size_t length,
+                                                   size_t expected_len, uint8_t* exception_code) {
+    if (length == 0) {
+        return MODBUS_ERR_TIMEOUT;
+    }
+    if (length < modbus_exception_length()) {
+        return MODBUS_ERR_LENGTH;
+    }
+    if (!modbus_crc_valid(response, length)) {
+        return MODBUS_ERR_CRC;
+    }
+    if (response[0] != request[0]) {
+        return MODBUS_ERR_ADDRESS;
+    }
+    if (response[1] == (request[1] | MODBUS_EXCEPTION_FLAG)) {
+        if (exception_code != nullptr) {
+            *exception_code = response[2];
+        }
+        return MODBUS_ERR_EXCEPTION;
+    }
+    if (response[1] != request[1]) {
+        return MODBUS_ERR_FUNCTION;
+    }
+    if (length != expected_len) {
+        return MODBUS_ERR_LENGTH;
+    }
+    size_t echo_from = 0;
+    size_t echo_to = 0;
+    switch (request[1]) {
+        case MODBUS_FC_READ_HOLDING:
+            if (response[2] != expected_len - 5) {
+                return MODBUS_ERR_LENGTH;
+            }
+            break;
+        case MODBUS_FC_WRITE_SINGLE:
+            echo_to = 6;  // Echo of address, register and value
+            break;
+        case MODBUS_FC_WRITE_MULTIPLE:
+            echo_from = 2;  // Start register and count
+            echo_to = 6;
+            break;
+        default:
+            break;
+    }
+    for (size_t i = echo_from; i < echo_to; i++) {
+        if (response[i] != request[i]) {
+            return MODBUS_ERR_MISMATCH;
+        }
+    }
+    return MODBUS_OK;
+}
+
+#endif // MODBUS_RTU_H
@@ -0,0 +1,259 @@
+#include "pi_autotune.h"
+#include <Arduino.h>
+#include "battery_types.h"
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include <math.h>
+
+// Tyreus-Luyben PI from the ultimate gain/period
+#define PI_TL_KP_DIVISOR    3.2f
+#define PI_TL_TI_FACTOR     2.2f
+
+// Gains of the profile selected for the current charge (see pi_autotune.h for threading)
+static const BatteryType* pi_tuning_profile = nullptr;
+static char pi_tuning_key_buf[12] = "";
+static pi_tuning_record_t pi_tuning_cached;
+static bool pi_tuning_valid = false;
+static bool pi_tuning_dirty = false;
+static portMUX_TYPE pi_tuning_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================================================================
+// Relay test
+// ============================================================================
+void pi_autotune_start(pi_autotune_t* tune, int32_t bias, int32_t setpoint, int32_t out_min, int32_t out_max,
+                       int32_t max_step, unsigned long now_ms) {
+    memset(tune, 0, sizeof(*tune));
+    tune->state = PI_AUTOTUNE_RUNNING;
+    tune->bias = bias;
+    tune->setpoint = setpoint;
+    tune->out_min = out_min;
+    tune->out_max = out_max;
+    tune->max_step = max_step;
+    tune->output = bias;
+    tune->relay_high = true;
+    tune->start_ms = now_ms;
+    tune->peak_max = INT32_MIN;
+    tune->peak_min = INT32_MAX;
+    tune->out_max_seen = bias;
+    tune->out_min_seen = bias;
+    Serial.printf("[TUNE] Relay test started: bias=%ld setpoint=%ld d=%d slew=%ld\n", (long) bias, (long) setpoint,
+                  PI_AUTOTUNE_RELAY_STEP, (long) max_step);
+}
+
+int32_t pi_autotune_step(pi_autotune_t* tune, int32_t measured, unsigned long now_ms) {
+    if (tune->state != PI_AUTOTUNE_RUNNING) {
+        return tune->bias;
+    }
+    if (now_ms - tune->start_ms > PI_AUTOTUNE_TIMEOUT_MS) {
+        tune->state = PI_AUTOTUNE_FAILED;
+        Serial.printf("[TUNE] Relay test timed out after %u periods\n", tune->periods_seen);
+        return tune->bias;
+    }
+
+    if (measured > tune->peak_max) tune->peak_max = measured;
+    if (measured < tune->peak_min) tune->peak_min = measured;
+
+    int32_t error = tune->setpoint - measured;
+    if (!tune->relay_high && error > PI_AUTOTUNE_HYSTERESIS) {
+        // Upward switch closes a period (the first one only settles the oscillation)
+        tune->relay_high = true;
+        if (tune->last_rise_ms != 0) {
+            if (tune->periods_seen > 0) {
+                tune->period_sum_ms += now_ms - tune->last_rise_ms;
+                tune->amplitude_sum += (tune->peak_max - tune->peak_min) / 2;
+                tune->swing_sum += (tune->out_max_seen - tune->out_min_seen) / 2;
+                tune->samples_sum += tune->period_samples;
+                tune->ramping_sum += tune->period_ramping;
+                tune->periods_used++;
+            }
+            tune->periods_seen++;
+        }
+        tune->last_rise_ms = now_ms;
+        tune->peak_max = measured;
+        tune->peak_min = measured;
+        tune->out_max_seen = tune->output;
+        tune->out_min_seen = tune->output;
+        tune->period_samples = 0;
+        tune->period_ramping = 0;
+    } else if (tune->relay_high && error < -PI_AUTOTUNE_HYSTERESIS) {
+        tune->relay_high = false;
+    }
+
+    if (tune->periods_used >= PI_AUTOTUNE_CYCLES) {
+        float amplitude = (float) tune->amplitude_sum / tune->periods_used;
+        float eps = (float) PI_AUTOTUNE_HYSTERESIS;
+        tune->tu_s = tune->period_sum_ms / (1000.0f * tune->periods_used);
+        // First harmonic of the output actually applied (see pi_autotune.h)
+        float swing = (float) tune->swing_sum / tune->periods_used;
+        float ramping = tune->samples_sum > 0 ? (float) tune->ramping_sum / tune->samples_sum : 0.0f;
+        float x = (float) M_PI * ramping / 2.0f;
+        float harmonic = 4.0f * swing / (float) M_PI * ((x > 0.0f) ? sinf(x) / x : 1.0f);
+        if (amplitude > eps && harmonic > 0.0f) {
+            tune->ku = harmonic / sqrtf(amplitude * amplitude - eps * eps);
+            tune->state = PI_AUTOTUNE_DONE;
+            Serial.printf("[TUNE] Relay test done: a=%.1f A=%.1f ramping %.0f%% Tu=%.2fs Ku=%.4f\n", amplitude, swing,
+                          ramping * 100.0f, tune->tu_s, tune->ku);
+        } else {
+            tune->state = PI_AUTOTUNE_FAILED;
+            Serial.printf("[TUNE] Relay test failed: oscillation %.1f inside hysteresis\n", amplitude);
+        }
+        return tune->bias;
+    }
+
+    int32_t output = tune->relay_high ? tune->bias + PI_AUTOTUNE_RELAY_STEP : tune->bias - PI_AUTOTUNE_RELAY_STEP;
+    output = (output < tune->out_min) ? tune->out_min : (output > tune->out_max) ? tune->out_max : output;
+    if (tune->max_step > 0) {
+        int32_t lo = tune->output - tune->max_step;
+        int32_t hi = tune->output + tune->max_step;
+        output = (output < lo) ? lo : (output > hi) ? hi : output;
+    }
+    tune->period_samples++;
+    if (output != tune->output) {
+        tune->period_ramping++;
+    }
+    tune->output = output;
+    if (output > tune->out_max_seen) tune->out_max_seen = output;
+    if (output < tune->out_min_seen) tune->out_min_seen = output;
+    return output;
+}
+
+bool pi_autotune_gains(const pi_autotune_t* tune, pi_gains_t* gains) {
+    if (tune->state != PI_AUTOTUNE_DONE || tune->ku <= 0.0f || tune->tu_s <= 0.0f) {
+        return false;
+    }
+    float kp = tune->ku / PI_TL_KP_DIVISOR;
+    float ki = kp / (PI_TL_TI_FACTOR * tune->tu_s);
+    gains->kp_q16 = PI_Q16(kp);
+    gains->ki_q16 = PI_Q16(ki);
+    gains->kd_q16 = 0;
+    return gains->kp_q16 > 0;
+}
+
+// ============================================================================
+// Gain store
+// ============================================================================
+// NVS key from the profile's storage id (survives reordering the profile list)
+static void pi_tuning_key(const BatteryType* profile, char* key, size_t key_size) {
+    snprintf(key, key_size, "p%08lx", (unsigned long) profile->getStorageId());
+}
+
+bool pi_tuning_load(const BatteryType* profile) {
+    if (profile == nullptr) {
+        return false;
+    }
+    char key[sizeof(pi_tuning_key_buf)];
+    pi_tuning_key(profile, key, sizeof(key));
+
+    pi_tuning_record_t record;
+    memset(&record, 0, sizeof(record));
+    bool found = false;
+    Preferences prefs;
+    if (prefs.begin(PI_TUNING_NVS_NAMESPACE, true)) {
+        found = prefs.getBytesLength(key) == sizeof(record) &&
+                prefs.getBytes(key, &record, sizeof(record)) == sizeof(record) &&
+                record.version == PI_TUNING_RECORD_VERSION;
+        prefs.end();
+    }
+
+    portENTER_CRITICAL(&pi_tuning_mux);
+    pi_tuning_profile = profile;
+    memcpy(pi_tuning_key_buf, key, sizeof(pi_tuning_key_buf));
+    pi_tuning_cached = record;
+    pi_tuning_valid = found;
+    pi_tuning_dirty = false;
+    portEXIT_CRITICAL(&pi_tuning_mux);
+
+    if (found) {
+        Serial.printf("[TUNE] %s: stored gains kp=%.4f ki=%.4f (Ku=%.4f Tu=%.2fs, tuned %lu times)\n", key,
+                     record.current_gains.kp_q16 / 65536.0f, record.current_gains.ki_q16 / 65536.0f,
+                     record.ku, record.tu_s, (unsigned long) record.tune_count);
+    } else {
+        Serial.printf("[TUNE] %s: no stored gains\n", key);
+    }
+    return found;
+}
+
+bool pi_tuning_lookup(const BatteryType* profile, pi_tuning_record_t* record) {
+    portENTER_CRITICAL(&pi_tuning_mux);
+    bool found = pi_tuning_valid && profile != nullptr && profile == pi_tuning_profile;
+    if (found) {
+        *record = pi_tuning_cached;
+    }
+    portEXIT_CRITICAL(&pi_tuning_mux);
+    return found;
+}
+
+void pi_tuning_update(const BatteryType* profile, const pi_autotune_t* tune) {
+    pi_gains_t gains;
+    if (!pi_autotune_gains(tune, &gains)) {
+        return;
+    }
+    portENTER_CRITICAL(&pi_tuning_mux);
+    bool loaded = (profile != nullptr && profile == pi_tuning_profile);  // Key is only known for the loaded profile
+    if (loaded) {
+        pi_tuning_cached.tune_count = pi_tuning_valid ? pi_tuning_cached.tune_count + 1 : 1;
+        pi_tuning_cached.version = PI_TUNING_RECORD_VERSION;
+        pi_tuning_cached.current_gains = gains;
+        pi_tuning_cached.ku = tune->ku;
+        pi_tuning_cached.tu_s = tune->tu_s;
+        pi_tuning_valid = true;
+        pi_tuning_dirty = true;
+    }
+    portEXIT_CRITICAL(&pi_tuning_mux);
+
+    if (loaded) {
+        Serial.printf("[TUNE] New gains kp=%.4f ki=%.4f, saving\n", gains.kp_q16 / 65536.0f, gains.ki_q16 / 65536.0f);
+    }
+}
+
+void pi_tuning_service(void) {
+    portENTER_CRITICAL(&pi_tuning_mux);
+    bool dirty = pi_tuning_dirty;
+    pi_tuning_record_t record = pi_tuning_cached;
+    char key[sizeof(pi_tuning_key_buf)];
+    memcpy(key, pi_tuning_key_buf, sizeof(key));
+    pi_tuning_dirty = false;
+    portEXIT_CRITICAL(&pi_tuning_mux);
+
+    if (!dirty) {
+        return;
+    }
+    Preferences prefs;
+    if (prefs.begin(PI_TUNING_NVS_NAMESPACE, false)) {
+        bool ok = prefs.putBytes(key, &record, sizeof(record)) == sizeof(record);
+        prefs.end();
+        Serial.printf("[TUNE] %s: gains %s\n", key, ok ? "saved to NVS" : "NVS write failed");
+    } else {
+        Serial.println("[TUNE] NVS open failed, gains not saved");
+    }
+}
+
+void pi_tuning_clear_all(void) {
+    Preferences prefs;
+    if (prefs.begin(PI_TUNING_NVS_NAMESPACE, false)) {
+        prefs.clear();
+        prefs.end();
+    }
+    portENTER_CRITICAL(&pi_tuning_mux);
+    pi_tuning_valid = false;
+    pi_tuning_dirty = false;
+    portEXIT_CRITICAL(&pi_tuning_mux);
+    Serial.println("[TUNE] All stored gains cleared");
+}
+
+void pi_tuning_dump(void) {
+    portENTER_CRITICAL(&pi_tuning_mux);
+    pi_tuning_record_t record = pi_tuning_cached;
+    bool valid = pi_tuning_valid;
+    char key[sizeof(pi_tuning_key_buf)];
+    memcpy(key, pi_tuning_key_buf, sizeof(key));
+    portEXIT_CRITICAL(&pi_tuning_mux);
+
+    if (!valid) {
+        Serial.printf("[TUNE] %s: no tuned gains (scheduled gains in use)\n", key[0] ? key : "-");
+        return;
+    }
+    Serial.printf("[TUNE] %s: kp=%.4f ki=%.4f Ku=%.4f Tu=%.2fs tuned %lu times\n", key,
+                 record.current_gains.kp_q16 / 65536.0f, record.current_gains.ki_q16 / 65536.0f,
+                 record.ku, record.tu_s, (unsigned long) record.tune_count);
+}
@@ -0,0 +1,99 @@
+#ifndef PI_AUTOTUNE_H
+#define PI_AUTOTUNE_H
+
+#include <stdint.h>
+#include "pi_controller.h"
+
+class BatteryType;
+
+// ============================================================================
+// Relay-feedback auto-tune and per-profile gain store
+// ============================================================================
+/*
+Relay test (Astrom-Hagglund) on the CC current loop, once the PI has brought the current
+within 2x PI_AUTOTUNE_HYSTERESIS of the target: the output heads for bias +/-
+PI_AUTOTUNE_RELAY_STEP whenever the current crosses the setpoint (with hysteresis).
+Precharge is too close to the 1 A disconnect threshold for the relay swing.
+
+The output moves at most max_step per call, the PI's own slew limit: the drive then
+follows it exactly, where a 5 Hz jump would be cut short by the drive's ramp and the
+swing that reaches the plant would be unknown. The oscillation is therefore a trapezoid (a triangle
+when the current turns before bias +/- d is reached) of half swing A, ramping for a
+fraction r of the period; its first harmonic is 4A/pi * sinc(pi r/2). With the current's
+half swing a this gives the ultimate gain Ku = 4A sinc(pi r/2) / (pi * sqrt(a^2 - eps^2))
+and period Tu, i.e. the plant's gain and lag at the phase crossover. PI gains follow
+Tyreus-Luyben (Kp = Ku/3.2, Ti = 2.2 Tu), which is less aggressive than Ziegler-Nichols.
+
+Tuned gains are kept per battery profile in NVS (namespace PI_TUNING_NVS_NAMESPACE),
+keyed by BatteryType::getStorageId(). pi_gains_for_profile() uses them
+for the current loops (bounded to [0.25, 4] x the schedule) and scales the voltage-loop
+gains by the same ratio, since both loops see the same frequency->current gain.
+Threading: load at charge start (UI), update from the control task (RAM only), and the
+NVS write happens later in pi_tuning_service() from loop().
+*/
+
+#define PI_AUTOTUNE_ENABLE          1       // Tune in CC when the profile has no stored gains
+#define PI_AUTOTUNE_RELAY_STEP      500     // Relay amplitude (0.01Hz) = 5 Hz around the bias frequency
+#define PI_AUTOTUNE_HYSTERESIS      30      // Noise band around the setpoint (0.01A) = 0.3 A
+#define PI_AUTOTUNE_CYCLES          4       // Limit-cycle periods averaged (after one settling period)
+#define PI_AUTOTUNE_TIMEOUT_MS      120000  // Give up (keep scheduled gains) after this long
+#define PI_TUNING_NVS_NAMESPACE     "pi_tuning"
+#define PI_TUNING_RECORD_VERSION    1
+
+typedef enum {
+    PI_AUTOTUNE_IDLE = 0,
+    PI_AUTOTUNE_RUNNING,
+    PI_AUTOTUNE_DONE,
+    PI_AUTOTUNE_FAILED
+} pi_autotune_state_t;
+
+typedef struct {
+    pi_autotune_state_t state;
+    int32_t bias;
+    int32_t setpoint;
+    int32_t out_min;
+    int32_t out_max;
+    int32_t max_step;               // Output slew per call, 0 = none
+    int32_t output;                 // Last output
+    bool relay_high;
+    unsigned long start_ms;
+    unsigned long last_rise_ms;     // Time of the last upward relay switch (0 = none yet)
+    uint8_t periods_seen;           // Completed periods, including the settling one
+    int32_t peak_max;               // Measurement extremes within the current period
+    int32_t peak_min;
+    int32_t out_max_seen;           // Output extremes within the current period
+    int32_t out_min_seen;
+    uint16_t period_samples;        // Calls within the current period, and how many of them slewed
+    uint16_t period_ramping;
+    uint32_t period_sum_ms;
+    int32_t amplitude_sum;          // Sum of half peak-to-peak (measurement units)
+    int32_t swing_sum;              // Sum of the output's half peak-to-peak (output units)
+    uint32_t samples_sum;
+    uint32_t ramping_sum;
+    uint8_t periods_used;
+    float ku;                       // Output units per measurement unit
+    float tu_s;
+} pi_autotune_t;
+
+void pi_autotune_start(pi_autotune_t* tune, int32_t bias, int32_t setpoint, int32_t out_min, int32_t out_max,
+                       int32_t max_step, unsigned long now_ms);
+int32_t pi_autotune_step(pi_autotune_t* tune, int32_t measured, unsigned long now_ms);  // Relay output
+bool pi_autotune_gains(const pi_autotune_t* tune, pi_gains_t* gains);                   // Current-loop PI gains
+
+// Gain store
+typedef struct {
+    uint16_t version;
+    pi_gains_t current_gains;       // PRECHARGE / CC
+    float ku;
+    float tu_s;
+    uint32_t tune_count;
+} pi_tuning_record_t;
+
+bool pi_tuning_load(const BatteryType* profile);    // Cache the profile's stored gains; false = none stored
+bool pi_tuning_lookup(const BatteryType* profile, pi_tuning_record_t* record);   // From the cache, any task
+void pi_tuning_update(const BatteryType* profile, const pi_autotune_t* tune);    // Cache + queue NVS write
+void pi_tuning_service(void);                       // loop(): write a queued record to NVS
+void pi_tuning_clear_all(void);
+void pi_tuning_dump(void);
+
+#endif // PI_AUTOTUNE_H
@@ -0,0 +1,114 @@
+#include "pi_controller.h"
+#include "battery_types.h"
+#include "pi_autotune.h"
+
+// Base gains at PI_SCHEDULE_REF_AH. Output 0.01Hz, error 0.01A (current modes) or 0.01V (voltage modes).
+// Current loops: 10A error -> 1 Hz proportional, 0.5 Hz/s integral. Voltage loops: 1V error -> 0.25 Hz, 0.1 Hz/s.
+#define PI_SCHEDULE_REF_AH      100
+#define PI_SCHEDULE_MIN_SCALE   0.25f
+#define PI_SCHEDULE_MAX_SCALE   4.0f
+
+static const pi_gains_t pi_base_gains[PI_MODE_COUNT] = {
+    { 0, 0, 0 },                              // PI_MODE_NONE
+    { PI_Q16(0.10f), PI_Q16(0.05f), 0 },      // PI_MODE_PRECHARGE
+    { PI_Q16(0.10f), PI_Q16(0.05f), 0 },      // PI_MODE_CC
+    { PI_Q16(0.25f), PI_Q16(0.10f), 0 },      // PI_MODE_CV
+    { PI_Q16(0.25f), PI_Q16(0.10f), 0 },      // PI_MODE_SAT_CV
+};
+
+static int32_t clamp_i32(int64_t value, int32_t lo, int32_t hi) {
+    return (value < lo) ? lo : (value > hi) ? hi : (int32_t)value;
+}
+
+static float clamp_scale(float scale) {
+    return (scale < PI_SCHEDULE_MIN_SCALE) ? PI_SCHEDULE_MIN_SCALE : (scale > PI_SCHEDULE_MAX_SCALE) ? PI_SCHEDULE_MAX_SCALE : scale;
+}
+
+static int64_t clamp_i64(int64_t value, int64_t lo, int64_t hi) {
+    return (value < lo) ? lo : (value > hi) ? hi : value;
+}
+
+void pi_controller_init(pi_controller_t* pi, pi_gains_t gains, int32_t out_min, int32_t out_max, int32_t max_step) {
+    pi->gains = gains;
+    pi->out_min = out_min;
+    pi->out_max = out_max;
+    pi->max_step = max_step;
+    pi->integral_q16 = 0;
+    pi->output = 0;
+    pi->last_measured = 0;
+    pi->has_last = false;
+}
+
+// Load the integrator so that, with the current error, P + I reproduces output
+void pi_controller_bumpless(pi_controller_t* pi, int32_t output, int32_t setpoint, int32_t measured) {
+    int32_t error = setpoint - measured;
+    pi->integral_q16 = ((int64_t)output << 16) - (int64_t)pi->gains.kp_q16 * error;
+    pi->output = output;
+    pi->last_measured = measured;
+    pi->has_last = true;
+}
+
+int32_t pi_controller_update(pi_controller_t* pi, int32_t setpoint, int32_t measured, uint32_t dt_ms) {
+    int32_t error = setpoint - measured;
+    int64_t p_q16 = (int64_t)pi->gains.kp_q16 * error;
+
+    int64_t d_q16 = 0;
+    if (pi->gains.kd_q16 != 0 && pi->has_last && dt_ms > 0) {
+        d_q16 = -(int64_t)pi->gains.kd_q16 * (measured - pi->last_measured) * 1000 / (int64_t)dt_ms;
+    }
+    pi->last_measured = measured;
+    pi->has_last = true;
+
+    // Integrate, then clamp so P + I + D cannot wind up past the output limits
+    pi->integral_q16 += (int64_t)pi->gains.ki_q16 * error * (int64_t)dt_ms / 1000;
+    pi->integral_q16 = clamp_i64(pi->integral_q16,
+                                 ((int64_t)pi->out_min << 16) - p_q16 - d_q16,
+                                 ((int64_t)pi->out_max << 16) - p_q16 - d_q16);
+
+    int64_t sum_q16 = p_q16 + pi->integral_q16 + d_q16;
+    int32_t output = clamp_i32((sum_q16 + (1 << 15)) >> 16, pi->out_min, pi->out_max);
+
+    // Slew limit; back-calculate the integrator so it tracks the applied output
+    if (pi->max_step > 0) {
+        int32_t limited = clamp_i32(output, pi->output - pi->max_step, pi->output + pi->max_step);
+        if (limited != output) {
+            output = clamp_i32(limited, pi->out_min, pi->out_max);
+            pi->integral_q16 = ((int64_t)output << 16) - p_q16 - d_q16;
+        }
+    }
+
+    pi->output = output;
+    return output;
+}
+
+// Larger packs (lower internal resistance) give more current per Hz, so gains scale
+// with PI_SCHEDULE_REF_AH / rated Ah, clamped to [0.25, 4]. Auto-tuned gains (pi_autotune.h)
+// move the current loops by their ratio to the schedule, bounded to the same [0.25, 4];
+// the voltage loops follow the kp ratio.
+pi_gains_t pi_gains_for_profile(const BatteryType* profile, pi_mode_t mode) {
+    pi_gains_t gains = pi_base_gains[(mode < PI_MODE_COUNT) ? mode : PI_MODE_NONE];
+    if (profile == nullptr || profile->getRatedAh() == 0) {
+        return gains;
+    }
+    float scale = (float)PI_SCHEDULE_REF_AH / (float)profile->getRatedAh();
+    scale = clamp_scale(scale);
+    gains.kp_q16 = (int32_t)(gains.kp_q16 * scale);
+    gains.ki_q16 = (int32_t)(gains.ki_q16 * scale);
+    gains.kd_q16 = (int32_t)(gains.kd_q16 * scale);
+
+    pi_tuning_record_t tuned;
+    if (mode != PI_MODE_NONE && pi_tuning_lookup(profile, &tuned)) {
+        const pi_gains_t& scheduled = pi_base_gains[PI_MODE_CC];
+        float kp_ratio = tuned.current_gains.kp_q16 / (scheduled.kp_q16 * scale);
+        float ki_ratio = tuned.current_gains.ki_q16 / (scheduled.ki_q16 * scale);
+        if (mode != PI_MODE_PRECHARGE && mode != PI_MODE_CC) {
+            ki_ratio = kp_ratio;
+        }
+        kp_ratio = clamp_scale(kp_ratio);
+        ki_ratio = clamp_scale(ki_ratio);
+        gains.kp_q16 = (int32_t)(gains.kp_q16 * kp_ratio);
+        gains.ki_q16 = (int32_t)(gains.ki_q16 * ki_ratio);
+        gains.kd_q16 = (int32_t)(gains.kd_q16 * kp_ratio);
+    }
+    return gains;
+}
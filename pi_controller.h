@@ -0,0 +1,60 @@
+#ifndef PI_CONTROLLER_H
+#define PI_CONTROLLER_H
+
+#include <stdint.h>
+
+class BatteryType;
+
+// ============================================================================
+// Fixed-point PI(D) controller
+// ============================================================================
+/*
+Integer controller in the charger's centi-units: setpoint/measurement in 0.01A or 0.01V,
+output in 0.01Hz. Gains are Q16 (value * 65536):
+  kp: output units per unit of error
+  ki: output units per unit of error per second
+  kd: output units per (unit of measurement change per second), derivative on measurement
+Anti-windup: the integrator is clamped so P+I+D stays inside [out_min, out_max], and is
+back-calculated when the output slew limit is active, so leaving a clamp is immediate.
+Bumpless transfer: pi_controller_bumpless() loads the integrator so the next output
+continues from the frequency currently applied (mode change, gain change, restart). New
+gains take effect through pi_controller_init() followed by pi_controller_bumpless().
+*/
+
+#define PI_Q16(x)   ((int32_t)((x) * 65536.0f + ((x) >= 0 ? 0.5f : -0.5f)))
+
+typedef struct {
+    int32_t kp_q16;
+    int32_t ki_q16;
+    int32_t kd_q16;            // 0 = PI
+} pi_gains_t;
+
+typedef struct {
+    pi_gains_t gains;
+    int32_t out_min;
+    int32_t out_max;
+    int32_t max_step;          // Max output change per update (0 = no slew limit)
+    int64_t integral_q16;      // Integrator in output units, Q16
+    int32_t output;            // Last output
+    int32_t last_measured;
+    bool has_last;
+} pi_controller_t;
+
+// Charging modes, each with its own scheduled gains
+typedef enum {
+    PI_MODE_NONE = 0,
+    PI_MODE_PRECHARGE,         // Current loop at PRECHARGE_AMPS
+    PI_MODE_CC,                // Current loop at the profile's constant current
+    PI_MODE_CV,                // Voltage loop at the profile's cutoff voltage
+    PI_MODE_SAT_CV,            // Voltage loop at the detected saturation voltage
+    PI_MODE_COUNT
+} pi_mode_t;
+
+void pi_controller_init(pi_controller_t* pi, pi_gains_t gains, int32_t out_min, int32_t out_max, int32_t max_step);
+void pi_controller_bumpless(pi_controller_t* pi, int32_t output, int32_t setpoint, int32_t measured);
+int32_t pi_controller_update(pi_controller_t* pi, int32_t setpoint, int32_t measured, uint32_t dt_ms);
+
+// Gain schedule: base gains per mode, scaled for the profile's capacity
+pi_gains_t pi_gains_for_profile(const BatteryType* profile, pi_mode_t mode);
+
+#endif // PI_CONTROLLER_H
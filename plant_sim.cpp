@@ -0,0 +1,361 @@
+#include "plant_sim.h"
+#include "can_twai.h"
+#include "rs485_vfdComs.h"
+#include "modbus_rtu.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <string.h>
+
+// Battery model constants
+#define PLANT_CELL_R_AH         0.25f     // Cell series resistance * rated Ah (ohm*Ah): 100 Ah -> 2.5 mohm/cell
+#define PLANT_TAU1_S            60.0f     // Polarisation time constant
+#define PLANT_THERMAL_TAU_S     600.0f
+#define PLANT_BATT_C_PER_W      0.2f      // Steady-state pack temperature rise per watt of I^2R
+#define PLANT_GEN_C_PER_A2      0.0022f   // Generator: ~50 C rise at 150 A
+#define PLANT_MOTOR_C_AT_MAX    40.0f     // Motor: rise at RS485_FREQ_MAX, scales with f^2
+#define PLANT_MOTOR_VOLTS       200.0f    // For the drive's output current register
+
+// Charging OCV per cell at 0%, 10%, ... 100% SOC. Includes the overpotential a pack shows
+// on charge near full (lead-acid gassing), so CV at the profile cutoff actually tapers.
+static const float plant_ocv_lead_acid[11] = { 1.95f, 2.00f, 2.05f, 2.10f, 2.15f, 2.20f, 2.25f, 2.30f, 2.40f, 2.55f, 2.70f };
+static const float plant_ocv_lifepo4[11]   = { 2.80f, 3.20f, 3.25f, 3.28f, 3.30f, 3.31f, 3.32f, 3.33f, 3.35f, 3.45f, 3.70f };
+static const float plant_ocv_lithium[11]   = { 3.30f, 3.55f, 3.62f, 3.68f, 3.74f, 3.80f, 3.87f, 3.95f, 4.03f, 4.10f, 4.25f };
+
+static plant_model_t plant;
+static portMUX_TYPE plant_sim_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t plant_control_word = VFD_CMD_STOP;
+static uint8_t plant_contactor_cmd = CONTACTOR_OPEN;
+static bool plant_contactor_changed = false;
+
+// ============================================================================
+// Model
+// ============================================================================
+float plant_model_ocv(BatteryChemistry chemistry, float soc) {
+    const float* table = (chemistry == LEAD_ACID) ? plant_ocv_lead_acid :
+                         (chemistry == LIFEPO4) ? plant_ocv_lifepo4 : plant_ocv_lithium;
+    if (soc <= 0.0f) return table[0];
+    if (soc >= 1.0f) return table[10];
+    float position = soc * 10.0f;
+    int index = (int)position;
+    float fraction = position - index;
+    return table[index] + (table[index + 1] - table[index]) * fraction;
+}
+
+void plant_model_init(plant_model_t* p, const BatteryType* profile, float soc_pct) {
+    memset(p, 0, sizeof(*p));
+    p->temp_motor_c = PLANT_SIM_AMBIENT_C;
+    p->temp_gen_c = PLANT_SIM_AMBIENT_C;
+    p->temp_batt_c = PLANT_SIM_AMBIENT_C;
+    if (profile == nullptr || profile->getRatedAh() == 0 || profile->getRatedVoltage() == 0) {
+        return;  // No battery
+    }
+
+    float cell_nominal = (profile->getChemistry() == LEAD_ACID) ? 2.0f :
+                         (profile->getChemistry() == LIFEPO4) ? 3.2f : 3.6f;
+    int cells = (int)(profile->getRatedVoltage() / cell_nominal + 0.5f);
+    p->present = true;
+    p->chemistry = profile->getChemistry();
+    p->cells = (uint8_t)(cells < 1 ? 1 : cells);
+    p->capacity_as = profile->getRatedAh() * 3600.0f;
+    p->soc = soc_pct / 100.0f;
+    p->r0_ohm = p->cells * PLANT_CELL_R_AH / profile->getRatedAh();
+    p->r1_ohm = p->r0_ohm;
+    p->tau1_s = PLANT_TAU1_S;
+    p->ke_v_per_hz = profile->getCutoffVoltage() * PLANT_SIM_GEN_HEADROOM / PLANT_SIM_GEN_REF_HZ;
+    p->terminal_v = plant_model_ocv(p->chemistry, p->soc) * p->cells;
+}
+
+void plant_model_step(plant_model_t* p, float dt_s) {
+    // VFD output frequency ramps to the setpoint (to 0 when stopped)
+    float target_hz = p->vfd_running ? p->freq_cmd_hz : 0.0f;
+    float max_change = PLANT_SIM_VFD_ACCEL_HZ_S * dt_s;
+    float delta = target_hz - p->freq_hz;
+    p->freq_hz += (delta > max_change) ? max_change : (delta < -max_change) ? -max_change : delta;
+
+    // Generator EMF into the pack through the rectifier (no reverse current)
+    float current = 0.0f;
+    float internal_v = 0.0f;
+    if (p->present) {
+        internal_v = plant_model_ocv(p->chemistry, p->soc) * p->cells + p->v_rc;
+        float emf = p->ke_v_per_hz * p->freq_hz;
+        if (p->contactor_closed && emf > internal_v) {
+            current = (emf - internal_v) / (PLANT_SIM_GEN_R_OHM + p->r0_ohm);
+        }
+        p->v_rc += (current * p->r1_ohm - p->v_rc) * (dt_s / p->tau1_s);
+        p->soc += current * dt_s / p->capacity_as;
+        if (p->soc > 1.0f) p->soc = 1.0f;
+    }
+    p->current_a = current;
+    p->terminal_v = p->present ? internal_v + current * p->r0_ohm : 0.0f;
+
+    // First-order thermal: each temperature relaxes to ambient + its steady-state rise
+    float k = dt_s / PLANT_THERMAL_TAU_S;
+    float freq_ratio = p->freq_hz / (RS485_FREQ_MAX / 100.0f);
+    p->temp_motor_c += (PLANT_SIM_AMBIENT_C + PLANT_MOTOR_C_AT_MAX * freq_ratio * freq_ratio - p->temp_motor_c) * k;
+    p->temp_gen_c += (PLANT_SIM_AMBIENT_C + PLANT_GEN_C_PER_A2 * current * current - p->temp_gen_c) * k;
+    p->temp_batt_c += (PLANT_SIM_AMBIENT_C + PLANT_BATT_C_PER_W * current * current * (p->r0_ohm + p->r1_ohm) - p->temp_batt_c) * k;
+}
+
+// ============================================================================
+// Virtual clock
+// ============================================================================
+unsigned long plant_sim_millis(void) {
+    return (unsigned long)((esp_timer_get_time() / 1000) * PLANT_SIM_TIME_SCALE);
+}
+
+// ============================================================================
+// M2 emulator
+// ============================================================================
+static void plant_sim_publish(uint32_t id, const uint8_t* data, uint8_t length) {
+    twai_message_t message = {};
+    message.identifier = id;
+    message.data_length_code = length;
+    memcpy(message.data, data, length);
+    can_dispatch_frame(&message);
+}
+
+static uint16_t plant_sim_u16(float value) {
+    return (value <= 0.0f) ? 0 : (value >= 65535.0f) ? 65535 : (uint16_t)(value + 0.5f);
+}
+
+static void plant_sim_put_s16(uint8_t* data, float value) {
+    int16_t raw = (int16_t)(value < -32768.0f ? -32768 : value > 32767.0f ? 32767 : value);
+    data[0] = (uint8_t)((uint16_t)raw >> 8);
+    data[1] = (uint8_t)raw;
+}
+
+static void plant_sim_publish_vi(const plant_model_t* p) {
+    uint16_t volt = plant_sim_u16(p->terminal_v * 100.0f);
+    uint16_t curr = plant_sim_u16(p->current_a * 100.0f);
+    uint8_t data[4] = { (uint8_t)(volt >> 8), (uint8_t)volt, (uint8_t)(curr >> 8), (uint8_t)curr };
+    plant_sim_publish(SENSOR_DATA_1_ID, data, sizeof(data));
+}
+
+static void plant_sim_publish_temps(const plant_model_t* p) {
+    uint8_t data[8];
+    plant_sim_put_s16(&data[0], p->temp_motor_c * 100.0f);
+    plant_sim_put_s16(&data[2], p->temp_gen_c * 100.0f);
+    plant_sim_put_s16(&data[4], PLANT_SIM_AMBIENT_C * 100.0f);
+    plant_sim_put_s16(&data[6], p->temp_batt_c * 100.0f);
+    plant_sim_publish(SENSOR_DATA_2_ID, data, sizeof(data));
+}
+
+// RTC: real time since boot on top of 2026-01-01 00:00:00 (Thursday), day wraps after 28
+static void plant_sim_publish_rtc(void) {
+    uint32_t seconds = millis() / 1000;
+    uint32_t days = seconds / 86400;
+    uint8_t data[8] = { (uint8_t)(2026 >> 8), (uint8_t)(2026 & 0xFF), 1, (uint8_t)(1 + days % 28),
+                        (uint8_t)(1 + (4 + days) % 7),  // 1 = Sunday
+                        (uint8_t)((seconds / 3600) % 24), (uint8_t)((seconds / 60) % 60), (uint8_t)(seconds % 60) };
+    plant_sim_publish(SENSOR_DATA_3_ID, data, sizeof(data));
+}
+
+static void plant_sim_publish_status(uint8_t contactor) {
+    uint8_t heartbeat[2] = { M2_NODE_ID, MSG_HEARTBEAT };
+    plant_sim_publish(HANDSHAKE_FRAME_ID, heartbeat, sizeof(heartbeat));
+    uint8_t feedback[2] = { M2_NODE_ID, contactor };
+    plant_sim_publish(CONTACTOR_FEEDBACK_ID, feedback, sizeof(feedback));
+}
+
+void plant_sim_task(void* pvParameters) {
+    (void) pvParameters;
+    const float dt_s = PLANT_SIM_STEP_MS * PLANT_SIM_TIME_SCALE / 1000.0f;
+    uint32_t last_vi_ms = 0;
+    uint32_t last_temp_ms = 0;
+    uint32_t last_slow_ms = 0;
+
+    Serial.printf("[SIM] Plant simulator running, time scale x%d\n", PLANT_SIM_TIME_SCALE);
+
+    TickType_t last_wake = xTaskGetTickCount();
+    while (true) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(PLANT_SIM_STEP_MS));
+
+        portENTER_CRITICAL(&plant_sim_mux);
+        plant_model_step(&plant, dt_s);
+        plant_model_t state = plant;
+        uint8_t contactor = plant_contactor_cmd;
+        bool contactor_changed = plant_contactor_changed;
+        plant_contactor_changed = false;
+        portEXIT_CRITICAL(&plant_sim_mux);
+
+        uint32_t now = millis();
+        if (now - last_vi_ms >= PLANT_SIM_VI_PERIOD_MS) {
+            last_vi_ms = now;
+            plant_sim_publish_vi(&state);
+        }
+        if (now - last_temp_ms >= PLANT_SIM_TEMP_PERIOD_MS) {
+            last_temp_ms = now;
+            plant_sim_publish_temps(&state);
+        }
+        if (contactor_changed || now - last_slow_ms >= PLANT_SIM_SLOW_PERIOD_MS) {
+            if (!contactor_changed) {
+                last_slow_ms = now;
+                plant_sim_publish_rtc();
+            }
+            plant_sim_publish_status(contactor);
+        }
+    }
+}
+
+// 0x105 from M1: close/open the simulated contactor
+bool plant_sim_can_transmit(const twai_message_t* message) {
+    if (message->identifier == CONTACTOR_CONTROL_ID && message->data_length_code >= 2 &&
+        message->data[0] == M1_NODE_ID &&
+        (message->data[1] == CONTACTOR_CLOSE || message->data[1] == CONTACTOR_OPEN)) {
+        portENTER_CRITICAL(&plant_sim_mux);
+        plant.contactor_closed = (message->data[1] == CONTACTOR_CLOSE);
+        plant_contactor_changed = (plant_contactor_cmd != message->data[1]);
+        plant_contactor_cmd = message->data[1];
+        portEXIT_CRITICAL(&plant_sim_mux);
+    }
+    return true;  // Every frame is "acknowledged"
+}
+
+// ============================================================================
+// VFD Modbus slave
+// ============================================================================
+static bool plant_sim_read_reg(uint16_t reg, uint16_t* value) {
+    switch (reg) {
+        case VFD_REG_CONTROL:        *value = plant_control_word; return true;
+        case VFD_REG_FREQUENCY:      *value = plant_sim_u16(plant.freq_cmd_hz * 100.0f); return true;
+        case VFD_REG_OUTPUT_FREQ:    *value = plant_sim_u16(plant.freq_hz * 100.0f); return true;
+        case VFD_REG_OUTPUT_CURRENT: *value = plant_sim_u16(plant.current_a * plant.terminal_v / PLANT_MOTOR_VOLTS * 10.0f); return true;
+        case VFD_REG_FAULT_CODE:     *value = 0; return true;
+        default:                     return false;
+    }
+}
+
+static bool plant_sim_write_reg(uint16_t reg, uint16_t value) {
+    switch (reg) {
+        case VFD_REG_CONTROL:
+            if (value != VFD_CMD_START && value != VFD_CMD_STOP) {
+                return false;
+            }
+            plant_control_word = value;
+            plant.vfd_running = (value == VFD_CMD_START);
+            return true;
+        case VFD_REG_FREQUENCY:
+            if (value > RS485_FREQ_MAX) {
+                return false;
+            }
+            plant.freq_cmd_hz = value / 100.0f;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static size_t plant_sim_finish(uint8_t* response, size_t length) {
+    uint16_t crc = modbus_crc16(response, length);
+    response[length] = (uint8_t)(crc & 0xFF);
+    response[length + 1] = (uint8_t)(crc >> 8);
+    return length + 2;
+}
+
+static size_t plant_sim_exception(uint8_t* response, uint8_t function, uint8_t code) {
+    response[0] = VFD_ADDRESS;
+    response[1] = (uint8_t)(function | MODBUS_EXCEPTION_FLAG);
+    response[2] = code;
+    return plant_sim_finish(response, 3);
+}
+
+// Returns the response length, 0 = no response (wrong address, bad CRC)
+size_t plant_sim_modbus_request(const uint8_t* request, size_t request_len, uint8_t* response, size_t response_size) {
+    if (request_len < 8 || response_size < 8 || !modbus_crc_valid(request, request_len) || request[0] != VFD_ADDRESS) {
+        return 0;
+    }
+    uint8_t function = request[1];
+    uint16_t reg = (uint16_t)((request[2] << 8) | request[3]);
+    uint16_t word = (uint16_t)((request[4] << 8) | request[5]);
+    bool ok = true;
+
+    portENTER_CRITICAL(&plant_sim_mux);
+    size_t length = 0;
+    switch (function) {
+        case MODBUS_FC_READ_HOLDING:
+            if (word == 0 || modbus_read_response_length(word) > response_size) {
+                ok = false;
+                break;
+            }
+            response[0] = VFD_ADDRESS;
+            response[1] = function;
+            response[2] = (uint8_t)(word * 2);
+            for (uint16_t i = 0; i < word && ok; i++) {
+                uint16_t value = 0;
+                ok = plant_sim_read_reg(reg + i, &value);
+                response[3 + 2 * i] = (uint8_t)(value >> 8);
+                response[4 + 2 * i] = (uint8_t)value;
+            }
+            length = 3 + 2 * word;
+            break;
+        case MODBUS_FC_WRITE_SINGLE:
+            ok = plant_sim_write_reg(reg, word);
+            memcpy(response, request, 6);
+            length = 6;
+            break;
+        case MODBUS_FC_WRITE_MULTIPLE:
+            if (request_len != (size_t)(9 + 2 * word) || request[6] != word * 2) {
+                ok = false;
+                break;
+            }
+            for (uint16_t i = 0; i < word && ok; i++) {
+                ok = plant_sim_write_reg(reg + i, (uint16_t)((request[7 + 2 * i] << 8) | request[8 + 2 * i]));
+            }
+            memcpy(response, request, 6);
+            length = 6;
+            break;
+        default:
+            portEXIT_CRITICAL(&plant_sim_mux);
+            return plant_sim_exception(response, function, 0x01);  // Illegal function
+    }
+    portEXIT_CRITICAL(&plant_sim_mux);
+
+    if (!ok) {
+        return plant_sim_exception(response, function, 0x02);  // Illegal data address / value
+    }
+    return plant_sim_finish(response, length);
+}
+
+// ============================================================================
+// Console
+// ============================================================================
+bool plant_sim_connect_battery(int profile_index, float soc_pct) {
+    const BatteryType* profile = (profile_index < 0) ? nullptr : batteryProfiles.getProfile(profile_index);
+    if (profile_index >= 0 && (profile == nullptr || profile->getRatedAh() == 0)) {
+        return false;
+    }
+    plant_model_t fresh;
+    plant_model_init(&fresh, profile, soc_pct);
+
+    portENTER_CRITICAL(&plant_sim_mux);
+    // The contactor and the drive belong to the charger, not the battery
+    fresh.contactor_closed = plant.contactor_closed;
+    fresh.vfd_running = plant.vfd_running;
+    fresh.freq_cmd_hz = plant.freq_cmd_hz;
+    fresh.freq_hz = plant.freq_hz;
+    fresh.temp_motor_c = plant.temp_motor_c;
+    fresh.temp_gen_c = plant.temp_gen_c;
+    plant = fresh;
+    portEXIT_CRITICAL(&plant_sim_mux);
+
+    if (profile != nullptr) {
+        Serial.printf("[SIM] Battery %d connected: %s, %d cells, %.0f%% SOC, R0=%.1f mohm\n", profile_index,
+                     profile->getDisplayName().c_str(), fresh.cells, soc_pct, fresh.r0_ohm * 1000.0f);
+    } else {
+        Serial.println("[SIM] Battery disconnected");
+    }
+    return true;
+}
+
+void plant_sim_dump(void) {
+    portENTER_CRITICAL(&plant_sim_mux);
+    plant_model_t state = plant;
+    portEXIT_CRITICAL(&plant_sim_mux);
+
+    Serial.printf("[SIM] battery=%s soc=%.1f%% V=%.2f I=%.2f v_rc=%.3f\n", state.present ? "yes" : "no",
+                 state.soc * 100.0f, state.terminal_v, state.current_a, state.v_rc);
+    Serial.printf("[SIM] contactor=%s vfd=%s cmd=%.2fHz out=%.2fHz\n", state.contactor_closed ? "closed" : "open",
+                 state.vfd_running ? "run" : "stop", state.freq_cmd_hz, state.freq_hz);
+    Serial.printf("[SIM] temps motor=%.1fC gen=%.1fC batt=%.1fC\n", state.temp_motor_c, state.temp_gen_c, state.temp_batt_c);
+}
@@ -0,0 +1,83 @@
+#ifndef PLANT_SIM_H
+#define PLANT_SIM_H
+
+#include <Arduino.h>
+#include <driver/twai.h>
+#include "battery_types.h"
+
+// ============================================================================
+// Plant simulator (bench build without M2, VFD/generator or battery)
+// ============================================================================
+/*
+PLANT_SIM 1 replaces the hardware around M1 with a model, so the real charging code
+(CAN decode, Modbus master, RS485/CAN tasks, control task, FSM, UI) runs unchanged:
+  - battery: charging OCV(SOC) per chemistry + R0 + one RC branch, first-order thermal
+  - VFD/generator: output frequency ramps to the Modbus setpoint, generator EMF is
+    proportional to frequency and drives current into the pack through its resistance
+  - M2 emulator: publishes 0x100/0x101/0x102/0x103/0x104 through can_dispatch_frame()
+    and honours 0x105 contactor commands (CAN TX is intercepted, nothing goes on the bus)
+  - Modbus slave: answers the master's 0x03/0x06/0x10 requests (RS485 UART is not used)
+The charging logic runs on charge_millis(), which in this build advances
+PLANT_SIM_TIME_SCALE times faster than real time, and so does the model. Heartbeat,
+UI and comms timing stay real time.
+Serial console: "simbatt <profile> [soc%]" connects a battery, "simbatt off" removes
+it, "simstat" prints the plant state.
+*/
+
+#define PLANT_SIM                   0       // 1 = simulated plant (bench only, never in production)
+
+#define PLANT_SIM_TIME_SCALE        20      // Virtual clock speed-up for charge_millis() and the model
+#define PLANT_SIM_STEP_MS           10      // Model step (real time)
+#define PLANT_SIM_VI_PERIOD_MS      100     // 0x101 interval (real time)
+#define PLANT_SIM_TEMP_PERIOD_MS    500     // 0x102 interval
+#define PLANT_SIM_SLOW_PERIOD_MS    1000    // 0x100 / 0x103 / 0x104 interval
+#define PLANT_SIM_TASK_STACK_SIZE   4096
+#define PLANT_SIM_TASK_PRIORITY     5       // Same as the CAN task it stands in for
+#define PLANT_SIM_TASK_CORE         1
+
+#define PLANT_SIM_DEFAULT_SOC       30      // % SOC of a connected battery unless given
+#define PLANT_SIM_AMBIENT_C         25.0f
+#define PLANT_SIM_GEN_HEADROOM      1.2f    // Generator EMF at PLANT_SIM_GEN_REF_HZ = pack cutoff voltage * this
+#define PLANT_SIM_GEN_REF_HZ        240.0f
+#define PLANT_SIM_GEN_R_OHM         0.03f   // Generator + rectifier + cable resistance
+#define PLANT_SIM_VFD_ACCEL_HZ_S    10.0f   // VFD ramp (virtual time)
+
+// Plant state (pure model, no hardware access)
+typedef struct {
+    bool present;                   // Battery connected to M2's sense/charge terminals
+    BatteryChemistry chemistry;
+    uint8_t cells;
+    float capacity_as;              // Amp-seconds
+    float soc;                      // 0..1
+    float r0_ohm;                   // Series resistance
+    float r1_ohm;                   // Polarisation branch
+    float tau1_s;
+    float v_rc;                     // Polarisation voltage
+
+    bool contactor_closed;
+    bool vfd_running;
+    float freq_cmd_hz;
+    float freq_hz;                  // VFD output frequency after the ramp
+    float ke_v_per_hz;              // Generator EMF constant
+
+    float temp_motor_c;
+    float temp_gen_c;
+    float temp_batt_c;
+
+    float current_a;                // Charge current into the pack
+    float terminal_v;               // Voltage M2 measures
+} plant_model_t;
+
+void plant_model_init(plant_model_t* plant, const BatteryType* profile, float soc_pct);
+void plant_model_step(plant_model_t* plant, float dt_s);
+float plant_model_ocv(BatteryChemistry chemistry, float soc);   // Per cell, charging
+
+// Glue (PLANT_SIM builds)
+unsigned long plant_sim_millis(void);
+void plant_sim_task(void* pvParameters);
+bool plant_sim_can_transmit(const twai_message_t* message);    // From can_tx_task instead of twai_transmit
+size_t plant_sim_modbus_request(const uint8_t* request, size_t request_len, uint8_t* response, size_t response_size);
+bool plant_sim_connect_battery(int profile_index, float soc_pct);  // profile_index < 0 = disconnect
+void plant_sim_dump(void);
+
+#endif // PLANT_SIM_H
@@ -1,99 +1,339 @@
 
 #include "rs485_vfdComs.h"
-#include "screen_definitions.h"  // For ACTUAL_TARGET_CC_CV_debug macro
+#include "charge_controller.h"  // For ACTUAL_TARGET_CC_CV_debug macro
+#include "modbus_rtu.h"
+#include "modbus_master.h"
+#include "latency_hist.h"
 #include <HardwareSerial.h>
 #include <cstring>
 
 // Use Serial2 for RS485 communication (pins 44=TX, 43=RX)
 extern HardwareSerial Serial2;
 
+// Constant VFD frames, built with CRC at compile time (follow VFD_ADDRESS automatically)
+static constexpr std::array<uint8_t, 8> vfd_start_frame = modbus_write_single(VFD_ADDRESS, VFD_REG_CONTROL, VFD_CMD_START);
+static constexpr std::array<uint8_t, 8> vfd_stop_frame = modbus_write_single(VFD_ADDRESS, VFD_REG_CONTROL, VFD_CMD_STOP);
+
+static_assert(RS485_BAUD_RATE == 9600 || RS485_BAUD_RATE == 19200 || RS485_BAUD_RATE == 38400,
+              "RS485_BAUD_RATE: 9600, 19200 or 38400");
+
+static vfd_status_t vfd_status = { 0, 0, 0, 0, 0, false };
+#if VFD_POLL_INTERVAL_MS > 0
+static unsigned long vfd_last_poll_ms = 0;
+static const uint16_t vfd_poll_registers[] = { VFD_REG_OUTPUT_FREQ, VFD_REG_OUTPUT_CURRENT, VFD_REG_FAULT_CODE };
+#define VFD_POLL_COUNT (sizeof(vfd_poll_registers) / sizeof(vfd_poll_registers[0]))
+static uint8_t vfd_poll_index = 0;
+static bool vfd_poll_rejected[VFD_POLL_COUNT] = {false};  // Drive answered illegal address/function: not polled again
+#endif
+
+// Commands waiting for rs485_task: one slot per kind, a newer frequency replaces the pending one
+typedef enum {
+    RS485_CMD_NONE = 0,
+    RS485_CMD_FREQUENCY,
+    RS485_CMD_START,
+    RS485_CMD_STOP
+} rs485_cmd_t;
+
+typedef struct {
+    bool stop;
+    uint32_t stop_us;
+    bool start;
+    uint32_t start_us;
+    bool frequency;
+    uint16_t frequency_value;
+    uint32_t frequency_us;
+} rs485_pending_t;
+
+static rs485_pending_t rs485_pending = { false, 0, false, 0, false, 0, 0 };
+static portMUX_TYPE rs485_pending_mux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t rs485_task_handle = NULL;
+
+// Command statistics
+static volatile uint32_t rs485_cmd_queued = 0;
+static volatile uint32_t rs485_cmd_coalesced = 0;   // Replaced or cancelled before reaching the wire
+static volatile uint32_t rs485_cmd_sent = 0;
+static volatile uint32_t rs485_cmd_failed = 0;
+static LatencyHist rs485_freq_latency_us;           // Enqueue to last byte on the wire
+static LatencyHist rs485_control_latency_us;
+
+// Shadow of the VFD control registers: last value the drive acknowledged.
+// Invalid after a failed write or when the drive comes (back) online, so the next command is always sent.
+// A failed write leaves the requested value dirty: the idle path re-sends it until the drive
+// acknowledges it or a newer command replaces it.
+typedef struct {
+    uint16_t reg;
+    bool valid;
+    uint16_t value;
+    unsigned long written_ms;
+    bool dirty;
+    uint16_t requested;
+    unsigned long attempt_ms;
+} vfd_shadow_reg_t;
+
+enum {
+    VFD_SHADOW_CONTROL = 0,     // 0xC738 run/stop word
+    VFD_SHADOW_FREQUENCY,       // 0xC739 frequency command
+    VFD_SHADOW_COUNT
+};
+
+static vfd_shadow_reg_t vfd_shadow[VFD_SHADOW_COUNT] = {
+    { VFD_REG_CONTROL, false, 0, 0, false, 0, 0 },
+    { VFD_REG_FREQUENCY, false, 0, 0, false, 0, 0 },
+};
+static_assert(VFD_REG_FREQUENCY == VFD_REG_CONTROL + 1, "Reconcile reads both shadow registers in one 0x03 request");
+static unsigned long vfd_last_reconcile_ms = 0;
+
+// Shadow statistics
+static volatile uint32_t vfd_writes_suppressed = 0;
+static volatile uint32_t vfd_keepalive_writes = 0;
+static volatile uint32_t vfd_reconcile_reads = 0;
+static volatile uint32_t vfd_reconcile_mismatches = 0;
+static volatile uint32_t vfd_retry_writes = 0;
+
+#if VFD_ADDRESS == 0x01
+// Known-good frames previously hardcoded here
+static_assert(vfd_start_frame[6] == 0xF4 && vfd_start_frame[7] == 0xB3, "Modbus CRC mismatch (start frame)");
+static_assert(vfd_stop_frame[6] == 0xF5 && vfd_stop_frame[7] == 0x70, "Modbus CRC mismatch (stop frame)");
+#endif
+
 /**
  * @brief  CRC calculation for VFD Modbus RTU
  * @param  buffer: Pointer to data buffer
  * @param  length: Length of data (excluding CRC bytes)
  * @retval 16-bit CRC value
+ * @note   Table-driven CRC-16/MODBUS, see modbus_rtu.h
  */
-uint16_t rs485_calculate_crc(uint8_t *buffer, uint16_t length) {
-    uint16_t crc = 0xFFFF;
-    uint8_t carryFlag;
-
-    for (int i = 0; i < length; i++) {
-        crc ^= buffer[i];
-        for (int j = 0; j < 8; j++) {
-            carryFlag = crc & 0x0001;
-            crc >>= 1;
-            if (carryFlag) {
-                crc ^= 0xA001;
+uint16_t rs485_calculate_crc(const uint8_t *buffer, uint16_t length) {
+    return modbus_crc16(buffer, length);
+}
+
+/**
+ * @brief  Track VFD link health from a transaction result
+ * @param  result: Result of the last Modbus transaction
+ * @retval None
+ */
+static void rs485_update_link(modbus_result_t result) {
+    if (result == MODBUS_OK || result == MODBUS_ERR_EXCEPTION) {
+        // An exception is still a valid answer from the drive
+        vfd_status.last_ok_ms = millis();
+        vfd_status.consecutive_fails = 0;
+        if (!vfd_status.online) {
+            vfd_status.online = true;
+            Serial.println("[RS485] VFD online");
+            // Drive may have been power cycled: its registers no longer match the shadow
+            for (int i = 0; i < VFD_SHADOW_COUNT; i++) {
+                vfd_shadow[i].valid = false;
             }
         }
+    } else if (vfd_status.consecutive_fails < 255) {
+        vfd_status.consecutive_fails++;
+        if (vfd_status.online && vfd_status.consecutive_fails >= VFD_OFFLINE_AFTER_FAILS) {
+            vfd_status.online = false;
+            Serial.printf("[RS485] VFD offline (%s)\n", modbus_result_name(result));
+        }
     }
-    return crc;
 }
 
-void rs485_sendModbusCommand(const uint8_t* packet, int length, const char* description) {
-    // Transmit packet using Arduino Serial2 (hardware handles DE/RE automatically)
-    Serial2.write((uint8_t*)packet, length);
-    Serial2.flush();  // Ensure transmission completes
+/**
+ * @brief  Send a Modbus write request (0x06/0x10) and validate the VFD's response
+ * @param  packet: Complete request frame including CRC
+ * @param  length: Frame length in bytes
+ * @param  description: Text for the failure log
+ * @retval true if the VFD acknowledged the write
+ */
+bool rs485_sendModbusCommand(const uint8_t* packet, int length, const char* description) {
+    // Transmit over Serial2 (hardware handles DE/RE automatically) and wait for the echo/exception
+    uint8_t exception_code = 0;
+    modbus_result_t result = modbus_master_transact(packet, length, NULL, modbus_write_response_length(), &exception_code);
+    rs485_update_link(result);
+
+    if (result != MODBUS_OK) {
+        if (result == MODBUS_ERR_EXCEPTION) {
+            Serial.printf("[RS485] %s rejected, exception 0x%02X\n", description, exception_code);
+        } else if (vfd_status.online || vfd_status.consecutive_fails == 1) {
+            Serial.printf("[RS485] %s failed: %s\n", description, modbus_result_name(result));
+        }
+        return false;
+    }
+    return true;
+}
+
+static void rs485_wake_task(void) {
+    if (rs485_task_handle != NULL) {
+        xTaskNotifyGive(rs485_task_handle);
+    }
 }
 
 /**
- * @brief  Send VFD Start command
+ * @brief  Queue VFD Start command
  * @retval None
+ * @note   Sent after a pending stop, before a pending frequency setpoint
  */
 void rs485_sendStartCommand(void) {
-    // Start command packet: {VFD_ADDRESS, 0x06, 0xC7, 0x38, 0x00, 0x01, 0xF4, 0xB3}
-    std::array<uint8_t, 8> controlPacket = {VFD_ADDRESS, 0x06, 0xC7, 0x38, 0x00, 0x01, 0xF4, 0xB3};
-    rs485_sendModbusCommand(controlPacket.data(), 8, "Start command");
+    portENTER_CRITICAL(&rs485_pending_mux);
+    rs485_pending.start = true;
+    rs485_pending.start_us = (uint32_t) micros();
+    rs485_cmd_queued++;
+    portEXIT_CRITICAL(&rs485_pending_mux);
+    rs485_wake_task();
 }
 
 /**
- * @brief  Send VFD Stop command
+ * @brief  Queue VFD Stop command
  * @retval None
+ * @note   Cancels a pending start and a pending non-zero frequency (a pending 0 Hz is still sent first)
  */
 void rs485_sendStopCommand(void) {
-    // Stop command packet: {VFD_ADDRESS, 0x06, 0xC7, 0x38, 0x00, 0x05, 0xF5, 0x70}
-    std::array<uint8_t, 8> controlPacket = {VFD_ADDRESS, 0x06, 0xC7, 0x38, 0x00, 0x05, 0xF5, 0x70};
-    rs485_sendModbusCommand(controlPacket.data(), 8, "Stop command");
+    portENTER_CRITICAL(&rs485_pending_mux);
+    if (rs485_pending.start) {
+        rs485_pending.start = false;
+        rs485_cmd_coalesced++;
+    }
+    if (rs485_pending.frequency && rs485_pending.frequency_value != 0) {
+        rs485_pending.frequency = false;
+        rs485_cmd_coalesced++;
+    }
+    if (rs485_pending.stop) {
+        rs485_cmd_coalesced++;
+    } else {
+        rs485_pending.stop_us = (uint32_t) micros();
+    }
+    rs485_pending.stop = true;
+    rs485_cmd_queued++;
+    portEXIT_CRITICAL(&rs485_pending_mux);
+    rs485_wake_task();
 }
 
 /**
- * @brief  Send VFD Frequency command
+ * @brief  Queue VFD Frequency command
  * @param  frequency_0_01hz: Target frequency in 0.01Hz units (e.g., 1000 = 10.00 Hz, 1050 = 10.50 Hz)
  * @retval None
  * @note   VFD register 51001 (0xC739) expects frequency in 0.01Hz units
  *         This provides fine-grained control (0.01Hz resolution)
+ *         Latest wins: replaces a setpoint that has not been sent yet. 0 Hz is sent before anything else.
  */
 void rs485_sendFrequencyCommand(uint16_t frequency_0_01hz) {
-    // VFD expects frequency in 0.01Hz units directly
-    // Extract frequency bytes (big-endian)
-    uint8_t F_UP_BYTE = (frequency_0_01hz >> 8) & 0xFF;
-    uint8_t F_LOW_BYTE = frequency_0_01hz & 0xFF;
-
-    // Build base packet (without CRC)
-    // Register address: 0xC739 (51001 decimal) - VFD frequency command register
-    std::array<uint8_t, 6> basePacket = {VFD_ADDRESS, 0x06, 0xC7, 0x39, F_UP_BYTE, F_LOW_BYTE};
-
-    // Calculate CRC for base packet
-    uint16_t crc = rs485_calculate_crc(basePacket.data(), 6);
-
-    // Build complete packet with CRC using memcpy for efficiency
-    std::array<uint8_t, 8> turnPacket;
-    memcpy(turnPacket.data(), basePacket.data(), 6);
-    turnPacket[6] = crc & 0xFF;        // CRC low byte
-    turnPacket[7] = (crc >> 8) & 0xFF; // CRC high byte
-
-    // Send command
-    rs485_sendModbusCommand(turnPacket.data(), 8, "Frequency command");
+    portENTER_CRITICAL(&rs485_pending_mux);
+    if (rs485_pending.frequency) {
+        rs485_cmd_coalesced++;
+    }
+    rs485_pending.frequency = true;
+    rs485_pending.frequency_value = frequency_0_01hz;
+    rs485_pending.frequency_us = (uint32_t) micros();
+    rs485_cmd_queued++;
+    portEXIT_CRITICAL(&rs485_pending_mux);
+    rs485_wake_task();
 
     // Debug print - show frequency in Hz using String for better C++ style
     #if ACTUAL_TARGET_CC_CV_debug
     float frequency_hz = frequency_0_01hz / 100.0f;
-    String msg = "Frequency command sent: " + String(frequency_0_01hz) +
+    String msg = "Frequency command queued: " + String(frequency_0_01hz) +
                  " (0.01Hz units) = " + String(frequency_hz, 2) + " Hz";
     Serial.println(msg);
     #endif
 }
 
+/**
+ * @brief  Take the next pending command in priority order: 0 Hz, stop, start, frequency
+ * @param  value: Frequency for RS485_CMD_FREQUENCY
+ * @param  enqueue_us: micros() when the command was queued
+ * @retval Command kind, RS485_CMD_NONE if nothing is pending
+ */
+static rs485_cmd_t rs485_take_next(uint16_t* value, uint32_t* enqueue_us) {
+    rs485_cmd_t cmd = RS485_CMD_NONE;
+    portENTER_CRITICAL(&rs485_pending_mux);
+    if (rs485_pending.frequency && rs485_pending.frequency_value == 0) {
+        cmd = RS485_CMD_FREQUENCY;
+    } else if (rs485_pending.stop) {
+        cmd = RS485_CMD_STOP;
+    } else if (rs485_pending.start) {
+        cmd = RS485_CMD_START;
+    } else if (rs485_pending.frequency) {
+        cmd = RS485_CMD_FREQUENCY;
+    }
+
+    if (cmd == RS485_CMD_FREQUENCY) {
+        rs485_pending.frequency = false;
+        *value = rs485_pending.frequency_value;
+        *enqueue_us = rs485_pending.frequency_us;
+    } else if (cmd == RS485_CMD_STOP) {
+        rs485_pending.stop = false;
+        *enqueue_us = rs485_pending.stop_us;
+    } else if (cmd == RS485_CMD_START) {
+        rs485_pending.start = false;
+        *enqueue_us = rs485_pending.start_us;
+    }
+    portEXIT_CRITICAL(&rs485_pending_mux);
+    return cmd;
+}
+
+/**
+ * @brief  Write a shadowed register and update its shadow from the result
+ * @note   On failure the value stays requested (dirty) for rs485_retry_dirty()
+ * @retval true if the VFD acknowledged the write
+ */
+static bool rs485_write_shadowed(vfd_shadow_reg_t* shadow, uint16_t value, const uint8_t* packet, const char* description) {
+    bool ok = rs485_sendModbusCommand(packet, 8, description);
+    unsigned long now = millis();
+    shadow->valid = ok;
+    shadow->dirty = !ok;
+    shadow->requested = value;
+    shadow->attempt_ms = now;
+    if (ok) {
+        shadow->value = value;
+        shadow->written_ms = now;
+    }
+    return ok;
+}
+
+/**
+ * @brief  Put one command on the wire (blocking, rs485_task only)
+ * @retval None
+ */
+static void rs485_execute(rs485_cmd_t cmd, uint16_t value, uint32_t enqueue_us) {
+    std::array<uint8_t, 8> packet;
+    const char* description;
+    LatencyHist* latency;
+    vfd_shadow_reg_t* shadow;
+
+    if (cmd == RS485_CMD_FREQUENCY) {
+        // Register address: 0xC739 (51001 decimal) - VFD frequency command register
+        packet = modbus_write_single(VFD_ADDRESS, VFD_REG_FREQUENCY, value);
+        description = "Frequency command";
+        latency = &rs485_freq_latency_us;
+        shadow = &vfd_shadow[VFD_SHADOW_FREQUENCY];
+    } else if (cmd == RS485_CMD_STOP) {
+        // Stop command packet: {VFD_ADDRESS, 0x06, 0xC7, 0x38, 0x00, 0x05, CRC}
+        packet = vfd_stop_frame;
+        value = VFD_CMD_STOP;
+        description = "Stop command";
+        latency = &rs485_control_latency_us;
+        shadow = &vfd_shadow[VFD_SHADOW_CONTROL];
+    } else {
+        // Start command packet: {VFD_ADDRESS, 0x06, 0xC7, 0x38, 0x00, 0x01, CRC}
+        packet = vfd_start_frame;
+        value = VFD_CMD_START;
+        description = "Start command";
+        latency = &rs485_control_latency_us;
+        shadow = &vfd_shadow[VFD_SHADOW_CONTROL];
+    }
+
+    // Delta-only: skip a setpoint the drive already holds. Start, stop and 0 Hz are always sent:
+    // the control word is neither kept alive nor reconciled, so its shadow can be stale.
+    bool safety = (cmd != RS485_CMD_FREQUENCY) || (value == 0);
+    if (!safety && shadow->valid && shadow->value == value) {
+        vfd_writes_suppressed++;
+        return;
+    }
+
+    if (rs485_write_shadowed(shadow, value, packet.data(), description)) {
+        latency->record(modbus_master_last_tx_end_us() - enqueue_us);
+        rs485_cmd_sent++;
+    } else {
+        rs485_cmd_failed++;
+    }
+}
+
 /**
  * @brief  Calculate frequency for Constant Current (CC) mode
  * @param  current_frequency: Current frequency in 0.01Hz units
@@ -234,26 +474,224 @@ uint16_t rs485_CalcFrequencyFor_CV(uint16_t current_frequency, uint16_t target_v
     return (uint16_t)new_frequency;
 }
 
+#if VFD_POLL_INTERVAL_MS > 0
+/**
+ * @brief  Read one VFD monitoring register (round robin over the ones the drive has not rejected)
+ * @retval true if a read was made
+ */
+static bool rs485_poll_vfd(void) {
+    vfd_last_poll_ms = millis();
+
+    uint8_t slot = vfd_poll_index;
+    uint8_t tried = 0;
+    while (vfd_poll_rejected[slot] && tried < VFD_POLL_COUNT) {
+        slot = (slot + 1) % VFD_POLL_COUNT;
+        tried++;
+    }
+    if (tried == VFD_POLL_COUNT) {
+        return false;  // Every register rejected
+    }
+    vfd_poll_index = (slot + 1) % VFD_POLL_COUNT;
+    uint16_t reg = vfd_poll_registers[slot];
+
+    uint16_t value = 0;
+    uint8_t exception_code = 0;
+    modbus_result_t result = modbus_master_read(VFD_ADDRESS, reg, 1, &value, &exception_code);
+    rs485_update_link(result);
+    if (result == MODBUS_ERR_EXCEPTION &&
+        (exception_code == MODBUS_EX_ILLEGAL_ADDRESS || exception_code == MODBUS_EX_ILLEGAL_FUNCTION)) {
+        vfd_poll_rejected[slot] = true;
+        Serial.printf("[RS485] Reg 0x%04X rejected by the VFD (exception 0x%02X), no longer polled\n", reg, exception_code);
+        return true;
+    }
+    if (result != MODBUS_OK) {
+        return true;
+    }
+
+    if (reg == VFD_REG_OUTPUT_FREQ) {
+        vfd_status.output_freq_0_01hz = value;
+    } else if (reg == VFD_REG_OUTPUT_CURRENT) {
+        vfd_status.output_current_raw = value;
+    } else {
+        if (value != vfd_status.fault_code && value != 0) {
+            Serial.printf("[RS485] VFD fault code 0x%04X\n", value);
+        }
+        vfd_status.fault_code = value;
+    }
+    return true;
+}
+#endif
+
+/**
+ * @brief  Re-send one shadowed register whose last write failed, at most every VFD_RETRY_MS
+ * @note   This is what makes a STOP or 0 Hz lost on the wire reach the drive: keep-alive and
+ *         reconcile only act on values the drive has acknowledged
+ * @retval true if a write was made
+ */
+static bool rs485_retry_dirty(unsigned long now) {
+    for (int i = 0; i < VFD_SHADOW_COUNT; i++) {
+        vfd_shadow_reg_t* shadow = &vfd_shadow[i];
+        if (shadow->dirty && now - shadow->attempt_ms >= VFD_RETRY_MS) {
+            std::array<uint8_t, 8> packet = modbus_write_single(VFD_ADDRESS, shadow->reg, shadow->requested);
+            if (rs485_write_shadowed(shadow, shadow->requested, packet.data(), "Retry")) {
+                Serial.printf("[RS485] Reg 0x%04X = %u acknowledged on retry\n", shadow->reg, shadow->value);
+            }
+            vfd_retry_writes++;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief  Keep-alive: rewrite one shadowed register that has not been written for VFD_KEEPALIVE_MS
+ * @note   The control word is skipped like in reconcile: re-sending START would restart a drive
+ *         that has tripped or stopped on its own
+ * @retval true if a write was made
+ */
+static bool rs485_keepalive(unsigned long now) {
+#if VFD_KEEPALIVE_MS > 0
+    for (int i = 0; i < VFD_SHADOW_COUNT; i++) {
+        vfd_shadow_reg_t* shadow = &vfd_shadow[i];
+        if (i == VFD_SHADOW_CONTROL && !VFD_RECONCILE_CONTROL_WORD) {
+            continue;
+        }
+        if (shadow->valid && now - shadow->written_ms >= VFD_KEEPALIVE_MS) {
+            std::array<uint8_t, 8> packet = modbus_write_single(VFD_ADDRESS, shadow->reg, shadow->value);
+            rs485_write_shadowed(shadow, shadow->value, packet.data(), "Keep-alive");
+            vfd_keepalive_writes++;
+            return true;
+        }
+    }
+#endif
+    return false;
+}
+
+/**
+ * @brief  Read back the control registers and re-assert the shadow where the drive differs
+ * @retval None
+ */
+static void rs485_reconcile(void) {
+    vfd_last_reconcile_ms = millis();
+    uint16_t values[VFD_SHADOW_COUNT] = {0};
+    modbus_result_t result = modbus_master_read(VFD_ADDRESS, VFD_REG_CONTROL, VFD_SHADOW_COUNT, values, NULL);
+    rs485_update_link(result);
+    if (result != MODBUS_OK) {
+        return;
+    }
+    vfd_reconcile_reads++;
+
+    for (int i = 0; i < VFD_SHADOW_COUNT; i++) {
+        vfd_shadow_reg_t* shadow = &vfd_shadow[i];
+        if (!shadow->valid || values[i] == shadow->value) {
+            continue;
+        }
+        if (i == VFD_SHADOW_CONTROL && !VFD_RECONCILE_CONTROL_WORD) {
+            continue;
+        }
+        vfd_reconcile_mismatches++;
+        Serial.printf("[RS485] Reg 0x%04X reads %u, expected %u - rewriting\n", shadow->reg, values[i], shadow->value);
+        std::array<uint8_t, 8> packet = modbus_write_single(VFD_ADDRESS, shadow->reg, shadow->value);
+        rs485_write_shadowed(shadow, shadow->value, packet.data(), "Reconcile");
+    }
+}
+
+/**
+ * @brief  RS485 worker task (RTOS). Owns Serial2: sends queued commands as soon as they arrive,
+ *         and a monitoring read every VFD_POLL_INTERVAL_MS (if enabled) when no command is pending.
+ * @param  parameter: Unused
+ * @retval None
+ */
+void rs485_task(void* parameter) {
+    rs485_task_handle = xTaskGetCurrentTaskHandle();
+
+    while (true) {
+        // Commands first (also picks up anything queued before this task started)
+        uint16_t value = 0;
+        uint32_t enqueue_us = 0;
+        rs485_cmd_t cmd;
+        while ((cmd = rs485_take_next(&value, &enqueue_us)) != RS485_CMD_NONE) {
+            rs485_execute(cmd, value, enqueue_us);
+        }
+
+        // Background work, one transaction per pass so new commands are picked up in between
+        unsigned long now = millis();
+        if (rs485_retry_dirty(now)) {
+            continue;
+        }
+        if (rs485_keepalive(now)) {
+            continue;
+        }
+        if (now - vfd_last_reconcile_ms >= VFD_RECONCILE_MS) {
+            rs485_reconcile();
+            continue;
+        }
+        unsigned long wait_ms = VFD_IDLE_WAKE_MS;
+        for (int i = 0; i < VFD_SHADOW_COUNT; i++) {
+            if (vfd_shadow[i].dirty && VFD_RETRY_MS - (now - vfd_shadow[i].attempt_ms) < wait_ms) {
+                wait_ms = VFD_RETRY_MS - (now - vfd_shadow[i].attempt_ms);
+            }
+        }
+#if VFD_POLL_INTERVAL_MS > 0
+        unsigned long since_poll = now - vfd_last_poll_ms;
+        if (since_poll >= VFD_POLL_INTERVAL_MS) {
+            if (rs485_poll_vfd()) {
+                continue;  // Re-check commands queued during the read
+            }
+        } else if (VFD_POLL_INTERVAL_MS - since_poll < wait_ms) {
+            wait_ms = VFD_POLL_INTERVAL_MS - since_poll;
+        }
+#endif
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
+    }
+}
+
+/**
+ * @brief  Latest VFD state read back over Modbus
+ * @retval Copy of the status
+ */
+vfd_status_t rs485_get_vfd_status(void) {
+    return vfd_status;
+}
+
+/**
+ * @brief  Print VFD status and Modbus master statistics over Serial
+ * @retval None
+ */
+void rs485_dump_stats(void) {
+    Serial.printf("[RS485] VFD %s: out_freq=%u (0.01Hz) out_current=%u fault=0x%04X last_ok=%lu ms ago\n",
+                  vfd_status.online ? "online" : "offline", vfd_status.output_freq_0_01hz,
+                  vfd_status.output_current_raw, vfd_status.fault_code,
+                  vfd_status.last_ok_ms ? (unsigned long)(millis() - vfd_status.last_ok_ms) : 0UL);
+    Serial.printf("[RS485] Commands queued=%u coalesced=%u sent=%u failed=%u\n",
+                  rs485_cmd_queued, rs485_cmd_coalesced, rs485_cmd_sent, rs485_cmd_failed);
+    Serial.printf("[RS485] Shadow writes suppressed=%u keepalive=%u retries=%u reconcile reads=%u mismatches=%u\n",
+                  vfd_writes_suppressed, vfd_keepalive_writes, vfd_retry_writes, vfd_reconcile_reads,
+                  vfd_reconcile_mismatches);
+    rs485_freq_latency_us.print("RS485", "Frequency queue-to-wire", "us");
+    rs485_control_latency_us.print("RS485", "Start/stop queue-to-wire", "us");
+    modbus_master_dump_stats();
+}
+
 /**
- * @brief  Initialize RS485 interface for Arduino (TX only, hardware DE/RE)
+ * @brief  Initialize RS485 interface for Arduino (Modbus master, hardware DE/RE)
  * @retval None
  */
 void rs485_init(void) {
-    // Initialize Serial2 for RS485 communication
-    Serial2.begin(RS485_BAUD_RATE, SERIAL_8N1, RS485_RX, RS485_TX);
+    // Initialize Serial2 for RS485 communication, responses framed by UART RX timeout
+    modbus_master_init(&Serial2, RS485_BAUD_RATE, RS485_RX, RS485_TX);
 
     // Small delay for initialization
     delay(90);
-    //send a stop command to the vfd
+    //queue a stop command to the vfd (sent first thing by rs485_task)
     rs485_sendStopCommand();
-    delay(10);
 
-    // Send startup message on RS485 bus
+    // Send startup message on RS485 bus (before rs485_task owns the UART)
     const char* startup_msg = "hello from touchUI 5 inch";
     Serial2.print(startup_msg);
     Serial2.flush();
 
-    Serial.println("RS485 interface initialized (TX only), Stop cmd sent to vfd ");
+    Serial.println("RS485 interface initialized (Modbus master), Stop cmd queued for vfd ");
     Serial.print("TX Pin: ");
     Serial.print(RS485_TX);
     Serial.print(", RX Pin: ");
@@ -12,7 +12,45 @@
 
 /* RS485 Modbus Configuration */
 #define VFD_ADDRESS 0x01
-#define RS485_BAUD_RATE 9600
+#define RS485_BAUD_RATE 9600    // 9600, 19200 or 38400 - must match the VFD's comms setting
+
+/* RS485 worker task: owns the UART, sends queued VFD commands and the monitoring reads */
+#define RS485_TASK_STACK_SIZE   4096
+#define RS485_TASK_PRIORITY     4       // Below CAN (5), above LVGL (2) and loop() (1)
+#define RS485_TASK_CORE         1
+
+/* VFD registers and control words */
+#define VFD_REG_CONTROL     0xC738  // 51000: run/stop control word
+#define VFD_REG_FREQUENCY   0xC739  // 51001: frequency command, 0.01Hz units
+#define VFD_CMD_START       0x0001
+#define VFD_CMD_STOP        0x0005
+
+/* VFD monitoring registers (read back with 0x03), from the drive's monitoring/fault register table:
+   check them against the manual of the drive actually fitted. A register the drive rejects as an
+   illegal address or function is dropped from the poll. A non-zero fault code, or the link going
+   offline, stops a charge (charge_controller.h, CHARGE_STOP_VFD_FAULT). */
+#define VFD_REG_OUTPUT_FREQ     0x3000  // Actual output frequency, 0.01Hz
+#define VFD_REG_OUTPUT_CURRENT  0x3004  // Output current (drive units, typically 0.1A)
+#define VFD_REG_FAULT_CODE      0x8000  // Current fault code, 0 = no fault
+#define VFD_POLL_INTERVAL_MS    1000    // One monitoring read per interval, round robin over the registers above, 0 = off
+#define VFD_IDLE_WAKE_MS        300     // rs485_task wakes this often for keep-alive and reconcile when idle
+#define VFD_OFFLINE_AFTER_FAILS 3       // Consecutive failed transactions before the VFD is reported offline
+
+/* Shadow of the VFD control registers (0xC738/0xC739): repeated frequency writes are suppressed */
+#define VFD_KEEPALIVE_MS        2000    // Rewrite the frequency register at least this often (comms watchdog), 0 = off
+#define VFD_RECONCILE_MS        5000    // Read back 0xC738/0xC739 and re-assert the shadow on mismatch
+#define VFD_RETRY_MS            200     // Re-send a write the drive did not acknowledge (stop, 0 Hz, ...) this often
+#define VFD_RECONCILE_CONTROL_WORD 0    // 1 = also compare and keep alive 0xC738 (only if the drive reads back the written word)
+
+/* VFD state read back over Modbus */
+typedef struct {
+    uint16_t output_freq_0_01hz;
+    uint16_t output_current_raw;
+    uint16_t fault_code;
+    unsigned long last_ok_ms;           // millis() of the last successful transaction
+    uint8_t consecutive_fails;
+    bool online;
+} vfd_status_t;
 
 /* Frequency to RPM conversion (adjust for different VFDs) */
 /* 1Hz = 20 RPM for your VFD (change this value for other VFDs: 15, 25, 30, etc.) */
@@ -54,12 +92,17 @@
 #define RS485_MIN(a, b) ((a) < (b) ? (a) : (b))
 
 /* Function declarations */
-uint16_t rs485_calculate_crc(uint8_t *buffer, uint16_t length);
-void rs485_sendModbusCommand(const uint8_t* packet, int length, const char* description);
+uint16_t rs485_calculate_crc(const uint8_t *buffer, uint16_t length);
+bool rs485_sendModbusCommand(const uint8_t* packet, int length, const char* description);  // Write + validated response
+/* VFD commands: non-blocking, queued for rs485_task. Frequency setpoints coalesce (latest wins);
+   0 Hz and stop pre-empt pending start/frequency commands. */
 void rs485_sendStartCommand(void);
 void rs485_sendStopCommand(void);
 void rs485_sendFrequencyCommand(uint16_t frequency_0_01hz);  // frequency in 0.01Hz units
 void rs485_init(void);
+void rs485_task(void* parameter);         // Sends queued commands, then VFD monitoring reads when idle
+vfd_status_t rs485_get_vfd_status(void);
+void rs485_dump_stats(void);
 
 /* Frequency calculation functions (PID-like proportional control) */
 uint16_t rs485_CalcFrequencyFor_CC(uint16_t current_frequency, uint16_t target_current, uint16_t actual_current);
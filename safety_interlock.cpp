@@ -0,0 +1,172 @@
+#include "safety_interlock.h"
+#include "can_twai.h"
+#include "rs485_vfdComs.h"
+#include "charge_control.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Armed limits and trip state (CAN task reads, control task arms/disarms)
+static portMUX_TYPE interlock_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool interlock_armed = false;
+static interlock_limits_t interlock_limits;
+static volatile interlock_cause_t interlock_cause = INTERLOCK_OK;
+
+// Last trip, reported from loop()
+static uint32_t interlock_trip_rx_us = 0;
+static uint32_t interlock_trip_queue_us = 0;
+static float interlock_trip_value = 0.0f;
+static volatile bool interlock_trip_reported = true;
+static can_tx_completion_t interlock_open_done;     // Contactor-open frame handed to the controller
+static volatile bool interlock_open_waiting = false;
+static volatile bool interlock_open_queued = true;   // False: held slot busy with another ID, frame not queued
+
+// Statistics
+static LatencyHist interlock_queue_us;              // Frame -> contactor open and 0 Hz queued
+static LatencyHist interlock_bus_us;                // Frame -> contactor open handed to the CAN controller
+static uint32_t interlock_trips = 0;
+
+static const char* interlock_cause_name(interlock_cause_t cause) {
+    switch (cause) {
+        case INTERLOCK_OVER_VOLT: return "over-voltage";
+        case INTERLOCK_OVER_CURR: return "over-current";
+        case INTERLOCK_OVER_TEMP: return "over-temperature";
+        default:                  return "none";
+    }
+}
+
+void safety_interlock_init(void) {
+    can_tx_completion_init(&interlock_open_done);
+}
+
+void safety_interlock_arm(float cutoff_voltage, float const_current) {
+    interlock_limits_t limits;
+    limits.max_volt = SAFETY_INTERLOCK_MAX_VOLT;
+    limits.max_curr = SAFETY_INTERLOCK_MAX_CURR;
+    limits.max_temp = SAFETY_INTERLOCK_MAX_TEMP;
+    float profile_volt = cutoff_voltage * SAFETY_INTERLOCK_VOLT_MARGIN;
+    float profile_curr = const_current * SAFETY_INTERLOCK_CURR_MARGIN;
+    if (profile_volt > 0.0f && profile_volt < limits.max_volt) {
+        limits.max_volt = profile_volt;
+    }
+    if (profile_curr > 0.0f && profile_curr < limits.max_curr) {
+        limits.max_curr = profile_curr;
+    }
+
+    portENTER_CRITICAL(&interlock_mux);
+    interlock_limits = limits;
+    interlock_cause = INTERLOCK_OK;
+    interlock_armed = SAFETY_INTERLOCK_ENABLE;
+    portEXIT_CRITICAL(&interlock_mux);
+}
+
+void safety_interlock_disarm(void) {
+    portENTER_CRITICAL(&interlock_mux);
+    interlock_armed = false;
+    portEXIT_CRITICAL(&interlock_mux);
+}
+
+interlock_cause_t safety_interlock_tripped(void) {
+    return interlock_cause;
+}
+
+// First breach since arm: disarm, then contactor open (urgent CAN) and 0 Hz (pre-empts the RS485 queue)
+static void interlock_trip(interlock_cause_t cause, float value, uint32_t rx_us) {
+    portENTER_CRITICAL(&interlock_mux);
+    bool armed = interlock_armed;
+    interlock_armed = false;
+    if (armed) {
+        interlock_cause = cause;
+    }
+    portEXIT_CRITICAL(&interlock_mux);
+    if (!armed) {
+        return;
+    }
+
+    // The completion is reused: a trip before loop() collected the previous one goes without it
+    can_tx_completion_t* completion = interlock_open_waiting ? NULL : &interlock_open_done;
+    uint8_t data[8] = {0};
+    data[0] = M1_NODE_ID;
+    data[1] = CONTACTOR_OPEN;
+    bool queued = can_tx_enqueue(CONTACTOR_CONTROL_ID, data, 8, CAN_TX_URGENT, completion);
+    rs485_sendFrequencyCommand(0);
+    interlock_trip_queue_us = (uint32_t) micros() - rx_us;
+    interlock_queue_us.record(interlock_trip_queue_us);
+
+    interlock_trip_rx_us = rx_us;
+    interlock_trip_value = value;
+    interlock_trips++;
+    if (queued && completion != NULL) {
+        interlock_open_waiting = true;
+    }
+    interlock_open_queued = queued;
+    interlock_trip_reported = false;
+
+    charge_control_notify_sample();  // Stop rules see the trip on this sample
+}
+
+void safety_interlock_check_vi(float volt, float curr, uint32_t rx_us) {
+    if (!interlock_armed) {
+        return;
+    }
+    portENTER_CRITICAL(&interlock_mux);
+    const interlock_limits_t limits = interlock_limits;
+    portEXIT_CRITICAL(&interlock_mux);
+    if (volt > limits.max_volt) {
+        interlock_trip(INTERLOCK_OVER_VOLT, volt, rx_us);
+    } else if (curr > limits.max_curr) {
+        interlock_trip(INTERLOCK_OVER_CURR, curr, rx_us);
+    }
+}
+
+void safety_interlock_check_temps(int32_t temp1, int32_t temp2, uint32_t rx_us) {
+    if (!interlock_armed) {
+        return;
+    }
+    portENTER_CRITICAL(&interlock_mux);
+    const int32_t max_temp = interlock_limits.max_temp;
+    portEXIT_CRITICAL(&interlock_mux);
+    if (temp1 > max_temp || temp2 > max_temp) {
+        interlock_trip(INTERLOCK_OVER_TEMP, (temp1 > temp2 ? temp1 : temp2) / 100.0f, rx_us);
+    }
+}
+
+void safety_interlock_service(void) {
+    if (interlock_open_waiting) {
+        esp_err_t result;
+        if (can_tx_completion_wait(&interlock_open_done, 0, &result)) {
+            if (result == ESP_OK) {
+                interlock_bus_us.record(interlock_open_done.done_us - interlock_trip_rx_us);
+                Serial.printf("[INTERLOCK] Contactor open on the bus %lu us after the frame\n",
+                              (unsigned long)(interlock_open_done.done_us - interlock_trip_rx_us));
+            } else {
+                Serial.printf("[INTERLOCK] Contactor open frame failed: %s\n", esp_err_to_name(result));
+            }
+            interlock_open_waiting = false;
+        }
+    }
+
+    if (!interlock_trip_reported) {
+        interlock_trip_reported = true;
+        if (!interlock_open_queued) {
+            Serial.println("[INTERLOCK] Contactor open frame could not be queued, 0 Hz only");
+        }
+        Serial.printf("[INTERLOCK] Tripped: %s (%.2f), contactor open and 0 Hz queued %lu us after the frame\n",
+                      interlock_cause_name(interlock_cause), interlock_trip_value,
+                      (unsigned long) interlock_trip_queue_us);
+    }
+}
+
+void safety_interlock_dump_stats(void) {
+    interlock_limits_t limits;
+    portENTER_CRITICAL(&interlock_mux);
+    limits = interlock_limits;
+    bool armed = interlock_armed;
+    portEXIT_CRITICAL(&interlock_mux);
+
+    Serial.printf("[INTERLOCK] ===== Safety interlock (%s) =====\n", SAFETY_INTERLOCK_ENABLE ? "enabled" : "disabled");
+    Serial.printf("[INTERLOCK] Armed: %s, limits %.2f V, %.2f A, %.2f C\n", armed ? "yes" : "no",
+                  limits.max_volt, limits.max_curr, limits.max_temp / 100.0f);
+    Serial.printf("[INTERLOCK] Trips: %u, last cause: %s\n", interlock_trips, interlock_cause_name(interlock_cause));
+    interlock_queue_us.print("INTERLOCK", "Frame to commands queued", "us");
+    interlock_bus_us.print("INTERLOCK", "Frame to contactor open on the bus", "us");
+}
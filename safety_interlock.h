@@ -0,0 +1,65 @@
+#ifndef SAFETY_INTERLOCK_H
+#define SAFETY_INTERLOCK_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "latency_hist.h"
+
+// ============================================================================
+// Hard-limit safety interlock in the CAN receive path
+// ============================================================================
+/*
+Checked by the CAN task as each 0x101 (volts/amps) and 0x102 (temperatures) frame is
+decoded, before the charging FSM sees the sample. While armed (contactor closed for a
+charge), a value over its hard limit trips the interlock once: the contactor-open frame
+goes on the urgent CAN queue (ahead of all routine traffic) and a 0 Hz command is queued
+for the RS485 task (0 Hz pre-empts every other VFD command). Nothing on this path blocks,
+prints or takes the charge control lock.
+
+The trip is latched until the next arm. The control task is woken by the same frame and
+stops the charge through the controller's stop rules (the sample carries the trip cause),
+and the VFD adapter holds the frequency at 0 Hz while tripped, so a control period racing
+the trip cannot replace the queued 0 Hz.
+
+Limits are set on arm: the absolute limits below, tightened to the charge profile (cutoff
+voltage and const current times a margin).
+
+Latency from taking the frame off the RX queue to (a) both commands queued and (b) the
+contactor-open frame handed to the CAN controller is kept in two histograms, collected by
+safety_interlock_service() from loop() and printed by safety_interlock_dump_stats()
+(serial command "interlock").
+*/
+
+#define SAFETY_INTERLOCK_ENABLE         1
+#define SAFETY_INTERLOCK_MAX_VOLT       62.0f   // V, absolute (above every profile cutoff)
+#define SAFETY_INTERLOCK_MAX_CURR       200.0f  // A, absolute
+#define SAFETY_INTERLOCK_MAX_TEMP       8000    // 0.01 °C, motor/generator (= MAX_TEMP_THRESHOLD)
+#define SAFETY_INTERLOCK_VOLT_MARGIN    1.10f   // Profile limit: cutoff voltage * margin
+#define SAFETY_INTERLOCK_CURR_MARGIN    1.50f   // Profile limit: const current * margin
+
+typedef enum {
+    INTERLOCK_OK = 0,
+    INTERLOCK_OVER_VOLT,
+    INTERLOCK_OVER_CURR,
+    INTERLOCK_OVER_TEMP
+} interlock_cause_t;
+
+typedef struct {
+    float max_volt;                 // V
+    float max_curr;                 // A
+    int32_t max_temp;               // 0.01 °C, temp1 and temp2
+} interlock_limits_t;
+
+void safety_interlock_init(void);   // setup(), before the CAN task starts
+void safety_interlock_arm(float cutoff_voltage, float const_current);  // Contactor closing for a charge
+void safety_interlock_disarm(void); // Contactor opening (trip cause stays latched)
+
+// CAN task, frame decode. rx_us: micros() when the frame was taken off the RX queue
+void safety_interlock_check_vi(float volt, float curr, uint32_t rx_us);
+void safety_interlock_check_temps(int32_t temp1, int32_t temp2, uint32_t rx_us);
+
+interlock_cause_t safety_interlock_tripped(void);   // INTERLOCK_OK unless tripped since the last arm
+void safety_interlock_service(void);                // loop(): trip report and bus latency
+void safety_interlock_dump_stats(void);
+
+#endif // SAFETY_INTERLOCK_H
@@ -0,0 +1,106 @@
+#include "sat_detector.h"
+#include <math.h>
+#include <string.h>
+
+void sat_detector_init(sat_detector_t* det, uint32_t window_ms, uint32_t sample_ms, float threshold_mv_per_min) {
+    memset(det, 0, sizeof(*det));
+    det->sample_ms = (sample_ms > 0) ? sample_ms : 1;
+    uint32_t points = window_ms / det->sample_ms;
+    det->points = (uint16_t)((points < 3) ? 3 : (points > SAT_DETECTOR_MAX_POINTS) ? SAT_DETECTOR_MAX_POINTS : points);
+    det->threshold_mv_per_min = threshold_mv_per_min;
+}
+
+void sat_detector_reset(sat_detector_t* det, uint32_t now_ms) {
+    det->bucket_start_ms = now_ms;
+    det->bucket_sum_mv = 0;
+    det->bucket_count = 0;
+    det->head = 0;
+    det->filled = 0;
+    det->buckets = 0;
+    det->sum_y = 0;
+    det->sum_yy = 0;
+    det->sum_ky = 0;
+    det->slope_mv_per_min = 0.0f;
+    det->sigma_mv_per_min = 0.0f;
+    det->fitted_mv = 0.0f;
+    det->saturated = false;
+}
+
+void sat_detector_resync(sat_detector_t* det, uint32_t now_ms) {
+    det->bucket_start_ms = now_ms;
+    det->bucket_sum_mv = 0;
+    det->bucket_count = 0;
+}
+
+// Least-squares line through the full window (x = bucket index, oldest = 0)
+static void sat_detector_fit(sat_detector_t* det) {
+    const int64_t n = det->points;
+    const int64_t sum_k = n * (n - 1) / 2;
+    const int64_t sum_kk = (n - 1) * n * (2 * n - 1) / 6;
+    const int64_t d_kk = n * sum_kk - sum_k * sum_k;           // n * centred sum of k^2
+    const int64_t d_ky = n * det->sum_ky - sum_k * det->sum_y; // n * centred sum of k*y (exact)
+    const int64_t d_yy = n * det->sum_yy - det->sum_y * det->sum_y;
+
+    double slope = (double) d_ky / (double) d_kk;              // mV per bucket
+    double sse = ((double) d_yy - (double) d_ky * (double) d_ky / (double) d_kk) / (double) n;
+    if (sse < 0.0) {
+        sse = 0.0;
+    }
+    double sigma = sqrt(sse / (double)(n - 2) * (double) n / (double) d_kk);
+    double intercept = ((double) det->sum_y - slope * (double) sum_k) / (double) n;
+
+    const float per_min = 60000.0f / (float) det->sample_ms;
+    det->slope_mv_per_min = (float) slope * per_min;
+    det->sigma_mv_per_min = (float) sigma * per_min;
+    det->fitted_mv = (float)(intercept + slope * (double)(n - 1));
+    det->saturated = det->slope_mv_per_min + SAT_DETECTOR_SIGMA * det->sigma_mv_per_min < det->threshold_mv_per_min;
+}
+
+static void sat_detector_push(sat_detector_t* det, int32_t y) {
+    const int64_t y64 = y;
+    det->buckets++;
+    if (det->filled < det->points) {
+        det->ring_mv[(det->head + det->filled) % det->points] = y;
+        det->sum_ky += (int64_t) det->filled * y64;
+        det->sum_y += y64;
+        det->sum_yy += y64 * y64;
+        det->filled++;
+    } else {
+        // Slide: every index drops by one, the new bucket takes index N-1
+        const int64_t y0 = det->ring_mv[det->head];
+        det->sum_ky += -(det->sum_y - y0) + (int64_t)(det->points - 1) * y64;
+        det->sum_y += y64 - y0;
+        det->sum_yy += y64 * y64 - y0 * y0;
+        det->ring_mv[det->head] = y;
+        det->head = (uint16_t)((det->head + 1) % det->points);
+    }
+    if (det->filled == det->points) {
+        sat_detector_fit(det);
+    }
+}
+
+bool sat_detector_add(sat_detector_t* det, float volt, uint32_t now_ms) {
+    det->bucket_sum_mv += (int32_t)(volt * 1000.0f + 0.5f);
+    det->bucket_count++;
+    if (now_ms - det->bucket_start_ms < det->sample_ms) {
+        return false;
+    }
+
+    int32_t mean_mv = (det->bucket_sum_mv + det->bucket_count / 2) / det->bucket_count;
+    det->bucket_sum_mv = 0;
+    det->bucket_count = 0;
+    det->bucket_start_ms += det->sample_ms;
+    if (now_ms - det->bucket_start_ms >= det->sample_ms) {
+        det->bucket_start_ms = now_ms;  // Stalled: restart the bucket grid rather than emit empty buckets
+    }
+    sat_detector_push(det, mean_mv);
+    return true;
+}
+
+bool sat_detector_saturated(const sat_detector_t* det) {
+    return det->filled == det->points && det->saturated;
+}
+
+float sat_detector_voltage(const sat_detector_t* det) {
+    return det->fitted_mv / 1000.0f;
+}
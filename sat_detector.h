@@ -0,0 +1,68 @@
+#ifndef SAT_DETECTOR_H
+#define SAT_DETECTOR_H
+
+#include <stdint.h>
+
+// ============================================================================
+// Voltage-saturation detector: sliding-window least-squares dV/dt
+// ============================================================================
+/*
+The CC voltage stream is averaged into buckets of sample_ms (boxcar, integer mV) and
+the last N = window_ms / sample_ms bucket means are kept in a ring. A least-squares
+line through them gives dV/dt. Every accumulator is an exact integer and a slide is O(1):
+
+  S  = sum(y_k)       Q = sum(y_k^2)       T = sum(k * y_k),  k = 0..N-1 oldest first
+  slide (drop y_0, append y_new at N-1):
+     T' = T - (S - y_0) + (N-1) * y_new,   S' = S - y_0 + y_new,   Q' = Q - y_0^2 + y_new^2
+
+sum(k) and sum(k^2) are constants of N, so slope and residual need no per-point pass:
+  slope = (N*T - Sk*S) / (N*Skk - Sk^2)  per bucket, residual variance from Q, S and T.
+
+Saturation is declared as soon as the window is full and the slope is confidently
+below the threshold: slope + SAT_DETECTOR_SIGMA * standard error < threshold. A single
+noisy sample moves one bucket mean by 1/(samples per bucket) of its error and the fit by
+far less, so it can neither trigger nor mask the detection on its own.
+
+Plain struct, no allocation: the controller owns one and the session checkpoint copies
+it. After a resume the window is kept and sat_detector_resync() restarts the bucket grid
+on the new clock.
+*/
+
+#define SAT_DETECTOR_MAX_POINTS     120     // Ring size: upper bound on window_ms / sample_ms
+#define SAT_DETECTOR_SIGMA          2.0f    // Confidence: slope + 2 standard errors below threshold
+
+typedef struct {
+    // Configuration
+    uint32_t sample_ms;             // Bucket length
+    uint16_t points;                // N, buckets in the window
+    float threshold_mv_per_min;
+
+    // Current bucket
+    uint32_t bucket_start_ms;
+    int32_t bucket_sum_mv;
+    uint16_t bucket_count;
+
+    // Window
+    int32_t ring_mv[SAT_DETECTOR_MAX_POINTS];
+    uint16_t head;                  // Oldest bucket
+    uint16_t filled;
+    uint32_t buckets;               // Completed since reset
+    int64_t sum_y;                  // S
+    int64_t sum_yy;                 // Q
+    int64_t sum_ky;                 // T
+
+    // Last fit (updated when a bucket completes)
+    float slope_mv_per_min;
+    float sigma_mv_per_min;
+    float fitted_mv;                // Fitted voltage at the newest bucket
+    bool saturated;
+} sat_detector_t;
+
+void sat_detector_init(sat_detector_t* det, uint32_t window_ms, uint32_t sample_ms, float threshold_mv_per_min);
+void sat_detector_reset(sat_detector_t* det, uint32_t now_ms);      // Empty window, keep configuration
+void sat_detector_resync(sat_detector_t* det, uint32_t now_ms);     // Drop the partial bucket, keep the window (new clock)
+bool sat_detector_add(sat_detector_t* det, float volt, uint32_t now_ms);  // True when a bucket completed
+bool sat_detector_saturated(const sat_detector_t* det);
+float sat_detector_voltage(const sat_detector_t* det);                // Fitted voltage (V) at the window end
+
+#endif // SAT_DETECTOR_H
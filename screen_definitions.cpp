@@ -10,34 +10,17 @@
 #include "arjunsJapFont/arjunsJapFont_28.c"
 #include "arjunsJapFont/arjunsJapFont_30.c"
 #include "can_twai.h"
+#include "can_stats.h"
 #include "sd_logging.h"
 #include "esp_panel_board_custom_conf.h"
 #include "lvgl_v8_port.h"
 #include "rs485_vfdComs.h"
+#include "charge_control.h"
+#include "charge_session.h"
 #include <Arduino.h>
 #include <string.h>
 #include <esp_heap_caps.h>
-
-// External sensor data
-extern struct sensor_data {
-    float volt;
-    float curr;
-    int32_t temp1;
-    int32_t temp2;
-    int32_t temp3;
-    int32_t temp4;
-} sensorData;
-
-// External time data from M2
-extern struct time_from_m2 {
-    uint16_t year;
-    uint8_t month;
-    uint8_t date;
-    uint8_t day_of_week;  // Note: 1=Sunday in M2, will convert to 1=Monday for display
-    uint8_t hour;
-    uint8_t minute;
-    uint8_t second;
-} m2Time;
+#include "sensor_snapshot.h"  // sensorData / m2Time (loop-task copies); m2Time.day_of_week: 1=Sunday in M2, converted to 1=Monday for display
 
 // ============================================================================
 // Global UI Variables
@@ -74,23 +57,9 @@ static lv_obj_t* screen5_temp_label = nullptr;
 static lv_obj_t* screen8_battery_details_label = nullptr;
 static lv_obj_t* screen8_temp_label = nullptr;
 
-// Timer variables for charging screens
-static unsigned long charging_start_time = 0;  // When charging started (screen 3)
-static unsigned long cv_start_time = 0;        // When CV state started (screen 5)
-static unsigned long cc_state_duration_for_timer = 0;  // CC state duration for remaining time calc
-static unsigned long precharge_duration_for_timer = 0;  // Precharge duration (set at precharge->CC transition) for CV time calc
-static unsigned long final_charging_time_ms = 0;  // Final charging time when complete (stops updating)
-static unsigned long final_remaining_time_ms = 0;  // Final remaining time when complete (stops updating)
-static bool charging_complete = false;  // Flag to stop timer updates after completion
-static bool pending_stop_command = false;  // Flag to send stop command after screen loads
-static bool current_flow_start = false;  // True after current >= 1.1 A in step 1; used for disconnect and timeout
-
-// Ah calculation variables
-static float accumulated_ah = 0.0f;  // Accumulated Ah (default 0.0)
-static unsigned long last_ah_update_time = 0;  // Last time Ah was updated (for rate limiting)
 static unsigned long last_rtc_update_time = 0;  // Last time RTC time was updated (for rate limiting, 2Hz = 500ms)
 
-// Charge log record (filled at start, updated during charge, completed at stop)
+// Charge log record (filled at start, completed from the controller's result)
 static charge_log_record_t current_charge_log;
 
 // Log number for SD card display
@@ -152,28 +121,10 @@ static lv_obj_t* screen18_rtc_time_label = nullptr;
 
 // Current screen and state tracking
 screen_id_t current_screen_id = SCREEN_HOME;
-app_state_t current_app_state = STATE_HOME;
-charge_stop_reason_t charge_stop_reason = CHARGE_STOP_NONE;
 
 // State-based screen switching triggers
 bool battery_detected = false;
 
-// ============================================================================
-// Charging Control Globals
-// ============================================================================
-static uint16_t current_frequency = 0;                // Current motor frequency in 0.01Hz units (0 = stopped)
-static unsigned long last_control_update = 0;         // Rate limiting for charging control
-static unsigned long cc_state_start_time = 0;         // Time when CC state started (millis)
-static unsigned long cv_state_start_time = 0;         // Time when CV state started (millis)
-static unsigned long cc_state_duration = 0;           // Duration spent in CC state (millis)
-
-// Voltage saturation detection variables (3kW)
-static float base_volt_satu_ref = 0.0f;              // Base voltage reference when entering CC stage
-static float present_volt_satu_check = 0.0f;         // Present voltage for saturation check
-static unsigned long last_voltage_saturation_check_time = 0;  // Last time voltage saturation was checked
-static float voltage_saturation_detected_voltage = 0.0f;      // Voltage when saturation was detected
-static unsigned long voltage_saturation_cv_start_time = 0;   // CV start time for screen 8 state
-
 // M2 heartbeat: frame 101 based (check every 1s after 6s grace; if no 101 for 2100ms -> lost)
 static bool m2_connection_lost = false;
 
@@ -184,8 +135,6 @@ void displayMatchingBatteryProfiles(float detectedVoltage, lv_obj_t* container);
 void emergency_stop_event_handler(lv_event_t * e);
 // Forward declaration for home button handler
 void home_button_event_handler(lv_event_t * e);
-// Forward declaration for Ah update function
-void update_accumulated_ah(void);
 
 // ============================================================================
 // Screen Management Functions
@@ -269,19 +218,10 @@ void switch_to_screen(screen_id_t screen_id) {
     if (target_screen != nullptr) {
         // On first entry to M2 lost screen only: 0 rpm, stop motor, open contactor (once)
         if (screen_id == SCREEN_M2_LOST && current_screen_id != SCREEN_M2_LOST) {
-            rs485_sendFrequencyCommand(0);
-            delay(5);
-            Serial.println("[M2] 0 rpm sent");
-            rs485_sendStopCommand();
-            delay(5);
-            Serial.println("[M2] Stop motor sent");
-            send_contactor_control(CONTACTOR_OPEN);
-            Serial.println("[M2] Contactor open sent");
-            // Stop charging FSM and clear flags so motor never restarts while on screen 18
-            current_app_state = STATE_EMERGENCY_STOP;
-            charging_complete = true;
-            current_flow_start = false;
-            pending_stop_command = false;
+            // Park the charging FSM so the motor never restarts while on screen 18
+            charge_control_lock();
+            charge_controller().halt();
+            charge_control_unlock();
         }
 
         // Lock LVGL for entire switch (move table + load screen). Prevents first-boot overlay
@@ -299,12 +239,11 @@ void switch_to_screen(screen_id_t screen_id) {
         }
 
         // Send stop command after screen 6 or 7 loads (if pending)
-        if (pending_stop_command && (screen_id == SCREEN_CHARGING_COMPLETE || screen_id == SCREEN_EMERGENCY_STOP)) {
+        if (charge_controller().stop_pending() && (screen_id == SCREEN_CHARGING_COMPLETE || screen_id == SCREEN_EMERGENCY_STOP)) {
             delay(50);  // Give screen time to fully load
-            Serial.println("[CHARGING] Sending STOP command to VFD after screen load...");
-            rs485_sendStopCommand();
-            Serial.println("[CHARGING] Stop command sent to VFD - Motor should now be stopped");
-            pending_stop_command = false;  // Clear flag
+            charge_control_lock();
+            charge_controller().send_pending_stop();
+            charge_control_unlock();
         }
 
         // Manage battery container visibility (only for screens that need profiles)
@@ -456,700 +395,6 @@ void switch_to_screen(screen_id_t screen_id) {
 
 
 
-
-
-// ============================================================================
-// Charging Control Function start
-// ============================================================================
-void update_charging_control() {
-    // Only run in charging states
-    if (current_app_state != STATE_CHARGING_START && 
-        current_app_state != STATE_CHARGING_CC && 
-        current_app_state != STATE_CHARGING_CV &&
-        current_app_state != STATE_CHARGING_VOLTAGE_SATURATION) { return; }
-    
-    // Check if battery profile is selected
-    if (selected_battery_profile == nullptr) { return; }
-    
-    // Rate limiting: update once per second
-    const unsigned long CONTROL_UPDATE_INTERVAL = 1000; // 1 second
-    if (millis() - last_control_update < CONTROL_UPDATE_INTERVAL) {
-        return;
-    }
-    last_control_update = millis();
-    
-    // Temperature check: Monitor temp1 and temp2 during charging states
-    // Convert from 0.01°C units to Celsius
-    float temp1_celsius = sensorData.temp1 / 100.0f; //motor temp
-    float temp2_celsius = sensorData.temp2 / 100.0f; //gcu gen temp
-    
-    // Check if either temperature exceeds threshold
-    if (temp1_celsius > MAX_TEMP_THRESHOLD || temp2_celsius > MAX_TEMP_THRESHOLD) {
-        Serial.printf("[TEMP] High temperature detected! Temp1=%.2f°C, Temp2=%.2f°C, Threshold=%.1f°C\n",
-                     temp1_celsius, temp2_celsius, MAX_TEMP_THRESHOLD);
-        Serial.println("[TEMP] Triggering emergency stop due to high temperature");
-        
-        // STEP 1: Send 0 RPM command IMMEDIATELY
-        Serial.println("[TEMP] Sending 0 RPM command immediately...");
-        rs485_sendFrequencyCommand(0);  // Send 0 Hz
-        current_frequency = 0;
-        delay(10);  // Give RS485 time to send the command
-       
-        // STEP 2: Open contactor via CAN bus IMMEDIATELY
-        Serial.println("[TEMP] Opening contactor immediately on high temperature...");
-        send_contactor_control(CONTACTOR_OPEN);
-        
-        // STEP 3: Store final charging time before transitioning (if charging was in progress)
-        if (charging_start_time > 0 && !charging_complete) {
-            final_charging_time_ms = millis() - charging_start_time;
-            charging_complete = true;
-            Serial.printf("[TEMP] Final charging time: %lu ms (%.2f minutes)\n", 
-                         final_charging_time_ms, final_charging_time_ms / 60000.0f);
-            
-            // Calculate and store final remaining time (if in CV state)
-            if (cv_start_time > 0 && cc_state_duration_for_timer > 0) {
-                unsigned long cv_elapsed = millis() - cv_start_time;
-                unsigned long cv_target_base = precharge_duration_for_timer + (cc_state_duration_for_timer / 2);  // precharge + 50% CC
-                unsigned long cv_33_min = 33 * 60 * 1000;  // 33 minutes in ms
-                unsigned long target_cv_time = (cv_target_base < cv_33_min) ? cv_target_base : cv_33_min;
-                final_remaining_time_ms = (target_cv_time > cv_elapsed) ? (target_cv_time - cv_elapsed) : 0;
-                Serial.printf("[TEMP] Final remaining time: %lu ms (%.2f minutes)\n", 
-                             final_remaining_time_ms, final_remaining_time_ms / 60000.0f);
-            }
-        }
-        
-        // STEP 4: Set stop reason to high temperature
-        charge_stop_reason = CHARGE_STOP_HIGH_TEMP;
-        current_flow_start = false;
-        
-        // Log charge complete
-        if (sd_logging_initialized) {
-            current_charge_log.end_volt = sensorData.volt;
-            current_charge_log.total_time_ms = final_charging_time_ms;
-            current_charge_log.ah_final = accumulated_ah;
-            current_charge_log.stop_reason = charge_stop_reason;
-            logChargeComplete(&current_charge_log);
-        }
-        
-        // STEP 5: Set flag to send stop command after screen 7 loads
-        pending_stop_command = true;
-        
-        // STEP 6: Switch to emergency stop state and screen
-        current_app_state = STATE_EMERGENCY_STOP;
-        switch_to_screen(SCREEN_EMERGENCY_STOP);
-        
-        // Exit early - don't continue with normal charging control
-        return;
-    }
-    
-    // Get target values from battery profile
-    float target_current = selected_battery_profile->getConstCurrent(); // Amps
-    float target_voltage = selected_battery_profile->getCutoffVoltage(); // Volts
-    
-    // Validate and convert sensor data (handle negative values)
-    // Clamp negative values to 0 to prevent unsigned wrap-around
-    float safe_actual_current = (sensorData.curr < 0.0f) ? 0.0f : sensorData.curr;
-    float safe_actual_voltage = (sensorData.volt < 0.0f) ? 0.0f : sensorData.volt;
-    
-    // Convert to 0.01 units (as required by RS485 functions)
-    uint16_t target_current_0_01A = (uint16_t)(target_current * 100);
-    uint16_t target_voltage_0_01V = (uint16_t)(target_voltage * 100);
-    uint16_t actual_current_0_01A = (uint16_t)(safe_actual_current * 100);
-    uint16_t actual_voltage_0_01V = (uint16_t)(safe_actual_voltage * 100);
-    
-    uint16_t new_frequency = current_frequency;
-    
-// State-specific charging logic
-    // ============================================================================
-    // [1] STATE_CHARGING_START: Maintain PRECHARGE_AMPS (2A) for PRECHARGE_TIME (3 minutes), then transition to CC
-    // ============================================================================
-    if (current_app_state == STATE_CHARGING_START) {
-        // Set current_flow_start once current >= 1.5 A (allows 0 A before that; 1.0 A below = disconnect after flow)
-        if (safe_actual_current >= 1.5f) {
-            current_flow_start = true;
-        }
-        // Battery disconnected: current had flowed but now dropped below 1.0 A
-        if (current_flow_start && safe_actual_current < 1.0f) {
-            Serial.println("[CHARGING] Battery disconnected (current < 1.0 A after flow), emergency stop");
-            send_contactor_control(CONTACTOR_OPEN);
-            delay(10);
-            rs485_sendFrequencyCommand(0);
-            current_frequency = 0;
-            delay(10);
-            if (charging_start_time > 0 && !charging_complete) {
-                final_charging_time_ms = millis() - charging_start_time;
-                charging_complete = true;
-            }
-            charge_stop_reason = CHARGE_STOP_BATTERY_DISCONNECTED;
-            if (sd_logging_initialized) {
-                current_charge_log.end_volt = sensorData.volt;
-                current_charge_log.total_time_ms = final_charging_time_ms;
-                current_charge_log.ah_final = accumulated_ah;
-                current_charge_log.stop_reason = charge_stop_reason;
-                logChargeComplete(&current_charge_log);
-            }
-            current_flow_start = false;
-            pending_stop_command = true;
-            current_app_state = STATE_EMERGENCY_STOP;
-            switch_to_screen(SCREEN_EMERGENCY_STOP);
-            return;
-        }
-        // Step 1 safety: no current flow within timeout, or RPM over limit
-        unsigned long step1_elapsed = (charging_start_time > 0) ? (millis() - charging_start_time) : 0;
-        float step1_rpm = VFD_FREQ_TO_RPM(current_frequency / 100.0f);
-
-        if ((step1_elapsed >= PRECHARGE_CURRENT_FLOW_TIMEOUT_MS && !current_flow_start) ||
-        ((step1_rpm > (float)PRECHARGE_RPM_LIMIT) && !current_flow_start)) {
-            Serial.println("[CHARGING] Volt or current error (no flow in time or RPM > limit), emergency stop");
-            send_contactor_control(CONTACTOR_OPEN);
-            delay(10);
-            rs485_sendFrequencyCommand(0);
-            current_frequency = 0;
-            delay(10);
-            if (charging_start_time > 0 && !charging_complete) {
-                final_charging_time_ms = millis() - charging_start_time;
-                charging_complete = true;
-            }
-            charge_stop_reason = CHARGE_STOP_VOLT_OR_CURRENT_ERROR;
-            if (sd_logging_initialized) {
-current_charge_log.end_volt = sensorData.volt;
-            current_charge_log.total_time_ms = final_charging_time_ms;
-            current_charge_log.ah_final = accumulated_ah;
-            current_charge_log.stop_reason = charge_stop_reason;
-            logChargeComplete(&current_charge_log);
-            }
-            current_flow_start = false;
-            pending_stop_command = true;
-            current_app_state = STATE_EMERGENCY_STOP;
-            switch_to_screen(SCREEN_EMERGENCY_STOP);
-            return;
-        }
-        // Use CC logic to maintain current at PRECHARGE_AMPS (2A) - like CC but fixed at precharge level
-        uint16_t precharge_target_0_01A = (uint16_t)(PRECHARGE_AMPS * 100);  // Convert 2A to 0.01A units
-        new_frequency = rs485_CalcFrequencyFor_CC(current_frequency, precharge_target_0_01A, actual_current_0_01A);
- 
-        // Debug logging
-        #if ACTUAL_TARGET_CC_CV_debug
-        int32_t current_error = (int32_t)actual_current_0_01A - (int32_t)precharge_target_0_01A;
-        Serial.printf("[CHARGING_START] Target: %.2fA (Precharge), Actual: %.2fA, Error: %d (0.01A), Freq: %d -> %d (%.2f Hz -> %.2f Hz)\n",
-            PRECHARGE_AMPS, safe_actual_current, current_error,
-            current_frequency, new_frequency,
-            current_frequency / 100.0f, new_frequency / 100.0f);
-        #endif
-        
-        // Send frequency command
-        rs485_sendFrequencyCommand(new_frequency);
-        current_frequency = new_frequency;
-        
-        // Check if voltage reached target voltage before 3 minutes - override and go to complete
-        if (safe_actual_voltage >= target_voltage) {
-            Serial.println("[CHARGING] Voltage limit reached during precharge, transitioning to complete");
-            
-            // STEP 1: Send 0 RPM command IMMEDIATELY when condition is met
-            Serial.println("[CHARGING] Sending 0 RPM command immediately...");
-            rs485_sendFrequencyCommand(0);  // Send 0 Hz
-            current_frequency = 0;
-            delay(10);  // Give RS485 time to send the command
-            
-            // STEP 2: Calculate final charging time
-            unsigned long current_time = millis();
-            if (charging_start_time > 0) {
-                final_charging_time_ms = current_time - charging_start_time;
-                charging_complete = true;
-                Serial.printf("[CHARGING] Final charging time: %lu ms (%.2f minutes)\n", 
-                             final_charging_time_ms, final_charging_time_ms / 60000.0f);
-            }
-            
-            // Open contactor via CAN bus
-            Serial.println("[CONTACTOR] Opening contactor on voltage limit reached during precharge...");
-            send_contactor_control(CONTACTOR_OPEN);
-            
-            // Set stop reason to voltage limit reached during precharge
-            charge_stop_reason = CHARGE_STOP_VOLTAGE_LIMIT_PRECHARGE;
-            
-            // Log charge complete
-            if (sd_logging_initialized) {
-current_charge_log.end_volt = sensorData.volt;
-            current_charge_log.total_time_ms = final_charging_time_ms;
-            current_charge_log.ah_final = accumulated_ah;
-            current_charge_log.stop_reason = charge_stop_reason;
-            logChargeComplete(&current_charge_log);
-            }
-            
-// Transition to complete state
-            current_app_state = STATE_CHARGING_COMPLETE;
-            current_flow_start = false;
-            Serial.println("[CHARGING] Transitioned to charging complete state (voltage limit during precharge)");
-
-            // Set flag to send stop command after screen 6 loads
-            pending_stop_command = true;
-
-            // STEP 3: Move to screen 6
-            switch_to_screen(SCREEN_CHARGING_COMPLETE);
-        }
-        // Check if precharge time elapsed (3 minutes), then transition to CC state
-        else {
-            unsigned long current_time = millis();
-            unsigned long precharge_elapsed = 0;
-            if (charging_start_time > 0) {
-                precharge_elapsed = current_time - charging_start_time;
-            }
-            
-            if (precharge_elapsed >= PRECHARGE_TIME_MS) {
-                Serial.println("[CHARGING] Precharge complete (x min elapsed), transitioning to CC mode");
-                precharge_duration_for_timer = precharge_elapsed;  // For CV time: precharge + 50% CC, max 33 min
-                current_app_state = STATE_CHARGING_CC; //update the fsm state to charging cc
-                cc_state_start_time = millis();  // Record CC state start time
-                Serial.println("[CHARGING] CC state timing started");
-                
-                // Initialize voltage saturation tracking on CC entry
-                base_volt_satu_ref = safe_actual_voltage;  // Record base voltage reference
-                present_volt_satu_check = 0.0f;  // Reset present voltage check
-                last_voltage_saturation_check_time = millis();  // Initialize check time
-                Serial.printf("[VOLT_SAT] CC entry: base_volt_satu_ref = %.2fV\n", base_volt_satu_ref);
-                
-                // Screen switch will happen in determine_screen_from_state()
-            }
-        }
-    }
-
-    // ============================================================================
-    // [2] STATE_CHARGING_CC: Constant Current mode until target voltage reached
-    // ============================================================================
-    else if (current_app_state == STATE_CHARGING_CC) {
-        // Battery disconnected in step 2
-        if (current_flow_start && safe_actual_current < 1.0f) {
-            Serial.println("[CHARGING_CC] Battery disconnected (current < 1.0 A), emergency stop");
-            send_contactor_control(CONTACTOR_OPEN);
-            delay(10);
-            rs485_sendFrequencyCommand(0);
-            current_frequency = 0;
-            delay(10);
-            if (charging_start_time > 0 && !charging_complete) {
-                final_charging_time_ms = millis() - charging_start_time;
-                charging_complete = true;
-            }
-            charge_stop_reason = CHARGE_STOP_BATTERY_DISCONNECTED;
-            if (sd_logging_initialized) {
-                current_charge_log.end_volt = sensorData.volt;
-                current_charge_log.total_time_ms = final_charging_time_ms;
-                current_charge_log.ah_final = accumulated_ah;
-                current_charge_log.stop_reason = charge_stop_reason;
-                logChargeComplete(&current_charge_log);
-            }
-            current_flow_start = false;
-            pending_stop_command = true;
-            current_app_state = STATE_EMERGENCY_STOP;
-            switch_to_screen(SCREEN_EMERGENCY_STOP);
-            return;
-        }
-        new_frequency = rs485_CalcFrequencyFor_CC(current_frequency, target_current_0_01A, actual_current_0_01A); 
-        
-        // Debug logging
-        #if ACTUAL_TARGET_CC_CV_debug
-        int32_t current_error = (int32_t)actual_current_0_01A - (int32_t)target_current_0_01A;
-        Serial.printf("[CHARGING_CC] Target: %.2fA, Actual: %.2fA, Error: %d (0.01A), Freq: %d -> %d (%.2f Hz -> %.2f Hz)\n",
-            target_current, safe_actual_current, current_error,
-            current_frequency, new_frequency,
-            current_frequency / 100.0f, new_frequency / 100.0f);
-        #endif
-        
-        // Send frequency command
-        rs485_sendFrequencyCommand(new_frequency);
-        current_frequency = new_frequency;
-        
-        // Check if 110% capacity reached: Stop charging if accumulated_ah >= 110% of selected_battery_profile Ah
-        if (selected_battery_profile != nullptr) {
-            float battery_profile_ah = (float)selected_battery_profile->getRatedAh();
-            float capacity_threshold = battery_profile_ah * 1.1f;  // 110% of rated capacity
-            
-            if (accumulated_ah >= capacity_threshold) {
-                Serial.printf("[CHARGING_CC] 110%% capacity reached! Accumulated: %.2f Ah, Threshold: %.2f Ah (%.0f Ah * 1.1)\n",
-                             accumulated_ah, capacity_threshold, battery_profile_ah);
-                
-                // Send 0 RPM command immediately
-                Serial.println("[CHARGING_CC] Sending 0 RPM command immediately...");
-                rs485_sendFrequencyCommand(0);  // Send 0 Hz
-                current_frequency = 0;
-                delay(10);  // Give RS485 time to send the command
-                
-                // Open contactor via CAN bus IMMEDIATELY
-                Serial.println("[CONTACTOR] Opening contactor immediately on 110% capacity reached...");
-                send_contactor_control(CONTACTOR_OPEN);
-                
-                // Store final charging time before transitioning (if charging was in progress)
-                if (charging_start_time > 0 && !charging_complete) {
-                    final_charging_time_ms = millis() - charging_start_time;
-                    charging_complete = true;
-                    Serial.printf("[CHARGING_CC] Final charging time: %lu ms (%.2f minutes)\n", 
-                                 final_charging_time_ms, final_charging_time_ms / 60000.0f);
-                    
-                    // Calculate and store final remaining time (if in CV state)
-                    if (cv_start_time > 0 && cc_state_duration_for_timer > 0) {
-                        unsigned long cv_elapsed = millis() - cv_start_time;
-                        unsigned long cv_target_base = precharge_duration_for_timer + (cc_state_duration_for_timer / 2);  // precharge + 50% CC
-                        unsigned long cv_33_min = 33 * 60 * 1000;  // 33 minutes in ms
-                        unsigned long target_cv_time = (cv_target_base < cv_33_min) ? cv_target_base : cv_33_min;
-                        final_remaining_time_ms = (target_cv_time > cv_elapsed) ? (target_cv_time - cv_elapsed) : 0;
-                        Serial.printf("[CHARGING_CC] Final remaining time: %lu ms (%.2f minutes)\n", 
-                                     final_remaining_time_ms, final_remaining_time_ms / 60000.0f);
-                    }
-                }
-                
-                // Set stop reason to 110% capacity reached
-                charge_stop_reason = CHARGE_STOP_110_PERCENT_CAPACITY;
-                current_flow_start = false;
-                
-                // Log charge complete
-                if (sd_logging_initialized) {
-current_charge_log.end_volt = sensorData.volt;
-            current_charge_log.total_time_ms = final_charging_time_ms;
-            current_charge_log.ah_final = accumulated_ah;
-            current_charge_log.stop_reason = charge_stop_reason;
-            logChargeComplete(&current_charge_log);
-                }
-                
-                // Set flag to send stop command after screen 7 loads
-                pending_stop_command = true;
-                
-                // Switch to emergency stop state and screen
-                current_app_state = STATE_EMERGENCY_STOP;
-                switch_to_screen(SCREEN_EMERGENCY_STOP);
-                
-                // Exit early - don't continue with normal charging control
-                return;
-            }
-        }
-        
-        // Voltage saturation check: Check every xx1 minutes (VOLTAGE_SATURATION_CHECK_INTERVAL_MS)
-        unsigned long current_time = millis();
-        if (last_voltage_saturation_check_time > 0 && 
-            (current_time - last_voltage_saturation_check_time) >= VOLTAGE_SATURATION_CHECK_INTERVAL_MS) {
-            
-            // Time to check for voltage saturation
-            present_volt_satu_check = safe_actual_voltage;  // Record present voltage
-            float voltage_difference = present_volt_satu_check - base_volt_satu_ref;
-            
-            Serial.printf("[VOLT_SAT] Check: base=%.2fV, present=%.2fV, diff=%.2fV\n", 
-                         base_volt_satu_ref, present_volt_satu_check, voltage_difference);
-            
-            if (voltage_difference > VOLTAGE_SATURATION_THRESHOLD_V) {
-                // Voltage increased by more than 0.5V - no saturation, continue CC
-                Serial.println("[VOLT_SAT] Voltage increased > 0.5V, no saturation detected. Continuing CC stage.");
-                base_volt_satu_ref = present_volt_satu_check;  // Update base reference
-                present_volt_satu_check = 0.0f;  // Reset present check
-                last_voltage_saturation_check_time = current_time;  // Reset check timer
-            } else {
-                // Voltage increase <= 0.5V (or negative) - saturation detected
-                Serial.printf("[VOLT_SAT] Saturation detected! Voltage diff=%.2fV <= %.2fV\n", 
-                             voltage_difference, VOLTAGE_SATURATION_THRESHOLD_V);
-                Serial.printf("[VOLT_SAT] Recording saturation voltage: %.2fV\n", present_volt_satu_check);
-                
-                // Record the saturation voltage
-                voltage_saturation_detected_voltage = present_volt_satu_check;
-                
-                // Transition to voltage saturation state (Screen 8)
-                current_app_state = STATE_CHARGING_VOLTAGE_SATURATION;
-                voltage_saturation_cv_start_time = millis();  // Record CV start time for screen 8
-                current_flow_start = false;  // Reset on saturate entry
-                Serial.println("[VOLT_SAT] Transitioning to voltage saturation state (Screen 8)");
-                
-                // Immediately calculate and send CV frequency command using saturation voltage
-                uint16_t saturation_voltage_0_01V = (uint16_t)(voltage_saturation_detected_voltage * 100);
-                uint16_t sat_cv_frequency = rs485_CalcFrequencyFor_CV(
-                    current_frequency, 
-                    saturation_voltage_0_01V, 
-                    actual_voltage_0_01V
-                );
-                rs485_sendFrequencyCommand(sat_cv_frequency);
-                current_frequency = sat_cv_frequency;
-                Serial.println("[VOLT_SAT] CV frequency command sent immediately on saturation transition");
-                
-                // Screen switch will happen in determine_screen_from_state()
-                return;  // Exit early, don't check normal voltage transition
-            }
-        }
-        
-        // Check if voltage >= target voltage, then transition to CV state
-        if (safe_actual_voltage >= target_voltage) {
-            Serial.println("[CHARGING] Voltage reached target, transitioning to CV mode");
-            // Calculate CC state duration before transitioning
-            if (cc_state_start_time > 0) {
-                cc_state_duration = millis() - cc_state_start_time;
-                cc_state_duration_for_timer = cc_state_duration;  // Store for remaining time calculation
-                Serial.printf("[CHARGING] CC state duration: %lu ms (%.2f minutes)\n", 
-                    cc_state_duration, cc_state_duration / 60000.0f);
-            }
-            current_app_state = STATE_CHARGING_CV;
-            cv_state_start_time = millis();  // Record CV state start time for charging control
-            cv_start_time = millis();  // Record CV state start time for timer display
-            Serial.println("[CHARGING] CV state timing started");
-            
-            // CRITICAL: Immediately calculate and send CV frequency command to prevent motor freeze
-            // Don't wait for next update_charging_control() call - ensure continuous control
-            uint16_t cv_frequency = rs485_CalcFrequencyFor_CV(
-                current_frequency, 
-                target_voltage_0_01V, 
-                actual_voltage_0_01V
-            );
-            rs485_sendFrequencyCommand(cv_frequency);
-            current_frequency = cv_frequency;
-            Serial.println("[CHARGING] CV frequency command sent immediately on transition");
-            
-// Calculate initial remaining time for immediate display
-            if (cc_state_duration_for_timer > 0) {
-                unsigned long cv_target_base = precharge_duration_for_timer + (cc_state_duration_for_timer / 2);  // precharge + 50% CC
-                unsigned long cv_33_min = 33 * 60 * 1000;  // 33 minutes in ms
-                unsigned long target_cv_time = (cv_target_base < cv_33_min) ? cv_target_base : cv_33_min;
-                unsigned long rem_seconds = target_cv_time / 1000;
-                unsigned long rem_minutes = rem_seconds / 60;
-                rem_seconds = rem_seconds % 60;
-                Serial.printf("[CHARGING] Initial remaining time: %02lu:%02lu (target CV time: %lu ms)\n",
-                             rem_minutes, rem_seconds, target_cv_time);
-            }
-            // Screen switch will happen in determine_screen_from_state()
-        }
-    }
-
-    // [3] STATE_CHARGING_CV: Constant Voltage mode
-    else if (current_app_state == STATE_CHARGING_CV) {
-        // Battery disconnected in step 3
-        if (current_flow_start && safe_actual_current < 1.0f) {
-            Serial.println("[CHARGING_CV] Battery disconnected (current < 1.0 A), emergency stop");
-            send_contactor_control(CONTACTOR_OPEN);
-            delay(10);
-            rs485_sendFrequencyCommand(0);
-            current_frequency = 0;
-            delay(10);
-            if (charging_start_time > 0 && !charging_complete) {
-                final_charging_time_ms = millis() - charging_start_time;
-                charging_complete = true;
-            }
-            charge_stop_reason = CHARGE_STOP_BATTERY_DISCONNECTED;
-            if (sd_logging_initialized) {
-                current_charge_log.end_volt = sensorData.volt;
-                current_charge_log.total_time_ms = final_charging_time_ms;
-                current_charge_log.ah_final = accumulated_ah;
-                current_charge_log.stop_reason = charge_stop_reason;
-                logChargeComplete(&current_charge_log);
-            }
-            current_flow_start = false;
-            pending_stop_command = true;
-            current_app_state = STATE_EMERGENCY_STOP;
-            switch_to_screen(SCREEN_EMERGENCY_STOP);
-            return;
-        }
-        new_frequency = rs485_CalcFrequencyFor_CV(current_frequency, target_voltage_0_01V, actual_voltage_0_01V);
-        
-        // Debug logging
-        #if ACTUAL_TARGET_CC_CV_debug
-        int32_t voltage_error = (int32_t)actual_voltage_0_01V - (int32_t)target_voltage_0_01V;
-        Serial.printf("[CHARGING_CV] Target: %.2fV, Actual: %.2fV, Error: %d (0.01V), Freq: %d -> %d (%.2f Hz -> %.2f Hz)\n",
-            target_voltage, safe_actual_voltage, voltage_error,
-            current_frequency, new_frequency,
-            current_frequency / 100.0f, new_frequency / 100.0f);
-        #endif
-        
-        // Send frequency command
-        rs485_sendFrequencyCommand(new_frequency);
-        current_frequency = new_frequency;
-        
-        // Termination condition: Check if charging is complete
-        // Complete if: 33 minutes in CV mode OR (precharge time + 50% of CC time) has elapsed
-        unsigned long current_time = millis();
-        unsigned long cv_duration = 0;
-        if (cv_state_start_time > 0) {
-            cv_duration = current_time - cv_state_start_time;
-        }
-        
-        const unsigned long CV_COMPLETE_TIME_MS = 33 * 60 * 1000;  // 33 minutes in milliseconds
-        bool cv_time_complete = (cv_duration >= CV_COMPLETE_TIME_MS);
-        
-        // Precharge + 50% of CC state time (if CC duration was recorded)
-        bool cc_time_complete = false;
-        if (cc_state_duration > 0) {
-            unsigned long cv_target_time = precharge_duration_for_timer + (cc_state_duration / 2);
-            unsigned long cv_33_min = 33 * 60 * 1000;
-            unsigned long cv_target_capped = (cv_target_time < cv_33_min) ? cv_target_time : cv_33_min;
-            cc_time_complete = (cv_duration >= cv_target_capped);
-        }
-        
-        if (cv_time_complete || cc_time_complete) {
-            Serial.println("[CHARGING] Charging complete condition met!");
-            
-            // STEP 1: Send 0 RPM command IMMEDIATELY when condition is met
-            Serial.println("[CHARGING] Sending 0 RPM command immediately...");
-            rs485_sendFrequencyCommand(0);  // Send 0 Hz
-            current_frequency = 0;
-            delay(10);  // Give RS485 time to send the command
-            
-            // STEP 2: Now do other things (logging, calculations, etc.)
-            if (cv_time_complete) {
-                Serial.printf("[CHARGING] CV mode duration: %lu ms (%.2f minutes) >= 33 minutes\n",
-                    cv_duration, cv_duration / 60000.0f);
-            }
-            if (cc_time_complete && cc_state_duration > 0) {
-                Serial.printf("[CHARGING] CV duration (%lu ms) >= (precharge + 50%% CC) target\n",
-                    cv_duration);
-            }
-            
-            // Store final charging time and remaining time before transitioning
-            if (charging_start_time > 0) {
-                final_charging_time_ms = millis() - charging_start_time;
-                charging_complete = true;
-                Serial.printf("[CHARGING] Final charging time: %lu ms (%.2f minutes)\n", 
-                             final_charging_time_ms, final_charging_time_ms / 60000.0f);
-                
-                // Calculate and store final remaining time
-                if (cv_start_time > 0 && cc_state_duration_for_timer > 0) {
-                    unsigned long cv_elapsed = millis() - cv_start_time;
-                    unsigned long cv_target_base = precharge_duration_for_timer + (cc_state_duration_for_timer / 2);  // precharge + 50% CC
-                    unsigned long cv_33_min = 33 * 60 * 1000;  // 33 minutes in ms
-                    unsigned long target_cv_time = (cv_target_base < cv_33_min) ? cv_target_base : cv_33_min;
-                    final_remaining_time_ms = (target_cv_time > cv_elapsed) ? (target_cv_time - cv_elapsed) : 0;
-                    Serial.printf("[CHARGING] Final remaining time: %lu ms (%.2f minutes)\n", 
-                                 final_remaining_time_ms, final_remaining_time_ms / 60000.0f);
-                }
-            }
-            
-            // Open contactor via CAN bus (just before moving out of screen 5)
-            Serial.println("[CONTACTOR] Opening contactor before completing charge...");
-            send_contactor_control(CONTACTOR_OPEN);
-            
-            // Set stop reason and transition to complete state
-            charge_stop_reason = CHARGE_STOP_COMPLETE;
-            current_flow_start = false;
-            
-            // Log charge complete
-            if (sd_logging_initialized) {
-current_charge_log.end_volt = sensorData.volt;
-            current_charge_log.total_time_ms = final_charging_time_ms;
-            current_charge_log.ah_final = accumulated_ah;
-            current_charge_log.stop_reason = charge_stop_reason;
-            logChargeComplete(&current_charge_log);
-            }
-            
-            current_app_state = STATE_CHARGING_COMPLETE;
-            
-            // Set flag to send stop command after screen 6 loads
-            pending_stop_command = true;
-            
-            // STEP 3: Move to screen 6
-            switch_to_screen(SCREEN_CHARGING_COMPLETE);
-        }
-    }
-        
-    // [4] STATE_CHARGING_VOLTAGE_SATURATION: Constant Voltage mode using saturation voltage as target
-    else if (current_app_state == STATE_CHARGING_VOLTAGE_SATURATION) {
-        // Battery disconnected in voltage saturation
-        if (current_flow_start && safe_actual_current < 1.0f) {
-            Serial.println("[CHARGING_VOLT_SAT] Battery disconnected (current < 1.0 A), emergency stop");
-            send_contactor_control(CONTACTOR_OPEN);
-            delay(10);
-            rs485_sendFrequencyCommand(0);
-            current_frequency = 0;
-            delay(10);
-            if (charging_start_time > 0 && !charging_complete) {
-                final_charging_time_ms = millis() - charging_start_time;
-                charging_complete = true;
-            }
-            charge_stop_reason = CHARGE_STOP_BATTERY_DISCONNECTED;
-            if (sd_logging_initialized) {
-                current_charge_log.end_volt = sensorData.volt;
-                current_charge_log.total_time_ms = final_charging_time_ms;
-                current_charge_log.ah_final = accumulated_ah;
-                current_charge_log.stop_reason = charge_stop_reason;
-                logChargeComplete(&current_charge_log);
-            }
-            current_flow_start = false;
-            pending_stop_command = true;
-            current_app_state = STATE_EMERGENCY_STOP;
-            switch_to_screen(SCREEN_EMERGENCY_STOP);
-            return;
-        }
-        // Use the recorded saturation voltage as target instead of battery profile cutoff voltage
-        uint16_t saturation_voltage_0_01V = (uint16_t)(voltage_saturation_detected_voltage * 100);
-        
-        new_frequency = rs485_CalcFrequencyFor_CV(current_frequency, saturation_voltage_0_01V, actual_voltage_0_01V);
-        
-        // Debug logging
-        #if ACTUAL_TARGET_CC_CV_debug
-        int32_t voltage_error = (int32_t)actual_voltage_0_01V - (int32_t)saturation_voltage_0_01V;
-        Serial.printf("[CHARGING_VOLT_SAT] Target: %.2fV, Actual: %.2fV, Error: %d (0.01V), Freq: %d -> %d (%.2f Hz -> %.2f Hz)\n",
-            voltage_saturation_detected_voltage, safe_actual_voltage, voltage_error,
-            current_frequency, new_frequency,
-            current_frequency / 100.0f, new_frequency / 100.0f);
-        #endif
-        
-        // Send frequency command
-        rs485_sendFrequencyCommand(new_frequency);
-        current_frequency = new_frequency;
-        
-        // Termination condition: Check if CV duration has reached xx2 minutes (VOLTAGE_SATURATION_CV_DURATION_MS)
-        unsigned long current_time = millis();
-        unsigned long sat_cv_duration = 0;
-        if (voltage_saturation_cv_start_time > 0) {
-            sat_cv_duration = current_time - voltage_saturation_cv_start_time;
-        }
-        
-        bool sat_cv_time_complete = (sat_cv_duration >= VOLTAGE_SATURATION_CV_DURATION_MS);
-        
-        if (sat_cv_time_complete) {
-            Serial.println("[CHARGING] Voltage saturation CV charging complete (xx2 minutes elapsed)!");
-            
-            // STEP 1: Send 0 RPM command IMMEDIATELY when condition is met
-            Serial.println("[CHARGING] Sending 0 RPM command immediately...");
-            rs485_sendFrequencyCommand(0);  // Send 0 Hz
-            current_frequency = 0;
-            delay(10);  // Give RS485 time to send the command
-            
-            // STEP 2: Now do other things (logging, calculations, etc.)
-            // Calculate total charging time
-            if (charging_start_time > 0) {
-                final_charging_time_ms = current_time - charging_start_time;
-                charging_complete = true;
-                Serial.printf("[CHARGING] Final charging time: %lu ms (%.2f minutes)\n", 
-                             final_charging_time_ms, final_charging_time_ms / 60000.0f);
-            }
-            
-            // Open contactor via CAN bus
-            Serial.println("[CONTACTOR] Opening contactor on charging complete...");
-            send_contactor_control(CONTACTOR_OPEN);
-            
-            // Set stop reason to voltage saturation
-            charge_stop_reason = CHARGE_STOP_VOLTAGE_SATURATION;
-            current_flow_start = false;
-            
-            // Log charge complete
-            if (sd_logging_initialized) {
-current_charge_log.end_volt = sensorData.volt;
-            current_charge_log.total_time_ms = final_charging_time_ms;
-            current_charge_log.ah_final = accumulated_ah;
-            current_charge_log.stop_reason = charge_stop_reason;
-            logChargeComplete(&current_charge_log);
-            }
-            
-            // Transition to complete state
-            current_app_state = STATE_CHARGING_COMPLETE;
-            Serial.println("[CHARGING] Transitioned to charging complete state (voltage saturation)");
-            
-            // Set flag to send stop command after screen 6 loads
-            pending_stop_command = true;
-            
-            // STEP 3: Move to screen 6
-            switch_to_screen(SCREEN_CHARGING_COMPLETE);
-        }
-    }
-}
-// ============================================================================
-//main charging control funciton end 
-// ============================================================================
-
-
-
-
-
-
 // Update current screen content (screen-specific updates)
 void update_current_screen() {
     // Screen 1 (home): Update M2 RTC time label only when battery_detected is false (rate limited to 2Hz = 500ms)
@@ -1193,11 +438,28 @@ void update_current_screen() {
     }
 #endif // CAN_RTC_DEBUG
 
-    // Charging control (runs only in charging states, once per second)
-    update_charging_control();
-    
-    // Update Ah calculation (runs only in charging states)
-    update_accumulated_ah();
+    // Charge finished in the control task or a stop handler: complete the record here (SD write stays off the control path)
+    charge_result_t charge_result;
+    if (charge_control_take_result(&charge_result)) {
+        current_charge_log.end_volt = charge_result.end_volt;
+        current_charge_log.total_time_ms = charge_result.total_time_ms;
+        current_charge_log.ah_final = charge_result.ah_final;
+        current_charge_log.max_volt = charge_result.max_volt;
+        current_charge_log.max_curr = charge_result.max_curr;
+        current_charge_log.max_t1_celsius = charge_result.max_temp1 / 100.0f;
+        current_charge_log.max_t2_celsius = charge_result.max_temp2 / 100.0f;
+        current_charge_log.stop_reason = charge_result.stop_reason;
+        current_charge_log.precharge_ir_ohm = charge_result.precharge_ir_ohm;
+        current_charge_log.precharge_check = charge_result.precharge_check;
+        logChargeComplete(&current_charge_log);
+        logEtaAccuracy(current_charge_log.serial, &charge_result);
+    }
+
+    // Charging state for this pass (the UI only observes the controller)
+    charge_status_t charge;
+    charge_control_lock();
+    charge_controller().status(&charge);
+    charge_control_unlock();
     
     // Check battery removal on screens 6 and 7 - auto-dismiss popup and navigate when battery removed
     if ((current_screen_id == SCREEN_CHARGING_COMPLETE || current_screen_id == SCREEN_EMERGENCY_STOP)) {
@@ -1222,21 +484,16 @@ void update_current_screen() {
             }
             
             if (should_navigate) {
-                // Reset variables
-                charge_stop_reason = CHARGE_STOP_NONE;
-                charging_start_time = 0;
-                cv_start_time = 0;
-                    cc_state_duration_for_timer = 0;
-                    precharge_duration_for_timer = 0;
-                    pending_stop_command = false;
-                    current_flow_start = false;
+                // Reset charging state and go home
+                charge_control_lock();
+                charge_controller().reset();
+                charge_control_unlock();
                     battery_detected = false;
                     
                     // Clear selected battery profile - user must select again from scratch
                     selected_battery_profile = nullptr;
                     
                     // Navigate to home
-                    current_app_state = STATE_HOME;
                     lvgl_port_unlock();  // Unlock before calling switch_to_screen (which may lock internally)
                     switch_to_screen(SCREEN_HOME);
             } else {
@@ -1294,12 +551,12 @@ void update_current_screen() {
             float temp1_celsius = sensorData.temp1 / 100.0f;
             float temp2_celsius = sensorData.temp2 / 100.0f;
             char temp_text[120];
-            sprintf(temp_text, "モーター温度: %.1f , GVOLTA温度: %.1f , 飽和電圧: %.2f V", temp1_celsius, temp2_celsius, voltage_saturation_detected_voltage);
+            sprintf(temp_text, "モーター温度: %.1f , GVOLTA温度: %.1f , 飽和電圧: %.2f V", temp1_celsius, temp2_celsius, charge.saturation_voltage);
             lv_label_set_text(screen8_temp_label, temp_text);
             lv_obj_clear_flag(screen8_temp_label, LV_OBJ_FLAG_HIDDEN);
         } else {
             char sat_text[60];
-            sprintf(sat_text, "飽和電圧: %.2f V", voltage_saturation_detected_voltage);
+            sprintf(sat_text, "飽和電圧: %.2f V", charge.saturation_voltage);
             lv_label_set_text(screen8_temp_label, sat_text);
             lv_obj_clear_flag(screen8_temp_label, LV_OBJ_FLAG_HIDDEN);
         }
@@ -1326,16 +583,16 @@ void update_current_screen() {
     
     // Update screen 6 status label based on charge stop reason
     if (screen6_status_label != nullptr && current_screen_id == SCREEN_CHARGING_COMPLETE) {
-        if (charge_stop_reason == CHARGE_STOP_VOLTAGE_LIMIT_PRECHARGE) {
+        if (charge.stop_reason == CHARGE_STOP_VOLTAGE_LIMIT_PRECHARGE) {
             lv_label_set_text(screen6_status_label, "充電前で電圧到達");
             lv_obj_set_style_text_color(screen6_status_label, lv_color_hex(0x006400), LV_PART_MAIN);  // Dark green (info, not error)
-        } else if (charge_stop_reason == CHARGE_STOP_VOLTAGE_SATURATION) {
+        } else if (charge.stop_reason == CHARGE_STOP_VOLTAGE_SATURATION) {
             lv_label_set_text(screen6_status_label, "電圧飽和で停止");
             lv_obj_set_style_text_color(screen6_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
-        } else if (charge_stop_reason == CHARGE_STOP_COMPLETE) {
+        } else if (charge.stop_reason == CHARGE_STOP_COMPLETE) {
             lv_label_set_text(screen6_status_label, "充電完了");
             lv_obj_set_style_text_color(screen6_status_label, lv_color_hex(0x006400), LV_PART_MAIN);  // Dark green
-        } else if (charge_stop_reason == CHARGE_STOP_EMERGENCY) {
+        } else if (charge.stop_reason == CHARGE_STOP_EMERGENCY) {
             // This shouldn't happen on screen 6, but handle it just in case
             lv_label_set_text(screen6_status_label, "手動停止");
             lv_obj_set_style_text_color(screen6_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
@@ -1348,21 +605,24 @@ void update_current_screen() {
     
     // Update screen 7 status label based on charge stop reason
     if (screen7_status_label != nullptr && current_screen_id == SCREEN_EMERGENCY_STOP) {
-        if (charge_stop_reason == CHARGE_STOP_HIGH_TEMP) {
+        if (charge.stop_reason == CHARGE_STOP_HIGH_TEMP) {
             lv_label_set_text(screen7_status_label, "温度警告");
             lv_obj_set_style_text_color(screen7_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
-        } else if (charge_stop_reason == CHARGE_STOP_EMERGENCY) {
+        } else if (charge.stop_reason == CHARGE_STOP_EMERGENCY) {
             lv_label_set_text(screen7_status_label, "手動停止");
             lv_obj_set_style_text_color(screen7_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
-        } else if (charge_stop_reason == CHARGE_STOP_110_PERCENT_CAPACITY) {
+        } else if (charge.stop_reason == CHARGE_STOP_110_PERCENT_CAPACITY) {
             lv_label_set_text(screen7_status_label, "容量110%到達");
             lv_obj_set_style_text_color(screen7_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
-        } else if (charge_stop_reason == CHARGE_STOP_BATTERY_DISCONNECTED) {
+        } else if (charge.stop_reason == CHARGE_STOP_BATTERY_DISCONNECTED) {
             lv_label_set_text(screen7_status_label, "切断失敗");
             lv_obj_set_style_text_color(screen7_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
-        } else if (charge_stop_reason == CHARGE_STOP_VOLT_OR_CURRENT_ERROR) {
+        } else if (charge.stop_reason == CHARGE_STOP_VOLT_OR_CURRENT_ERROR) {
             lv_label_set_text(screen7_status_label, "電圧電流失敗");
             lv_obj_set_style_text_color(screen7_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
+        } else if (charge.stop_reason == CHARGE_STOP_VFD_FAULT) {
+            lv_label_set_text(screen7_status_label, "インバータ異常");
+            lv_obj_set_style_text_color(screen7_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
         } else {
             // Default message
             lv_label_set_text(screen7_status_label, "手動停止");
@@ -1373,21 +633,15 @@ void update_current_screen() {
     // Update timer displays on screens 3, 4, 5, 6, 7, 8
     lvgl_port_lock(-1);  // Lock LVGL for thread safety
     
-    unsigned long total_elapsed = 0;
-    if (charging_complete && final_charging_time_ms > 0) {
-        // Use final time if charging is complete (stops updating)
-        total_elapsed = final_charging_time_ms;
-    } else if (charging_start_time > 0) {
-        // Calculate elapsed time if charging is in progress
-        total_elapsed = millis() - charging_start_time;
-    }
+    // Total time, frozen by the controller when charging completes
+    unsigned long total_elapsed = charge.elapsed_ms;
     
     // Format Ah value (always update, even if time is 0)
     char ah_str[20];
-    sprintf(ah_str, "%.1f", accumulated_ah);
+    sprintf(ah_str, "%.1f", charge.ah);
     
     // Update Ah display on screens 3, 4, 5, 8 (always, not just when time > 0)
-    if (!charging_complete) {
+    if (!charge.complete) {
         if (screen3_timer_table != nullptr && current_screen_id == SCREEN_CHARGING_STARTED) {
             lv_table_set_cell_value(screen3_timer_table, 1, 2, ah_str);
         }
@@ -1413,54 +667,56 @@ void update_current_screen() {
         sprintf(time_str, "%02lu:%02lu:%02lu", total_hours, total_minutes, total_seconds);
         
         // Update total time on screens 3, 4, 5, 8 (only if charging in progress)
-        if (!charging_complete) {
+        if (!charge.complete) {
             if (screen3_timer_table != nullptr && current_screen_id == SCREEN_CHARGING_STARTED) {
                 lv_table_set_cell_value(screen3_timer_table, 1, 0, time_str);
             }
             if (screen4_timer_table != nullptr && current_screen_id == SCREEN_CHARGING_CC) {
                 lv_table_set_cell_value(screen4_timer_table, 1, 0, time_str);
+
+                // Estimated time to the end of the charge (CC voltage-rise model) as a range, h:mm
+                if (charge.remaining_ms >= 0) {
+                    unsigned long lo_minutes = (unsigned long) charge.remaining_lo_ms / 60000;
+                    if (charge.remaining_hi_ms >= 0) {
+                        unsigned long hi_minutes = (unsigned long) charge.remaining_hi_ms / 60000;
+                        sprintf(time_str, "%lu:%02lu-%lu:%02lu", lo_minutes / 60, lo_minutes % 60,
+                                hi_minutes / 60, hi_minutes % 60);
+                    } else {
+                        sprintf(time_str, ">%lu:%02lu", lo_minutes / 60, lo_minutes % 60);
+                    }
+                    lv_table_set_cell_value(screen4_timer_table, 1, 1, time_str);
+                } else {
+                    // Not enough CC data yet
+                    lv_table_set_cell_value(screen4_timer_table, 1, 1, "--:--");
+                }
             }
             if (screen5_timer_table != nullptr && current_screen_id == SCREEN_CHARGING_CV) {
                 lv_table_set_cell_value(screen5_timer_table, 1, 0, time_str);
                 
-                // Also update remaining time on screen 5 (CV state)
-                if (cv_start_time > 0 && cc_state_duration_for_timer > 0) {
-                    unsigned long cv_elapsed = millis() - cv_start_time;
-                    unsigned long cv_target_base = precharge_duration_for_timer + (cc_state_duration_for_timer / 2);  // precharge + 50% CC
-                    unsigned long cv_33_min = 33 * 60 * 1000;  // 33 minutes in ms
-                    unsigned long target_cv_time = (cv_target_base < cv_33_min) ? cv_target_base : cv_33_min;
-                    unsigned long remaining_time_ms = (target_cv_time > cv_elapsed) ? (target_cv_time - cv_elapsed) : 0;
-                    
-                    unsigned long rem_seconds = remaining_time_ms / 1000;
+                // Also update remaining time on screen 5 (taper to the tail current, capped by the CV time budget)
+                if (charge.remaining_ms >= 0) {
+                    unsigned long rem_seconds = (unsigned long) charge.remaining_ms / 1000;
                     unsigned long rem_minutes = rem_seconds / 60;
                     rem_seconds = rem_seconds % 60;
                     sprintf(time_str, "%02lu:%02lu", rem_minutes, rem_seconds);
                     lv_table_set_cell_value(screen5_timer_table, 1, 1, time_str);
                 } else {
-                    // If cv_start_time or cc_state_duration not set yet, show default
-                    if (cv_start_time == 0) {
-                        lv_table_set_cell_value(screen5_timer_table, 1, 1, "--:--");
-                    } else {
-                        lv_table_set_cell_value(screen5_timer_table, 1, 1, "00:00");
-                    }
+                    // CV not started yet
+                    lv_table_set_cell_value(screen5_timer_table, 1, 1, "--:--");
                 }
             }
             if (screen8_timer_table != nullptr && current_screen_id == SCREEN_VOLTAGE_SATURATION) {
                 lv_table_set_cell_value(screen8_timer_table, 1, 0, time_str);
                 
                 // Also update remaining time on screen 8 (voltage saturation CV state)
-                if (voltage_saturation_cv_start_time > 0) {
-                    unsigned long sat_cv_elapsed = millis() - voltage_saturation_cv_start_time;
-                    unsigned long remaining_time_ms = (VOLTAGE_SATURATION_CV_DURATION_MS > sat_cv_elapsed) ? 
-                                                      (VOLTAGE_SATURATION_CV_DURATION_MS - sat_cv_elapsed) : 0;
-                    
-                    unsigned long rem_seconds = remaining_time_ms / 1000;
+                if (charge.remaining_ms >= 0) {
+                    unsigned long rem_seconds = (unsigned long) charge.remaining_ms / 1000;
                     unsigned long rem_minutes = rem_seconds / 60;
                     rem_seconds = rem_seconds % 60;
                     sprintf(time_str, "%02lu:%02lu", rem_minutes, rem_seconds);
                     lv_table_set_cell_value(screen8_timer_table, 1, 1, time_str);
                 } else {
-                    // If voltage_saturation_cv_start_time not set yet, show default
+                    // Saturation CV not started yet
                     lv_table_set_cell_value(screen8_timer_table, 1, 1, "--:--");
                 }
             }
@@ -1472,8 +728,8 @@ void update_current_screen() {
             lv_table_set_cell_value(screen6_timer_table, 1, 2, ah_str);
             
             // Also display final remaining time on screen 6
-            if (final_remaining_time_ms > 0) {
-                unsigned long rem_seconds = final_remaining_time_ms / 1000;
+            if (charge.remaining_ms > 0) {
+                unsigned long rem_seconds = (unsigned long) charge.remaining_ms / 1000;
                 unsigned long rem_minutes = rem_seconds / 60;
                 rem_seconds = rem_seconds % 60;
                 sprintf(time_str, "%02lu:%02lu", rem_minutes, rem_seconds);
@@ -1502,22 +758,23 @@ screen_id_t determine_screen_from_state() {
         return SCREEN_M2_LOST;
     }
     // Priority-based screen selection
-    if (current_app_state == STATE_CHARGING_START) {
+    const app_state_t state = charge_controller().state();
+    if (state == STATE_CHARGING_START) {
         return SCREEN_CHARGING_STARTED;
     }
-    if (current_app_state == STATE_CHARGING_CC) {
+    if (state == STATE_CHARGING_CC) {
         return SCREEN_CHARGING_CC;
     }
-    if (current_app_state == STATE_CHARGING_CV) {
+    if (state == STATE_CHARGING_CV) {
         return SCREEN_CHARGING_CV;
     }
-    if (current_app_state == STATE_CHARGING_VOLTAGE_SATURATION) {
+    if (state == STATE_CHARGING_VOLTAGE_SATURATION) {
         return SCREEN_VOLTAGE_SATURATION;
     }
-    if (current_app_state == STATE_CHARGING_COMPLETE) {
+    if (state == STATE_CHARGING_COMPLETE) {
         return SCREEN_CHARGING_COMPLETE;
     }
-    if (current_app_state == STATE_EMERGENCY_STOP) {
+    if (state == STATE_EMERGENCY_STOP) {
         return SCREEN_EMERGENCY_STOP;
     }
 #if CAN_RTC_DEBUG
@@ -1559,6 +816,7 @@ void check_m2_heartbeat(void) {
     if (last_101 == 0 || (now - last_101) > LOST_THRESHOLD_MS) {
         m2_connection_lost = true;
         if (current_screen_id != SCREEN_M2_LOST) {
+            can_stats_dump();  // Tell a dead M2 from a saturated/faulty bus
             switch_to_screen(SCREEN_M2_LOST);
         }
     } else {
@@ -1647,20 +905,6 @@ void update_table_values() {
     // Lock LVGL before updating UI
     lvgl_port_lock(-1);
 
-    // Update max values during charge (non-blocking)
-    if (charging_start_time > 0 && !charging_complete) {
-        if (sensorData.curr > current_charge_log.max_curr) {
-            current_charge_log.max_curr = sensorData.curr;
-        }
-        if (sensorData.volt > current_charge_log.max_volt) {
-            current_charge_log.max_volt = sensorData.volt;
-        }
-        float t1 = sensorData.temp1 / 100.0f;
-        float t2 = sensorData.temp2 / 100.0f;
-        if (t1 > current_charge_log.max_t1_celsius) current_charge_log.max_t1_celsius = t1;
-        if (t2 > current_charge_log.max_t2_celsius) current_charge_log.max_t2_celsius = t2;
-    }
-
     if (data_table != nullptr) {
         // Update voltage (column 0)
         lv_table_set_cell_value(data_table, 1, 0,
@@ -1677,7 +921,7 @@ void update_table_values() {
 
         // Column 3: RPM if TEST_SCREEN else Power
         if (TEST_SCREEN) {
-            float freq_hz = current_frequency / 100.0f;
+            float freq_hz = charge_controller().frequency() / 100.0f;
             float rpm = VFD_FREQ_TO_RPM(freq_hz);
             lv_table_set_cell_value(data_table, 1, 3, String((int)rpm).c_str());
         } else {
@@ -1698,51 +942,6 @@ void update_table_values() {
     lvgl_port_unlock();
 }
 
-// Update accumulated Ah based on current flow
-void update_accumulated_ah(void) {
-    // Only run in charging states
-    if (current_app_state != STATE_CHARGING_START && 
-        current_app_state != STATE_CHARGING_CC && 
-        current_app_state != STATE_CHARGING_CV) {
-        return;
-    }
-    
-    // Rate limiting: update every 1 second
-    const unsigned long AH_UPDATE_INTERVAL = 1000; // 1 second
-    unsigned long current_time = millis();
-    
-    // Initialize on first call or if reset
-    if (last_ah_update_time == 0) {
-        last_ah_update_time = current_time;
-        Serial.println("[AH] Ah calculation initialized");
-        return;
-    }
-    
-    // Check if enough time has passed
-    if (current_time - last_ah_update_time < AH_UPDATE_INTERVAL) {
-        return;
-    }
-    
-    // Calculate time delta in hours
-    unsigned long time_delta_ms = current_time - last_ah_update_time;
-    float time_delta_hours = time_delta_ms / 3600000.0f; // Convert ms to hours
-    
-    // Get current (handle negative values)
-    float safe_current = (sensorData.curr < 0.0f) ? 0.0f : sensorData.curr;
-    
-    // Ah = current (A) * time (h)
-    float ah_increment = safe_current * time_delta_hours;
-    accumulated_ah += ah_increment;
-    
-    #if Ah_CALCULATION_DEBUG
-        // Debug logging
-        Serial.printf("[AH] Current: %.2fA, Time: %.3fh, Increment: %.4fAh, Total: %.2fAh\n",
-                    safe_current, time_delta_hours, ah_increment, accumulated_ah);
-    #endif
-    
-    last_ah_update_time = current_time;
-}
-
 // Update CAN debug screen with received frame
 void update_can_debug_display(uint32_t id, uint8_t* data, uint8_t length) {
     if (screen13_can_frame_label != nullptr && current_screen_id == SCREEN_CAN_DEBUG) {
@@ -1937,47 +1136,19 @@ void screen2_start_button_event_handler(lv_event_t * e) {
     if(code == LV_EVENT_CLICKED) {
         Serial.println("[SCREEN2] START button pressed - switching to charging screen");
 
-        // Close contactor via CAN bus (M1 -> M2)
-        Serial.println("[CONTACTOR] Closing contactor before starting charge...");
-        send_contactor_control(CONTACTOR_CLOSE);
-        
-        // Send RS485 start command to VFD
-        rs485_sendStartCommand();
+        // Close the contactor, start the VFD and enter precharge (control task picks it up on its next period)
+        const charge_profile_t profile = charge_profile_of(selected_battery_profile);
+        charge_control_lock();
+        charge_controller().start(&profile);
+        charge_control_unlock();
         Serial.println("Start cmd sent to vfd, going to scrn3 now.");
 
-        // Initialize charging control variables
-        current_frequency = 0;  // Start at 0 (stopped)
-        last_control_update = 0;  // Reset rate limiting
-        cc_state_start_time = 0;  // Reset CC timing
-        cv_state_start_time = 0;  // Reset CV timing
-        cc_state_duration = 0;    // Reset CC duration
-        cc_state_duration_for_timer = 0;  // Reset for timer calculation
-        precharge_duration_for_timer = 0;
-        
-        // Reset voltage saturation tracking variables
-        base_volt_satu_ref = 0.0f;
-        present_volt_satu_check = 0.0f;
-        last_voltage_saturation_check_time = 0;
-        voltage_saturation_detected_voltage = 0.0f;
-        voltage_saturation_cv_start_time = 0;
-        
-        // Initialize charging start time and reset completion flag
-        charging_start_time = millis();
-        charging_complete = false;
-        final_charging_time_ms = 0;
-        final_remaining_time_ms = 0;
-        pending_stop_command = false;  // Reset stop command flag
-        current_flow_start = false;
-        
-        // Reset Ah calculation
-        accumulated_ah = 0.0f;
-        last_ah_update_time = millis();
-        
-        // Reset and fill charge log record for this cycle
+        // Reset and fill charge log record for this cycle (LVGL task: read the snapshot, not the loop copy)
+        const sensor_data start_sample = sensor_snapshot_get();
         memset(&current_charge_log, 0, sizeof(current_charge_log));
         current_charge_log.serial = getNextSerialNumber();
-        current_charge_log.start_volt = (sensorData.volt > 0.0f) ? sensorData.volt : 0.0f;
-        current_charge_log.start_temp3_celsius = sensorData.temp3 / 100.0f;  // temp3 in 0.01°C
+        current_charge_log.start_volt = (start_sample.volt > 0.0f) ? start_sample.volt : 0.0f;
+        current_charge_log.start_temp3_celsius = start_sample.temp3 / 100.0f;  // temp3 in 0.01°C
         {
             String name = selected_battery_profile->getBatteryName();
             strncpy(current_charge_log.battery_name, name.c_str(), CHARGE_LOG_NAME_MAX - 1);
@@ -1997,13 +1168,40 @@ void screen2_start_button_event_handler(lv_event_t * e) {
                 }
             }
         }
+        charge_session_begin(selected_battery_profile, &current_charge_log);
 
-        // Switch to charging start state
-        current_app_state = STATE_CHARGING_START;
         switch_to_screen(SCREEN_CHARGING_STARTED);
     }
 }
 
+// Interrupted charge that passed the boot re-check (loop): same profile and log line, checkpointed stage.
+// update_screen_based_on_state() then shows the stage's screen.
+void resume_charge_session(BatteryType* battery, const charge_session_record_t* session) {
+    const charge_profile_t profile = charge_profile_of(battery);
+    charge_control_lock();
+    const bool idle = !charge_controller().running();
+    if (idle) {
+        charge_controller().resume(&profile, &session->checkpoint);
+    }
+    charge_control_unlock();
+    if (!idle) {
+        Serial.println("[SESSION] Charger already running, interrupted charge not resumed");
+        return;
+    }
+
+    selected_battery_profile = battery;
+    current_charge_log = session->log;
+    if (sd_logging_initialized && logChargeResume(&current_charge_log)) {
+        log_num_sdhc = (int32_t)current_charge_log.serial;
+        if (TEST_SCREEN && data_table != nullptr) {
+            lvgl_port_lock(-1);
+            lv_table_set_cell_value(data_table, 1, 4, String(log_num_sdhc).c_str());
+            lvgl_port_unlock();
+        }
+    }
+    charge_session_begin(battery, &current_charge_log);
+}
+
 void screen2_reselect_button_event_handler(lv_event_t * e) {
     lv_event_code_t code = lv_event_get_code(e);
     if(code == LV_EVENT_CLICKED) {
@@ -2017,8 +1215,9 @@ void screen2_reselect_button_event_handler(lv_event_t * e) {
         }
 
         // Show battery list again with current voltage
-        if (sensorData.volt > 0) {
-            displayMatchingBatteryProfiles(sensorData.volt, screen2_battery_container);
+        const sensor_data sample = sensor_snapshot_get();
+        if (sample.volt > 0) {
+            displayMatchingBatteryProfiles(sample.volt, screen2_battery_container);
         } else {
             // Show default 0V profile if no voltage detected
             displayMatchingBatteryProfiles(0.0f, screen2_battery_container);
@@ -2032,7 +1231,9 @@ void generic_back_button_event_handler(lv_event_t * e) {
     if(code == LV_EVENT_CLICKED) {
         Serial.println("[SCREEN] BACK button pressed - returning to home screen");
         // Reset state and return to home
-        current_app_state = STATE_HOME;
+        charge_control_lock();
+        charge_controller().reset();
+        charge_control_unlock();
         switch_to_screen(SCREEN_HOME);
     }
 }
@@ -2043,53 +1244,10 @@ void emergency_stop_event_handler(lv_event_t * e) {
     if(code == LV_EVENT_CLICKED) {
         Serial.println("[EMERGENCY] Emergency stop button pressed!");
         
-        // STEP 1: Send 0 RPM command IMMEDIATELY in button callback (100% triggers)
-        Serial.println("[EMERGENCY] Sending 0 RPM command immediately in button callback...");
-        rs485_sendFrequencyCommand(0);  // Send 0 Hz
-        current_frequency = 0;
-        delay(10);  // Give RS485 time to send the command
-        
-        // Open contactor via CAN bus IMMEDIATELY on emergency stop
-        Serial.println("[CONTACTOR] Opening contactor immediately on emergency stop...");
-        send_contactor_control(CONTACTOR_OPEN);
-        
-        // Store final charging time and remaining time before transitioning (if charging was in progress)
-        if (charging_start_time > 0 && !charging_complete) {
-            final_charging_time_ms = millis() - charging_start_time;
-            charging_complete = true;
-            Serial.printf("[EMERGENCY] Final charging time: %lu ms (%.2f minutes)\n", 
-                         final_charging_time_ms, final_charging_time_ms / 60000.0f);
-            
-            // Calculate and store final remaining time (if in CV state)
-            if (cv_start_time > 0 && cc_state_duration_for_timer > 0) {
-                unsigned long cv_elapsed = millis() - cv_start_time;
-                unsigned long cv_target_base = precharge_duration_for_timer + (cc_state_duration_for_timer / 2);  // precharge + 50% CC
-                unsigned long cv_33_min = 33 * 60 * 1000;  // 33 minutes in ms
-                unsigned long target_cv_time = (cv_target_base < cv_33_min) ? cv_target_base : cv_33_min;
-                final_remaining_time_ms = (target_cv_time > cv_elapsed) ? (target_cv_time - cv_elapsed) : 0;
-                Serial.printf("[EMERGENCY] Final remaining time: %lu ms (%.2f minutes)\n", 
-                             final_remaining_time_ms, final_remaining_time_ms / 60000.0f);
-            }
-        }
-        
-        // Set stop reason
-        charge_stop_reason = CHARGE_STOP_EMERGENCY;
-        current_flow_start = false;
-        
-        // Log charge complete
-        if (sd_logging_initialized) {
-            current_charge_log.end_volt = sensorData.volt;
-            current_charge_log.total_time_ms = final_charging_time_ms;
-            current_charge_log.ah_final = accumulated_ah;
-            current_charge_log.stop_reason = charge_stop_reason;
-            logChargeComplete(&current_charge_log);
-        }
-        
-        // Set flag to send stop command after screen 7 loads
-        pending_stop_command = true;
-        
-        // STEP 2: Switch to emergency stop state and screen
-        current_app_state = STATE_EMERGENCY_STOP;
+        // 0 Hz, contactor open and the stop record, with the control task held off
+        charge_control_lock();
+        charge_controller().stop(CHARGE_STOP_EMERGENCY);
+        charge_control_unlock();
         switch_to_screen(SCREEN_EMERGENCY_STOP);
     }
 }
@@ -2101,7 +1259,7 @@ void home_button_event_handler(lv_event_t * e) {
         Serial.println("[HOME] Home button pressed");
         
         // Check if battery is still connected
-        if (battery_detected && sensorData.volt >= 9.0f) {
+        if (battery_detected && sensor_snapshot_get().volt >= 9.0f) {
             // Battery still connected - show message to remove battery
             Serial.println("[HOME] Battery still connected, showing remove battery message");
             
@@ -2126,16 +1284,10 @@ void home_button_event_handler(lv_event_t * e) {
                 lv_obj_add_flag(screen7_remove_battery_popup, LV_OBJ_FLAG_HIDDEN);
             }
             
-            // Reset stop reason
-            charge_stop_reason = CHARGE_STOP_NONE;
-            
-            // Reset timer variables
-            charging_start_time = 0;
-            cv_start_time = 0;
-            cc_state_duration_for_timer = 0;
-            precharge_duration_for_timer = 0;
-            pending_stop_command = false;  // Reset stop command flag
-            current_flow_start = false;
+            // Reset stop reason, timers and flags
+            charge_control_lock();
+            charge_controller().reset();
+            charge_control_unlock();
             
             // Ensure battery_detected is false
             battery_detected = false;
@@ -2144,7 +1296,6 @@ void home_button_event_handler(lv_event_t * e) {
             selected_battery_profile = nullptr;
             
             // Navigate to home screen
-            current_app_state = STATE_HOME;
             switch_to_screen(SCREEN_HOME);
         }
     }
@@ -2600,10 +1751,10 @@ void create_screen_4(void) {
     lv_table_set_col_width(screen4_timer_table, 1, 200);
     lv_table_set_col_width(screen4_timer_table, 2, 240);  // Wider so "Charged(Ah)" doesn't wrap
     lv_table_set_cell_value(screen4_timer_table, 0, 0, "充電時間");
-    lv_table_set_cell_value(screen4_timer_table, 0, 1, "");
+    lv_table_set_cell_value(screen4_timer_table, 0, 1, "残り時間");
     lv_table_set_cell_value(screen4_timer_table, 0, 2, "充電量 (Ah)");
     lv_table_set_cell_value(screen4_timer_table, 1, 0, "00:00:00");
-    lv_table_set_cell_value(screen4_timer_table, 1, 1, "");
+    lv_table_set_cell_value(screen4_timer_table, 1, 1, "--:--");
     lv_table_set_cell_value(screen4_timer_table, 1, 2, "0.0");
     lv_obj_set_style_bg_color(screen4_timer_table, lv_color_hex(0xFFFFFF), LV_PART_ITEMS);  // White
     lv_obj_set_style_border_color(screen4_timer_table, lv_color_hex(0x000000), LV_PART_ITEMS);  // Black border
@@ -2732,7 +1883,7 @@ void create_screen_6(void) {
     lv_obj_set_style_text_font(title, &arjunsJapFont_28, LV_PART_MAIN);
     lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 10);
 
-    // Status label (will be updated dynamically based on charge_stop_reason)
+    // Status label (will be updated dynamically based on the charge stop reason)
     screen6_status_label = lv_label_create(screen_6);
     lv_label_set_text(screen6_status_label, "充電完了");
     lv_obj_set_style_text_color(screen6_status_label, lv_color_hex(0x006400), LV_PART_MAIN);  // Dark green
@@ -3147,34 +2298,17 @@ void create_screen_18(void) {
 
 #include "screen_definitions.h"
 #include "can_twai.h"
+#include "can_stats.h"
 #include "sd_logging.h"
 #include "esp_panel_board_custom_conf.h"
 #include "lvgl_v8_port.h"
 #include "rs485_vfdComs.h"
+#include "charge_control.h"
+#include "charge_session.h"
 #include <Arduino.h>
 #include <string.h>
 #include <esp_heap_caps.h>
-
-// External sensor data
-extern struct sensor_data {
-    float volt;
-    float curr;
-    int32_t temp1;
-    int32_t temp2;
-    int32_t temp3;
-    int32_t temp4;
-} sensorData;
-
-// External time data from M2
-extern struct time_from_m2 {
-    uint16_t year;
-    uint8_t month;
-    uint8_t date;
-    uint8_t day_of_week;  // Note: 1=Sunday in M2, will convert to 1=Monday for display
-    uint8_t hour;
-    uint8_t minute;
-    uint8_t second;
-} m2Time;
+#include "sensor_snapshot.h"  // sensorData / m2Time (loop-task copies); m2Time.day_of_week: 1=Sunday in M2, converted to 1=Monday for display
 
 // ============================================================================
 // Global UI Variables
@@ -3211,23 +2345,9 @@ static lv_obj_t* screen5_temp_label = nullptr;
 static lv_obj_t* screen8_battery_details_label = nullptr;
 static lv_obj_t* screen8_temp_label = nullptr;
 
-// Timer variables for charging screens
-static unsigned long charging_start_time = 0;  // When charging started (screen 3)
-static unsigned long cv_start_time = 0;        // When CV state started (screen 5)
-static unsigned long cc_state_duration_for_timer = 0;  // CC state duration for remaining time calc
-static unsigned long precharge_duration_for_timer = 0;  // Precharge duration (set at precharge->CC transition) for CV time calc
-static unsigned long final_charging_time_ms = 0;  // Final charging time when complete (stops updating)
-static unsigned long final_remaining_time_ms = 0;  // Final remaining time when complete (stops updating)
-static bool charging_complete = false;  // Flag to stop timer updates after completion
-static bool pending_stop_command = false;  // Flag to send stop command after screen loads
-static bool current_flow_start = false;  // True after current >= 1.1 A in step 1; used for disconnect and timeout
-
-// Ah calculation variables
-static float accumulated_ah = 0.0f;  // Accumulated Ah (default 0.0)
-static unsigned long last_ah_update_time = 0;  // Last time Ah was updated (for rate limiting)
 static unsigned long last_rtc_update_time = 0;  // Last time RTC time was updated (for rate limiting, 2Hz = 500ms)
 
-// Charge log record (filled at start, updated during charge, completed at stop)
+// Charge log record (filled at start, completed from the controller's result)
 static charge_log_record_t current_charge_log;
 
 // Log number for SD card display
@@ -3289,28 +2409,10 @@ static lv_obj_t* screen18_rtc_time_label = nullptr;
 
 // Current screen and state tracking
 screen_id_t current_screen_id = SCREEN_HOME;
-app_state_t current_app_state = STATE_HOME;
-charge_stop_reason_t charge_stop_reason = CHARGE_STOP_NONE;
 
 // State-based screen switching triggers
 bool battery_detected = false;
 
-// ============================================================================
-// Charging Control Globals
-// ============================================================================
-static uint16_t current_frequency = 0;                // Current motor frequency in 0.01Hz units (0 = stopped)
-static unsigned long last_control_update = 0;         // Rate limiting for charging control
-static unsigned long cc_state_start_time = 0;         // Time when CC state started (millis)
-static unsigned long cv_state_start_time = 0;         // Time when CV state started (millis)
-static unsigned long cc_state_duration = 0;           // Duration spent in CC state (millis)
-
-// Voltage saturation detection variables (3kW)
-static float base_volt_satu_ref = 0.0f;              // Base voltage reference when entering CC stage
-static float present_volt_satu_check = 0.0f;         // Present voltage for saturation check
-static unsigned long last_voltage_saturation_check_time = 0;  // Last time voltage saturation was checked
-static float voltage_saturation_detected_voltage = 0.0f;      // Voltage when saturation was detected
-static unsigned long voltage_saturation_cv_start_time = 0;   // CV start time for screen 8 state
-
 // M2 heartbeat: frame 101 based (check every 1s after 6s grace; if no 101 for 2100ms -> lost)
 static bool m2_connection_lost = false;
 
@@ -3321,8 +2423,6 @@ void displayMatchingBatteryProfiles(float detectedVoltage, lv_obj_t* container);
 void emergency_stop_event_handler(lv_event_t * e);
 // Forward declaration for home button handler
 void home_button_event_handler(lv_event_t * e);
-// Forward declaration for Ah update function
-void update_accumulated_ah(void);
 
 // ============================================================================
 // Screen Management Functions
@@ -3406,19 +2506,10 @@ void switch_to_screen(screen_id_t screen_id) {
     if (target_screen != nullptr) {
         // On first entry to M2 lost screen only: 0 rpm, stop motor, open contactor (once)
         if (screen_id == SCREEN_M2_LOST && current_screen_id != SCREEN_M2_LOST) {
-            rs485_sendFrequencyCommand(0);
-            delay(5);
-            Serial.println("[M2] 0 rpm sent");
-            rs485_sendStopCommand();
-            delay(5);
-            Serial.println("[M2] Stop motor sent");
-            send_contactor_control(CONTACTOR_OPEN);
-            Serial.println("[M2] Contactor open sent");
-            // Stop charging FSM and clear flags so motor never restarts while on screen 18
-            current_app_state = STATE_EMERGENCY_STOP;
-            charging_complete = true;
-            current_flow_start = false;
-            pending_stop_command = false;
+            // Park the charging FSM so the motor never restarts while on screen 18
+            charge_control_lock();
+            charge_controller().halt();
+            charge_control_unlock();
         }
 
         // Lock LVGL for entire switch (move table + load screen). Prevents first-boot overlay
@@ -3436,12 +2527,11 @@ void switch_to_screen(screen_id_t screen_id) {
         }
 
         // Send stop command after screen 6 or 7 loads (if pending)
-        if (pending_stop_command && (screen_id == SCREEN_CHARGING_COMPLETE || screen_id == SCREEN_EMERGENCY_STOP)) {
+        if (charge_controller().stop_pending() && (screen_id == SCREEN_CHARGING_COMPLETE || screen_id == SCREEN_EMERGENCY_STOP)) {
             delay(50);  // Give screen time to fully load
-            Serial.println("[CHARGING] Sending STOP command to VFD after screen load...");
-            rs485_sendStopCommand();
-            Serial.println("[CHARGING] Stop command sent to VFD - Motor should now be stopped");
-            pending_stop_command = false;  // Clear flag
+            charge_control_lock();
+            charge_controller().send_pending_stop();
+            charge_control_unlock();
         }
 
         // Manage battery container visibility (only for screens that need profiles)
@@ -3593,700 +2683,6 @@ void switch_to_screen(screen_id_t screen_id) {
 
 
 
-
-
-// ============================================================================
-// Charging Control Function start
-// ============================================================================
-void update_charging_control() {
-    // Only run in charging states
-    if (current_app_state != STATE_CHARGING_START && 
-        current_app_state != STATE_CHARGING_CC && 
-        current_app_state != STATE_CHARGING_CV &&
-        current_app_state != STATE_CHARGING_VOLTAGE_SATURATION) { return; }
-    
-    // Check if battery profile is selected
-    if (selected_battery_profile == nullptr) { return; }
-    
-    // Rate limiting: update once per second
-    const unsigned long CONTROL_UPDATE_INTERVAL = 1000; // 1 second
-    if (millis() - last_control_update < CONTROL_UPDATE_INTERVAL) {
-        return;
-    }
-    last_control_update = millis();
-    
-    // Temperature check: Monitor temp1 and temp2 during charging states
-    // Convert from 0.01°C units to Celsius
-    float temp1_celsius = sensorData.temp1 / 100.0f;
-    float temp2_celsius = sensorData.temp2 / 100.0f;
-    
-    // Check if either temperature exceeds threshold
-    if (temp1_celsius > MAX_TEMP_THRESHOLD || temp2_celsius > MAX_TEMP_THRESHOLD) {
-        Serial.printf("[TEMP] High temperature detected! Temp1=%.2f°C, Temp2=%.2f°C, Threshold=%.1f°C\n",
-                     temp1_celsius, temp2_celsius, MAX_TEMP_THRESHOLD);
-        Serial.println("[TEMP] Triggering emergency stop due to high temperature");
-        
-        // STEP 1: Send 0 RPM command IMMEDIATELY
-        Serial.println("[TEMP] Sending 0 RPM command immediately...");
-        rs485_sendFrequencyCommand(0);  // Send 0 Hz
-        current_frequency = 0;
-        delay(10);  // Give RS485 time to send the command
-       
-        // STEP 2: Open contactor via CAN bus IMMEDIATELY
-        Serial.println("[TEMP] Opening contactor immediately on high temperature...");
-        send_contactor_control(CONTACTOR_OPEN);
-        
-        // STEP 3: Store final charging time before transitioning (if charging was in progress)
-        if (charging_start_time > 0 && !charging_complete) {
-            final_charging_time_ms = millis() - charging_start_time;
-            charging_complete = true;
-            Serial.printf("[TEMP] Final charging time: %lu ms (%.2f minutes)\n", 
-                         final_charging_time_ms, final_charging_time_ms / 60000.0f);
-            
-            // Calculate and store final remaining time (if in CV state)
-            if (cv_start_time > 0 && cc_state_duration_for_timer > 0) {
-                unsigned long cv_elapsed = millis() - cv_start_time;
-                unsigned long cv_target_base = precharge_duration_for_timer + (cc_state_duration_for_timer / 2);  // precharge + 50% CC
-                unsigned long cv_33_min = 33 * 60 * 1000;  // 33 minutes in ms
-                unsigned long target_cv_time = (cv_target_base < cv_33_min) ? cv_target_base : cv_33_min;
-                final_remaining_time_ms = (target_cv_time > cv_elapsed) ? (target_cv_time - cv_elapsed) : 0;
-                Serial.printf("[TEMP] Final remaining time: %lu ms (%.2f minutes)\n", 
-                             final_remaining_time_ms, final_remaining_time_ms / 60000.0f);
-            }
-        }
-        
-        // STEP 4: Set stop reason to high temperature
-        charge_stop_reason = CHARGE_STOP_HIGH_TEMP;
-        current_flow_start = false;
-        
-        // Log charge complete
-        if (sd_logging_initialized) {
-            current_charge_log.end_volt = sensorData.volt;
-            current_charge_log.total_time_ms = final_charging_time_ms;
-            current_charge_log.ah_final = accumulated_ah;
-            current_charge_log.stop_reason = charge_stop_reason;
-            logChargeComplete(&current_charge_log);
-        }
-        
-        // STEP 5: Set flag to send stop command after screen 7 loads
-        pending_stop_command = true;
-        
-        // STEP 6: Switch to emergency stop state and screen
-        current_app_state = STATE_EMERGENCY_STOP;
-        switch_to_screen(SCREEN_EMERGENCY_STOP);
-        
-        // Exit early - don't continue with normal charging control
-        return;
-    }
-    
-    // Get target values from battery profile
-    float target_current = selected_battery_profile->getConstCurrent(); // Amps
-    float target_voltage = selected_battery_profile->getCutoffVoltage(); // Volts
-    
-    // Validate and convert sensor data (handle negative values)
-    // Clamp negative values to 0 to prevent unsigned wrap-around
-    float safe_actual_current = (sensorData.curr < 0.0f) ? 0.0f : sensorData.curr;
-    float safe_actual_voltage = (sensorData.volt < 0.0f) ? 0.0f : sensorData.volt;
-    
-    // Convert to 0.01 units (as required by RS485 functions)
-    uint16_t target_current_0_01A = (uint16_t)(target_current * 100);
-    uint16_t target_voltage_0_01V = (uint16_t)(target_voltage * 100);
-    uint16_t actual_current_0_01A = (uint16_t)(safe_actual_current * 100);
-    uint16_t actual_voltage_0_01V = (uint16_t)(safe_actual_voltage * 100);
-    
-    uint16_t new_frequency = current_frequency;
-    
-// State-specific charging logic
-    // ============================================================================
-    // [1] STATE_CHARGING_START: Maintain PRECHARGE_AMPS (2A) for PRECHARGE_TIME (3 minutes), then transition to CC
-    // ============================================================================
-    if (current_app_state == STATE_CHARGING_START) {
-        // Set current_flow_start once current >= 1.5 A (allows 0 A before that; 1.0 A below = disconnect after flow)
-        if (safe_actual_current >= 1.5f) {
-            current_flow_start = true;
-        }
-        // Battery disconnected: current had flowed but now dropped below 1.0 A
-        if (current_flow_start && safe_actual_current < 1.0f) {
-            Serial.println("[CHARGING] Battery disconnected (current < 1.0 A after flow), emergency stop");
-            send_contactor_control(CONTACTOR_OPEN);
-            delay(10);
-            rs485_sendFrequencyCommand(0);
-            current_frequency = 0;
-            delay(10);
-            if (charging_start_time > 0 && !charging_complete) {
-                final_charging_time_ms = millis() - charging_start_time;
-                charging_complete = true;
-            }
-            charge_stop_reason = CHARGE_STOP_BATTERY_DISCONNECTED;
-            if (sd_logging_initialized) {
-                current_charge_log.end_volt = sensorData.volt;
-                current_charge_log.total_time_ms = final_charging_time_ms;
-                current_charge_log.ah_final = accumulated_ah;
-                current_charge_log.stop_reason = charge_stop_reason;
-                logChargeComplete(&current_charge_log);
-            }
-            current_flow_start = false;
-            pending_stop_command = true;
-            current_app_state = STATE_EMERGENCY_STOP;
-            switch_to_screen(SCREEN_EMERGENCY_STOP);
-            return;
-        }
-        // Step 1 safety: no current flow within timeout, or RPM over limit
-        unsigned long step1_elapsed = (charging_start_time > 0) ? (millis() - charging_start_time) : 0;
-        float step1_rpm = VFD_FREQ_TO_RPM(current_frequency / 100.0f);
-
-        if ((step1_elapsed >= PRECHARGE_CURRENT_FLOW_TIMEOUT_MS && !current_flow_start) ||
-        ((step1_rpm > (float)PRECHARGE_RPM_LIMIT) && !current_flow_start)) {
-            Serial.println("[CHARGING] Volt or current error (no flow in time or RPM > limit), emergency stop");
-            send_contactor_control(CONTACTOR_OPEN);
-            delay(10);
-            rs485_sendFrequencyCommand(0);
-            current_frequency = 0;
-            delay(10);
-            if (charging_start_time > 0 && !charging_complete) {
-                final_charging_time_ms = millis() - charging_start_time;
-                charging_complete = true;
-            }
-            charge_stop_reason = CHARGE_STOP_VOLT_OR_CURRENT_ERROR;
-            if (sd_logging_initialized) {
-current_charge_log.end_volt = sensorData.volt;
-            current_charge_log.total_time_ms = final_charging_time_ms;
-            current_charge_log.ah_final = accumulated_ah;
-            current_charge_log.stop_reason = charge_stop_reason;
-            logChargeComplete(&current_charge_log);
-            }
-            current_flow_start = false;
-            pending_stop_command = true;
-            current_app_state = STATE_EMERGENCY_STOP;
-            switch_to_screen(SCREEN_EMERGENCY_STOP);
-            return;
-        }
-        // Use CC logic to maintain current at PRECHARGE_AMPS (2A) - like CC but fixed at precharge level
-        uint16_t precharge_target_0_01A = (uint16_t)(PRECHARGE_AMPS * 100);  // Convert 2A to 0.01A units
-        new_frequency = rs485_CalcFrequencyFor_CC(current_frequency, precharge_target_0_01A, actual_current_0_01A);
- 
-        // Debug logging
-        #if ACTUAL_TARGET_CC_CV_debug
-        int32_t current_error = (int32_t)actual_current_0_01A - (int32_t)precharge_target_0_01A;
-        Serial.printf("[CHARGING_START] Target: %.2fA (Precharge), Actual: %.2fA, Error: %d (0.01A), Freq: %d -> %d (%.2f Hz -> %.2f Hz)\n",
-            PRECHARGE_AMPS, safe_actual_current, current_error,
-            current_frequency, new_frequency,
-            current_frequency / 100.0f, new_frequency / 100.0f);
-        #endif
-        
-        // Send frequency command
-        rs485_sendFrequencyCommand(new_frequency);
-        current_frequency = new_frequency;
-        
-        // Check if voltage reached target voltage before 3 minutes - override and go to complete
-        if (safe_actual_voltage >= target_voltage) {
-            Serial.println("[CHARGING] Voltage limit reached during precharge, transitioning to complete");
-            
-            // STEP 1: Send 0 RPM command IMMEDIATELY when condition is met
-            Serial.println("[CHARGING] Sending 0 RPM command immediately...");
-            rs485_sendFrequencyCommand(0);  // Send 0 Hz
-            current_frequency = 0;
-            delay(10);  // Give RS485 time to send the command
-            
-            // STEP 2: Calculate final charging time
-            unsigned long current_time = millis();
-            if (charging_start_time > 0) {
-                final_charging_time_ms = current_time - charging_start_time;
-                charging_complete = true;
-                Serial.printf("[CHARGING] Final charging time: %lu ms (%.2f minutes)\n", 
-                             final_charging_time_ms, final_charging_time_ms / 60000.0f);
-            }
-            
-            // Open contactor via CAN bus
-            Serial.println("[CONTACTOR] Opening contactor on voltage limit reached during precharge...");
-            send_contactor_control(CONTACTOR_OPEN);
-            
-            // Set stop reason to voltage limit reached during precharge
-            charge_stop_reason = CHARGE_STOP_VOLTAGE_LIMIT_PRECHARGE;
-            
-            // Log charge complete
-            if (sd_logging_initialized) {
-current_charge_log.end_volt = sensorData.volt;
-            current_charge_log.total_time_ms = final_charging_time_ms;
-            current_charge_log.ah_final = accumulated_ah;
-            current_charge_log.stop_reason = charge_stop_reason;
-            logChargeComplete(&current_charge_log);
-            }
-            
-// Transition to complete state
-            current_app_state = STATE_CHARGING_COMPLETE;
-            current_flow_start = false;
-            Serial.println("[CHARGING] Transitioned to charging complete state (voltage limit during precharge)");
-
-            // Set flag to send stop command after screen 6 loads
-            pending_stop_command = true;
-
-            // STEP 3: Move to screen 6
-            switch_to_screen(SCREEN_CHARGING_COMPLETE);
-        }
-        // Check if precharge time elapsed (3 minutes), then transition to CC state
-        else {
-            unsigned long current_time = millis();
-            unsigned long precharge_elapsed = 0;
-            if (charging_start_time > 0) {
-                precharge_elapsed = current_time - charging_start_time;
-            }
-            
-            if (precharge_elapsed >= PRECHARGE_TIME_MS) {
-                Serial.println("[CHARGING] Precharge complete (x min elapsed), transitioning to CC mode");
-                precharge_duration_for_timer = precharge_elapsed;  // For CV time: precharge + 50% CC, max 33 min
-                current_app_state = STATE_CHARGING_CC; //update the fsm state to charging cc
-                cc_state_start_time = millis();  // Record CC state start time
-                Serial.println("[CHARGING] CC state timing started");
-                
-                // Initialize voltage saturation tracking on CC entry
-                base_volt_satu_ref = safe_actual_voltage;  // Record base voltage reference
-                present_volt_satu_check = 0.0f;  // Reset present voltage check
-                last_voltage_saturation_check_time = millis();  // Initialize check time
-                Serial.printf("[VOLT_SAT] CC entry: base_volt_satu_ref = %.2fV\n", base_volt_satu_ref);
-                
-                // Screen switch will happen in determine_screen_from_state()
-            }
-        }
-    }
-
-    // ============================================================================
-    // [2] STATE_CHARGING_CC: Constant Current mode until target voltage reached
-    // ============================================================================
-    else if (current_app_state == STATE_CHARGING_CC) {
-        // Battery disconnected in step 2
-        if (current_flow_start && safe_actual_current < 1.0f) {
-            Serial.println("[CHARGING_CC] Battery disconnected (current < 1.0 A), emergency stop");
-            send_contactor_control(CONTACTOR_OPEN);
-            delay(10);
-            rs485_sendFrequencyCommand(0);
-            current_frequency = 0;
-            delay(10);
-            if (charging_start_time > 0 && !charging_complete) {
-                final_charging_time_ms = millis() - charging_start_time;
-                charging_complete = true;
-            }
-            charge_stop_reason = CHARGE_STOP_BATTERY_DISCONNECTED;
-            if (sd_logging_initialized) {
-                current_charge_log.end_volt = sensorData.volt;
-                current_charge_log.total_time_ms = final_charging_time_ms;
-                current_charge_log.ah_final = accumulated_ah;
-                current_charge_log.stop_reason = charge_stop_reason;
-                logChargeComplete(&current_charge_log);
-            }
-            current_flow_start = false;
-            pending_stop_command = true;
-            current_app_state = STATE_EMERGENCY_STOP;
-            switch_to_screen(SCREEN_EMERGENCY_STOP);
-            return;
-        }
-        new_frequency = rs485_CalcFrequencyFor_CC(current_frequency, target_current_0_01A, actual_current_0_01A); 
-        
-        // Debug logging
-        #if ACTUAL_TARGET_CC_CV_debug
-        int32_t current_error = (int32_t)actual_current_0_01A - (int32_t)target_current_0_01A;
-        Serial.printf("[CHARGING_CC] Target: %.2fA, Actual: %.2fA, Error: %d (0.01A), Freq: %d -> %d (%.2f Hz -> %.2f Hz)\n",
-            target_current, safe_actual_current, current_error,
-            current_frequency, new_frequency,
-            current_frequency / 100.0f, new_frequency / 100.0f);
-        #endif
-        
-        // Send frequency command
-        rs485_sendFrequencyCommand(new_frequency);
-        current_frequency = new_frequency;
-        
-        // Check if 110% capacity reached: Stop charging if accumulated_ah >= 110% of selected_battery_profile Ah
-        if (selected_battery_profile != nullptr) {
-            float battery_profile_ah = (float)selected_battery_profile->getRatedAh();
-            float capacity_threshold = battery_profile_ah * 1.1f;  // 110% of rated capacity
-            
-            if (accumulated_ah >= capacity_threshold) {
-                Serial.printf("[CHARGING_CC] 110%% capacity reached! Accumulated: %.2f Ah, Threshold: %.2f Ah (%.0f Ah * 1.1)\n",
-                             accumulated_ah, capacity_threshold, battery_profile_ah);
-                
-                // Send 0 RPM command immediately
-                Serial.println("[CHARGING_CC] Sending 0 RPM command immediately...");
-                rs485_sendFrequencyCommand(0);  // Send 0 Hz
-                current_frequency = 0;
-                delay(10);  // Give RS485 time to send the command
-                
-                // Open contactor via CAN bus IMMEDIATELY
-                Serial.println("[CONTACTOR] Opening contactor immediately on 110% capacity reached...");
-                send_contactor_control(CONTACTOR_OPEN);
-                
-                // Store final charging time before transitioning (if charging was in progress)
-                if (charging_start_time > 0 && !charging_complete) {
-                    final_charging_time_ms = millis() - charging_start_time;
-                    charging_complete = true;
-                    Serial.printf("[CHARGING_CC] Final charging time: %lu ms (%.2f minutes)\n", 
-                                 final_charging_time_ms, final_charging_time_ms / 60000.0f);
-                    
-                    // Calculate and store final remaining time (if in CV state)
-                    if (cv_start_time > 0 && cc_state_duration_for_timer > 0) {
-                        unsigned long cv_elapsed = millis() - cv_start_time;
-                        unsigned long cv_target_base = precharge_duration_for_timer + (cc_state_duration_for_timer / 2);  // precharge + 50% CC
-                        unsigned long cv_33_min = 33 * 60 * 1000;  // 33 minutes in ms
-                        unsigned long target_cv_time = (cv_target_base < cv_33_min) ? cv_target_base : cv_33_min;
-                        final_remaining_time_ms = (target_cv_time > cv_elapsed) ? (target_cv_time - cv_elapsed) : 0;
-                        Serial.printf("[CHARGING_CC] Final remaining time: %lu ms (%.2f minutes)\n", 
-                                     final_remaining_time_ms, final_remaining_time_ms / 60000.0f);
-                    }
-                }
-                
-                // Set stop reason to 110% capacity reached
-                charge_stop_reason = CHARGE_STOP_110_PERCENT_CAPACITY;
-                current_flow_start = false;
-                
-                // Log charge complete
-                if (sd_logging_initialized) {
-current_charge_log.end_volt = sensorData.volt;
-            current_charge_log.total_time_ms = final_charging_time_ms;
-            current_charge_log.ah_final = accumulated_ah;
-            current_charge_log.stop_reason = charge_stop_reason;
-            logChargeComplete(&current_charge_log);
-                }
-                
-                // Set flag to send stop command after screen 7 loads
-                pending_stop_command = true;
-                
-                // Switch to emergency stop state and screen
-                current_app_state = STATE_EMERGENCY_STOP;
-                switch_to_screen(SCREEN_EMERGENCY_STOP);
-                
-                // Exit early - don't continue with normal charging control
-                return;
-            }
-        }
-        
-        // Voltage saturation check: Check every xx1 minutes (VOLTAGE_SATURATION_CHECK_INTERVAL_MS)
-        unsigned long current_time = millis();
-        if (last_voltage_saturation_check_time > 0 && 
-            (current_time - last_voltage_saturation_check_time) >= VOLTAGE_SATURATION_CHECK_INTERVAL_MS) {
-            
-            // Time to check for voltage saturation
-            present_volt_satu_check = safe_actual_voltage;  // Record present voltage
-            float voltage_difference = present_volt_satu_check - base_volt_satu_ref;
-            
-            Serial.printf("[VOLT_SAT] Check: base=%.2fV, present=%.2fV, diff=%.2fV\n", 
-                         base_volt_satu_ref, present_volt_satu_check, voltage_difference);
-            
-            if (voltage_difference > VOLTAGE_SATURATION_THRESHOLD_V) {
-                // Voltage increased by more than 0.5V - no saturation, continue CC
-                Serial.println("[VOLT_SAT] Voltage increased > 0.5V, no saturation detected. Continuing CC stage.");
-                base_volt_satu_ref = present_volt_satu_check;  // Update base reference
-                present_volt_satu_check = 0.0f;  // Reset present check
-                last_voltage_saturation_check_time = current_time;  // Reset check timer
-            } else {
-                // Voltage increase <= 0.5V (or negative) - saturation detected
-                Serial.printf("[VOLT_SAT] Saturation detected! Voltage diff=%.2fV <= %.2fV\n", 
-                             voltage_difference, VOLTAGE_SATURATION_THRESHOLD_V);
-                Serial.printf("[VOLT_SAT] Recording saturation voltage: %.2fV\n", present_volt_satu_check);
-                
-                // Record the saturation voltage
-                voltage_saturation_detected_voltage = present_volt_satu_check;
-                
-                // Transition to voltage saturation state (Screen 8)
-                current_app_state = STATE_CHARGING_VOLTAGE_SATURATION;
-                voltage_saturation_cv_start_time = millis();  // Record CV start time for screen 8
-                current_flow_start = false;  // Reset on saturate entry
-                Serial.println("[VOLT_SAT] Transitioning to voltage saturation state (Screen 8)");
-                
-                // Immediately calculate and send CV frequency command using saturation voltage
-                uint16_t saturation_voltage_0_01V = (uint16_t)(voltage_saturation_detected_voltage * 100);
-                uint16_t sat_cv_frequency = rs485_CalcFrequencyFor_CV(
-                    current_frequency, 
-                    saturation_voltage_0_01V, 
-                    actual_voltage_0_01V
-                );
-                rs485_sendFrequencyCommand(sat_cv_frequency);
-                current_frequency = sat_cv_frequency;
-                Serial.println("[VOLT_SAT] CV frequency command sent immediately on saturation transition");
-                
-                // Screen switch will happen in determine_screen_from_state()
-                return;  // Exit early, don't check normal voltage transition
-            }
-        }
-        
-        // Check if voltage >= target voltage, then transition to CV state
-        if (safe_actual_voltage >= target_voltage) {
-            Serial.println("[CHARGING] Voltage reached target, transitioning to CV mode");
-            // Calculate CC state duration before transitioning
-            if (cc_state_start_time > 0) {
-                cc_state_duration = millis() - cc_state_start_time;
-                cc_state_duration_for_timer = cc_state_duration;  // Store for remaining time calculation
-                Serial.printf("[CHARGING] CC state duration: %lu ms (%.2f minutes)\n", 
-                    cc_state_duration, cc_state_duration / 60000.0f);
-            }
-            current_app_state = STATE_CHARGING_CV;
-            cv_state_start_time = millis();  // Record CV state start time for charging control
-            cv_start_time = millis();  // Record CV state start time for timer display
-            Serial.println("[CHARGING] CV state timing started");
-            
-            // CRITICAL: Immediately calculate and send CV frequency command to prevent motor freeze
-            // Don't wait for next update_charging_control() call - ensure continuous control
-            uint16_t cv_frequency = rs485_CalcFrequencyFor_CV(
-                current_frequency, 
-                target_voltage_0_01V, 
-                actual_voltage_0_01V
-            );
-            rs485_sendFrequencyCommand(cv_frequency);
-            current_frequency = cv_frequency;
-            Serial.println("[CHARGING] CV frequency command sent immediately on transition");
-            
-// Calculate initial remaining time for immediate display
-            if (cc_state_duration_for_timer > 0) {
-                unsigned long cv_target_base = precharge_duration_for_timer + (cc_state_duration_for_timer / 2);  // precharge + 50% CC
-                unsigned long cv_33_min = 33 * 60 * 1000;  // 33 minutes in ms
-                unsigned long target_cv_time = (cv_target_base < cv_33_min) ? cv_target_base : cv_33_min;
-                unsigned long rem_seconds = target_cv_time / 1000;
-                unsigned long rem_minutes = rem_seconds / 60;
-                rem_seconds = rem_seconds % 60;
-                Serial.printf("[CHARGING] Initial remaining time: %02lu:%02lu (target CV time: %lu ms)\n",
-                             rem_minutes, rem_seconds, target_cv_time);
-            }
-            // Screen switch will happen in determine_screen_from_state()
-        }
-    }
-
-    // [3] STATE_CHARGING_CV: Constant Voltage mode
-    else if (current_app_state == STATE_CHARGING_CV) {
-        // Battery disconnected in step 3
-        if (current_flow_start && safe_actual_current < 1.0f) {
-            Serial.println("[CHARGING_CV] Battery disconnected (current < 1.0 A), emergency stop");
-            send_contactor_control(CONTACTOR_OPEN);
-            delay(10);
-            rs485_sendFrequencyCommand(0);
-            current_frequency = 0;
-            delay(10);
-            if (charging_start_time > 0 && !charging_complete) {
-                final_charging_time_ms = millis() - charging_start_time;
-                charging_complete = true;
-            }
-            charge_stop_reason = CHARGE_STOP_BATTERY_DISCONNECTED;
-            if (sd_logging_initialized) {
-                current_charge_log.end_volt = sensorData.volt;
-                current_charge_log.total_time_ms = final_charging_time_ms;
-                current_charge_log.ah_final = accumulated_ah;
-                current_charge_log.stop_reason = charge_stop_reason;
-                logChargeComplete(&current_charge_log);
-            }
-            current_flow_start = false;
-            pending_stop_command = true;
-            current_app_state = STATE_EMERGENCY_STOP;
-            switch_to_screen(SCREEN_EMERGENCY_STOP);
-            return;
-        }
-        new_frequency = rs485_CalcFrequencyFor_CV(current_frequency, target_voltage_0_01V, actual_voltage_0_01V);
-        
-        // Debug logging
-        #if ACTUAL_TARGET_CC_CV_debug
-        int32_t voltage_error = (int32_t)actual_voltage_0_01V - (int32_t)target_voltage_0_01V;
-        Serial.printf("[CHARGING_CV] Target: %.2fV, Actual: %.2fV, Error: %d (0.01V), Freq: %d -> %d (%.2f Hz -> %.2f Hz)\n",
-            target_voltage, safe_actual_voltage, voltage_error,
-            current_frequency, new_frequency,
-            current_frequency / 100.0f, new_frequency / 100.0f);
-        #endif
-        
-        // Send frequency command
-        rs485_sendFrequencyCommand(new_frequency);
-        current_frequency = new_frequency;
-        
-        // Termination condition: Check if charging is complete
-        // Complete if: 33 minutes in CV mode OR (precharge time + 50% of CC time) has elapsed
-        unsigned long current_time = millis();
-        unsigned long cv_duration = 0;
-        if (cv_state_start_time > 0) {
-            cv_duration = current_time - cv_state_start_time;
-        }
-        
-        const unsigned long CV_COMPLETE_TIME_MS = 33 * 60 * 1000;  // 33 minutes in milliseconds
-        bool cv_time_complete = (cv_duration >= CV_COMPLETE_TIME_MS);
-        
-        // Precharge + 50% of CC state time (if CC duration was recorded)
-        bool cc_time_complete = false;
-        if (cc_state_duration > 0) {
-            unsigned long cv_target_time = precharge_duration_for_timer + (cc_state_duration / 2);
-            unsigned long cv_33_min = 33 * 60 * 1000;
-            unsigned long cv_target_capped = (cv_target_time < cv_33_min) ? cv_target_time : cv_33_min;
-            cc_time_complete = (cv_duration >= cv_target_capped);
-        }
-        
-        if (cv_time_complete || cc_time_complete) {
-            Serial.println("[CHARGING] Charging complete condition met!");
-            
-            // STEP 1: Send 0 RPM command IMMEDIATELY when condition is met
-            Serial.println("[CHARGING] Sending 0 RPM command immediately...");
-            rs485_sendFrequencyCommand(0);  // Send 0 Hz
-            current_frequency = 0;
-            delay(10);  // Give RS485 time to send the command
-            
-            // STEP 2: Now do other things (logging, calculations, etc.)
-            if (cv_time_complete) {
-                Serial.printf("[CHARGING] CV mode duration: %lu ms (%.2f minutes) >= 33 minutes\n",
-                    cv_duration, cv_duration / 60000.0f);
-            }
-            if (cc_time_complete && cc_state_duration > 0) {
-                Serial.printf("[CHARGING] CV duration (%lu ms) >= (precharge + 50%% CC) target\n",
-                    cv_duration);
-            }
-            
-            // Store final charging time and remaining time before transitioning
-            if (charging_start_time > 0) {
-                final_charging_time_ms = millis() - charging_start_time;
-                charging_complete = true;
-                Serial.printf("[CHARGING] Final charging time: %lu ms (%.2f minutes)\n", 
-                             final_charging_time_ms, final_charging_time_ms / 60000.0f);
-                
-                // Calculate and store final remaining time
-                if (cv_start_time > 0 && cc_state_duration_for_timer > 0) {
-                    unsigned long cv_elapsed = millis() - cv_start_time;
-                    unsigned long cv_target_base = precharge_duration_for_timer + (cc_state_duration_for_timer / 2);  // precharge + 50% CC
-                    unsigned long cv_33_min = 33 * 60 * 1000;  // 33 minutes in ms
-                    unsigned long target_cv_time = (cv_target_base < cv_33_min) ? cv_target_base : cv_33_min;
-                    final_remaining_time_ms = (target_cv_time > cv_elapsed) ? (target_cv_time - cv_elapsed) : 0;
-                    Serial.printf("[CHARGING] Final remaining time: %lu ms (%.2f minutes)\n", 
-                                 final_remaining_time_ms, final_remaining_time_ms / 60000.0f);
-                }
-            }
-            
-            // Open contactor via CAN bus (just before moving out of screen 5)
-            Serial.println("[CONTACTOR] Opening contactor before completing charge...");
-            send_contactor_control(CONTACTOR_OPEN);
-            
-            // Set stop reason and transition to complete state
-            charge_stop_reason = CHARGE_STOP_COMPLETE;
-            current_flow_start = false;
-            
-            // Log charge complete
-            if (sd_logging_initialized) {
-current_charge_log.end_volt = sensorData.volt;
-            current_charge_log.total_time_ms = final_charging_time_ms;
-            current_charge_log.ah_final = accumulated_ah;
-            current_charge_log.stop_reason = charge_stop_reason;
-            logChargeComplete(&current_charge_log);
-            }
-            
-            current_app_state = STATE_CHARGING_COMPLETE;
-            
-            // Set flag to send stop command after screen 6 loads
-            pending_stop_command = true;
-            
-            // STEP 3: Move to screen 6
-            switch_to_screen(SCREEN_CHARGING_COMPLETE);
-        }
-    }
-        
-    // [4] STATE_CHARGING_VOLTAGE_SATURATION: Constant Voltage mode using saturation voltage as target
-    else if (current_app_state == STATE_CHARGING_VOLTAGE_SATURATION) {
-        // Battery disconnected in voltage saturation
-        if (current_flow_start && safe_actual_current < 1.0f) {
-            Serial.println("[CHARGING_VOLT_SAT] Battery disconnected (current < 1.0 A), emergency stop");
-            send_contactor_control(CONTACTOR_OPEN);
-            delay(10);
-            rs485_sendFrequencyCommand(0);
-            current_frequency = 0;
-            delay(10);
-            if (charging_start_time > 0 && !charging_complete) {
-                final_charging_time_ms = millis() - charging_start_time;
-                charging_complete = true;
-            }
-            charge_stop_reason = CHARGE_STOP_BATTERY_DISCONNECTED;
-            if (sd_logging_initialized) {
-                current_charge_log.end_volt = sensorData.volt;
-                current_charge_log.total_time_ms = final_charging_time_ms;
-                current_charge_log.ah_final = accumulated_ah;
-                current_charge_log.stop_reason = charge_stop_reason;
-                logChargeComplete(&current_charge_log);
-            }
-            current_flow_start = false;
-            pending_stop_command = true;
-            current_app_state = STATE_EMERGENCY_STOP;
-            switch_to_screen(SCREEN_EMERGENCY_STOP);
-            return;
-        }
-        // Use the recorded saturation voltage as target instead of battery profile cutoff voltage
-        uint16_t saturation_voltage_0_01V = (uint16_t)(voltage_saturation_detected_voltage * 100);
-        
-        new_frequency = rs485_CalcFrequencyFor_CV(current_frequency, saturation_voltage_0_01V, actual_voltage_0_01V);
-        
-        // Debug logging
-        #if ACTUAL_TARGET_CC_CV_debug
-        int32_t voltage_error = (int32_t)actual_voltage_0_01V - (int32_t)saturation_voltage_0_01V;
-        Serial.printf("[CHARGING_VOLT_SAT] Target: %.2fV, Actual: %.2fV, Error: %d (0.01V), Freq: %d -> %d (%.2f Hz -> %.2f Hz)\n",
-            voltage_saturation_detected_voltage, safe_actual_voltage, voltage_error,
-            current_frequency, new_frequency,
-            current_frequency / 100.0f, new_frequency / 100.0f);
-        #endif
-        
-        // Send frequency command
-        rs485_sendFrequencyCommand(new_frequency);
-        current_frequency = new_frequency;
-        
-        // Termination condition: Check if CV duration has reached xx2 minutes (VOLTAGE_SATURATION_CV_DURATION_MS)
-        unsigned long current_time = millis();
-        unsigned long sat_cv_duration = 0;
-        if (voltage_saturation_cv_start_time > 0) {
-            sat_cv_duration = current_time - voltage_saturation_cv_start_time;
-        }
-        
-        bool sat_cv_time_complete = (sat_cv_duration >= VOLTAGE_SATURATION_CV_DURATION_MS);
-        
-        if (sat_cv_time_complete) {
-            Serial.println("[CHARGING] Voltage saturation CV charging complete (xx2 minutes elapsed)!");
-            
-            // STEP 1: Send 0 RPM command IMMEDIATELY when condition is met
-            Serial.println("[CHARGING] Sending 0 RPM command immediately...");
-            rs485_sendFrequencyCommand(0);  // Send 0 Hz
-            current_frequency = 0;
-            delay(10);  // Give RS485 time to send the command
-            
-            // STEP 2: Now do other things (logging, calculations, etc.)
-            // Calculate total charging time
-            if (charging_start_time > 0) {
-                final_charging_time_ms = current_time - charging_start_time;
-                charging_complete = true;
-                Serial.printf("[CHARGING] Final charging time: %lu ms (%.2f minutes)\n", 
-                             final_charging_time_ms, final_charging_time_ms / 60000.0f);
-            }
-            
-            // Open contactor via CAN bus
-            Serial.println("[CONTACTOR] Opening contactor on charging complete...");
-            send_contactor_control(CONTACTOR_OPEN);
-            
-            // Set stop reason to voltage saturation
-            charge_stop_reason = CHARGE_STOP_VOLTAGE_SATURATION;
-            current_flow_start = false;
-            
-            // Log charge complete
-            if (sd_logging_initialized) {
-current_charge_log.end_volt = sensorData.volt;
-            current_charge_log.total_time_ms = final_charging_time_ms;
-            current_charge_log.ah_final = accumulated_ah;
-            current_charge_log.stop_reason = charge_stop_reason;
-            logChargeComplete(&current_charge_log);
-            }
-            
-            // Transition to complete state
-            current_app_state = STATE_CHARGING_COMPLETE;
-            Serial.println("[CHARGING] Transitioned to charging complete state (voltage saturation)");
-            
-            // Set flag to send stop command after screen 6 loads
-            pending_stop_command = true;
-            
-            // STEP 3: Move to screen 6
-            switch_to_screen(SCREEN_CHARGING_COMPLETE);
-        }
-    }
-}
-// ============================================================================
-//main charging control funciton end 
-// ============================================================================
-
-
-
-
-
-
 // Update current screen content (screen-specific updates)
 void update_current_screen() {
     // Screen 1 (home): Update M2 RTC time label only when battery_detected is false (rate limited to 2Hz = 500ms)
@@ -4330,11 +2726,28 @@ void update_current_screen() {
     }
 #endif // CAN_RTC_DEBUG
 
-    // Charging control (runs only in charging states, once per second)
-    update_charging_control();
-    
-    // Update Ah calculation (runs only in charging states)
-    update_accumulated_ah();
+    // Charge finished in the control task or a stop handler: complete the record here (SD write stays off the control path)
+    charge_result_t charge_result;
+    if (charge_control_take_result(&charge_result)) {
+        current_charge_log.end_volt = charge_result.end_volt;
+        current_charge_log.total_time_ms = charge_result.total_time_ms;
+        current_charge_log.ah_final = charge_result.ah_final;
+        current_charge_log.max_volt = charge_result.max_volt;
+        current_charge_log.max_curr = charge_result.max_curr;
+        current_charge_log.max_t1_celsius = charge_result.max_temp1 / 100.0f;
+        current_charge_log.max_t2_celsius = charge_result.max_temp2 / 100.0f;
+        current_charge_log.stop_reason = charge_result.stop_reason;
+        current_charge_log.precharge_ir_ohm = charge_result.precharge_ir_ohm;
+        current_charge_log.precharge_check = charge_result.precharge_check;
+        logChargeComplete(&current_charge_log);
+        logEtaAccuracy(current_charge_log.serial, &charge_result);
+    }
+
+    // Charging state for this pass (the UI only observes the controller)
+    charge_status_t charge;
+    charge_control_lock();
+    charge_controller().status(&charge);
+    charge_control_unlock();
     
     // Check battery removal on screens 6 and 7 - auto-dismiss popup and navigate when battery removed
     if ((current_screen_id == SCREEN_CHARGING_COMPLETE || current_screen_id == SCREEN_EMERGENCY_STOP)) {
@@ -4359,21 +2772,16 @@ void update_current_screen() {
             }
             
             if (should_navigate) {
-                // Reset variables
-                charge_stop_reason = CHARGE_STOP_NONE;
-                charging_start_time = 0;
-                cv_start_time = 0;
-                    cc_state_duration_for_timer = 0;
-                    precharge_duration_for_timer = 0;
-                    pending_stop_command = false;
-                    current_flow_start = false;
+                // Reset charging state and go home
+                charge_control_lock();
+                charge_controller().reset();
+                charge_control_unlock();
                     battery_detected = false;
                     
                     // Clear selected battery profile - user must select again from scratch
                     selected_battery_profile = nullptr;
                     
                     // Navigate to home
-                    current_app_state = STATE_HOME;
                     lvgl_port_unlock();  // Unlock before calling switch_to_screen (which may lock internally)
                     switch_to_screen(SCREEN_HOME);
             } else {
@@ -4436,7 +2844,7 @@ void update_current_screen() {
             lv_obj_clear_flag(screen8_temp_label, LV_OBJ_FLAG_HIDDEN);
         } else {
             char sat_text[60];
-            sprintf(sat_text, "Saturation Voltage: %.2f V", voltage_saturation_detected_voltage);
+            sprintf(sat_text, "Saturation Voltage: %.2f V", charge.saturation_voltage);
             lv_label_set_text(screen8_temp_label, sat_text);
             lv_obj_clear_flag(screen8_temp_label, LV_OBJ_FLAG_HIDDEN);
         }
@@ -4450,12 +2858,12 @@ void update_current_screen() {
                         selected_battery_profile->getDisplayName().c_str(),
                         selected_battery_profile->getCutoffVoltage(),
                         selected_battery_profile->getConstCurrent(),
-                        voltage_saturation_detected_voltage);
+                        charge.saturation_voltage);
             } else {
                 sprintf(details_text, "Selected Battery: %s , %s\nSaturation Voltage: %.2f V",
                         selected_battery_profile->getBatteryName().c_str(),
                         selected_battery_profile->getDisplayName().c_str(),
-                        voltage_saturation_detected_voltage);
+                        charge.saturation_voltage);
             }
             lv_label_set_text(screen8_battery_details_label, details_text);
         } else {
@@ -4465,16 +2873,16 @@ void update_current_screen() {
     
     // Update screen 6 status label based on charge stop reason
     if (screen6_status_label != nullptr && current_screen_id == SCREEN_CHARGING_COMPLETE) {
-        if (charge_stop_reason == CHARGE_STOP_VOLTAGE_LIMIT_PRECHARGE) {
+        if (charge.stop_reason == CHARGE_STOP_VOLTAGE_LIMIT_PRECHARGE) {
             lv_label_set_text(screen6_status_label, "Voltage limit reached during precharge");
             lv_obj_set_style_text_color(screen6_status_label, lv_color_hex(0x006400), LV_PART_MAIN);  // Dark green (info, not error)
-        } else if (charge_stop_reason == CHARGE_STOP_VOLTAGE_SATURATION) {
+        } else if (charge.stop_reason == CHARGE_STOP_VOLTAGE_SATURATION) {
             lv_label_set_text(screen6_status_label, "Charge stopped due to voltage saturate!");
             lv_obj_set_style_text_color(screen6_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
-        } else if (charge_stop_reason == CHARGE_STOP_COMPLETE) {
+        } else if (charge.stop_reason == CHARGE_STOP_COMPLETE) {
             lv_label_set_text(screen6_status_label, "Battery charging completed successfully");
             lv_obj_set_style_text_color(screen6_status_label, lv_color_hex(0x006400), LV_PART_MAIN);  // Dark green
-        } else if (charge_stop_reason == CHARGE_STOP_EMERGENCY) {
+        } else if (charge.stop_reason == CHARGE_STOP_EMERGENCY) {
             // This shouldn't happen on screen 6, but handle it just in case
             lv_label_set_text(screen6_status_label, "Charging stopped by user");
             lv_obj_set_style_text_color(screen6_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
@@ -4487,21 +2895,24 @@ void update_current_screen() {
     
     // Update screen 7 status label based on charge stop reason
     if (screen7_status_label != nullptr && current_screen_id == SCREEN_EMERGENCY_STOP) {
-        if (charge_stop_reason == CHARGE_STOP_HIGH_TEMP) {
+        if (charge.stop_reason == CHARGE_STOP_HIGH_TEMP) {
             lv_label_set_text(screen7_status_label, "High temp detected");
             lv_obj_set_style_text_color(screen7_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
-        } else if (charge_stop_reason == CHARGE_STOP_EMERGENCY) {
+        } else if (charge.stop_reason == CHARGE_STOP_EMERGENCY) {
             lv_label_set_text(screen7_status_label, "Charging stopped by user");
             lv_obj_set_style_text_color(screen7_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
-        } else if (charge_stop_reason == CHARGE_STOP_110_PERCENT_CAPACITY) {
+        } else if (charge.stop_reason == CHARGE_STOP_110_PERCENT_CAPACITY) {
             lv_label_set_text(screen7_status_label, "110% capacity reached");
             lv_obj_set_style_text_color(screen7_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
-        } else if (charge_stop_reason == CHARGE_STOP_BATTERY_DISCONNECTED) {
+        } else if (charge.stop_reason == CHARGE_STOP_BATTERY_DISCONNECTED) {
             lv_label_set_text(screen7_status_label, "Battery disconnected error");
             lv_obj_set_style_text_color(screen7_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
-        } else if (charge_stop_reason == CHARGE_STOP_VOLT_OR_CURRENT_ERROR) {
+        } else if (charge.stop_reason == CHARGE_STOP_VOLT_OR_CURRENT_ERROR) {
             lv_label_set_text(screen7_status_label, "Volt or current error");
             lv_obj_set_style_text_color(screen7_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
+        } else if (charge.stop_reason == CHARGE_STOP_VFD_FAULT) {
+            lv_label_set_text(screen7_status_label, "VFD fault");
+            lv_obj_set_style_text_color(screen7_status_label, lv_color_hex(0x8B0000), LV_PART_MAIN);  // Dark red
         } else {
             // Default message
             lv_label_set_text(screen7_status_label, "Charging stopped by user");
@@ -4512,21 +2923,15 @@ void update_current_screen() {
     // Update timer displays on screens 3, 4, 5, 6, 7, 8
     lvgl_port_lock(-1);  // Lock LVGL for thread safety
     
-    unsigned long total_elapsed = 0;
-    if (charging_complete && final_charging_time_ms > 0) {
-        // Use final time if charging is complete (stops updating)
-        total_elapsed = final_charging_time_ms;
-    } else if (charging_start_time > 0) {
-        // Calculate elapsed time if charging is in progress
-        total_elapsed = millis() - charging_start_time;
-    }
+    // Total time, frozen by the controller when charging completes
+    unsigned long total_elapsed = charge.elapsed_ms;
     
     // Format Ah value (always update, even if time is 0)
     char ah_str[20];
-    sprintf(ah_str, "%.1f", accumulated_ah);
+    sprintf(ah_str, "%.1f", charge.ah);
     
     // Update Ah display on screens 3, 4, 5, 8 (always, not just when time > 0)
-    if (!charging_complete) {
+    if (!charge.complete) {
         if (screen3_timer_table != nullptr && current_screen_id == SCREEN_CHARGING_STARTED) {
             lv_table_set_cell_value(screen3_timer_table, 1, 2, ah_str);
         }
@@ -4552,54 +2957,56 @@ void update_current_screen() {
         sprintf(time_str, "%02lu:%02lu:%02lu", total_hours, total_minutes, total_seconds);
         
         // Update total time on screens 3, 4, 5, 8 (only if charging in progress)
-        if (!charging_complete) {
+        if (!charge.complete) {
             if (screen3_timer_table != nullptr && current_screen_id == SCREEN_CHARGING_STARTED) {
                 lv_table_set_cell_value(screen3_timer_table, 1, 0, time_str);
             }
             if (screen4_timer_table != nullptr && current_screen_id == SCREEN_CHARGING_CC) {
                 lv_table_set_cell_value(screen4_timer_table, 1, 0, time_str);
+
+                // Estimated time to the end of the charge (CC voltage-rise model) as a range, h:mm
+                if (charge.remaining_ms >= 0) {
+                    unsigned long lo_minutes = (unsigned long) charge.remaining_lo_ms / 60000;
+                    if (charge.remaining_hi_ms >= 0) {
+                        unsigned long hi_minutes = (unsigned long) charge.remaining_hi_ms / 60000;
+                        sprintf(time_str, "%lu:%02lu-%lu:%02lu", lo_minutes / 60, lo_minutes % 60,
+                                hi_minutes / 60, hi_minutes % 60);
+                    } else {
+                        sprintf(time_str, ">%lu:%02lu", lo_minutes / 60, lo_minutes % 60);
+                    }
+                    lv_table_set_cell_value(screen4_timer_table, 1, 1, time_str);
+                } else {
+                    // Not enough CC data yet
+                    lv_table_set_cell_value(screen4_timer_table, 1, 1, "--:--");
+                }
             }
             if (screen5_timer_table != nullptr && current_screen_id == SCREEN_CHARGING_CV) {
                 lv_table_set_cell_value(screen5_timer_table, 1, 0, time_str);
                 
-                // Also update remaining time on screen 5 (CV state)
-                if (cv_start_time > 0 && cc_state_duration_for_timer > 0) {
-                    unsigned long cv_elapsed = millis() - cv_start_time;
-                    unsigned long cv_target_base = precharge_duration_for_timer + (cc_state_duration_for_timer / 2);  // precharge + 50% CC
-                    unsigned long cv_33_min = 33 * 60 * 1000;  // 33 minutes in ms
-                    unsigned long target_cv_time = (cv_target_base < cv_33_min) ? cv_target_base : cv_33_min;
-                    unsigned long remaining_time_ms = (target_cv_time > cv_elapsed) ? (target_cv_time - cv_elapsed) : 0;
-                    
-                    unsigned long rem_seconds = remaining_time_ms / 1000;
+                // Also update remaining time on screen 5 (taper to the tail current, capped by the CV time budget)
+                if (charge.remaining_ms >= 0) {
+                    unsigned long rem_seconds = (unsigned long) charge.remaining_ms / 1000;
                     unsigned long rem_minutes = rem_seconds / 60;
                     rem_seconds = rem_seconds % 60;
                     sprintf(time_str, "%02lu:%02lu", rem_minutes, rem_seconds);
                     lv_table_set_cell_value(screen5_timer_table, 1, 1, time_str);
                 } else {
-                    // If cv_start_time or cc_state_duration not set yet, show default
-                    if (cv_start_time == 0) {
-                        lv_table_set_cell_value(screen5_timer_table, 1, 1, "--:--");
-                    } else {
-                        lv_table_set_cell_value(screen5_timer_table, 1, 1, "00:00");
-                    }
+                    // CV not started yet
+                    lv_table_set_cell_value(screen5_timer_table, 1, 1, "--:--");
                 }
             }
             if (screen8_timer_table != nullptr && current_screen_id == SCREEN_VOLTAGE_SATURATION) {
                 lv_table_set_cell_value(screen8_timer_table, 1, 0, time_str);
                 
                 // Also update remaining time on screen 8 (voltage saturation CV state)
-                if (voltage_saturation_cv_start_time > 0) {
-                    unsigned long sat_cv_elapsed = millis() - voltage_saturation_cv_start_time;
-                    unsigned long remaining_time_ms = (VOLTAGE_SATURATION_CV_DURATION_MS > sat_cv_elapsed) ? 
-                                                      (VOLTAGE_SATURATION_CV_DURATION_MS - sat_cv_elapsed) : 0;
-                    
-                    unsigned long rem_seconds = remaining_time_ms / 1000;
+                if (charge.remaining_ms >= 0) {
+                    unsigned long rem_seconds = (unsigned long) charge.remaining_ms / 1000;
                     unsigned long rem_minutes = rem_seconds / 60;
                     rem_seconds = rem_seconds % 60;
                     sprintf(time_str, "%02lu:%02lu", rem_minutes, rem_seconds);
                     lv_table_set_cell_value(screen8_timer_table, 1, 1, time_str);
                 } else {
-                    // If voltage_saturation_cv_start_time not set yet, show default
+                    // Saturation CV not started yet
                     lv_table_set_cell_value(screen8_timer_table, 1, 1, "--:--");
                 }
             }
@@ -4611,8 +3018,8 @@ void update_current_screen() {
             lv_table_set_cell_value(screen6_timer_table, 1, 2, ah_str);
             
             // Also display final remaining time on screen 6
-            if (final_remaining_time_ms > 0) {
-                unsigned long rem_seconds = final_remaining_time_ms / 1000;
+            if (charge.remaining_ms > 0) {
+                unsigned long rem_seconds = (unsigned long) charge.remaining_ms / 1000;
                 unsigned long rem_minutes = rem_seconds / 60;
                 rem_seconds = rem_seconds % 60;
                 sprintf(time_str, "%02lu:%02lu", rem_minutes, rem_seconds);
@@ -4641,22 +3048,23 @@ screen_id_t determine_screen_from_state() {
         return SCREEN_M2_LOST;
     }
     // Priority-based screen selection
-    if (current_app_state == STATE_CHARGING_START) {
+    const app_state_t state = charge_controller().state();
+    if (state == STATE_CHARGING_START) {
         return SCREEN_CHARGING_STARTED;
     }
-    if (current_app_state == STATE_CHARGING_CC) {
+    if (state == STATE_CHARGING_CC) {
         return SCREEN_CHARGING_CC;
     }
-    if (current_app_state == STATE_CHARGING_CV) {
+    if (state == STATE_CHARGING_CV) {
         return SCREEN_CHARGING_CV;
     }
-    if (current_app_state == STATE_CHARGING_VOLTAGE_SATURATION) {
+    if (state == STATE_CHARGING_VOLTAGE_SATURATION) {
         return SCREEN_VOLTAGE_SATURATION;
     }
-    if (current_app_state == STATE_CHARGING_COMPLETE) {
+    if (state == STATE_CHARGING_COMPLETE) {
         return SCREEN_CHARGING_COMPLETE;
     }
-    if (current_app_state == STATE_EMERGENCY_STOP) {
+    if (state == STATE_EMERGENCY_STOP) {
         return SCREEN_EMERGENCY_STOP;
     }
 #if CAN_RTC_DEBUG
@@ -4698,6 +3106,7 @@ void check_m2_heartbeat(void) {
     if (last_101 == 0 || (now - last_101) > LOST_THRESHOLD_MS) {
         m2_connection_lost = true;
         if (current_screen_id != SCREEN_M2_LOST) {
+            can_stats_dump();  // Tell a dead M2 from a saturated/faulty bus
             switch_to_screen(SCREEN_M2_LOST);
         }
     } else {
@@ -4786,20 +3195,6 @@ void update_table_values() {
     // Lock LVGL before updating UI
     lvgl_port_lock(-1);
 
-    // Update max values during charge (non-blocking)
-    if (charging_start_time > 0 && !charging_complete) {
-        if (sensorData.curr > current_charge_log.max_curr) {
-            current_charge_log.max_curr = sensorData.curr;
-        }
-        if (sensorData.volt > current_charge_log.max_volt) {
-            current_charge_log.max_volt = sensorData.volt;
-        }
-        float t1 = sensorData.temp1 / 100.0f;
-        float t2 = sensorData.temp2 / 100.0f;
-        if (t1 > current_charge_log.max_t1_celsius) current_charge_log.max_t1_celsius = t1;
-        if (t2 > current_charge_log.max_t2_celsius) current_charge_log.max_t2_celsius = t2;
-    }
-
     if (data_table != nullptr) {
         // Update voltage (column 0)
         lv_table_set_cell_value(data_table, 1, 0,
@@ -4816,7 +3211,7 @@ void update_table_values() {
 
         // Column 3: RPM if TEST_SCREEN else Power
         if (TEST_SCREEN) {
-            float freq_hz = current_frequency / 100.0f;
+            float freq_hz = charge_controller().frequency() / 100.0f;
             float rpm = VFD_FREQ_TO_RPM(freq_hz);
             lv_table_set_cell_value(data_table, 1, 3, String((int)rpm).c_str());
         } else {
@@ -4837,51 +3232,6 @@ void update_table_values() {
     lvgl_port_unlock();
 }
 
-// Update accumulated Ah based on current flow
-void update_accumulated_ah(void) {
-    // Only run in charging states
-    if (current_app_state != STATE_CHARGING_START && 
-        current_app_state != STATE_CHARGING_CC && 
-        current_app_state != STATE_CHARGING_CV) {
-        return;
-    }
-    
-    // Rate limiting: update every 1 second
-    const unsigned long AH_UPDATE_INTERVAL = 1000; // 1 second
-    unsigned long current_time = millis();
-    
-    // Initialize on first call or if reset
-    if (last_ah_update_time == 0) {
-        last_ah_update_time = current_time;
-        Serial.println("[AH] Ah calculation initialized");
-        return;
-    }
-    
-    // Check if enough time has passed
-    if (current_time - last_ah_update_time < AH_UPDATE_INTERVAL) {
-        return;
-    }
-    
-    // Calculate time delta in hours
-    unsigned long time_delta_ms = current_time - last_ah_update_time;
-    float time_delta_hours = time_delta_ms / 3600000.0f; // Convert ms to hours
-    
-    // Get current (handle negative values)
-    float safe_current = (sensorData.curr < 0.0f) ? 0.0f : sensorData.curr;
-    
-    // Ah = current (A) * time (h)
-    float ah_increment = safe_current * time_delta_hours;
-    accumulated_ah += ah_increment;
-    
-    #if Ah_CALCULATION_DEBUG
-        // Debug logging
-        Serial.printf("[AH] Current: %.2fA, Time: %.3fh, Increment: %.4fAh, Total: %.2fAh\n",
-                    safe_current, time_delta_hours, ah_increment, accumulated_ah);
-    #endif
-    
-    last_ah_update_time = current_time;
-}
-
 // Update CAN debug screen with received frame
 void update_can_debug_display(uint32_t id, uint8_t* data, uint8_t length) {
     if (screen13_can_frame_label != nullptr && current_screen_id == SCREEN_CAN_DEBUG) {
@@ -5076,47 +3426,19 @@ void screen2_start_button_event_handler(lv_event_t * e) {
     if(code == LV_EVENT_CLICKED) {
         Serial.println("[SCREEN2] START button pressed - switching to charging screen");
 
-        // Close contactor via CAN bus (M1 -> M2)
-        Serial.println("[CONTACTOR] Closing contactor before starting charge...");
-        send_contactor_control(CONTACTOR_CLOSE);
-        
-        // Send RS485 start command to VFD
-        rs485_sendStartCommand();
+        // Close the contactor, start the VFD and enter precharge (control task picks it up on its next period)
+        const charge_profile_t profile = charge_profile_of(selected_battery_profile);
+        charge_control_lock();
+        charge_controller().start(&profile);
+        charge_control_unlock();
         Serial.println("Start cmd sent to vfd, going to scrn3 now.");
 
-        // Initialize charging control variables
-        current_frequency = 0;  // Start at 0 (stopped)
-        last_control_update = 0;  // Reset rate limiting
-        cc_state_start_time = 0;  // Reset CC timing
-        cv_state_start_time = 0;  // Reset CV timing
-        cc_state_duration = 0;    // Reset CC duration
-        cc_state_duration_for_timer = 0;  // Reset for timer calculation
-        precharge_duration_for_timer = 0;
-        
-        // Reset voltage saturation tracking variables
-        base_volt_satu_ref = 0.0f;
-        present_volt_satu_check = 0.0f;
-        last_voltage_saturation_check_time = 0;
-        voltage_saturation_detected_voltage = 0.0f;
-        voltage_saturation_cv_start_time = 0;
-        
-        // Initialize charging start time and reset completion flag
-        charging_start_time = millis();
-        charging_complete = false;
-        final_charging_time_ms = 0;
-        final_remaining_time_ms = 0;
-        pending_stop_command = false;  // Reset stop command flag
-        current_flow_start = false;
-        
-        // Reset Ah calculation
-        accumulated_ah = 0.0f;
-        last_ah_update_time = millis();
-        
-        // Reset and fill charge log record for this cycle
+        // Reset and fill charge log record for this cycle (LVGL task: read the snapshot, not the loop copy)
+        const sensor_data start_sample = sensor_snapshot_get();
         memset(&current_charge_log, 0, sizeof(current_charge_log));
         current_charge_log.serial = getNextSerialNumber();
-        current_charge_log.start_volt = (sensorData.volt > 0.0f) ? sensorData.volt : 0.0f;
-        current_charge_log.start_temp3_celsius = sensorData.temp3 / 100.0f;  // temp3 in 0.01°C
+        current_charge_log.start_volt = (start_sample.volt > 0.0f) ? start_sample.volt : 0.0f;
+        current_charge_log.start_temp3_celsius = start_sample.temp3 / 100.0f;  // temp3 in 0.01°C
         {
             String name = selected_battery_profile->getBatteryName();
             strncpy(current_charge_log.battery_name, name.c_str(), CHARGE_LOG_NAME_MAX - 1);
@@ -5136,13 +3458,40 @@ void screen2_start_button_event_handler(lv_event_t * e) {
                 }
             }
         }
+        charge_session_begin(selected_battery_profile, &current_charge_log);
 
-        // Switch to charging start state
-        current_app_state = STATE_CHARGING_START;
         switch_to_screen(SCREEN_CHARGING_STARTED);
     }
 }
 
+// Interrupted charge that passed the boot re-check (loop): same profile and log line, checkpointed stage.
+// update_screen_based_on_state() then shows the stage's screen.
+void resume_charge_session(BatteryType* battery, const charge_session_record_t* session) {
+    const charge_profile_t profile = charge_profile_of(battery);
+    charge_control_lock();
+    const bool idle = !charge_controller().running();
+    if (idle) {
+        charge_controller().resume(&profile, &session->checkpoint);
+    }
+    charge_control_unlock();
+    if (!idle) {
+        Serial.println("[SESSION] Charger already running, interrupted charge not resumed");
+        return;
+    }
+
+    selected_battery_profile = battery;
+    current_charge_log = session->log;
+    if (sd_logging_initialized && logChargeResume(&current_charge_log)) {
+        log_num_sdhc = (int32_t)current_charge_log.serial;
+        if (TEST_SCREEN && data_table != nullptr) {
+            lvgl_port_lock(-1);
+            lv_table_set_cell_value(data_table, 1, 4, String(log_num_sdhc).c_str());
+            lvgl_port_unlock();
+        }
+    }
+    charge_session_begin(battery, &current_charge_log);
+}
+
 void screen2_reselect_button_event_handler(lv_event_t * e) {
     lv_event_code_t code = lv_event_get_code(e);
     if(code == LV_EVENT_CLICKED) {
@@ -5156,8 +3505,9 @@ void screen2_reselect_button_event_handler(lv_event_t * e) {
         }
 
         // Show battery list again with current voltage
-        if (sensorData.volt > 0) {
-            displayMatchingBatteryProfiles(sensorData.volt, screen2_battery_container);
+        const sensor_data sample = sensor_snapshot_get();
+        if (sample.volt > 0) {
+            displayMatchingBatteryProfiles(sample.volt, screen2_battery_container);
         } else {
             // Show default 0V profile if no voltage detected
             displayMatchingBatteryProfiles(0.0f, screen2_battery_container);
@@ -5171,7 +3521,9 @@ void generic_back_button_event_handler(lv_event_t * e) {
     if(code == LV_EVENT_CLICKED) {
         Serial.println("[SCREEN] BACK button pressed - returning to home screen");
         // Reset state and return to home
-        current_app_state = STATE_HOME;
+        charge_control_lock();
+        charge_controller().reset();
+        charge_control_unlock();
         switch_to_screen(SCREEN_HOME);
     }
 }
@@ -5182,53 +3534,10 @@ void emergency_stop_event_handler(lv_event_t * e) {
     if(code == LV_EVENT_CLICKED) {
         Serial.println("[EMERGENCY] Emergency stop button pressed!");
         
-        // STEP 1: Send 0 RPM command IMMEDIATELY in button callback (100% triggers)
-        Serial.println("[EMERGENCY] Sending 0 RPM command immediately in button callback...");
-        rs485_sendFrequencyCommand(0);  // Send 0 Hz
-        current_frequency = 0;
-        delay(10);  // Give RS485 time to send the command
-        
-        // Open contactor via CAN bus IMMEDIATELY on emergency stop
-        Serial.println("[CONTACTOR] Opening contactor immediately on emergency stop...");
-        send_contactor_control(CONTACTOR_OPEN);
-        
-        // Store final charging time and remaining time before transitioning (if charging was in progress)
-        if (charging_start_time > 0 && !charging_complete) {
-            final_charging_time_ms = millis() - charging_start_time;
-            charging_complete = true;
-            Serial.printf("[EMERGENCY] Final charging time: %lu ms (%.2f minutes)\n", 
-                         final_charging_time_ms, final_charging_time_ms / 60000.0f);
-            
-            // Calculate and store final remaining time (if in CV state)
-            if (cv_start_time > 0 && cc_state_duration_for_timer > 0) {
-                unsigned long cv_elapsed = millis() - cv_start_time;
-                unsigned long cv_target_base = precharge_duration_for_timer + (cc_state_duration_for_timer / 2);  // precharge + 50% CC
-                unsigned long cv_33_min = 33 * 60 * 1000;  // 33 minutes in ms
-                unsigned long target_cv_time = (cv_target_base < cv_33_min) ? cv_target_base : cv_33_min;
-                final_remaining_time_ms = (target_cv_time > cv_elapsed) ? (target_cv_time - cv_elapsed) : 0;
-                Serial.printf("[EMERGENCY] Final remaining time: %lu ms (%.2f minutes)\n", 
-                             final_remaining_time_ms, final_remaining_time_ms / 60000.0f);
-            }
-        }
-        
-        // Set stop reason
-        charge_stop_reason = CHARGE_STOP_EMERGENCY;
-        current_flow_start = false;
-        
-        // Log charge complete
-        if (sd_logging_initialized) {
-            current_charge_log.end_volt = sensorData.volt;
-            current_charge_log.total_time_ms = final_charging_time_ms;
-            current_charge_log.ah_final = accumulated_ah;
-            current_charge_log.stop_reason = charge_stop_reason;
-            logChargeComplete(&current_charge_log);
-        }
-        
-        // Set flag to send stop command after screen 7 loads
-        pending_stop_command = true;
-        
-        // STEP 2: Switch to emergency stop state and screen
-        current_app_state = STATE_EMERGENCY_STOP;
+        // 0 Hz, contactor open and the stop record, with the control task held off
+        charge_control_lock();
+        charge_controller().stop(CHARGE_STOP_EMERGENCY);
+        charge_control_unlock();
         switch_to_screen(SCREEN_EMERGENCY_STOP);
     }
 }
@@ -5240,7 +3549,7 @@ void home_button_event_handler(lv_event_t * e) {
         Serial.println("[HOME] Home button pressed");
         
         // Check if battery is still connected
-        if (battery_detected && sensorData.volt >= 9.0f) {
+        if (battery_detected && sensor_snapshot_get().volt >= 9.0f) {
             // Battery still connected - show message to remove battery
             Serial.println("[HOME] Battery still connected, showing remove battery message");
             
@@ -5265,16 +3574,10 @@ void home_button_event_handler(lv_event_t * e) {
                 lv_obj_add_flag(screen7_remove_battery_popup, LV_OBJ_FLAG_HIDDEN);
             }
             
-            // Reset stop reason
-            charge_stop_reason = CHARGE_STOP_NONE;
-            
-            // Reset timer variables
-            charging_start_time = 0;
-            cv_start_time = 0;
-            cc_state_duration_for_timer = 0;
-            precharge_duration_for_timer = 0;
-            pending_stop_command = false;  // Reset stop command flag
-            current_flow_start = false;
+            // Reset stop reason, timers and flags
+            charge_control_lock();
+            charge_controller().reset();
+            charge_control_unlock();
             
             // Ensure battery_detected is false
             battery_detected = false;
@@ -5283,7 +3586,6 @@ void home_button_event_handler(lv_event_t * e) {
             selected_battery_profile = nullptr;
             
             // Navigate to home screen
-            current_app_state = STATE_HOME;
             switch_to_screen(SCREEN_HOME);
         }
     }
@@ -5738,10 +4040,10 @@ void create_screen_4(void) {
     lv_table_set_col_width(screen4_timer_table, 1, 200);
     lv_table_set_col_width(screen4_timer_table, 2, 240);  // Wider so "Charged(Ah)" doesn't wrap
     lv_table_set_cell_value(screen4_timer_table, 0, 0, "Total Time");
-    lv_table_set_cell_value(screen4_timer_table, 0, 1, "");
+    lv_table_set_cell_value(screen4_timer_table, 0, 1, "Remaining");
     lv_table_set_cell_value(screen4_timer_table, 0, 2, "Charged(Ah)");
     lv_table_set_cell_value(screen4_timer_table, 1, 0, "00:00:00");
-    lv_table_set_cell_value(screen4_timer_table, 1, 1, "");
+    lv_table_set_cell_value(screen4_timer_table, 1, 1, "--:--");
     lv_table_set_cell_value(screen4_timer_table, 1, 2, "0.0");
     lv_obj_set_style_bg_color(screen4_timer_table, lv_color_hex(0xFFFFFF), LV_PART_ITEMS);  // White
     lv_obj_set_style_border_color(screen4_timer_table, lv_color_hex(0x000000), LV_PART_ITEMS);  // Black border
@@ -5870,7 +4172,7 @@ void create_screen_6(void) {
     lv_obj_set_style_text_font(title, &lv_font_montserrat_26, LV_PART_MAIN);
     lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 10);
 
-    // Status label (will be updated dynamically based on charge_stop_reason)
+    // Status label (will be updated dynamically based on the charge stop reason)
     screen6_status_label = lv_label_create(screen_6);
     lv_label_set_text(screen6_status_label, "Battery charging completed successfully");
     lv_obj_set_style_text_color(screen6_status_label, lv_color_hex(0x006400), LV_PART_MAIN);  // Dark green
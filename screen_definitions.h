@@ -3,26 +3,7 @@
 
 #include <lvgl.h>
 #include "battery_types.h"
-
-// Debug macro for CC/CV charging control prints
-#define ACTUAL_TARGET_CC_CV_debug 0  // 1 = print, 0 = print off
-#define Ah_CALCULATION_DEBUG 0  // 1 = print, 0 = print off
-
-// Voltage saturation detection macros (3kW)
-#define VOLTAGE_SATURATION_CHECK_INTERVAL_MS (10 * 60 * 1000)  // xx1: 10 minutes in milliseconds
-#define VOLTAGE_SATURATION_CV_DURATION_MS (5 * 60 * 1000)     // xx2: 5 minutes in milliseconds
-#define VOLTAGE_SATURATION_THRESHOLD_V 0.2f                   // 0.2V threshold for saturation detection
-
-// Precharge timing macros (Screen 3 - Charging Start)
-//#define PRECHARGE_TIME_MS (1.2 * 60 * 1000)  // 3 minutes in milliseconds
-#define PRECHARGE_TIME_MS (5 * 60 * 1000)  // 3 minutes in milliseconds
-#define PRECHARGE_AMPS 5.0f                // 2.0 Amps threshold
-// Step 1 safety: current must flow within this time, else volt_or_current error
-#define PRECHARGE_CURRENT_FLOW_TIMEOUT_MS (45 * 1000)  // 45 seconds (precharge can be 1 min)
-#define PRECHARGE_RPM_LIMIT 3700           // RPM above this in step 1 -> volt_or_current error
-
-// Temperature threshold macro
-#define MAX_TEMP_THRESHOLD 80.0f           // 80.0 degrees Celsius
+#include "charge_controller.h"  // app_state_t, charge_stop_reason_t, charging limits
 
 // CAN/RTC Debug screens macro (0 = hidden for production, 1 = visible for debugging)
 #define CAN_RTC_DEBUG 0  // can, rtc screens hidden for production
@@ -63,33 +44,7 @@ typedef enum {
     SCREEN_M2_LOST = 18        // Screen 18 - M2 connection failed or lost
 } screen_id_t;
 
-typedef enum {
-    STATE_HOME = 0,               // Home state
-    STATE_BATTERY_DETECTED,       // Battery detected
-    STATE_CHARGING_START,         // Charging start (waiting for 1A current)
-    STATE_CHARGING_CC,            // Constant Current mode
-    STATE_CHARGING_CV,            // Constant Voltage mode
-    STATE_CHARGING_VOLTAGE_SATURATION, // Voltage saturation detected (CV with saturation voltage)
-    STATE_CHARGING_COMPLETE,      // Charging complete
-    STATE_EMERGENCY_STOP          // Emergency stop
-} app_state_t;
-
-// Charge stop reason enum
-typedef enum {
-    CHARGE_STOP_NONE = 0,              // No stop reason
-    CHARGE_STOP_COMPLETE = 1,          // Charging complete (normal termination)
-    CHARGE_STOP_EMERGENCY = 2,         // Emergency stop (user initiated)
-    CHARGE_STOP_VOLTAGE_SATURATION = 3, // Charge stopped due to voltage saturation
-    CHARGE_STOP_VOLTAGE_LIMIT_PRECHARGE = 4, // Voltage limit reached during precharge
-    CHARGE_STOP_HIGH_TEMP = 5,         // Emergency stop due to high temperature
-    CHARGE_STOP_110_PERCENT_CAPACITY = 6, // Charge stopped: 110% capacity reached, Ah limit
-    CHARGE_STOP_BATTERY_DISCONNECTED = 7, // Battery disconnected (current dropped below 1.0 A after flow)
-    CHARGE_STOP_VOLT_OR_CURRENT_ERROR = 8 // Step 1: no current flow in time or RPM > limit
-} charge_stop_reason_t;
-
 extern screen_id_t current_screen_id;
-extern app_state_t current_app_state;
-extern charge_stop_reason_t charge_stop_reason;
 
 // Function declarations for creating custom UI screens
 void create_screen_1(void); //screen 1 - default screen
@@ -111,11 +66,12 @@ void update_current_screen(void);
 screen_id_t determine_screen_from_state(void);
 void update_screen_based_on_state(void);
 void check_m2_heartbeat(void);  // Call every 1s from loop; 6s startup grace, 2100ms no-frame-101 -> M2 lost
+struct charge_session_record;    // charge_session.h (includes this header through sd_logging.h)
+void resume_charge_session(BatteryType* battery, const struct charge_session_record* session);  // loop, after charge_session_take_resume()
 
 // Table and UI update functions
 void update_table_values(void);
 void update_can_debug_display(uint32_t id, uint8_t* data, uint8_t length);
 void update_time_debug_display(void); // Update time display on screen 16
-void update_charging_control(void); // Charging control logic (CC/CV)
 
 #endif // SCREEN_DEFINITIONS_H
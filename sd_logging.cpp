@@ -1,17 +1,7 @@
 #include "sd_logging.h"
 #include <SD.h>
 #include "screen_definitions.h"
-
-// External time data from M2
-extern struct time_from_m2 {
-    uint16_t year;
-    uint8_t month;
-    uint8_t date;
-    uint8_t day_of_week;
-    uint8_t hour;
-    uint8_t minute;
-    uint8_t second;
-} m2Time;
+#include "sensor_snapshot.h"
 
 // Global SD logging initialization flag
 bool sd_logging_initialized = false;
@@ -24,10 +14,13 @@ ScreenLogger screenLogger;
 // Note: Leading slash required for ESP32 SD library root directory files
 #define CHARGE_LOG_FILE "/chglog_v2.dat"
 
+// Remaining-time estimate vs actual, per charge (logEtaAccuracy)
+#define ETA_LOG_FILE "/eta_log.csv"
+
 static void repairIncompleteLastLine();  // forward decl
 
 // Initialize charge logging (check/create charge_log.dat file)
-bool initChargeLogging() {
+bool initChargeLogging(bool keep_incomplete_line) {
     // Check if SD card is available (cardType should not be CARD_NONE)
     uint8_t cardType = SD.cardType();
     if (cardType == CARD_NONE) {
@@ -118,7 +111,9 @@ bool initChargeLogging() {
     }
 
     Serial.println("[SD_LOG] charge_log.dat file exists");
-    repairIncompleteLastLine();  // if power was lost after start but before complete, close incomplete line with \n
+    if (!keep_incomplete_line) {
+        repairIncompleteLastLine();  // if power was lost after start but before complete, close incomplete line with \n
+    }
     return true;
 }
 
@@ -146,6 +141,43 @@ static void repairIncompleteLastLine() {
     }
 }
 
+void closeIncompleteChargeLine() {
+    if (sd_logging_initialized) {
+        repairIncompleteLastLine();
+    }
+}
+
+// Last line has only its start part and belongs to this serial
+static bool lastLineOpenForSerial(uint32_t serial) {
+    File file = SD.open(CHARGE_LOG_FILE, FILE_READ);
+    if (!file) return false;
+    size_t sz = file.size();
+    if (sz == 0) {
+        file.close();
+        return false;
+    }
+    file.seek(sz - 1, SeekSet);
+    if ((char)file.read() == '\n') {
+        file.close();
+        return false;
+    }
+    // Back to the start of the last line
+    size_t start = sz - 1;
+    while (start > 0) {
+        file.seek(start - 1, SeekSet);
+        if ((char)file.read() == '\n') break;
+        start--;
+    }
+    file.seek(start, SeekSet);
+    char head[16];
+    size_t n = file.read((uint8_t*)head, sizeof(head) - 1);
+    head[n] = '\0';
+    file.close();
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "%lu,", (unsigned long)serial);
+    return strncmp(head, prefix, strlen(prefix)) == 0;
+}
+
 // Get next serial number from charge_log.dat file
 uint32_t getNextSerialNumber() {
     if (!sd_logging_initialized) {
@@ -202,12 +234,13 @@ uint32_t getNextSerialNumber() {
     return nextSerial;
 }
 
-// Get timestamp string from m2Time struct
+// Get timestamp string from the M2 time snapshot (called from loop and LVGL event handlers)
 String getTimestampString() {
+    time_from_m2 now = m2_time_snapshot_get();
     char timestamp[20];
     sprintf(timestamp, "%04d-%02d-%02d %02d:%02d:%02d",
-            m2Time.year, m2Time.month, m2Time.date,
-            m2Time.hour, m2Time.minute, m2Time.second);
+            now.year, now.month, now.date,
+            now.hour, now.minute, now.second);
     return String(timestamp);
 }
 
@@ -230,12 +263,32 @@ String getChargeStopReasonString(charge_stop_reason_t reason) {
             return "BATT_DISCONNECT";
         case CHARGE_STOP_VOLT_OR_CURRENT_ERROR:
             return "VOLT_CURR_ERR";
+        case CHARGE_STOP_VFD_FAULT:
+            return "VFD_FAULT";
         case CHARGE_STOP_NONE:
         default:
             return "UNKNOWN";
     }
 }
 
+String getPrechargeCheckString(charge_precharge_t check) {
+    switch (check) {
+        case CHARGE_PRECHARGE_EARLY:
+            return "EARLY";
+        case CHARGE_PRECHARGE_FULL_SHORT:
+            return "FULL_SHORT";
+        case CHARGE_PRECHARGE_FULL_DEEP:
+            return "FULL_DEEP";
+        case CHARGE_PRECHARGE_FULL_HIGH_IR:
+            return "FULL_HIGH_IR";
+        case CHARGE_PRECHARGE_FULL_NO_STEP:
+            return "FULL_NO_STEP";
+        case CHARGE_PRECHARGE_NONE:
+        default:
+            return "NONE";
+    }
+}
+
 // Log charge start event
 bool logChargeStart(const charge_log_record_t* record) {
     if (!sd_logging_initialized) {
@@ -248,6 +301,7 @@ bool logChargeStart(const charge_log_record_t* record) {
         return false;
     }
 
+    repairIncompleteLastLine();  // a new charge never continues an open line (interrupted charge not resumed)
     File file = SD.open(CHARGE_LOG_FILE, FILE_APPEND);
     if (!file) {
         Serial.println("[SD_LOG] Failed to open charge_log.dat for appending");
@@ -281,6 +335,18 @@ bool logChargeStart(const charge_log_record_t* record) {
     return true;
 }
 
+// Resumed charge: completes on its open line, or on a new start line with the same serial
+bool logChargeResume(const charge_log_record_t* record) {
+    if (!sd_logging_initialized || !record) {
+        return false;
+    }
+    if (lastLineOpenForSerial(record->serial)) {
+        Serial.printf("[SD_LOG] Charge %lu resumed on its open line\n", (unsigned long)record->serial);
+        return true;
+    }
+    return logChargeStart(record);
+}
+
 // Log charge complete/stop event
 bool logChargeComplete(const charge_log_record_t* record) {
     if (!sd_logging_initialized) {
@@ -299,7 +365,7 @@ bool logChargeComplete(const charge_log_record_t* record) {
         return false;
     }
 
-    // Append: ,end_ts,end_volt,...,max_t2,complete_flag\n  (complete_flag=1 so next startup knows line is complete)
+    // Append: ,end_ts,end_volt,...,max_t2,precharge_ir_mohm,precharge,complete_flag\n  (complete_flag=1 so next startup knows line is complete)
     String end_ts = getTimestampString();
     file.print(",");
     file.print(end_ts);
@@ -319,12 +385,51 @@ bool logChargeComplete(const charge_log_record_t* record) {
     file.print(record->max_t1_celsius, 1);
     file.print(",");
     file.print(record->max_t2_celsius, 1);
+    file.print(",");
+    file.print((record->precharge_ir_ohm >= 0.0f) ? record->precharge_ir_ohm * 1000.0f : -1.0f, 1);
+    file.print(",");
+    file.print(getPrechargeCheckString(record->precharge_check));
     file.print(",1\n");  // completion flag 1 = second part written; avoids next log appending to same line after power loss
 
     file.close();
-    Serial.printf("[SD_LOG] Charge complete logged: end_volt=%.1f, max_volt=%.1f, max_t1=%.1f, max_t2=%.1f, reason=%s\n",
+    Serial.printf("[SD_LOG] Charge complete logged: end_volt=%.1f, max_volt=%.1f, max_t1=%.1f, max_t2=%.1f, reason=%s, precharge=%s\n",
                   record->end_volt, record->max_volt, record->max_t1_celsius, record->max_t2_celsius,
-                  getChargeStopReasonString(record->stop_reason).c_str());
+                  getChargeStopReasonString(record->stop_reason).c_str(),
+                  getPrechargeCheckString(record->precharge_check).c_str());
     return true;
 }
 
+
+// Append the charge's remaining-time estimates with the actual remaining time of each
+bool logEtaAccuracy(uint32_t serial, const charge_result_t* result) {
+    if (!sd_logging_initialized || !result || result->eta_points == 0) {
+        return false;
+    }
+
+    bool new_file = !SD.exists(ETA_LOG_FILE);
+    File file = SD.open(ETA_LOG_FILE, FILE_APPEND);
+    if (!file) {
+        Serial.println("[SD_LOG] Failed to open eta_log.csv for appending");
+        return false;
+    }
+    if (new_file) {
+        file.print("serial,elapsed_s,state,est_remaining_s,est_lo_s,est_hi_s,actual_remaining_s,stop_reason\n");
+    }
+
+    String reason = getChargeStopReasonString(result->stop_reason);
+    for (uint8_t i = 0; i < result->eta_points; i++) {
+        const eta_point_t* point = &result->eta[i];
+        long actual = (result->total_time_ms >= point->elapsed_ms) ?
+                      (long)((result->total_time_ms - point->elapsed_ms) / 1000) : 0;
+        file.printf("%lu,%lu,%u,%ld,%ld,%ld,%ld,%s\n", (unsigned long) serial,
+                    (unsigned long)(point->elapsed_ms / 1000), (unsigned) point->state,
+                    point->remaining_ms < 0 ? -1L : (long)(point->remaining_ms / 1000),
+                    point->lo_ms < 0 ? -1L : (long)(point->lo_ms / 1000),
+                    point->hi_ms < 0 ? -1L : (long)(point->hi_ms / 1000),
+                    actual, reason.c_str());
+    }
+    file.close();
+    Serial.printf("[SD_LOG] ETA accuracy logged: serial=%lu, %u estimates\n",
+                  (unsigned long) serial, (unsigned) result->eta_points);
+    return true;
+}
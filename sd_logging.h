@@ -24,7 +24,7 @@ extern bool sd_logging_initialized;
 // Battery name is UTF-8 (e.g. Japanese). Log viewer: open file with encoding='utf-8'.
 #define CHARGE_LOG_NAME_MAX 96  // UTF-8 bytes
 
-// Log format (one line per charge, UTF-8): serial, start_ts, start_volt, start_temp3, "battery_name", v, ah, tc, tv, end_ts, end_volt, max_volt, max_curr, total_time_ms, ah_final, stop_reason, max_t1, max_t2, complete_flag (1=second part written; if power lost before complete, line has no newline and startup appends \n to close it)
+// Log format (one line per charge, UTF-8): serial, start_ts, start_volt, start_temp3, "battery_name", v, ah, tc, tv, end_ts, end_volt, max_volt, max_curr, total_time_ms, ah_final, stop_reason, max_t1, max_t2, precharge_ir_mohm, precharge, complete_flag (1=second part written; if power lost before complete, line has no newline and startup appends \n to close it)
 
 typedef struct charge_log_record {
     uint32_t serial;
@@ -43,11 +43,16 @@ typedef struct charge_log_record {
     unsigned long total_time_ms;
     float ah_final;
     charge_stop_reason_t stop_reason;
+    float precharge_ir_ohm;     // IR from the precharge step, < 0 = not measured
+    charge_precharge_t precharge_check;
 } charge_log_record_t;
 
 // Initialize charge logging (check/create charge_log.dat file)
+// keep_incomplete_line: an interrupted charge may resume onto its open line (charge_session.h);
+// logChargeResume() continues it, closeIncompleteChargeLine() or the next logChargeStart() closes it.
 // Returns true if successful, false otherwise
-bool initChargeLogging();
+bool initChargeLogging(bool keep_incomplete_line = false);
+void closeIncompleteChargeLine();
 
 // Get next serial number from charge_log.dat file
 // Returns next serial number (starts at 1 if file is empty)
@@ -58,13 +63,24 @@ uint32_t getNextSerialNumber();
 // CSV: serial,start_ts,start_volt,start_temp3,"battery_name",v,ah,tc,tv
 bool logChargeStart(const charge_log_record_t* record);
 
+// Resumed charge (same record, same serial): nothing written if the last line is this charge's
+// open start part, else that line is closed and the start part written again
+bool logChargeResume(const charge_log_record_t* record);
+
 // Log charge complete/stop event (appends rest of line + newline)
 // Record must have: end_volt, max_volt, max_curr, max_t1_celsius, max_t2_celsius,
-// total_time_ms, ah_final, stop_reason set. end_ts is taken at write time.
-// Appends: ,end_ts,end_volt,max_volt,max_curr,total_time_ms,ah_final,stop_reason,max_t1,max_t2,complete_flag\n
+// total_time_ms, ah_final, stop_reason, precharge_ir_ohm, precharge_check set. end_ts is taken at write time.
+// Appends: ,end_ts,end_volt,max_volt,max_curr,total_time_ms,ah_final,stop_reason,max_t1,max_t2,
+//          precharge_ir_mohm,precharge,complete_flag\n  (precharge_ir_mohm -1 = not measured)
 // complete_flag=1 when second part written; on startup, if file doesn't end with \n, last line is repaired (append \n) so next log starts on new line.
 bool logChargeComplete(const charge_log_record_t* record);
 
+// Remaining-time estimates of a finished charge against the actual remaining time
+// (ETA_LOG_FILE, one line per estimate, header written when the file is created).
+// CSV: serial,elapsed_s,state,est_remaining_s,est_lo_s,est_hi_s,actual_remaining_s,stop_reason
+// -1 = no estimate / open band.
+bool logEtaAccuracy(uint32_t serial, const charge_result_t* result);
+
 // ============================================================================
 // Screen Logging Functions (Simple logging without NTP/RTC)
 // ============================================================================
@@ -0,0 +1,60 @@
+#include "sensor_snapshot.h"
+#include "seqlock.h"
+
+// Published snapshots
+static Seqlock<sensor_data> sensor_seqlock;
+static Seqlock<time_from_m2> m2_time_seqlock;
+
+// Writer-side working copy: each publish updates some fields and republishes the whole sample.
+// Writers are serialised (and kept from being preempted by a same-core reader) by this spinlock.
+static sensor_data sensor_staging;
+static portMUX_TYPE sensor_writer_mux = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE m2_time_writer_mux = portMUX_INITIALIZER_UNLOCKED;
+
+sensor_data sensor_snapshot_get(void) {
+    sensor_data sample;
+    sensor_seqlock.read(&sample);
+    return sample;
+}
+
+uint32_t sensor_snapshot_read(sensor_data* out) {
+    return sensor_seqlock.read(out);
+}
+
+uint32_t sensor_snapshot_version(void) {
+    return sensor_seqlock.version();
+}
+
+time_from_m2 m2_time_snapshot_get(void) {
+    time_from_m2 time;
+    m2_time_seqlock.read(&time);
+    return time;
+}
+
+void sensor_snapshot_publish_vi(float volt, float curr, uint32_t rx_ms) {
+    portENTER_CRITICAL(&sensor_writer_mux);
+    sensor_staging.volt = volt;
+    sensor_staging.curr = curr;
+    sensor_staging.vi_rx_ms = rx_ms;
+    sensor_staging.seq++;
+    sensor_seqlock.write(sensor_staging);
+    portEXIT_CRITICAL(&sensor_writer_mux);
+}
+
+void sensor_snapshot_publish_temps(int32_t temp1, int32_t temp2, int32_t temp3, int32_t temp4, uint32_t rx_ms) {
+    portENTER_CRITICAL(&sensor_writer_mux);
+    sensor_staging.temp1 = temp1;
+    sensor_staging.temp2 = temp2;
+    sensor_staging.temp3 = temp3;
+    sensor_staging.temp4 = temp4;
+    sensor_staging.temp_rx_ms = rx_ms;
+    sensor_staging.seq++;
+    sensor_seqlock.write(sensor_staging);
+    portEXIT_CRITICAL(&sensor_writer_mux);
+}
+
+void m2_time_snapshot_publish(const time_from_m2* time) {
+    portENTER_CRITICAL(&m2_time_writer_mux);
+    m2_time_seqlock.write(*time);
+    portEXIT_CRITICAL(&m2_time_writer_mux);
+}
@@ -0,0 +1,54 @@
+#ifndef SENSOR_SNAPSHOT_H
+#define SENSOR_SNAPSHOT_H
+
+#include <Arduino.h>
+
+// ============================================================================
+// Sensor sample from M2 (CAN 0x101 voltage/current, 0x102 temperatures)
+// ============================================================================
+struct sensor_data {
+    float volt = -3.0f;
+    float curr = -3.0f;
+    int32_t temp1 = 0;        // 0.01 °C (motor)
+    int32_t temp2 = 0;        // 0.01 °C (GCU / generator)
+    int32_t temp3 = 0;        // 0.01 °C (room)
+    int32_t temp4 = 0;        // 0.01 °C
+    uint32_t vi_rx_ms = 0;    // millis() when the volt/curr frame (0x101) was received, 0 = never
+    uint32_t temp_rx_ms = 0;  // millis() when the temperature frame (0x102) was received, 0 = never
+    uint32_t seq = 0;         // Incremented on every publish
+};
+
+// Time data from M2 (CAN 0x103)
+struct time_from_m2 {
+    uint16_t year = 2010;
+    uint8_t month = 1;
+    uint8_t date = 1;
+    uint8_t day_of_week = 1; // 1=Sunday
+    uint8_t hour = 0;
+    uint8_t minute = 0;
+    uint8_t second = 0;
+};
+
+// Loop-task copies, refreshed from the snapshots once per loop() pass so every
+// function called in that pass sees volt/curr/temps from the same publish.
+// Code running in other tasks (LVGL event handlers, CAN task) must use the
+// snapshot readers below instead.
+extern sensor_data sensorData;
+extern time_from_m2 m2Time;
+
+// ============================================================================
+// Readers (lock-free, any task; never take lvgl_port_lock)
+// ============================================================================
+sensor_data sensor_snapshot_get(void);
+uint32_t sensor_snapshot_read(sensor_data* out);     // Returns snapshot version
+uint32_t sensor_snapshot_version(void);              // Changes whenever a new sample is published
+time_from_m2 m2_time_snapshot_get(void);
+
+// ============================================================================
+// Writers (CAN task; serial debug input). Each call publishes a whole new sample.
+// ============================================================================
+void sensor_snapshot_publish_vi(float volt, float curr, uint32_t rx_ms);
+void sensor_snapshot_publish_temps(int32_t temp1, int32_t temp2, int32_t temp3, int32_t temp4, uint32_t rx_ms);
+void m2_time_snapshot_publish(const time_from_m2* time);
+
+#endif // SENSOR_SNAPSHOT_H
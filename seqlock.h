@@ -0,0 +1,75 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+// ============================================================================
+// Seqlock<T> - lock-free versioned snapshot of a small trivially copyable struct
+// ============================================================================
+/*
+One writer at a time publishes a whole value; any number of readers take a
+consistent copy without locking. The sequence counter is odd while a write is
+in progress, readers retry if it was odd or changed during their copy.
+The payload is stored as relaxed 32-bit atomics so the copy itself is race free.
+
+Writers must be serialised by the caller (e.g. a portMUX critical section) and
+must not be preemptible by a reader on the same core, otherwise that reader spins.
+*/
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock<T> needs a trivially copyable T");
+
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> payload[WORDS];
+
+public:
+    Seqlock() : sequence(0) {
+        write(T{});
+    }
+
+    // Publish a new value (single writer at a time)
+    void write(const T& value) {
+        uint32_t words[WORDS] = {0};
+        memcpy(words, &value, sizeof(T));
+
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);  // odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++) {
+            payload[i].store(words[i], std::memory_order_relaxed);
+        }
+        sequence.store(seq + 2, std::memory_order_release);  // even: stable
+    }
+
+    // Copy the latest value into *out; returns its version (number of writes so far)
+    uint32_t read(T* out) const {
+        uint32_t words[WORDS];
+        for (;;) {
+            uint32_t seq_before = sequence.load(std::memory_order_acquire);
+            if (seq_before & 1) {
+                continue;  // writer active
+            }
+            for (size_t i = 0; i < WORDS; i++) {
+                words[i] = payload[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == seq_before) {
+                memcpy(out, words, sizeof(T));
+                return seq_before >> 1;
+            }
+        }
+    }
+
+    // Version of the latest value without copying it (cheap "anything new?" check)
+    uint32_t version() const {
+        return sequence.load(std::memory_order_acquire) >> 1;
+    }
+};
+
+#endif // SEQLOCK_H
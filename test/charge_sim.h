@@ -0,0 +1,132 @@
+#ifndef CHARGE_SIM_H
+#define CHARGE_SIM_H
+
+#include "charge_controller.h"
+#include "plant_sim.h"
+#include "battery_types.h"
+#include "rs485_vfdComs.h"
+#include <string>
+#include <vector>
+
+// ============================================================================
+// ChargeController on the plant model, under a simulated clock
+// ============================================================================
+/*
+The controller runs against fake sinks wired to plant_model_step(): every period the
+plant advances 100 ms in 10 ms steps and the sensor source returns its terminal voltage
+and current in 0.01 units, as M2 sends them. Nothing waits on real time, so a charge of
+several hours runs in milliseconds. One plant per process (single-threaded tests).
+*/
+
+#define CHARGE_SIM_PERIOD_MS      100
+#define CHARGE_SIM_PLANT_STEP_MS  10
+#define CHARGE_SIM_MAX_CHARGE_MS  (6UL * 3600 * 1000)
+
+static plant_model_t plant;
+static unsigned long sim_now_ms;
+static uint32_t sim_seq;
+static charge_vfd_t vfd_state = CHARGE_VFD_OK;
+static charge_vfd_t vfd_trip = CHARGE_VFD_OK;      // VFD state from vfd_trip_ms on
+static unsigned long vfd_trip_ms = 0;              // Into the charge; 0 = never
+
+class SimClock : public ChargeClock {
+public:
+    unsigned long now_ms(void) override { return sim_now_ms; }
+};
+
+class SimSensors : public ChargeSensorSource {
+public:
+    charge_sample_t read(void) override {
+        charge_sample_t sample;
+        sample.volt = (int)(plant.terminal_v * 100.0f + 0.5f) / 100.0f;
+        sample.curr = (int)(plant.current_a * 100.0f + 0.5f) / 100.0f;
+        sample.temp1 = (int32_t)(plant.temp_motor_c * 100.0f);
+        sample.temp2 = (int32_t)(plant.temp_gen_c * 100.0f);
+        sample.seq = sim_seq;
+        sample.vi_ms = sim_now_ms;
+        sample.interlock = CHARGE_INTERLOCK_NONE;
+        sample.vfd = vfd_state;
+        return sample;
+    }
+};
+
+class SimVfd : public ChargeVfdSink {
+public:
+    void start(void) override { plant.vfd_running = true; }
+    void set_frequency(uint16_t freq_0_01Hz) override { plant.freq_cmd_hz = freq_0_01Hz / 100.0f; }
+    void stop(void) override { plant.vfd_running = false; }
+    uint16_t min_frequency(void) const override { return RS485_FREQ_MIN; }
+    uint16_t max_frequency(void) const override { return RS485_FREQ_MAX; }
+    float rpm_per_hz(void) const override { return 20.0f; }
+};
+
+class SimContactor : public ChargeContactorSink {
+public:
+    void set_closed(bool closed) override { plant.contactor_closed = closed; }
+};
+
+class RecordingLog : public ChargeLogSink {
+public:
+    std::vector<std::string> lines;
+    charge_result_t result;
+    bool finished = false;
+
+    void message(const char* text) override { lines.push_back(text); }
+    void charge_finished(const charge_result_t* charge) override {
+        result = *charge;
+        finished = true;
+    }
+    bool contains(const char* text) const {
+        for (const std::string& line : lines) {
+            if (line.find(text) != std::string::npos) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static charge_profile_t profile_of(const BatteryType* battery, uint8_t plan_id = CHARGE_PLAN_STANDARD) {
+    charge_profile_t profile;
+    profile.battery = battery;
+    profile.const_current = battery->getConstCurrent();
+    profile.cutoff_voltage = battery->getCutoffVoltage();
+    profile.rated_ah = (float) battery->getRatedAh();
+    profile.rated_voltage = (float) battery->getRatedVoltage();
+    charge_plan_compile(&profile.plan, plan_id, profile.const_current, profile.cutoff_voltage, profile.rated_ah);
+    return profile;
+}
+
+// Whole charge from soc_pct; returns the state the controller ended in
+static app_state_t run_charge(const BatteryType* battery, float soc_pct, RecordingLog* log,
+                              uint8_t plan_id = CHARGE_PLAN_STANDARD) {
+    SimClock clock;
+    SimSensors sensors;
+    SimVfd vfd;
+    SimContactor contactor;
+    ChargeController controller(clock, sensors, vfd, contactor, *log, CHARGE_SIM_PERIOD_MS);
+    charge_profile_t profile = profile_of(battery, plan_id);
+
+    plant_model_init(&plant, battery, soc_pct);
+    // Twice the model's EMF per Hz: from the 30 Hz minimum at 3 Hz/s, flow then starts well
+    // inside PRECHARGE_CURRENT_FLOW_TIMEOUT_MS (the default needs about 48 s)
+    plant.ke_v_per_hz *= 2.0f;
+    sim_now_ms = 1000;
+    vfd_state = CHARGE_VFD_OK;
+    controller.start(&profile);
+    while (controller.running() && sim_now_ms < CHARGE_SIM_MAX_CHARGE_MS) {
+        if (vfd_trip_ms > 0 && sim_now_ms >= vfd_trip_ms) {
+            vfd_state = vfd_trip;
+        }
+        for (int i = 0; i < CHARGE_SIM_PERIOD_MS / CHARGE_SIM_PLANT_STEP_MS; i++) {
+            plant_model_step(&plant, CHARGE_SIM_PLANT_STEP_MS / 1000.0f);
+        }
+        sim_now_ms += CHARGE_SIM_PERIOD_MS;
+        sim_seq++;
+        controller.step();
+    }
+    controller.send_pending_stop();
+    return controller.state();
+}
+
+#endif // CHARGE_SIM_H
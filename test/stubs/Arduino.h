@@ -0,0 +1,75 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// ============================================================================
+// Host stand-in for the parts of the Arduino core the tested modules use
+// ============================================================================
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+
+#define SERIAL_8N1 0x800001c
+
+class String {
+    std::string text;
+public:
+    String(const char* s = "") : text(s) {}
+    String(const std::string& s) : text(s) {}
+    String(int v) : text(std::to_string(v)) {}
+    String(unsigned int v) : text(std::to_string(v)) {}
+    String(long v) : text(std::to_string(v)) {}
+    String(unsigned long v) : text(std::to_string(v)) {}
+    String(float v, unsigned int decimals = 2) : String((double) v, decimals) {}
+    String(double v, unsigned int decimals = 2) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.*f", (int) decimals, v);
+        text = buffer;
+    }
+    const char* c_str() const { return text.c_str(); }
+    unsigned int length() const { return (unsigned int) text.size(); }
+    char charAt(unsigned int index) const { return index < text.size() ? text[index] : 0; }
+    void trim(void) {
+        size_t first = text.find_first_not_of(" \t\r\n");
+        size_t last = text.find_last_not_of(" \t\r\n");
+        text = (first == std::string::npos) ? std::string() : text.substr(first, last - first + 1);
+    }
+    String& operator+=(const String& other) { text += other.text; return *this; }
+    friend String operator+(const String& a, const String& b) { return String(a.text + b.text); }
+    bool operator==(const String& other) const { return text == other.text; }
+};
+
+// Serial output goes to stdout, prefixed so test logs show where it came from
+class HardwareSerial {
+public:
+    void begin(unsigned long, uint32_t = SERIAL_8N1, int8_t = -1, int8_t = -1) {}
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    size_t print(const char* text) { return printf("%s", text); }
+    size_t print(const String& text) { return printf("%s", text.c_str()); }
+    size_t println(const char* text = "") { return printf("%s\n", text); }
+    size_t println(const String& text) { return printf("%s\n", text.c_str()); }
+    size_t write(const uint8_t*, size_t length) { return length; }
+    int available(void) { return 0; }
+    int read(void) { return -1; }
+    void flush(void) {}
+};
+extern HardwareSerial Serial;
+extern HardwareSerial Serial2;
+extern bool host_serial_quiet;  // Tests set this to drop Serial output
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(uint32_t ms);
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,62 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+// In-memory NVS: one map shared by every Preferences object, empty at start
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class Preferences {
+    std::string name_space;
+
+    static std::map<std::string, std::vector<uint8_t>>& store(void) {
+        static std::map<std::string, std::vector<uint8_t>> entries;
+        return entries;
+    }
+    std::string key_of(const char* key) const { return name_space + "/" + key; }
+
+public:
+    bool begin(const char* name, bool read_only = false, const char* partition = nullptr) {
+        (void) read_only;
+        (void) partition;
+        name_space = name;
+        return true;
+    }
+    void end(void) {}
+    size_t putBytes(const char* key, const void* value, size_t length) {
+        const uint8_t* bytes = (const uint8_t*) value;
+        store()[key_of(key)].assign(bytes, bytes + length);
+        return length;
+    }
+    size_t getBytes(const char* key, void* value, size_t length) {
+        auto it = store().find(key_of(key));
+        if (it == store().end()) {
+            return 0;
+        }
+        size_t count = it->second.size() < length ? it->second.size() : length;
+        memcpy(value, it->second.data(), count);
+        return count;
+    }
+    size_t getBytesLength(const char* key) {
+        auto it = store().find(key_of(key));
+        return it == store().end() ? 0 : it->second.size();
+    }
+    bool isKey(const char* key) { return store().count(key_of(key)) > 0; }
+    bool remove(const char* key) { return store().erase(key_of(key)) > 0; }
+    size_t putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+    uint32_t getUInt(const char* key, uint32_t fallback = 0) {
+        uint32_t value = fallback;
+        getBytes(key, &value, sizeof(value));
+        return value;
+    }
+    bool clear(void) {
+        std::string prefix = name_space + "/";
+        for (auto it = store().begin(); it != store().end();) {
+            it = (it->first.compare(0, prefix.size(), prefix) == 0) ? store().erase(it) : std::next(it);
+        }
+        return true;
+    }
+};
+
+#endif // HOST_PREFERENCES_H
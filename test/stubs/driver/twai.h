@@ -0,0 +1,120 @@
+#ifndef HOST_DRIVER_TWAI_H
+#define HOST_DRIVER_TWAI_H
+
+// ============================================================================
+// Host TWAI shim: the driver API over a bounded RX queue fed by the test
+// ============================================================================
+/*
+twai_shim_inject() plays the bus: it puts a frame in the driver RX queue (dropped
+with TWAI_ALERT_RX_QUEUE_FULL when rx_queue_len frames are waiting, like the real
+driver) and raises TWAI_ALERT_RX_DATA for twai_read_alerts(). Transmitted frames
+are counted and discarded.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "../esp_err.h"
+#include "../freertos/FreeRTOS.h"
+
+typedef enum { GPIO_NUM_15 = 15, GPIO_NUM_16 = 16 } gpio_num_t;
+#define TWAI_IO_UNUSED ((gpio_num_t) -1)
+
+typedef enum { TWAI_MODE_NORMAL, TWAI_MODE_NO_ACK, TWAI_MODE_LISTEN_ONLY } twai_mode_t;
+
+typedef struct {
+    union {
+        struct {
+            uint32_t extd: 1;
+            uint32_t rtr: 1;
+            uint32_t ss: 1;
+            uint32_t self: 1;
+            uint32_t dlc_non_comp: 1;
+            uint32_t reserved: 27;
+        };
+        uint32_t flags;
+    };
+    uint32_t identifier;
+    uint8_t data_length_code;
+    uint8_t data[8];
+} twai_message_t;
+
+typedef struct {
+    twai_mode_t mode;
+    gpio_num_t tx_io;
+    gpio_num_t rx_io;
+    gpio_num_t clkout_io;
+    gpio_num_t bus_off_io;
+    uint32_t tx_queue_len;
+    uint32_t rx_queue_len;
+    uint32_t alerts_enabled;
+    uint32_t clkout_divider;
+    int intr_flags;
+} twai_general_config_t;
+
+typedef struct {
+    uint32_t brp;
+    uint8_t tseg_1;
+    uint8_t tseg_2;
+    uint8_t sjw;
+    bool triple_sampling;
+} twai_timing_config_t;
+
+typedef struct {
+    uint32_t acceptance_code;
+    uint32_t acceptance_mask;
+    bool single_filter;
+} twai_filter_config_t;
+
+typedef enum { TWAI_STATE_STOPPED, TWAI_STATE_RUNNING, TWAI_STATE_BUS_OFF, TWAI_STATE_RECOVERING } twai_state_t;
+
+typedef struct {
+    twai_state_t state;
+    uint32_t msgs_to_tx;
+    uint32_t msgs_to_rx;
+    uint32_t tx_error_counter;
+    uint32_t rx_error_counter;
+    uint32_t tx_failed_count;
+    uint32_t rx_missed_count;
+    uint32_t rx_overrun_count;
+    uint32_t arb_lost_count;
+    uint32_t bus_error_count;
+} twai_status_info_t;
+
+#define TWAI_ALERT_TX_IDLE              0x00000001
+#define TWAI_ALERT_TX_SUCCESS           0x00000002
+#define TWAI_ALERT_RX_DATA              0x00000004
+#define TWAI_ALERT_BELOW_ERR_WARN       0x00000008
+#define TWAI_ALERT_ERR_ACTIVE           0x00000010
+#define TWAI_ALERT_RECOVERY_IN_PROGRESS 0x00000020
+#define TWAI_ALERT_BUS_RECOVERED        0x00000040
+#define TWAI_ALERT_ARB_LOST             0x00000080
+#define TWAI_ALERT_ABOVE_ERR_WARN       0x00000100
+#define TWAI_ALERT_BUS_ERROR            0x00000200
+#define TWAI_ALERT_TX_FAILED            0x00000400
+#define TWAI_ALERT_RX_QUEUE_FULL        0x00000800
+#define TWAI_ALERT_ERR_PASS             0x00001000
+#define TWAI_ALERT_BUS_OFF              0x00002000
+#define TWAI_ALERT_RX_FIFO_OVERRUN      0x00004000
+#define TWAI_ALERT_NONE                 0
+
+#define TWAI_GENERAL_CONFIG_DEFAULT(tx, rx, m) { m, tx, rx, TWAI_IO_UNUSED, TWAI_IO_UNUSED, 5, 5, TWAI_ALERT_NONE, 0, 0 }
+#define TWAI_FILTER_CONFIG_ACCEPT_ALL() { 0, 0xFFFFFFFF, true }
+
+esp_err_t twai_driver_install(const twai_general_config_t* g_config, const twai_timing_config_t* t_config,
+                              const twai_filter_config_t* f_config);
+esp_err_t twai_driver_uninstall(void);
+esp_err_t twai_start(void);
+esp_err_t twai_stop(void);
+esp_err_t twai_transmit(const twai_message_t* message, TickType_t ticks_to_wait);
+esp_err_t twai_receive(twai_message_t* message, TickType_t ticks_to_wait);
+esp_err_t twai_read_alerts(uint32_t* alerts, TickType_t ticks_to_wait);
+esp_err_t twai_get_status_info(twai_status_info_t* status);
+
+// Test side of the shim
+bool twai_shim_inject(const twai_message_t* message);   // false = RX queue full, frame dropped
+uint32_t twai_shim_rx_waiting(void);
+uint32_t twai_shim_rx_dropped(void);
+uint32_t twai_shim_tx_count(void);                     // Frames taken by twai_transmit (failed ones too)
+void twai_shim_tx_result(esp_err_t result);            // twai_transmit result from now on (ESP_OK = bus fine)
+bool twai_shim_tx_sent(uint32_t index, twai_message_t* message);  // index-th frame sent with ESP_OK
+
+#endif // HOST_DRIVER_TWAI_H
@@ -0,0 +1,40 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// ============================================================================
+// Host FreeRTOS subset: 1 ms ticks, queues and semaphores on std::mutex,
+// critical sections as a spinlock. Tasks are plain std::threads started by the test.
+// ============================================================================
+#include <stdint.h>
+#include <atomic>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdMS_TO_TICKS(x)    ((TickType_t)(x))
+#define portMAX_DELAY       ((TickType_t)0xffffffff)
+#define portTICK_PERIOD_MS  1
+#define configTICK_RATE_HZ  1000
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              1
+#define pdFAIL              0
+#define tskNO_AFFINITY      0x7fffffff
+
+typedef struct {
+    std::atomic<bool> locked;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { false }
+
+static inline void host_mux_enter(portMUX_TYPE* mux) {
+    while (mux->locked.exchange(true, std::memory_order_acquire)) {
+    }
+}
+static inline void host_mux_exit(portMUX_TYPE* mux) {
+    mux->locked.store(false, std::memory_order_release);
+}
+#define portENTER_CRITICAL(mux) host_mux_enter(mux)
+#define portEXIT_CRITICAL(mux)  host_mux_exit(mux)
+
+#endif // HOST_FREERTOS_H
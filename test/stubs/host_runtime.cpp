@@ -0,0 +1,194 @@
+#include <Arduino.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// Host implementations behind the Arduino / ESP-IDF / FreeRTOS stubs
+// ============================================================================
+
+HardwareSerial Serial;
+HardwareSerial Serial2;
+bool host_serial_quiet = false;
+
+size_t HardwareSerial::printf(const char* format, ...) {
+    if (host_serial_quiet) {
+        return 0;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vprintf(format, args);
+    va_end(args);
+    return written < 0 ? 0 : (size_t) written;
+}
+
+static const std::chrono::steady_clock::time_point host_start = std::chrono::steady_clock::now();
+
+int64_t esp_timer_get_time(void) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - host_start).count();
+}
+
+unsigned long micros(void) {
+    return (unsigned long)(uint32_t) esp_timer_get_time();
+}
+
+unsigned long millis(void) {
+    return (unsigned long)(uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        default: return "ESP_ERR";
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Ticks, delays, task notifications
+// ---------------------------------------------------------------------------
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t) millis();
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delay(ticks);
+}
+
+void vTaskDelayUntil(TickType_t* previous_wake, TickType_t period) {
+    *previous_wake += period;
+    int32_t wait = (int32_t)(*previous_wake - xTaskGetTickCount());
+    if (wait > 0) {
+        delay((uint32_t) wait);
+    }
+}
+
+struct host_task {
+    std::mutex lock;
+    std::condition_variable wake;
+    uint32_t notifications = 0;
+};
+
+static thread_local host_task host_current_task;
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return &host_current_task;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> guard(task->lock);
+        task->notifications++;
+    }
+    task->wake.notify_one();
+    return pdPASS;
+}
+
+static bool host_wait(std::unique_lock<std::mutex>& guard, std::condition_variable& wake,
+                      TickType_t ticks_to_wait, const std::function<bool()>& ready) {
+    if (ticks_to_wait == portMAX_DELAY) {
+        wake.wait(guard, ready);
+        return true;
+    }
+    return wake.wait_for(guard, std::chrono::milliseconds(ticks_to_wait), ready);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    host_task* task = &host_current_task;
+    std::unique_lock<std::mutex> guard(task->lock);
+    host_wait(guard, task->wake, ticks_to_wait, [task]() { return task->notifications > 0; });
+    uint32_t value = task->notifications;
+    if (value > 0) {
+        task->notifications = clear_on_exit ? 0 : value - 1;
+    }
+    return value;
+}
+
+// ---------------------------------------------------------------------------
+// Queues (semaphores are one-slot queues of zero-size items)
+// ---------------------------------------------------------------------------
+struct host_queue {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t item_size;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    host_queue* queue = new host_queue();
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> guard(queue->lock);
+    if (!host_wait(guard, queue->changed, ticks_to_wait, [queue]() { return queue->items.size() < queue->length; })) {
+        return pdFALSE;
+    }
+    const uint8_t* bytes = (const uint8_t*) item;
+    queue->items.emplace_back(bytes, bytes + queue->item_size);
+    guard.unlock();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> guard(queue->lock);
+    if (!host_wait(guard, queue->changed, ticks_to_wait, [queue]() { return !queue->items.empty(); })) {
+        return pdFALSE;
+    }
+    if (queue->item_size > 0) {
+        memcpy(item, queue->items.front().data(), queue->item_size);
+    }
+    queue->items.pop_front();
+    guard.unlock();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return (UBaseType_t) queue->items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buffer) {
+    buffer->handle = xSemaphoreCreateBinary();
+    return buffer->handle;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    xSemaphoreGive(mutex);  // Mutexes start available
+    return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* buffer) {
+    buffer->handle = xSemaphoreCreateMutex();
+    return buffer->handle;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait) {
+    return xQueueReceive(semaphore, NULL, ticks_to_wait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return xQueueSend(semaphore, NULL, 0);
+}
@@ -0,0 +1,14 @@
+#ifndef HOST_LVGL_H
+#define HOST_LVGL_H
+
+// Types only: enough for headers that declare LVGL objects, nothing draws on the host
+#include <stdint.h>
+
+typedef struct _lv_obj_t lv_obj_t;
+typedef struct _lv_event_t lv_event_t;
+typedef struct { int unused; } lv_font_t;
+typedef struct { uint32_t full; } lv_color_t;
+typedef int lv_event_code_t;
+typedef void (*lv_event_cb_t)(lv_event_t*);
+
+#endif // HOST_LVGL_H
@@ -0,0 +1,144 @@
+#include <driver/twai.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// Host TWAI driver: bounded RX queue, alert word, TX log with a switchable result
+// ============================================================================
+// The acceptance filter is not modelled: every injected frame reaches the RX queue
+// and the software post-filter in can_dispatch_frame() does the rejecting.
+
+static std::mutex shim_lock;
+static std::condition_variable shim_alert;
+static std::deque<twai_message_t> shim_rx;
+static size_t shim_rx_len = 5;
+static uint32_t shim_alerts_enabled = 0;
+static uint32_t shim_alerts = 0;
+static uint32_t shim_rx_dropped = 0;
+static uint32_t shim_tx_count = 0;
+static esp_err_t shim_tx_result = ESP_OK;
+static std::vector<twai_message_t> shim_tx_sent;
+static bool shim_running = false;
+
+esp_err_t twai_driver_install(const twai_general_config_t* g_config, const twai_timing_config_t* t_config,
+                              const twai_filter_config_t* f_config) {
+    (void) t_config;
+    (void) f_config;
+    std::lock_guard<std::mutex> guard(shim_lock);
+    shim_rx_len = g_config->rx_queue_len;
+    shim_alerts_enabled = g_config->alerts_enabled;
+    shim_rx.clear();
+    return ESP_OK;
+}
+
+esp_err_t twai_driver_uninstall(void) {
+    return ESP_OK;
+}
+
+esp_err_t twai_start(void) {
+    shim_running = true;
+    return ESP_OK;
+}
+
+esp_err_t twai_stop(void) {
+    shim_running = false;
+    return ESP_OK;
+}
+
+// A timeout result waits ticks_to_wait first, as the driver does with its TX queue full
+esp_err_t twai_transmit(const twai_message_t* message, TickType_t ticks_to_wait) {
+    esp_err_t result;
+    {
+        std::lock_guard<std::mutex> guard(shim_lock);
+        shim_tx_count++;
+        result = shim_tx_result;
+        if (result == ESP_OK) {
+            shim_tx_sent.push_back(*message);
+        }
+    }
+    if (result == ESP_ERR_TIMEOUT) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ticks_to_wait));
+    }
+    return result;
+}
+
+esp_err_t twai_receive(twai_message_t* message, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> guard(shim_lock);
+    if (!shim_alert.wait_for(guard, std::chrono::milliseconds(ticks_to_wait), []() { return !shim_rx.empty(); })) {
+        return ESP_ERR_TIMEOUT;
+    }
+    *message = shim_rx.front();
+    shim_rx.pop_front();
+    return ESP_OK;
+}
+
+esp_err_t twai_read_alerts(uint32_t* alerts, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> guard(shim_lock);
+    auto raised = []() { return (shim_alerts & shim_alerts_enabled) != 0; };
+    bool ready = (ticks_to_wait == portMAX_DELAY) ? (shim_alert.wait(guard, raised), true)
+                                                  : shim_alert.wait_for(guard, std::chrono::milliseconds(ticks_to_wait), raised);
+    if (!ready) {
+        return ESP_ERR_TIMEOUT;
+    }
+    *alerts = shim_alerts & shim_alerts_enabled;
+    shim_alerts = 0;
+    return ESP_OK;
+}
+
+esp_err_t twai_get_status_info(twai_status_info_t* status) {
+    std::lock_guard<std::mutex> guard(shim_lock);
+    memset(status, 0, sizeof(*status));
+    status->state = shim_running ? TWAI_STATE_RUNNING : TWAI_STATE_STOPPED;
+    status->msgs_to_rx = (uint32_t) shim_rx.size();
+    status->rx_missed_count = shim_rx_dropped;
+    return ESP_OK;
+}
+
+bool twai_shim_inject(const twai_message_t* message) {
+    {
+        std::lock_guard<std::mutex> guard(shim_lock);
+        if (shim_rx.size() >= shim_rx_len) {
+            shim_rx_dropped++;
+            shim_alerts |= TWAI_ALERT_RX_QUEUE_FULL;
+            return false;
+        }
+        shim_rx.push_back(*message);
+        shim_alerts |= TWAI_ALERT_RX_DATA;
+    }
+    shim_alert.notify_all();
+    return true;
+}
+
+uint32_t twai_shim_rx_waiting(void) {
+    std::lock_guard<std::mutex> guard(shim_lock);
+    return (uint32_t) shim_rx.size();
+}
+
+uint32_t twai_shim_rx_dropped(void) {
+    std::lock_guard<std::mutex> guard(shim_lock);
+    return shim_rx_dropped;
+}
+
+uint32_t twai_shim_tx_count(void) {
+    std::lock_guard<std::mutex> guard(shim_lock);
+    return shim_tx_count;
+}
+
+void twai_shim_tx_result(esp_err_t result) {
+    std::lock_guard<std::mutex> guard(shim_lock);
+    shim_tx_result = result;
+}
+
+bool twai_shim_tx_sent(uint32_t index, twai_message_t* message) {
+    std::lock_guard<std::mutex> guard(shim_lock);
+    if (index >= shim_tx_sent.size()) {
+        return false;
+    }
+    *message = shim_tx_sent[index];
+    return true;
+}
@@ -0,0 +1,222 @@
+#include "test_util.h"
+#include "can_frames.h"
+
+// ============================================================================
+// can_frames.h: registry decode and dispatch vs the old switch (+ cost per frame)
+// ============================================================================
+/*
+The registry below has the same sensor frame descriptors as can_twai.cpp, with
+sinks that do what the old switch cases did (scale to float V/A, store temps and
+the RTC fields), so --bench compares decode cost and nothing else.
+*/
+
+#define SENSOR_DATA_1_ID    0x101
+#define SENSOR_DATA_2_ID    0x102
+#define SENSOR_DATA_3_ID    0x103
+#define HANDSHAKE_FRAME_ID  0x100
+#define CONTACTOR_FEEDBACK_ID 0x104
+
+typedef struct {
+    float volt;
+    float curr;
+    int32_t temp[4];
+    uint16_t year;
+    uint8_t clock[6];  // month date day_of_week hour minute second
+    uint8_t handshake[2];
+    uint32_t rx_ms;
+} decoded_t;
+
+static decoded_t decoded;
+
+static void sink_vi(const int32_t* values, uint32_t rx_ms) {
+    decoded.volt = values[0] / 100.0f;
+    decoded.curr = values[1] / 100.0f;
+    decoded.rx_ms = rx_ms;
+}
+
+static void sink_temps(const int32_t* values, uint32_t rx_ms) {
+    (void) rx_ms;
+    for (int i = 0; i < 4; i++) {
+        decoded.temp[i] = values[i];
+    }
+}
+
+static void sink_time(const int32_t* values, uint32_t rx_ms) {
+    (void) rx_ms;
+    decoded.year = (uint16_t) values[0];
+    for (int i = 0; i < 6; i++) {
+        decoded.clock[i] = (uint8_t) values[1 + i];
+    }
+}
+
+static void sink_pair(const int32_t* values, uint32_t rx_ms) {
+    (void) rx_ms;
+    decoded.handshake[0] = (uint8_t) values[0];
+    decoded.handshake[1] = (uint8_t) values[1];
+}
+
+static constexpr std::array<can_frame_desc_t, 5> test_frames = {{
+    { HANDSHAKE_FRAME_ID, 2, 2, { can_u8(0), can_u8(1) }, sink_pair, "HANDSHAKE" },
+    { SENSOR_DATA_1_ID, 4, 2,
+      { can_u16be(0, CAN_UNIT_CENTIVOLT), can_u16be(2, CAN_UNIT_CENTIAMP) }, sink_vi, "SENSOR_DATA_1" },
+    { SENSOR_DATA_2_ID, 8, 4,
+      { can_s16be(0, CAN_UNIT_CENTIDEGREE), can_s16be(2, CAN_UNIT_CENTIDEGREE),
+        can_s16be(4, CAN_UNIT_CENTIDEGREE), can_s16be(6, CAN_UNIT_CENTIDEGREE) }, sink_temps, "SENSOR_DATA_2" },
+    { SENSOR_DATA_3_ID, 8, 7,
+      { can_u16be(0), can_u8(2), can_u8(3), can_u8(4), can_u8(5), can_u8(6), can_u8(7) }, sink_time, "SENSOR_DATA_3" },
+    { CONTACTOR_FEEDBACK_ID, 2, 2, { can_u8(0), can_u8(1) }, sink_pair, "CONTACTOR_FEEDBACK" },
+}};
+static_assert(can_frames_valid(test_frames), "test registry");
+static constexpr auto test_rx_dispatch = can_make_dispatch<test_frames>();
+
+static bool registry_decode(const twai_message_t* message, uint32_t rx_ms) {
+    if (message->extd || message->rtr) {
+        return false;
+    }
+    const can_dispatch_entry_t* entry = can_find_dispatch(test_rx_dispatch, message->identifier);
+    return entry != nullptr && entry->decode(message, rx_ms);
+}
+
+// The switch from can_task() before the registry (0x101-0x103, DLC checks as they were)
+static uint16_t be16(const uint8_t* data) {
+    return (uint16_t)((data[0] << 8) | data[1]);
+}
+
+static bool switch_decode(const twai_message_t* message, uint32_t rx_ms) {
+    switch (message->identifier) {
+        case SENSOR_DATA_1_ID:
+            if (message->data_length_code >= 4) {
+                decoded.rx_ms = rx_ms;
+                decoded.volt = be16(&message->data[0]) / 100.0f;
+                decoded.curr = be16(&message->data[2]) / 100.0f;
+                return true;
+            }
+            break;
+        case SENSOR_DATA_2_ID:
+            if (message->data_length_code >= 8) {
+                for (int i = 0; i < 4; i++) {
+                    decoded.temp[i] = (int32_t)(int16_t) be16(&message->data[2 * i]);
+                }
+                return true;
+            }
+            break;
+        case SENSOR_DATA_3_ID:
+            if (message->data_length_code >= 7) {
+                decoded.year = be16(&message->data[0]);
+                for (int i = 0; i < 6; i++) {
+                    decoded.clock[i] = message->data[2 + i];  // data[7] read with DLC 7
+                }
+                return true;
+            }
+            break;
+        default:
+            break;
+    }
+    return false;
+}
+
+static twai_message_t frame(uint32_t id, uint8_t dlc, std::array<uint8_t, 8> data) {
+    twai_message_t message;
+    memset(&message, 0, sizeof(message));
+    message.identifier = id;
+    message.data_length_code = dlc;
+    memcpy(message.data, data.data(), 8);
+    return message;
+}
+
+static const twai_message_t sample_frames[] = {
+    frame(SENSOR_DATA_1_ID, 4, { 0x0A, 0xBE, 0x04, 0xD2 }),                          // 27.50 V, 12.34 A
+    frame(SENSOR_DATA_2_ID, 8, { 0x0B, 0xB8, 0xFF, 0x38, 0x00, 0x00, 0x80, 0x00 }),  // 30.00, -2.00, 0, min
+    frame(SENSOR_DATA_3_ID, 8, { 0x07, 0xEA, 10, 16, 6, 14, 30, 59 }),                 // 2026-10-16 14:30:59
+};
+
+static void test_same_result(void) {
+    printf("registry matches the switch\n");
+    for (const twai_message_t& message : sample_frames) {
+        memset(&decoded, 0, sizeof(decoded));
+        CHECK(switch_decode(&message, 1234));
+        decoded_t expected = decoded;
+        memset(&decoded, 0, sizeof(decoded));
+        CHECK(registry_decode(&message, 1234));
+        CHECK(memcmp(&decoded, &expected, sizeof(decoded)) == 0);
+    }
+    CHECK_EQ(decoded.year, 2026);
+    CHECK_EQ(decoded.clock[5], 59);
+}
+
+static void test_dispatch(void) {
+    printf("dispatch table and DLC checks\n");
+    for (size_t i = 1; i < test_rx_dispatch.size(); i++) {
+        CHECK(test_rx_dispatch[i - 1].identifier < test_rx_dispatch[i].identifier);
+    }
+    for (size_t i = 0; i < test_frames.size(); i++) {
+        const can_dispatch_entry_t* entry = can_find_dispatch(test_rx_dispatch, test_frames[i].identifier);
+        CHECK(entry != nullptr && entry->index == i);
+    }
+    CHECK(can_find_dispatch(test_rx_dispatch, 0x000) == nullptr);
+    CHECK(can_find_dispatch(test_rx_dispatch, 0x105) == nullptr);
+    CHECK(can_find_dispatch(test_rx_dispatch, 0x7FF) == nullptr);
+
+    // 0x103 with DLC 7: the switch accepted it and read data[7], the registry needs 8
+    twai_message_t short_time = frame(SENSOR_DATA_3_ID, 7, { 0x07, 0xEA, 10, 16, 6, 14, 30, 0xEE });
+    CHECK(switch_decode(&short_time, 0));
+    CHECK(!registry_decode(&short_time, 0));
+    twai_message_t short_vi = frame(SENSOR_DATA_1_ID, 3, { 0x0A, 0xBE, 0x04 });
+    CHECK(!registry_decode(&short_vi, 0));
+    twai_message_t extended = sample_frames[0];
+    extended.extd = 1;
+    CHECK(!registry_decode(&extended, 0));
+
+    // New frames are one descriptor each
+    memset(&decoded, 0, sizeof(decoded));
+    twai_message_t feedback = frame(CONTACTOR_FEEDBACK_ID, 2, { 0x02, 0x4C });
+    CHECK(registry_decode(&feedback, 0));
+    CHECK_EQ(decoded.handshake[1], 0x4C);
+
+    static constexpr twai_filter_config_t filter = can_make_filter(test_frames);
+    CHECK(can_filter_covers(filter, test_frames));
+}
+
+template <typename Decode>
+static double bench_ns(Decode decode, const twai_message_t* frames, size_t count, int rounds) {
+    uint32_t accepted = 0;
+    uint64_t t0 = test_now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < count; i++) {
+            accepted += decode(&frames[i], (uint32_t) r) ? 1 : 0;
+            test_keep(decoded);
+        }
+    }
+    uint64_t t1 = test_now_ns();
+    test_keep(accepted);
+    return (double)(t1 - t0) / ((double) rounds * count);
+}
+
+static void bench_decode(void) {
+    const int rounds = 5000000;
+    printf("decode cost per frame (ns)\n");
+    const char* names[] = { "0x101", "0x102", "0x103" };
+    for (size_t i = 0; i < 3; i++) {
+        double old_ns = bench_ns(switch_decode, &sample_frames[i], 1, rounds);
+        double new_ns = bench_ns(registry_decode, &sample_frames[i], 1, rounds);
+        printf("  %s: switch %6.2f  registry %6.2f\n", names[i], old_ns, new_ns);
+    }
+    twai_message_t unknown = frame(0x200, 8, {});
+    printf("  unknown: switch %6.2f  registry %6.2f\n",
+           bench_ns(switch_decode, &unknown, 1, rounds), bench_ns(registry_decode, &unknown, 1, rounds));
+    // Interleaved as on the bus (0x101 is by far the most frequent)
+    const twai_message_t mix[] = { sample_frames[0], sample_frames[1], sample_frames[0], sample_frames[2],
+                                   sample_frames[0], unknown };
+    size_t mix_count = sizeof(mix) / sizeof(mix[0]);
+    printf("  mix:     switch %6.2f  registry %6.2f\n",
+           bench_ns(switch_decode, mix, mix_count, rounds / 4), bench_ns(registry_decode, mix, mix_count, rounds / 4));
+}
+
+int main(int argc, char** argv) {
+    test_same_result();
+    test_dispatch();
+    if (test_bench_requested(argc, argv)) {
+        bench_decode();
+    }
+    return test_summary("can_decode");
+}
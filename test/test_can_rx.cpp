@@ -0,0 +1,218 @@
+#include "test_util.h"
+#include "can_twai.h"
+#include "can_stats.h"
+#include "sensor_snapshot.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// CAN receive path on the TWAI shim: can_task -> registry decode -> snapshot
+// ============================================================================
+/*
+can_twai.cpp, can_stats.cpp and sensor_snapshot.cpp are the firmware sources; the
+driver underneath is test/stubs/twai_shim.cpp. can_task runs on its own thread and
+the test plays M2 by injecting frames. --bench measures frame-to-snapshot latency
+and the highest paced frame rate the task drains without the RX queue overflowing.
+*/
+
+// Hooks the sinks call into modules that are not under test
+bool battery_detected = false;
+static std::atomic<uint32_t> interlock_vi_checks(0);
+static std::atomic<uint32_t> control_notifications(0);
+
+void safety_interlock_check_vi(float volt, float curr, uint32_t rx_us) {
+    (void) volt;
+    (void) curr;
+    (void) rx_us;
+    interlock_vi_checks.fetch_add(1, std::memory_order_relaxed);
+}
+
+void safety_interlock_check_temps(int32_t temp1, int32_t temp2, uint32_t rx_us) {
+    (void) temp1;
+    (void) temp2;
+    (void) rx_us;
+}
+
+void charge_control_notify_sample(void) {
+    control_notifications.fetch_add(1, std::memory_order_relaxed);
+}
+
+static twai_message_t frame(uint32_t id, uint8_t dlc, const uint8_t* data) {
+    twai_message_t message;
+    memset(&message, 0, sizeof(message));
+    message.identifier = id;
+    message.data_length_code = dlc;
+    memcpy(message.data, data, dlc);
+    return message;
+}
+
+static twai_message_t vi_frame(uint16_t centivolt, uint16_t centiamp) {
+    uint8_t data[4] = { (uint8_t)(centivolt >> 8), (uint8_t)(centivolt & 0xFF),
+                        (uint8_t)(centiamp >> 8), (uint8_t)(centiamp & 0xFF) };
+    return frame(SENSOR_DATA_1_ID, 4, data);
+}
+
+// Wait (max 1 s) until the snapshot version reaches target; false on timeout
+static bool wait_version(uint32_t target) {
+    uint64_t deadline = test_now_ns() + 1000000000ull;
+    while ((int32_t)(sensor_snapshot_version() - target) < 0) {
+        if (test_now_ns() > deadline) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+// Wait until the task has taken every frame off the shim queue and finished the last one
+static void wait_drained(void) {
+    while (twai_shim_rx_waiting() > 0) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+}
+
+static void test_decode(void) {
+    printf("decode into the snapshot\n");
+    uint32_t version = sensor_snapshot_version();
+    twai_message_t message = vi_frame(2750, 1234);
+    CHECK(twai_shim_inject(&message));
+    CHECK(wait_version(version + 1));
+    sensor_data sample = sensor_snapshot_get();
+    CHECK(fabsf(sample.volt - 27.50f) < 0.001f);
+    CHECK(fabsf(sample.curr - 12.34f) < 0.001f);
+    CHECK(sample.vi_rx_ms != 0);
+    CHECK(can101_rx_timestamp != 0);
+    CHECK(battery_detected);
+    CHECK(interlock_vi_checks.load() >= 1);
+    CHECK(control_notifications.load() >= 1);
+
+    // 0x102: four signed centidegree temperatures
+    const uint8_t temps[8] = { 0x0B, 0xB8, 0xFF, 0x38, 0x00, 0x00, 0x80, 0x00 };  // 30.00, -2.00, 0, min
+    message = frame(SENSOR_DATA_2_ID, 8, temps);
+    version = sensor_snapshot_version();
+    CHECK(twai_shim_inject(&message));
+    CHECK(wait_version(version + 1));
+    sample = sensor_snapshot_get();
+    CHECK_EQ(sample.temp1, 3000);
+    CHECK_EQ(sample.temp2, -200);
+    CHECK_EQ(sample.temp3, 0);
+    CHECK_EQ(sample.temp4, -32768);
+    CHECK(fabsf(sample.volt - 27.50f) < 0.001f);  // Untouched by the temperature frame
+}
+
+static void test_rejects(void) {
+    printf("short DLC, unknown ID, extended and remote frames\n");
+    uint32_t rejected = can_stats_rx_rejected_count();
+    uint32_t version = sensor_snapshot_version();
+
+    const uint8_t data[8] = { 0x09, 0x99, 0x09, 0x99 };
+    twai_message_t short_dlc = frame(SENSOR_DATA_1_ID, 3, data);
+    twai_message_t unknown = frame(0x200, 4, data);
+    twai_message_t extended = frame(SENSOR_DATA_1_ID, 4, data);
+    extended.extd = 1;
+    twai_message_t remote = frame(SENSOR_DATA_1_ID, 4, data);
+    remote.rtr = 1;
+    CHECK(twai_shim_inject(&short_dlc));
+    CHECK(twai_shim_inject(&unknown));
+    CHECK(twai_shim_inject(&extended));
+    CHECK(twai_shim_inject(&remote));
+    twai_message_t marker = vi_frame(1300, 500);
+    CHECK(twai_shim_inject(&marker));
+
+    CHECK(wait_version(version + 1));
+    wait_drained();
+    CHECK_EQ(sensor_snapshot_version(), version + 1);  // Only the marker was published
+    CHECK(fabsf(sensor_snapshot_get().volt - 13.00f) < 0.001f);
+    CHECK_EQ(can_stats_rx_rejected_count(), rejected + 3);
+}
+
+static void test_burst(void) {
+    printf("burst of %d frames (full RX queue), none dropped\n", CAN_RX_QUEUE_LEN);
+    uint32_t version = sensor_snapshot_version();
+    uint32_t dropped = twai_shim_rx_dropped();
+    int injected = 0;
+    for (int i = 0; i < CAN_RX_QUEUE_LEN; i++) {
+        twai_message_t message = vi_frame((uint16_t)(1000 + i), 0);
+        injected += twai_shim_inject(&message) ? 1 : 0;
+    }
+    CHECK_EQ(injected, CAN_RX_QUEUE_LEN);
+    CHECK(wait_version(version + CAN_RX_QUEUE_LEN));
+    CHECK_EQ(twai_shim_rx_dropped(), dropped);
+    CHECK(fabsf(sensor_snapshot_get().volt - (1000 + CAN_RX_QUEUE_LEN - 1) / 100.0f) < 0.001f);
+}
+
+static void bench_latency(void) {
+    const int samples = 20000;
+    std::vector<uint32_t> latency_ns;
+    latency_ns.reserve(samples);
+    for (int i = 0; i < samples; i++) {
+        uint32_t version = sensor_snapshot_version();
+        twai_message_t message = vi_frame((uint16_t)(1000 + (i & 0x3FF)), (uint16_t) i);
+        uint64_t t0 = test_now_ns();
+        twai_shim_inject(&message);
+        while (sensor_snapshot_version() == version) {
+        }
+        latency_ns.push_back((uint32_t)(test_now_ns() - t0));
+    }
+    std::sort(latency_ns.begin(), latency_ns.end());
+    printf("frame -> sensor snapshot latency (%d frames)\n", samples);
+    printf("  p50 %.1f us  p99 %.1f us  max %.1f us\n", latency_ns[samples / 2] / 1000.0,
+           latency_ns[samples * 99 / 100] / 1000.0, latency_ns[samples - 1] / 1000.0);
+}
+
+// Offer frames at a fixed rate for a while; true if none was dropped
+static bool offer_rate(uint32_t frames_per_s, uint32_t duration_ms, uint32_t* delivered) {
+    uint32_t dropped = twai_shim_rx_dropped();
+    uint32_t version = sensor_snapshot_version();
+    std::chrono::nanoseconds period(1000000000ull / frames_per_s);
+    uint32_t count = (uint32_t)((uint64_t) frames_per_s * duration_ms / 1000);
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < count; i++) {
+        std::this_thread::sleep_until(next);  // Sleep, not spin: can_task may share the core
+        twai_message_t message = vi_frame((uint16_t) i, 0);
+        twai_shim_inject(&message);
+        next += period;
+    }
+    wait_drained();
+    *delivered = sensor_snapshot_version() - version;
+    return twai_shim_rx_dropped() == dropped;
+}
+
+static void bench_rate(void) {
+    // 500 kbit/s bus, 8-byte standard frames, no stuff bits: about 4500 frames/s
+    const uint32_t bus_limit = 500000 / 111;
+    printf("max sustained rate without RX queue overflow (queue %d, 300 ms per step)\n", CAN_RX_QUEUE_LEN);
+    if (std::thread::hardware_concurrency() < 2) {
+        printf("  (single CPU host: the bus thread and can_task share it, figures are a lower bound)\n");
+    }
+    uint32_t best = 0;
+    for (uint32_t rate = 1000; rate <= 2048000; rate *= 2) {
+        uint32_t delivered = 0;
+        bool clean = offer_rate(rate, 300, &delivered);
+        printf("  %8u frames/s offered: %s, %u decoded\n", rate, clean ? "no drops" : "OVERFLOW", delivered);
+        if (!clean) {
+            break;
+        }
+        best = rate;
+    }
+    printf("  sustained >= %u frames/s (%.1fx the bus maximum of %u)\n", best, (double) best / bus_limit, bus_limit);
+}
+
+int main(int argc, char** argv) {
+    host_serial_quiet = true;
+    delay(2);  // millis() == 0 means "never received" to the sinks
+    CHECK(init_can_twai());
+    std::thread(can_task, nullptr).detach();
+
+    test_decode();
+    test_rejects();
+    test_burst();
+    if (test_bench_requested(argc, argv)) {
+        bench_latency();
+        bench_rate();
+    }
+    return test_summary("can_rx");
+}
@@ -0,0 +1,121 @@
+#include "test_util.h"
+#include "can_twai.h"
+#include <thread>
+
+// ============================================================================
+// CAN transmit path on the TWAI shim: urgent frames survive a full queue and a dead bus
+// ============================================================================
+/*
+can_tx_task runs on its own thread over test/stubs/twai_shim.cpp. twai_shim_tx_result()
+switches the bus off (every transmit times out after CAN_TX_TIMEOUT_MS, as with M2 not
+acknowledging) and on again; twai_shim_tx_sent() is the order frames reached the bus.
+*/
+
+// Hooks the receive sinks call into modules that are not under test
+bool battery_detected = false;
+
+void safety_interlock_check_vi(float volt, float curr, uint32_t rx_us) {
+    (void) volt;
+    (void) curr;
+    (void) rx_us;
+}
+
+void safety_interlock_check_temps(int32_t temp1, int32_t temp2, uint32_t rx_us) {
+    (void) temp1;
+    (void) temp2;
+    (void) rx_us;
+}
+
+void charge_control_notify_sample(void) {
+}
+
+static const uint8_t open_data[8] = { M1_NODE_ID, CONTACTOR_OPEN };
+static const uint8_t heartbeat_data[2] = { M1_NODE_ID, MSG_HEARTBEAT };
+
+static uint32_t sent_count(void) {
+    twai_message_t message;
+    uint32_t n = 0;
+    while (twai_shim_tx_sent(n, &message)) {
+        n++;
+    }
+    return n;
+}
+
+// Wait (max 2 s) until at least target frames are on the bus
+static bool wait_sent(uint32_t target) {
+    uint64_t deadline = test_now_ns() + 2000000000ull;
+    while (sent_count() < target) {
+        if (test_now_ns() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static void test_routine(void) {
+    printf("routine frame on a working bus\n");
+    uint32_t before = sent_count();
+    CHECK(can_tx_enqueue(HANDSHAKE_FRAME_ID, heartbeat_data, 2, CAN_TX_ROUTINE, NULL));
+    CHECK(wait_sent(before + 1));
+}
+
+static void test_urgent_bus_down(void) {
+    printf("contactor OPEN with the bus down and the urgent queue full\n");
+    const int offered = CAN_TX_URGENT_QUEUE_LEN + 4;
+    uint32_t before = sent_count();
+    static can_tx_completion_t done;
+    can_tx_completion_init(&done);
+
+    twai_shim_tx_result(ESP_ERR_TIMEOUT);
+    int accepted = 0;
+    for (int i = 0; i < offered; i++) {
+        accepted += can_tx_enqueue(CONTACTOR_CONTROL_ID, open_data, 8, CAN_TX_URGENT, (i == 0) ? &done : NULL) ? 1 : 0;
+    }
+    CHECK_EQ(accepted, offered);  // Queue full: held and merged, never dropped
+    // Another urgent ID cannot be held while the OPEN is
+    const uint8_t other[1] = { 0x55 };
+    CHECK(!can_tx_enqueue(CONTACTOR_CONTROL_ID + 1, other, 1, CAN_TX_URGENT, NULL));
+    CHECK(can_tx_enqueue(HANDSHAKE_FRAME_ID, heartbeat_data, 2, CAN_TX_ROUTINE, NULL));
+
+    // Failed transmits are re-sent, not completed
+    std::this_thread::sleep_for(std::chrono::milliseconds(4 * CAN_TX_TIMEOUT_MS));
+    esp_err_t result = ESP_FAIL;
+    CHECK(!can_tx_completion_wait(&done, 0, &result));
+    CHECK_EQ(sent_count(), before);
+
+    twai_shim_tx_result(ESP_OK);
+    CHECK(can_tx_completion_wait(&done, pdMS_TO_TICKS(2000), &result));
+    CHECK_EQ(result, ESP_OK);
+    CHECK(wait_sent(before + 2));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * CAN_TX_URGENT_RETRY_MS));
+
+    // Every OPEN went out ahead of the routine heartbeat, and the heartbeat went last
+    uint32_t total = sent_count();
+    twai_message_t message;
+    uint32_t opens = 0;
+    for (uint32_t i = before; i < total; i++) {
+        CHECK(twai_shim_tx_sent(i, &message));
+        if (message.identifier == CONTACTOR_CONTROL_ID) {
+            CHECK_EQ(message.data[1], CONTACTOR_OPEN);
+            opens++;
+        } else {
+            CHECK_EQ(message.identifier, HANDSHAKE_FRAME_ID);
+            CHECK_EQ(i, total - 1);
+        }
+    }
+    CHECK(opens >= 1);
+    CHECK(opens <= (uint32_t) offered);
+}
+
+int main(int argc, char** argv) {
+    (void) argc;
+    (void) argv;
+    host_serial_quiet = true;
+    CHECK(init_can_twai());
+    std::thread(can_tx_task, nullptr).detach();
+
+    test_routine();
+    test_urgent_bus_down();
+    return test_summary("can_tx");
+}
@@ -0,0 +1,106 @@
+#include "test_util.h"
+#include "charge_sim.h"
+#include <stdlib.h>
+
+// ============================================================================
+// Charge cycles over every configured battery profile on the plant model
+// ============================================================================
+/*
+initializeBatteryProfiles() as the firmware builds it, then N whole charges per
+profile through charge_sim.h, each from a different starting SOC (10..80 %, fixed
+sequence so runs repeat). Auto-tuned gains and the feed-forward map carry over from
+one cycle of a profile to the next, as on the charger. Per profile: how many cycles
+completed, the stop reasons, and the mean charge time and Ah. Every cycle must end in
+STATE_CHARGING_COMPLETE.
+  test_charge_cycles               CYCLES_DEFAULT per profile (make test)
+  test_charge_cycles --cycles N    N per profile (make sim CYCLES=N)
+*/
+
+// rs485_vfdComs.cpp glue the plant model does not need in this build
+void can_dispatch_frame(const twai_message_t* message) {
+    (void) message;
+}
+
+#define CYCLES_DEFAULT      10
+#define CYCLES_SOC_MIN      10.0f
+#define CYCLES_SOC_MAX      80.0f
+#define CYCLES_REASONS      (CHARGE_STOP_VFD_FAULT + 1)
+
+// Same names as the SD charge log (sd_logging.cpp)
+static const char* const stop_reason_names[CYCLES_REASONS] = {
+    "UNKNOWN", "COMPLETE", "EMERGENCY", "VOLT_SAT", "VOLT_LIMIT", "HIGH_TEMP",
+    "110_PERCENT", "BATT_DISCONNECT", "VOLT_CURR_ERR", "VFD_FAULT"
+};
+
+static int cycles_requested(int argc, char** argv) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--cycles") == 0) {
+            int cycles = atoi(argv[i + 1]);
+            return cycles > 0 ? cycles : CYCLES_DEFAULT;
+        }
+    }
+    return CYCLES_DEFAULT;
+}
+
+// Starting SOC of cycle n: a fixed LCG, so every run covers the same spread
+static float cycle_soc(uint32_t* seed) {
+    *seed = *seed * 1664525u + 1013904223u;
+    return CYCLES_SOC_MIN + (CYCLES_SOC_MAX - CYCLES_SOC_MIN) * ((*seed >> 8) / 16777216.0f);
+}
+
+static void run_profile(int index, const BatteryType* battery, int cycles) {
+    uint32_t reasons[CYCLES_REASONS] = { 0 };
+    uint32_t completed = 0;
+    double time_sum_ms = 0.0;
+    double ah_sum = 0.0;
+    uint32_t seed = (uint32_t) index;
+
+    for (int n = 0; n < cycles; n++) {
+        float soc = cycle_soc(&seed);
+        RecordingLog log;
+        app_state_t state = run_charge(battery, soc, &log, battery->getChargePlan());
+        CHECK(log.finished);
+        if (state == STATE_CHARGING_COMPLETE) {
+            completed++;
+        } else {
+            printf("    cycle %d from %.0f %%: state %d, stop reason %s\n", n, soc, (int) state,
+                   stop_reason_names[log.result.stop_reason < CYCLES_REASONS ? log.result.stop_reason : 0]);
+        }
+        if (log.finished && log.result.stop_reason < CYCLES_REASONS) {
+            reasons[log.result.stop_reason]++;
+        }
+        time_sum_ms += log.result.total_time_ms;
+        ah_sum += log.result.ah_final;
+    }
+
+    printf("  %2d %-12s %3u/%d complete, %6.1f min, %6.1f Ah mean |", index,
+           battery->getDisplayName().c_str(), completed, cycles, time_sum_ms / cycles / 60000.0, ah_sum / cycles);
+    for (int r = 0; r < CYCLES_REASONS; r++) {
+        if (reasons[r] > 0) {
+            printf(" %s %u", stop_reason_names[r], reasons[r]);
+        }
+    }
+    printf("\n");
+    CHECK_EQ(completed, cycles);
+}
+
+int main(int argc, char** argv) {
+    host_serial_quiet = true;
+    const int cycles = cycles_requested(argc, argv);
+    initializeBatteryProfiles();
+    printf("%d charge cycles per battery profile, start SOC %.0f..%.0f %%\n", cycles, CYCLES_SOC_MIN,
+           CYCLES_SOC_MAX);
+
+    uint64_t start_ns = test_now_ns();
+    int profiles = 0;
+    for (int i = 0; i < batteryProfiles.getProfileCount(); i++) {
+        const BatteryType* battery = batteryProfiles.getProfile(i);
+        if (battery->getRatedAh() == 0) {
+            continue;  // Placeholder shown before a battery is detected
+        }
+        run_profile(i, battery, cycles);
+        profiles++;
+    }
+    printf("  %d charges in %.2f s\n", profiles * cycles, (test_now_ns() - start_ns) / 1e9);
+    return test_summary("charge_cycles");
+}
@@ -0,0 +1,110 @@
+#include "test_util.h"
+#include "charge_sim.h"
+
+// ============================================================================
+// ChargeController on the plant model: CV ends on the tail current, small packs too
+// ============================================================================
+/*
+The controller runs on the plant model through charge_sim.h. C/20 of a 10 Ah pack
+(0.5 A) is below the disconnect threshold, so the compiled tail exit must be floored
+above it or the charge ends as "battery disconnected" instead of complete. The same holds for the
+C/20 equalise stage of CHARGE_PLAN_EQUALISE, whose setpoint is floored the same way.
+A VFD fault or lost RS485 link read back mid-charge stops it as CHARGE_STOP_VFD_FAULT.
+*/
+
+// rs485_vfdComs.cpp glue the plant model does not need in this build
+void can_dispatch_frame(const twai_message_t* message) {
+    (void) message;
+}
+
+#define TAIL_VFD_TRIP_MS    (10UL * 60 * 1000)   // Into the charge when the VFD state changes
+
+static uint16_t cv_exit_0_01A(const charge_profile_t& profile) {
+    for (uint8_t i = 0; i < profile.plan.count; i++) {
+        if (profile.plan.stages[i].mode == CHARGE_REG_VOLTAGE) {
+            return profile.plan.stages[i].exit_0_01A;
+        }
+    }
+    return 0;
+}
+
+static void test_compiled_floor(void) {
+    printf("compiled tail exit: C/20, floored above the disconnect threshold\n");
+    BatteryType small(LEAD_ACID, 12, 10, 16.0, 6.0, "Lead 10Ah");
+    BatteryType mid(LEAD_ACID, 12, 40, 16.0, 12.0, "Lead 40Ah");
+    BatteryType large(LIFEPO4, 12, 280, 14.5, 150.0, "LiFePO4 280Ah");
+    CHECK_EQ(cv_exit_0_01A(profile_of(&small)), 150);   // 0.5 A -> floor
+    CHECK_EQ(cv_exit_0_01A(profile_of(&mid)), 200);     // 2.0 A, above the floor
+    CHECK_EQ(cv_exit_0_01A(profile_of(&large)), 1400);
+    CHECK(CHARGE_STAGE_TAIL_MIN_AMPS > CHARGE_DISCONNECT_AMPS);
+
+    printf("compiled equalise setpoint: C/20, floored above the disconnect threshold\n");
+    charge_profile_t equalise = profile_of(&small, CHARGE_PLAN_EQUALISE);
+    const charge_stage_t* last = &equalise.plan.stages[equalise.plan.count - 1];
+    CHECK_EQ(last->mode, CHARGE_REG_CURRENT);
+    CHECK_EQ(last->setpoint, 150);                        // 0.5 A -> floor
+    equalise = profile_of(&mid, CHARGE_PLAN_EQUALISE);
+    CHECK_EQ(equalise.plan.stages[equalise.plan.count - 1].setpoint, 200);
+}
+
+static void test_small_pack_tail(void) {
+    printf("10 Ah pack: CV ends on the tail current\n");
+    BatteryType small(LEAD_ACID, 12, 10, 16.0, 6.0, "Lead 10Ah");
+    RecordingLog log;
+    // From 10 %: the CV budget (half the CC time) then outlasts the taper to the tail current
+    app_state_t state = run_charge(&small, 10.0f, &log);
+    printf("  %.1f min, %.2f Ah, stop reason %d\n", log.result.total_time_ms / 60000.0f, log.result.ah_final,
+           (int) log.result.stop_reason);
+
+    CHECK_EQ(state, STATE_CHARGING_COMPLETE);
+    CHECK(log.finished);
+    CHECK_EQ(log.result.stop_reason, CHARGE_STOP_COMPLETE);
+    CHECK(log.contains("[STAGE] Tail current"));
+    CHECK(log.contains("'cv' done (tail current)"));
+    CHECK(!log.contains("battery_disconnected"));
+}
+
+static void test_small_pack_equalise(void) {
+    printf("10 Ah pack: equalise stage at the floored setpoint\n");
+    BatteryType small(LEAD_ACID, 12, 10, 16.0, 6.0, "Lead 10Ah");
+    RecordingLog log;
+    app_state_t state = run_charge(&small, 40.0f, &log, CHARGE_PLAN_EQUALISE);
+    printf("  %.1f min, %.2f Ah, stop reason %d\n", log.result.total_time_ms / 60000.0f, log.result.ah_final,
+           (int) log.result.stop_reason);
+
+    CHECK_EQ(state, STATE_CHARGING_COMPLETE);
+    CHECK(log.finished);
+    CHECK_EQ(log.result.stop_reason, CHARGE_STOP_COMPLETE);
+    CHECK(log.contains("4/4 'equalise': current 1.50A"));
+    CHECK(log.contains("'equalise' done"));
+    CHECK(!log.contains("battery_disconnected"));
+}
+
+static void test_vfd_fault(charge_vfd_t trip, const char* name) {
+    printf("VFD %s 10 min into the charge\n", name);
+    BatteryType lead75(LEAD_ACID, 12, 75, 16, 45.0, "Lead 75Ah");
+    RecordingLog log;
+    vfd_trip = trip;
+    vfd_trip_ms = TAIL_VFD_TRIP_MS;
+    app_state_t state = run_charge(&lead75, 30.0f, &log);
+    vfd_trip_ms = 0;
+    printf("  %.1f min, stop reason %d\n", log.result.total_time_ms / 60000.0f, (int) log.result.stop_reason);
+
+    CHECK_EQ(state, STATE_EMERGENCY_STOP);
+    CHECK(log.finished);
+    CHECK_EQ(log.result.stop_reason, CHARGE_STOP_VFD_FAULT);
+    CHECK(log.contains("vfd_fault"));
+    CHECK(!plant.contactor_closed);
+}
+
+int main(int argc, char** argv) {
+    (void) argc;
+    (void) argv;
+    host_serial_quiet = true;
+    test_compiled_floor();
+    test_small_pack_tail();
+    test_small_pack_equalise();
+    test_vfd_fault(CHARGE_VFD_FAULT, "fault code");
+    test_vfd_fault(CHARGE_VFD_OFFLINE, "offline");
+    return test_summary("charge_tail");
+}
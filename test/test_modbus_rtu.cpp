@@ -0,0 +1,205 @@
+#include "test_util.h"
+#include "modbus_rtu.h"
+
+// ============================================================================
+// modbus_rtu.h: CRC, request builders, response validation (+ CRC benchmark)
+// ============================================================================
+
+// The bit-by-bit routine the table replaced (rs485_calculate_crc), kept as the reference
+static uint16_t crc16_bitwise(const uint8_t* buffer, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= buffer[i];
+        for (int j = 0; j < 8; j++) {
+            uint8_t carry = crc & 0x0001;
+            crc >>= 1;
+            if (carry) {
+                crc ^= 0xA001;
+            }
+        }
+    }
+    return crc;
+}
+
+template <size_t N>
+static bool frame_equals(const std::array<uint8_t, N>& frame, const uint8_t (&expected)[N]) {
+    return memcmp(frame.data(), expected, N) == 0;
+}
+
+// Appends the reference CRC to a hand-built frame of length bytes (room for 2 more)
+static size_t seal(uint8_t* frame, size_t length) {
+    uint16_t crc = crc16_bitwise(frame, length);
+    frame[length] = (uint8_t)(crc & 0xFF);
+    frame[length + 1] = (uint8_t)(crc >> 8);
+    return length + 2;
+}
+
+// The VFD start frame is assembled by the compiler
+static_assert(modbus_write_single(0x01, 0xC738, 0x0001)[6] == 0xF4 &&
+              modbus_write_single(0x01, 0xC738, 0x0001)[7] == 0xB3, "constexpr start frame CRC");
+
+static void test_crc_vectors(void) {
+    printf("crc vectors\n");
+    static const uint8_t check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    CHECK_EQ(modbus_crc16(check, sizeof(check)), 0x4B37);  // CRC-16/MODBUS check value
+    CHECK_EQ(modbus_crc16(check, 0), 0xFFFF);
+
+    static const uint8_t read_req[] = { 0x01, 0x03, 0x00, 0x00, 0x00, 0x01 };
+    CHECK_EQ(modbus_crc16(read_req, sizeof(read_req)), 0x0A84);  // Sent as 84 0A
+
+    // Table and bit loop agree on every single byte and on a long pseudo-random run
+    for (int b = 0; b < 256; b++) {
+        uint8_t byte = (uint8_t) b;
+        CHECK_EQ(modbus_crc16(&byte, 1), crc16_bitwise(&byte, 1));
+    }
+    uint8_t noise[1024];
+    uint32_t x = 0x12345678;
+    for (size_t i = 0; i < sizeof(noise); i++) {
+        x = x * 1664525u + 1013904223u;
+        noise[i] = (uint8_t)(x >> 24);
+    }
+    CHECK_EQ(modbus_crc16(noise, sizeof(noise)), crc16_bitwise(noise, sizeof(noise)));
+
+    uint8_t frame[8] = { 0x01, 0x03, 0x00, 0x00, 0x00, 0x01, 0x84, 0x0A };
+    CHECK(modbus_crc_valid(frame, sizeof(frame)));
+    frame[7] ^= 0x01;
+    CHECK(!modbus_crc_valid(frame, sizeof(frame)));
+    CHECK(!modbus_crc_valid(frame, 3));
+}
+
+static void test_builders(void) {
+    printf("builders\n");
+    // Start/stop frames that used to be hard coded, CRC included
+    static const uint8_t start[8] = { 0x01, 0x06, 0xC7, 0x38, 0x00, 0x01, 0xF4, 0xB3 };
+    static const uint8_t stop[8]  = { 0x01, 0x06, 0xC7, 0x38, 0x00, 0x05, 0xF5, 0x70 };
+    CHECK(frame_equals(modbus_write_single(0x01, 0xC738, 0x0001), start));
+    CHECK(frame_equals(modbus_write_single(0x01, 0xC738, 0x0005), stop));
+
+    // Frequency write (30.00 Hz) against a hand-assembled frame
+    uint8_t freq[8] = { 0x01, 0x06, 0xC7, 0x39, 0x0B, 0xB8 };
+    seal(freq, 6);
+    CHECK(frame_equals(modbus_write_single(0x01, 0xC739, 3000), freq));
+
+    static const uint8_t read[8] = { 0x01, 0x03, 0x00, 0x00, 0x00, 0x01, 0x84, 0x0A };
+    CHECK(frame_equals(modbus_read_holding(0x01, 0x0000, 1), read));
+
+    uint8_t multi[13] = { 0x01, 0x10, 0xC7, 0x38, 0x00, 0x02, 0x04, 0x00, 0x01, 0x0B, 0xB8 };
+    seal(multi, 11);
+    CHECK(frame_equals(modbus_write_multiple<2>(0x01, 0xC738, { 0x0001, 3000 }), multi));
+
+    CHECK_EQ(modbus_read_response_length(1), 7);
+    CHECK_EQ(modbus_read_response_length(2), 9);
+    CHECK_EQ(modbus_write_response_length(), 8);
+    CHECK_EQ(modbus_exception_length(), 5);
+}
+
+static void test_validate(void) {
+    printf("response validation\n");
+    std::array<uint8_t, 8> read_req = modbus_read_holding(0x01, 0xC738, 1);
+    std::array<uint8_t, 8> write_req = modbus_write_single(0x01, 0xC739, 3000);
+    const size_t read_len = modbus_read_response_length(1);
+    uint8_t code = 0xEE;
+
+    uint8_t good[16] = { 0x01, 0x03, 0x02, 0x12, 0x34 };
+    size_t good_len = seal(good, 5);
+    CHECK_EQ(modbus_validate_response(read_req.data(), good, good_len, read_len, &code), MODBUS_OK);
+    CHECK_EQ(code, 0xEE);  // Untouched unless there is an exception
+
+    // Nothing / too little received
+    CHECK_EQ(modbus_validate_response(read_req.data(), good, 0, read_len, NULL), MODBUS_ERR_TIMEOUT);
+    CHECK_EQ(modbus_validate_response(read_req.data(), good, 3, read_len, NULL), MODBUS_ERR_LENGTH);
+    CHECK_EQ(modbus_validate_response(read_req.data(), good, 4, read_len, NULL), MODBUS_ERR_LENGTH);
+
+    // Bad CRC: corrupt a data byte, then the CRC itself
+    uint8_t bad[16];
+    memcpy(bad, good, good_len);
+    bad[3] ^= 0x40;
+    CHECK_EQ(modbus_validate_response(read_req.data(), bad, good_len, read_len, NULL), MODBUS_ERR_CRC);
+    memcpy(bad, good, good_len);
+    bad[good_len - 1] ^= 0x01;
+    CHECK_EQ(modbus_validate_response(read_req.data(), bad, good_len, read_len, NULL), MODBUS_ERR_CRC);
+
+    // Truncated frame that still carries a valid CRC
+    uint8_t truncated[16] = { 0x01, 0x03, 0x02, 0x12 };
+    size_t truncated_len = seal(truncated, 4);
+    CHECK_EQ(modbus_validate_response(read_req.data(), truncated, truncated_len, read_len, NULL), MODBUS_ERR_LENGTH);
+
+    // Byte count disagrees with the request
+    uint8_t count[16] = { 0x01, 0x03, 0x03, 0x12, 0x34 };
+    size_t count_len = seal(count, 5);
+    CHECK_EQ(modbus_validate_response(read_req.data(), count, count_len, read_len, NULL), MODBUS_ERR_LENGTH);
+
+    // Wrong slave
+    uint8_t other[16] = { 0x02, 0x03, 0x02, 0x12, 0x34 };
+    size_t other_len = seal(other, 5);
+    CHECK_EQ(modbus_validate_response(read_req.data(), other, other_len, read_len, NULL), MODBUS_ERR_ADDRESS);
+
+    // Wrong function
+    uint8_t function[16] = { 0x01, 0x04, 0x02, 0x12, 0x34 };
+    size_t function_len = seal(function, 5);
+    CHECK_EQ(modbus_validate_response(read_req.data(), function, function_len, read_len, NULL), MODBUS_ERR_FUNCTION);
+
+    // Exception (short frame, accepted before the length check)
+    uint8_t exception[16] = { 0x01, 0x83, MODBUS_EX_ILLEGAL_ADDRESS };
+    size_t exception_len = seal(exception, 3);
+    CHECK_EQ(modbus_validate_response(read_req.data(), exception, exception_len, read_len, &code), MODBUS_ERR_EXCEPTION);
+    CHECK_EQ(code, MODBUS_EX_ILLEGAL_ADDRESS);
+    CHECK_EQ(modbus_validate_response(read_req.data(), exception, exception_len, read_len, NULL), MODBUS_ERR_EXCEPTION);
+    // An exception to a different function is not ours
+    CHECK_EQ(modbus_validate_response(write_req.data(), exception, exception_len, 8, NULL), MODBUS_ERR_FUNCTION);
+
+    // Write echo
+    CHECK_EQ(modbus_validate_response(write_req.data(), write_req.data(), write_req.size(), 8, NULL), MODBUS_OK);
+    std::array<uint8_t, 8> other_value = modbus_write_single(0x01, 0xC739, 3001);
+    CHECK_EQ(modbus_validate_response(write_req.data(), other_value.data(), other_value.size(), 8, NULL), MODBUS_ERR_MISMATCH);
+
+    std::array<uint8_t, 13> multi_req = modbus_write_multiple<2>(0x01, 0xC738, { 0x0001, 3000 });
+    uint8_t multi_ok[8] = { 0x01, 0x10, 0xC7, 0x38, 0x00, 0x02 };
+    seal(multi_ok, 6);
+    CHECK_EQ(modbus_validate_response(multi_req.data(), multi_ok, 8, 8, NULL), MODBUS_OK);
+    uint8_t multi_bad[8] = { 0x01, 0x10, 0xC7, 0x38, 0x00, 0x01 };
+    seal(multi_bad, 6);
+    CHECK_EQ(modbus_validate_response(multi_req.data(), multi_bad, 8, 8, NULL), MODBUS_ERR_MISMATCH);
+}
+
+static void bench_crc(void) {
+    static const size_t sizes[] = { 8, 13, 256 };
+    uint8_t data[256];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i * 37 + 11);
+    }
+    printf("crc benchmark (ns per frame)\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t length = sizes[s];
+        const int rounds = (int)(20000000 / length);
+        uint16_t acc = 0;
+
+        uint64_t t0 = test_now_ns();
+        for (int r = 0; r < rounds; r++) {
+            data[0] = (uint8_t) r;
+            acc ^= crc16_bitwise(data, length);
+        }
+        uint64_t t1 = test_now_ns();
+        for (int r = 0; r < rounds; r++) {
+            data[0] = (uint8_t) r;
+            acc ^= modbus_crc16(data, length);
+        }
+        uint64_t t2 = test_now_ns();
+        test_keep(acc);
+
+        double bitwise_ns = (double)(t1 - t0) / rounds;
+        double table_ns = (double)(t2 - t1) / rounds;
+        printf("  %3zu bytes: bitwise %8.1f  table %8.1f  (x%.1f)\n",
+               length, bitwise_ns, table_ns, bitwise_ns / table_ns);
+    }
+}
+
+int main(int argc, char** argv) {
+    test_crc_vectors();
+    test_builders();
+    test_validate();
+    if (test_bench_requested(argc, argv)) {
+        bench_crc();
+    }
+    return test_summary("modbus_rtu");
+}
@@ -0,0 +1,169 @@
+#include "test_util.h"
+#include "pi_autotune.h"
+#include "pi_controller.h"
+#include "plant_sim.h"
+#include "rs485_vfdComs.h"
+#include "charge_controller.h"
+
+// ============================================================================
+// Relay auto-tune on the plant model: Ku/Tu, and the tuned PI in closed loop
+// ============================================================================
+/*
+The relay test runs in CC as ChargeController::cc_frequency() runs it: the plant is
+held at the profile's CC current, then pi_autotune_step() drives the VFD command every
+100 ms from the M2 current (0.01 A). The plant's frequency->current gain
+G = ke / (R_gen + R0) is known from plant_sim.cpp, and with one sample of delay and
+the slew limit in the loop the ultimate gain is of the order of 1/G, so Ku * G must
+come out near 1 (a relay whose swing the drive never follows reads several times
+higher). The gains from pi_autotune_gains() then go through pi_gains_for_profile() as in a
+charge and the PI steps PRECHARGE_AMPS -> CC on a fresh plant: it must settle no
+slower than on the scheduled gains and without a limit cycle.
+*/
+
+// rs485_vfdComs.cpp glue the plant model does not need in this build
+void can_dispatch_frame(const twai_message_t* message) {
+    (void) message;
+}
+
+#define TUNE_PLANT_STEP_MS   10
+#define TUNE_PERIOD_MS       100     // CHARGE_CONTROL_PERIOD_MS
+#define TUNE_LOOP_S          300
+#define TUNE_RIPPLE_WINDOW_S 60
+#define TUNE_SETTLE_BAND     0.05f   // Of the step
+#define TUNE_QUANTUM         0.01f   // One count of the M2 measurement
+#define TUNE_FREQ_COUNTS     3       // Steady-state dither of the frequency command (0.01 Hz counts)
+
+// Plant settled at a steady current: frequency command, in 0.01 Hz
+static uint16_t settle_at(plant_model_t* plant, float amps) {
+    plant->contactor_closed = true;
+    plant->vfd_running = true;
+    float emf = plant->terminal_v + amps * (PLANT_SIM_GEN_R_OHM + plant->r0_ohm + plant->r1_ohm);
+    float hz = emf / plant->ke_v_per_hz;
+    plant->freq_cmd_hz = hz;
+    plant->freq_hz = hz;
+    plant->v_rc = amps * plant->r1_ohm;
+    plant_model_step(plant, 0.001f);
+    return (uint16_t)(hz * 100.0f + 0.5f);
+}
+
+static uint16_t sample_0_01(float value) {
+    return (uint16_t)(value * 100.0f + 0.5f);
+}
+
+// Relay test at the profile's CC current
+static pi_autotune_t run_relay(const BatteryType* battery, float* gain_a_per_hz) {
+    plant_model_t plant;
+    plant_model_init(&plant, battery, 30.0f);
+    const uint16_t target = sample_0_01(battery->getConstCurrent());
+    uint16_t frequency = settle_at(&plant, battery->getConstCurrent());
+    *gain_a_per_hz = plant.ke_v_per_hz / (PLANT_SIM_GEN_R_OHM + plant.r0_ohm);
+
+    pi_autotune_t tune;
+    const int32_t slew = (CHARGE_FREQ_SLEW_PER_S * TUNE_PERIOD_MS + 999) / 1000;
+    pi_autotune_start(&tune, frequency, target, RS485_FREQ_MIN, RS485_FREQ_MAX, slew, 0);
+    for (uint32_t t_ms = 0; tune.state == PI_AUTOTUNE_RUNNING; t_ms += TUNE_PLANT_STEP_MS) {
+        if (t_ms % TUNE_PERIOD_MS == 0) {
+            frequency = (uint16_t) pi_autotune_step(&tune, sample_0_01(plant.current_a), t_ms);
+        }
+        plant.freq_cmd_hz = frequency / 100.0f;
+        plant_model_step(&plant, TUNE_PLANT_STEP_MS / 1000.0f);
+    }
+    return tune;
+}
+
+typedef struct {
+    float settle_s;
+    float overshoot_pct;
+    float ripple_pp;
+} tune_loop_result_t;
+
+// PRECHARGE_AMPS -> CC step with the given gains
+static tune_loop_result_t run_loop(const BatteryType* battery, pi_gains_t gains) {
+    plant_model_t plant;
+    plant_model_init(&plant, battery, 30.0f);
+    uint16_t frequency = settle_at(&plant, PRECHARGE_AMPS);
+    const float setpoint = battery->getConstCurrent();
+    const float band = (setpoint - PRECHARGE_AMPS) * TUNE_SETTLE_BAND;
+
+    pi_controller_t pi;
+    pi_controller_init(&pi, gains, RS485_FREQ_MIN, RS485_FREQ_MAX,
+                       (CHARGE_FREQ_SLEW_PER_S * TUNE_PERIOD_MS + 999) / 1000);
+    uint16_t measured = sample_0_01(plant.current_a);
+    pi_controller_bumpless(&pi, frequency, sample_0_01(setpoint), measured);
+
+    tune_loop_result_t result = { 0.0f, 0.0f, 0.0f };
+    float peak = PRECHARGE_AMPS;
+    float ripple_min = 1e9f;
+    float ripple_max = -1e9f;
+    for (uint32_t t_ms = 0; t_ms < TUNE_LOOP_S * 1000; t_ms += TUNE_PLANT_STEP_MS) {
+        if (t_ms % TUNE_PERIOD_MS == 0) {
+            measured = sample_0_01(plant.current_a);
+            float amps = measured / 100.0f;
+            peak = fmaxf(peak, amps);
+            if (fabsf(amps - setpoint) > band) {
+                result.settle_s = t_ms / 1000.0f;
+            }
+            if (t_ms >= (TUNE_LOOP_S - TUNE_RIPPLE_WINDOW_S) * 1000) {
+                ripple_min = fminf(ripple_min, amps);
+                ripple_max = fmaxf(ripple_max, amps);
+            }
+            frequency = (uint16_t) pi_controller_update(&pi, sample_0_01(setpoint), measured, TUNE_PERIOD_MS);
+        }
+        plant.freq_cmd_hz = frequency / 100.0f;
+        plant_model_step(&plant, TUNE_PLANT_STEP_MS / 1000.0f);
+    }
+    result.overshoot_pct = peak > setpoint ? (peak - setpoint) / (setpoint - PRECHARGE_AMPS) * 100.0f : 0.0f;
+    result.ripple_pp = ripple_max - ripple_min;
+    return result;
+}
+
+static void print_loop(const char* gains, const tune_loop_result_t& r) {
+    printf("    %-9s settle %5.1f s  overshoot %4.1f %%  ripple %.2f A p-p\n", gains, r.settle_s, r.overshoot_pct,
+           r.ripple_pp);
+}
+
+static void check_profile(const char* name, const BatteryType* battery) {
+    printf("  %s\n", name);
+    float gain = 0.0f;
+    pi_autotune_t tune = run_relay(battery, &gain);
+    CHECK_EQ(tune.state, PI_AUTOTUNE_DONE);
+    pi_gains_t tuned;
+    CHECK(pi_autotune_gains(&tune, &tuned));
+    printf("    G %.2f A/Hz  Ku %.3f Hz/A (Ku*G %.2f)  Tu %.2f s  kp %.4f ki %.4f\n", gain, tune.ku,
+           tune.ku * gain, tune.tu_s, tuned.kp_q16 / 65536.0f, tuned.ki_q16 / 65536.0f);
+    CHECK(tune.ku * gain >= 0.5f);
+    CHECK(tune.ku * gain <= 2.0f);
+    CHECK(tune.tu_s >= 2.0f * TUNE_PERIOD_MS / 1000.0f);
+    CHECK(tune.tu_s * PI_AUTOTUNE_CYCLES < PI_AUTOTUNE_TIMEOUT_MS / 1000.0f);
+
+    // Scheduled gains first, then the tuned ones through the gain store as the next charge
+    // of this profile would see them
+    CHECK(!pi_tuning_load(battery));
+    tune_loop_result_t scheduled = run_loop(battery, pi_gains_for_profile(battery, PI_MODE_CC));
+    pi_tuning_update(battery, &tune);
+    tune_loop_result_t loop = run_loop(battery, pi_gains_for_profile(battery, PI_MODE_CC));
+    pi_tuning_clear_all();
+    print_loop("scheduled", scheduled);
+    print_loop("tuned", loop);
+
+    // Settled without a limit cycle: ripple within a few counts of the frequency command
+    CHECK(loop.settle_s <= scheduled.settle_s);
+    CHECK(loop.overshoot_pct <= 10.0f);
+    CHECK(loop.ripple_pp <= scheduled.ripple_pp + TUNE_QUANTUM);
+    CHECK(loop.ripple_pp <= TUNE_FREQ_COUNTS * gain * 0.01f + TUNE_QUANTUM);
+}
+
+int main(int argc, char** argv) {
+    (void) argc;
+    (void) argv;
+    host_serial_quiet = true;
+    printf("relay auto-tune at the CC current, then PRECHARGE_AMPS -> CC with the tuned gains\n");
+
+    BatteryType lead75(LEAD_ACID, 12, 75, 16, 45.0, "Lead 75Ah");
+    BatteryType lead195(LEAD_ACID, 12, 195, 16, 117.0, "Lead 195Ah");
+    BatteryType lead10(LEAD_ACID, 12, 10, 16.0, 6.0, "Lead 10Ah");
+    check_profile("CC 45 A, 12 V 75 Ah lead", &lead75);
+    check_profile("CC 117 A, 12 V 195 Ah lead", &lead195);
+    check_profile("CC 6 A, 12 V 10 Ah lead", &lead10);
+    return test_summary("pi_autotune");
+}
@@ -0,0 +1,197 @@
+#include "test_util.h"
+#include "pi_controller.h"
+#include "plant_sim.h"
+#include "rs485_vfdComs.h"
+#include "charge_controller.h"
+
+// ============================================================================
+// Closed loop on the plant model: PI controller vs the old step ladder
+// ============================================================================
+/*
+The plant is plant_model_step() from plant_sim.cpp (VFD ramp, generator EMF into
+the pack through R0 + one RC branch). M2 samples it every 100 ms in 0.01 units.
+The PI runs as the control task does (10 Hz, scheduled gains, slew limit, bumpless
+start); the ladder is the former rs485_CalcFrequencyFor_CC/CV at once per second.
+Each run starts settled at PRECHARGE_AMPS and then steps the setpoint:
+  CC: the profile's constant current
+  CV: the cutoff voltage, on a pack at 80 % SOC
+Reported: rise time (first time within 10 % of the step), overshoot past the
+setpoint, settling time (last time outside 5 % of the step) and the peak-to-peak/RMS
+ripple over the last 60 s.
+*/
+
+// rs485_vfdComs.cpp glue the plant model does not need in this build
+void can_dispatch_frame(const twai_message_t* message) {
+    (void) message;
+}
+
+#define LOOP_PLANT_STEP_MS   10
+#define LOOP_SAMPLE_MS       100
+#define LOOP_PI_PERIOD_MS    100   // CHARGE_CONTROL_PERIOD_MS (charge_control.h brings in the task)
+#define LOOP_LADDER_MS       1000
+#define LOOP_DURATION_S      600
+#define LOOP_RIPPLE_WINDOW_S 60
+#define LOOP_SETTLE_BAND     0.05f   // Of the step
+#define LOOP_QUANTUM         0.01f   // One count of the M2 measurement
+
+// The step ladder the PI replaced, as it was in rs485_vfdComs.cpp
+static uint16_t ladder_cc(uint16_t frequency, uint16_t target, uint16_t actual) {
+    int32_t error = (int32_t) actual - (int32_t) target;
+    uint32_t abs_error = error < 0 ? -error : error;
+    uint32_t percent = target > 0 ? (abs_error * 100) / target : 100;
+    if (percent > 100) percent = 100;
+    int16_t offset = 0;
+    if (error != 0) {
+        offset = (percent >= 90 || (error < 0 && actual == 0)) ? RS485_CALC_FREQ_COND05 :
+                 percent >= 70 ? RS485_CALC_FREQ_COND04 :
+                 percent >= 50 ? RS485_CALC_FREQ_COND01 :
+                 percent >= 30 ? RS485_CALC_FREQ_COND02 :
+                 percent >= 10 ? RS485_CALC_FREQ_COND03 : RS485_CALC_FREQ_COND00;
+        if (error > 0) {
+            offset = -offset;
+        }
+    }
+    int32_t next = (int32_t) frequency + offset;
+    return (uint16_t)(next < RS485_FREQ_MIN ? RS485_FREQ_MIN : next > RS485_FREQ_MAX ? RS485_FREQ_MAX : next);
+}
+
+static uint16_t ladder_cv(uint16_t frequency, uint16_t target, uint16_t actual) {
+    int32_t error = (int32_t) actual - (int32_t) target;
+    uint32_t abs_error = error < 0 ? -error : error;
+    int16_t offset = 0;
+    if (error < 0) {
+        offset = abs_error >= RS485_ERROR_VOLTAGE_LARGE ? RS485_CALC_FREQ_COND01 :
+                 abs_error >= RS485_ERROR_VOLTAGE_MID ? RS485_CALC_FREQ_COND02 :
+                 abs_error >= RS485_ERROR_VOLTAGE_SMALL ? RS485_CALC_FREQ_COND03 : RS485_CALC_FREQ_COND00;
+    } else if (error > 0) {
+        offset = abs_error >= RS485_ERROR_VOLTAGE_REV ? RS485_CALC_FREQ_COND11 :
+                 frequency > RS485_CALC_FREQ_COND12 ? RS485_CALC_FREQ_COND12 : RS485_CALC_FREQ_COND13;
+        offset = -offset;
+    }
+    int32_t next = (int32_t) frequency + offset;
+    return (uint16_t)(next < RS485_FREQ_MIN ? RS485_FREQ_MIN : next > RS485_FREQ_MAX ? RS485_FREQ_MAX : next);
+}
+
+typedef enum { LOOP_PI, LOOP_LADDER } loop_law_t;
+
+typedef struct {
+    float rise_s;        // < 0: never reached
+    float overshoot_pct;
+    float settle_s;
+    float ripple_pp;     // Measurement units (A or V)
+    float ripple_rms;
+} loop_result_t;
+
+// Plant settled at PRECHARGE_AMPS (same frequency for both laws)
+static uint16_t settle_precharge(plant_model_t* plant) {
+    plant->contactor_closed = true;
+    plant->vfd_running = true;
+    float internal_v = plant->terminal_v;
+    float emf = internal_v + PRECHARGE_AMPS * (PLANT_SIM_GEN_R_OHM + plant->r0_ohm + plant->r1_ohm);
+    float hz = emf / plant->ke_v_per_hz;
+    plant->freq_cmd_hz = hz;
+    plant->freq_hz = hz;
+    plant->v_rc = PRECHARGE_AMPS * plant->r1_ohm;
+    plant_model_step(plant, 0.001f);
+    return (uint16_t)(hz * 100.0f + 0.5f);
+}
+
+static loop_result_t run_loop(const BatteryType* battery, float soc_pct, pi_mode_t mode, loop_law_t law) {
+    plant_model_t plant;
+    plant_model_init(&plant, battery, soc_pct);
+    uint16_t frequency = settle_precharge(&plant);
+
+    bool voltage_loop = (mode == PI_MODE_CV);
+    float setpoint = voltage_loop ? battery->getCutoffVoltage() : battery->getConstCurrent();
+    uint16_t setpoint_0_01 = (uint16_t)(setpoint * 100.0f + 0.5f);
+    float start = voltage_loop ? plant.terminal_v : plant.current_a;
+
+    pi_controller_t pi;
+    pi_controller_init(&pi, pi_gains_for_profile(battery, mode), RS485_FREQ_MIN, RS485_FREQ_MAX,
+                       (CHARGE_FREQ_SLEW_PER_S * LOOP_PI_PERIOD_MS + 999) / 1000);
+    uint16_t measured_0_01 = (uint16_t)((voltage_loop ? plant.terminal_v : plant.current_a) * 100.0f + 0.5f);
+    pi_controller_bumpless(&pi, frequency, setpoint_0_01, measured_0_01);
+
+    loop_result_t result = { -1.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    float peak = start;
+    float ripple_min = 1e9f;
+    float ripple_max = -1e9f;
+    double ripple_sq = 0.0;
+    int ripple_n = 0;
+    const float band = fabsf(setpoint - start) * LOOP_SETTLE_BAND;
+
+    for (uint32_t t_ms = 0; t_ms < LOOP_DURATION_S * 1000; t_ms += LOOP_PLANT_STEP_MS) {
+        if (t_ms % LOOP_SAMPLE_MS == 0) {
+            float value = voltage_loop ? plant.terminal_v : plant.current_a;
+            measured_0_01 = (uint16_t)(value * 100.0f + 0.5f);
+            float measured = measured_0_01 / 100.0f;
+            float t_s = t_ms / 1000.0f;
+
+            if (result.rise_s < 0 && fabsf(setpoint - measured) <= 0.1f * fabsf(setpoint - start)) {
+                result.rise_s = t_s;
+            }
+            if (measured > peak) {
+                peak = measured;
+            }
+            if (fabsf(measured - setpoint) > band) {
+                result.settle_s = t_s;
+            }
+            if (t_ms >= (LOOP_DURATION_S - LOOP_RIPPLE_WINDOW_S) * 1000) {
+                ripple_min = fminf(ripple_min, measured);
+                ripple_max = fmaxf(ripple_max, measured);
+                ripple_sq += (double)(measured - setpoint) * (measured - setpoint);
+                ripple_n++;
+            }
+        }
+        if (law == LOOP_PI && t_ms % LOOP_PI_PERIOD_MS == 0) {
+            frequency = (uint16_t) pi_controller_update(&pi, setpoint_0_01, measured_0_01, LOOP_PI_PERIOD_MS);
+        } else if (law == LOOP_LADDER && t_ms % LOOP_LADDER_MS == 0) {
+            frequency = voltage_loop ? ladder_cv(frequency, setpoint_0_01, measured_0_01)
+                                     : ladder_cc(frequency, setpoint_0_01, measured_0_01);
+        }
+        plant.freq_cmd_hz = frequency / 100.0f;
+        plant_model_step(&plant, LOOP_PLANT_STEP_MS / 1000.0f);
+    }
+
+    result.overshoot_pct = peak > setpoint ? (peak - setpoint) / fabsf(setpoint - start) * 100.0f : 0.0f;
+    result.ripple_pp = ripple_max - ripple_min;
+    result.ripple_rms = ripple_n > 0 ? (float) sqrt(ripple_sq / ripple_n) : 0.0f;
+    return result;
+}
+
+static void print_result(const char* law, const loop_result_t& r, const char* unit) {
+    printf("    %-6s rise %6.1f s  overshoot %5.1f %%  settle %6.1f s  ripple %.2f %s p-p, %.3f %s rms\n",
+           law, r.rise_s, r.overshoot_pct, r.settle_s, r.ripple_pp, unit, r.ripple_rms, unit);
+}
+
+static void compare(const char* name, const BatteryType* battery, float soc_pct, pi_mode_t mode) {
+    const char* unit = (mode == PI_MODE_CV) ? "V" : "A";
+    loop_result_t pi = run_loop(battery, soc_pct, mode, LOOP_PI);
+    loop_result_t ladder = run_loop(battery, soc_pct, mode, LOOP_LADDER);
+    printf("  %s\n", name);
+    print_result("PI", pi, unit);
+    print_result("ladder", ladder, unit);
+
+    CHECK(pi.rise_s >= 0);
+    CHECK(pi.rise_s <= ladder.rise_s || ladder.rise_s < 0);
+    CHECK(pi.settle_s <= ladder.settle_s);
+    CHECK(pi.overshoot_pct <= 10.0f);
+    CHECK(pi.ripple_pp <= ladder.ripple_pp + LOOP_QUANTUM * 1.5f);
+}
+
+int main(int argc, char** argv) {
+    (void) argc;
+    (void) argv;
+    host_serial_quiet = true;
+    printf("closed loop, precharge -> setpoint step (%d s runs)\n", LOOP_DURATION_S);
+
+    BatteryType lifepo(LIFEPO4, 12, 280, 14.5, 150.0, "LiFePO4 280Ah");
+    BatteryType lead75(LEAD_ACID, 12, 75, 16, 45.0, "Lead 75Ah");
+    BatteryType lead20(LEAD_ACID, 24, 20, 31.2, 12.0, "Lead 24V 20Ah");
+    compare("CC 150 A, 12 V 280 Ah LiFePO4", &lifepo, 30.0f, PI_MODE_CC);
+    compare("CC 45 A, 12 V 75 Ah lead", &lead75, 30.0f, PI_MODE_CC);
+    compare("CC 12 A, 24 V 20 Ah lead", &lead20, 30.0f, PI_MODE_CC);
+    compare("CV 16.0 V, 12 V 75 Ah lead at 80 %", &lead75, 80.0f, PI_MODE_CV);
+    compare("CV 31.2 V, 24 V 20 Ah lead at 80 %", &lead20, 80.0f, PI_MODE_CV);
+    return test_summary("pi_loop");
+}
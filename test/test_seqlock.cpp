@@ -0,0 +1,142 @@
+#include "test_util.h"
+#include "seqlock.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// seqlock.h: torn-read stress test (one writer, several readers) + throughput
+// ============================================================================
+/*
+Every published value is derived from a single counter, so a reader can tell
+a consistent copy from one mixed out of two writes. Readers also check that
+versions never go backwards and match the counter they carry.
+*/
+
+#define STRESS_WRITES   2000000
+#define STRESS_READERS  3
+
+typedef struct {
+    uint32_t counter;
+    float voltage;
+    float current;
+    uint32_t words[10];
+    uint32_t check;
+} stress_value_t;
+
+static stress_value_t make_value(uint32_t n) {
+    stress_value_t v;
+    v.counter = n;
+    v.voltage = (float)(n & 0xFFFF) * 0.01f;
+    v.current = -(float)(n & 0xFFFF) * 0.5f;
+    uint32_t check = n;
+    for (int i = 0; i < 10; i++) {
+        v.words[i] = n * 2654435761u + (uint32_t) i;
+        check ^= v.words[i];
+    }
+    v.check = check;
+    return v;
+}
+
+static bool consistent(const stress_value_t& v) {
+    stress_value_t expected = make_value(v.counter);
+    return memcmp(&v, &expected, sizeof(v)) == 0;
+}
+
+static void test_single_thread(void) {
+    printf("single thread\n");
+    Seqlock<stress_value_t> lock;
+    stress_value_t out;
+    CHECK_EQ(lock.version(), 1);  // The constructor publishes T{}
+    CHECK_EQ(lock.read(&out), 1);
+    CHECK_EQ(out.counter, 0);
+
+    lock.write(make_value(42));
+    CHECK_EQ(lock.version(), 2);
+    CHECK_EQ(lock.read(&out), 2);
+    CHECK(consistent(out));
+    CHECK_EQ(out.counter, 42);
+}
+
+static void test_torn_reads(void) {
+    printf("torn reads: %d writes, %d readers\n", STRESS_WRITES, STRESS_READERS);
+    Seqlock<stress_value_t> lock;
+    lock.write(make_value(1));  // Version 2 carries counter 1 from here on
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> reads(0);
+    std::atomic<uint64_t> torn(0);
+    std::atomic<uint64_t> backwards(0);
+    std::atomic<uint64_t> mislabelled(0);
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < STRESS_READERS; r++) {
+        readers.emplace_back([&]() {
+            uint64_t local_reads = 0;
+            uint32_t last_version = 0;
+            stress_value_t out;
+            while (!done.load(std::memory_order_relaxed)) {
+                uint32_t version = lock.read(&out);
+                local_reads++;
+                if (!consistent(out)) {
+                    torn.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (version < last_version) {
+                    backwards.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (out.counter + 1 != version) {
+                    mislabelled.fetch_add(1, std::memory_order_relaxed);
+                }
+                last_version = version;
+            }
+            reads.fetch_add(local_reads, std::memory_order_relaxed);
+        });
+    }
+
+    uint64_t t0 = test_now_ns();
+    for (uint32_t n = 2; n <= STRESS_WRITES; n++) {
+        lock.write(make_value(n));
+    }
+    uint64_t t1 = test_now_ns();
+    done.store(true, std::memory_order_relaxed);
+    for (std::thread& t : readers) {
+        t.join();
+    }
+
+    printf("  %llu reads in %.0f ms\n", (unsigned long long) reads.load(), (double)(t1 - t0) / 1e6);
+    CHECK(reads.load() > 0);
+    CHECK_EQ(torn.load(), 0);
+    CHECK_EQ(backwards.load(), 0);
+    CHECK_EQ(mislabelled.load(), 0);
+    CHECK_EQ(lock.version(), STRESS_WRITES + 1);
+}
+
+static void bench_seqlock(void) {
+    const int rounds = 10000000;
+    Seqlock<stress_value_t> lock;
+    stress_value_t value = make_value(7);
+    stress_value_t out;
+
+    uint64_t t0 = test_now_ns();
+    for (int r = 0; r < rounds; r++) {
+        value.counter = (uint32_t) r;
+        lock.write(value);
+    }
+    uint64_t t1 = test_now_ns();
+    uint32_t acc = 0;
+    for (int r = 0; r < rounds; r++) {
+        acc += lock.read(&out);
+    }
+    uint64_t t2 = test_now_ns();
+    test_keep(acc);
+    printf("seqlock benchmark (%zu byte value, uncontended)\n", sizeof(stress_value_t));
+    printf("  write %.1f ns  read %.1f ns\n", (double)(t1 - t0) / rounds, (double)(t2 - t1) / rounds);
+}
+
+int main(int argc, char** argv) {
+    test_single_thread();
+    test_torn_reads();
+    if (test_bench_requested(argc, argv)) {
+        bench_seqlock();
+    }
+    return test_summary("seqlock");
+}
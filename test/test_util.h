@@ -0,0 +1,64 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+
+// ============================================================================
+// Minimal host test helpers (no framework: one executable per module)
+// ============================================================================
+/*
+CHECK* log the failing expression and keep going; test_summary() prints the
+tally and gives main() its exit code. Benchmarks only run with --bench so
+"make test" stays fast.
+*/
+
+static int test_checks = 0;
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+    test_checks++; \
+    if (!(cond)) { \
+        test_failures++; \
+        printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+    } \
+} while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+    test_checks++; \
+    long long a_ = (long long)(actual); \
+    long long e_ = (long long)(expected); \
+    if (a_ != e_) { \
+        test_failures++; \
+        printf("  FAIL %s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+    } \
+} while (0)
+
+static inline bool test_bench_requested(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline uint64_t test_now_ns(void) {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Keeps the optimiser from dropping a benchmark loop
+template <typename T>
+static inline void test_keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+static inline int test_summary(const char* name) {
+    printf("[%s] %d checks, %d failed\n", name, test_checks, test_failures);
+    return test_failures == 0 ? 0 : 1;
+}
+
+#endif // TEST_UTIL_H